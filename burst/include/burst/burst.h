@@ -0,0 +1,70 @@
+/*===========================================================================
+ * burst/burst.h
+ *
+ * Detection and buffering of bursts of keystrokes, such as those from a
+ * barcode scanner that presents itself as a USB keyboard. A scanner can 
+ * type a hundred characters in a few tens of milliseconds -- far faster
+ * than the display can show them one at a time. So, when keystrokes from
+ * one device arrive closer together than a person could type them, we
+ * collect them in a buffer, and hand the whole buffer to the application
+ * when the burst ends. The application can then display it in a single
+ * batched update.
+ *
+ * The first keystroke of a burst can't be recognized as such, and is 
+ * handled as an ordinary keystroke. This means that ordinary typing is
+ * never delayed.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <i2c_lcd/i2c_lcd.h>
+
+typedef struct _BURST BURST;
+
+// Called with the contents of the buffer when a burst ends
+typedef void (*BURST_FLUSH_FN) (const char *s, int n, void *context);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Create a burst detector. Keystrokes less than gap_us apart, from the
+    same device, are treated as a burst. Up to max_chars characters are
+    buffered -- if a burst is longer than this, it is handed over in
+    several pieces. */
+extern BURST *burst_new (int max_chars, uint32_t gap_us, 
+                 BURST_FLUSH_FN flush, void *context);
+extern void   burst_destroy (BURST *self);
+
+/** Offer a printable character to the burst detector, with the device
+    it came from and the time it arrived. Returns TRUE if the character
+    has been buffered as part of a burst. If it returns FALSE, the
+    caller should handle the character itself. Any burst that this
+    character does not belong to is flushed first. */
+extern BOOL   burst_add (BURST *self, int dev, uint32_t time_us, char c);
+
+/** Hand over anything in the buffer now. This should be called before
+    handling any keystroke that is not offered to burst_add() -- a
+    terminator like Enter, for example. */
+extern void   burst_flush (BURST *self);
+
+/** If a burst is in progress, set *end_us to the time at which it will
+    end, if no more characters arrive, and return TRUE. */
+extern BOOL   burst_pending (const BURST *self, uint32_t *end_us);
+
+/** Flush the buffer if the burst has ended, at time now_us. */
+extern void   burst_check (BURST *self, uint32_t now_us);
+
+/** Total number of characters that have been buffered as bursts, and
+    number of bursts. */
+extern uint32_t burst_chars (const BURST *self);
+extern uint32_t burst_count (const BURST *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+
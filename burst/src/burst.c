@@ -0,0 +1,127 @@
+/*===========================================================================
+ * burst/burst.c
+ *
+ * Detection and buffering of bursts of keystrokes. See burst.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdlib.h>
+#include <burst/burst.h>
+
+struct _BURST
+  {
+  int max_chars;
+  uint32_t gap_us;
+  BURST_FLUSH_FN flush;
+  void *context;
+  char *buffer;
+  int len;
+  int last_dev;       // Device that sent the last character, or -1
+  uint32_t last_us;   // Time the last character arrived
+  uint32_t chars;
+  uint32_t bursts;
+  };
+
+/*===========================================================================
+ * burst_new
+ * ========================================================================*/
+BURST *burst_new (int max_chars, uint32_t gap_us, BURST_FLUSH_FN flush,
+         void *context)
+  {
+  BURST *self = malloc (sizeof (BURST));
+  self->max_chars = max_chars;
+  self->gap_us = gap_us;
+  self->flush = flush;
+  self->context = context;
+  self->buffer = malloc (max_chars);
+  self->len = 0;
+  self->last_dev = -1;
+  self->last_us = 0;
+  self->chars = 0;
+  self->bursts = 0;
+  return self;
+  }
+
+/*===========================================================================
+ * burst_flush
+ * ========================================================================*/
+void burst_flush (BURST *self)
+  {
+  if (self->len == 0) return;
+  // Clear the buffer before calling back, in case the callback calls us
+  int len = self->len;
+  self->len = 0;
+  self->flush (self->buffer, len, self->context);
+  }
+
+/*===========================================================================
+ * burst_add
+ * ========================================================================*/
+BOOL burst_add (BURST *self, int dev, uint32_t time_us, char c)
+  {
+  BOOL close = (dev == self->last_dev 
+                && time_us - self->last_us <= self->gap_us);
+  self->last_dev = dev;
+  self->last_us = time_us;
+
+  if (!close)
+    {
+    // Not part of any burst in progress. It might be the start of a new
+    //   one, but we can't tell yet.
+    burst_flush (self);
+    return FALSE;
+    }
+
+  if (self->len == 0) self->bursts++;
+  if (self->len == self->max_chars) burst_flush (self);
+  self->buffer[self->len++] = c;
+  self->chars++;
+  return TRUE;
+  }
+
+/*===========================================================================
+ * burst_pending
+ * ========================================================================*/
+BOOL burst_pending (const BURST *self, uint32_t *end_us)
+  {
+  if (self->len == 0) return FALSE;
+  *end_us = self->last_us + self->gap_us;
+  return TRUE;
+  }
+
+/*===========================================================================
+ * burst_check
+ * ========================================================================*/
+void burst_check (BURST *self, uint32_t now_us)
+  {
+  if (self->len > 0 && (int32_t)(now_us - self->last_us) > 
+        (int32_t)self->gap_us)
+    burst_flush (self);
+  }
+
+/*===========================================================================
+ * burst_chars
+ * ========================================================================*/
+uint32_t burst_chars (const BURST *self)
+  {
+  return self->chars;
+  }
+
+/*===========================================================================
+ * burst_count
+ * ========================================================================*/
+uint32_t burst_count (const BURST *self)
+  {
+  return self->bursts;
+  }
+
+/*===========================================================================
+ * burst_destroy
+ * ========================================================================*/
+void burst_destroy (BURST *self)
+  {
+  free (self->buffer);
+  free (self);
+  }
+
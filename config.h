@@ -13,6 +13,97 @@
 //   increasing this, except memory.
 #define SCROLLBACK_PAGES 10
 
+// Rows of the display set aside as a status line, which doesn't scroll.
+//   The status line shows the console number and the time since 
+//   start-up. STATUS_AT_TOP puts it at the top of the display, rather
+//   than the bottom. On a two-line display, a status line leaves only 
+//   one line for text, so the default is no status line.
+#define STATUS_ROWS 0
+#define STATUS_AT_TOP 1
+
+// The number of virtual consoles, switched with Alt+F1, Alt+F2, etc. 
+//   Each has its own scrollback buffer, of SCROLLBACK_PAGES, and line 
+//   editor. Consoles that are not on the display are updated only in
+//   RAM. Set to 1 for a single console.
+#define NUM_CONSOLES 4
+
+// The time, in microseconds, that switching consoles should take -- 
+//   about one frame at 60Hz. Switches that take longer are counted
+//   ('v' on the serial console).
+#define CONSOLE_SWITCH_BUDGET_US 16667
+
+// The number of 4kB flash sectors, at the end of flash, used to keep a 
+//   journal of the lines in the scrollback buffer, so that they survive
+//   a reset. Each sector holds about 16 pages of lines, and sectors are
+//   erased in rotation, so more sectors means less wear. Zero, the 
+//   default, turns the journal off; 16 is a sensible value to turn it 
+//   on. Erasing a sector takes about 50ms with interrupts disabled, 
+//   which is over STALL_BUDGET_US, so each erase will be recorded as a 
+//   slow task unless STALL_BUDGET_US is raised to about 60000. 
+#define JOURNAL_SECTORS 0
+
+// The number of completed lines that can wait in RAM to be written to
+//   the journal. If more lines than this arrive while the keyboard is 
+//   busy, the oldest are not journalled.
+#define JOURNAL_RAM_LINES 64
+
+// The journal is only written to flash when there have been no 
+//   keystrokes for this many milliseconds, because the Pico can't
+//   take interrupts while it writes or erases flash. Full pages of lines
+//   are written after JOURNAL_QUIET_MS, and a part-filled page after 
+//   JOURNAL_FLUSH_MS.
+#define JOURNAL_QUIET_MS 250
+#define JOURNAL_FLUSH_MS 2000
+
+// Mirroring of the display to a host, over the serial console -- see
+//   mirror/mirror.h, and tools/lcd_mirror. The 'm' command turns it on 
+//   and off; MIRROR_AT_BOOT turns it on from the start. Changes are 
+//   collected for MIRROR_INTERVAL_MS and sent as one frame, of no more
+//   than MIRROR_MAX_BYTES. The UART blocks while it sends, so this is kept
+//   small: 64 bytes take about 5.5ms at 115200 baud. A key frame, which
+//   sends the whole screen again, goes out every MIRROR_KEY_FRAME_MS, so
+//   a viewer that starts late, or loses something, catches up.
+#define MIRROR_AT_BOOT 0
+#define MIRROR_INTERVAL_MS 50
+#define MIRROR_MAX_BYTES 64
+#define MIRROR_KEY_FRAME_MS 10000
+
+// The 'x' command exports the scrollback buffer of the console that's
+//   showing, compressed, over the serial console -- see export/export.h,
+//   and tools/export_decode. It goes out a frame at a time, each with up
+//   to EXPORT_CHUNK_BYTES of compressed data (a third as much again, as
+//   base64), so keystrokes are dealt with in between.
+#define EXPORT_CHUNK_BYTES 48
+
+// How the display is connected. LCD_BUS_I2C is the usual PCF8574 I2C
+//   backpack. LCD_BUS_GPIO is an HD44780 wired directly to the Pico's
+//   GPIO pins (see LCD_GPIO_ below), which is much faster. LCD_BUS_MOCK
+//   is no display at all -- the output is kept in memory.
+#define LCD_BUS_I2C  0
+#define LCD_BUS_GPIO 1
+#define LCD_BUS_MOCK 2
+#define LCD_BUS LCD_BUS_I2C
+
+// GPIO pins for LCD_BUS_GPIO. The HD44780 is used in 4-bit mode, and its
+//   data lines D4-D7 go to four consecutive pins, starting at LCD_GPIO_D4.
+//   RW should be tied to ground. Set LCD_GPIO_BACKLIGHT to -1 if the 
+//   backlight is not switched by the Pico. A 40x4 panel has two 
+//   controllers, with an enable line each: the second goes to 
+//   LCD_GPIO_E2, which is -1 for a panel with one. (On the I2C bus, see
+//   LCD_I2C_DUAL.)
+#define LCD_GPIO_RS 6
+#define LCD_GPIO_E 7
+#define LCD_GPIO_E2 -1
+#define LCD_GPIO_D4 8
+#define LCD_GPIO_BACKLIGHT -1
+
+// Set to 1 for a 40x4 panel, with two controllers, on the I2C bus. The
+//   second controller's enable line must be wired to the backpack's RW
+//   pin (I2C_LCD_RW, in i2c_lcd.h), and the panel's RW pin tied to 
+//   ground. With 0, the backpack's RW pin is held low, and the panel is
+//   driven as one controller, of at most 80 characters.
+#define LCD_I2C_DUAL 0
+
 // The I2C address of the I2C LCD device. Common values are 0x27 and 0x3F. 
 // Some devices can have their I2C addresses set using jumpers.
 #define I2C_LCD_ADDRESS 0x27
@@ -21,8 +112,85 @@
 //   this could usefully be set higher.
 #define I2C_BAUD 100000
 
-// The size of the LCD. Common sizes are 16x2, 20x4 and 40x2
+// The fastest I2C baud rate to try. At start-up, the bus is stepped up 
+//   from I2C_BAUD through the standard rates (400k, 1M) as far as this
+//   limit, and the fastest rate at which the I2C backpack responds 
+//   reliably is used. If errors appear later, the rate is stepped back
+//   down. Set this to I2C_BAUD to stay at I2C_BAUD.
+#define I2C_BAUD_MAX 1000000
+
+// The size of the LCD. Common sizes are 16x2, 20x4, 40x2 and 40x4
 #define LCD_WIDTH  16
 #define LCD_HEIGHT 2
 
+// The longest line that the line editor will accept. In practice, the
+//   line is also limited to what will fit on the display.
+#define LINE_EDIT_MAX 80
+
+// The number of previous lines that the line editor remembers, for
+//   recall using the up and down arrow keys.
+#define LINE_EDIT_HISTORY 8
+
+// Size, in bytes, of the RAM buffer that records raw HID reports from
+//   the keyboard. Each keystroke takes about 24 bytes (one report for
+//   the key press, and one for the release). Enter 't' on the serial
+//   console to dump the trace. Set to zero to disable tracing.
+#define HID_TRACE_BYTES 4096
+
+// Size, in bytes, of the RAM buffer that records every transfer on the
+//   display's I2C bus, for tools/i2c_vcd. Enter 'I' on the serial 
+//   console to dump the trace and start a new one. A character takes 
+//   four bytes at 100k baud, more at higher rates, so 4096 bytes holds
+//   several screens. Dumping that much takes about 0.7s, during which 
+//   nothing else runs. Set to zero, as it is by default, to disable 
+//   tracing, which then costs one test per transfer.
+#define I2C_TRACE_BYTES 0
+
+// The longest time, in milliseconds, that the main loop will sleep when
+//   it is idle. The loop is woken by interrupts and timers, so this
+//   is only a safety net.
+#define LOOP_MAX_SLEEP_MS 100
+
+// The hardware watchdog resets the Pico if a pass of the main loop
+//   takes longer than STALL_WATCHDOG_MS, and what was running is 
+//   printed after the reset ('w' on the serial console shows it again).
+//   This must be well over LOOP_MAX_SLEEP_MS, and no more than 8000; 
+//   zero turns the watchdog off. Any task that takes longer than 
+//   STALL_BUDGET_US is recorded, with the time between tasks, so there 
+//   is a history of what was slow before the reset.
+#define STALL_WATCHDOG_MS 2000
+#define STALL_BUDGET_US 50000
+
+// The display and its backlight are turned off when no key has been
+//   pressed for IDLE_SLEEP_MS; zero keeps them on. Any keystroke, or
+//   anything printed to the console that's showing, turns them on
+//   again, with what was on the screen. The backpack's backlight is
+//   either on or off, so there is no dimming.
+#define IDLE_SLEEP_MS 300000
+
+// If this is 1, the keystroke that wakes the display is thrown away,
+//   so that a key pressed just to see the screen doesn't type anything.
+//   Leave it at 0 if a barcode scanner is used, or the first character
+//   of the first scan after a quiet spell will be lost.
+#define IDLE_SWALLOW_WAKE_KEY 0
+
+// The number of keystrokes that can be queued between the USB callback
+//   and the display. Keystrokes that arrive when the queue is full are
+//   dropped (and counted).
+#define KEY_QUEUE_SIZE 64
+
+// How long the display task should take, in microseconds, to deal with
+//   the keystrokes in the queue. Taking longer than this is counted as 
+//   an overrun in the task statistics ('s' on the serial console).
+#define DISPLAY_BUDGET_US 20000
+
+// Keystrokes from the same device that arrive less than this many 
+//   microseconds apart are treated as a burst -- typically from a barcode
+//   scanner -- and displayed all at once when the burst ends. Even a very
+//   fast typist rarely gets below 30,000us between keystrokes.
+#define BURST_GAP_US 5000
+
+// The number of characters buffered during a burst. Longer bursts are
+//   displayed in pieces of this size.
+#define BURST_MAX_CHARS 128
 
@@ -0,0 +1,93 @@
+/*===========================================================================
+ * export/export.h
+ *
+ * Export of a console's scrollback buffer over the serial console, for
+ * getting the history off the device after something has gone wrong.
+ * Each logical line -- a line as it was printed, however many rows it
+ * wrapped on to -- is sent with its trailing spaces removed, and a 
+ * newline, and the resulting text is compressed as it goes. The export 
+ * is done a frame at a time, by repeated calls to export_work(), so that
+ * the application can carry on dealing with the keyboard in between.
+ *
+ * Lines are identified by their line numbers (see
+ * i2c_lcd_first_line()), so the display can go on scrolling
+ * during an export. The export covers the lines that were in the buffer
+ * when it started; any of them that scroll out of the buffer before
+ * they are sent are lost, and counted.
+ *
+ * Like the display mirror's frames, every frame is a line of printable
+ * ASCII starting with '@':
+ *
+ *   @SB <console> <width> <lines>
+ *     The start of an export of 'lines' lines of the given console, 
+ *     whose display is 'width' characters wide.
+ *
+ *   @SD<seq> <base64>
+ *     Compressed data. seq goes from 0 to 255 and round again.
+ *
+ *   @SE <lines> <lost> <bytes> <crc>
+ *     The end of the export: lines sent, lines lost, and the length and
+ *     CRC-32 (hex) of the uncompressed text.
+ *
+ * The compressed data is a byte stream, which runs on from one data
+ * frame to the next. It is an LZ77 variant, made of:
+ *
+ *   0x00-0x7F              the byte itself
+ *   0x80-0xBF, d           a copy of (b & 0x3F) + 3 bytes, starting d + 1
+ *                          bytes back
+ *   0xC0-0xDF, dh, dl      a copy of (b & 0x1F) + 3 bytes, starting
+ *                          (dh << 8 | dl) + 1 bytes back
+ *   0xFF, c                the byte c
+ *
+ * Copies may overlap the bytes they produce. No copy reaches back more
+ * than EXPORT_WINDOW bytes.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <i2c_lcd/i2c_lcd.h>
+
+// How far back a copy can reach
+#define EXPORT_WINDOW 1024
+
+typedef struct _EXPORT EXPORT;
+
+// Called with each frame, including its final newline
+typedef void (*EXPORT_WRITE_FN) (const char *s, int n, void *context);
+
+typedef struct _EXPORT_STATS
+  {
+  uint32_t lines;       // Lines sent
+  uint32_t lost;        // Lines that left the buffer before they were sent
+  uint32_t text_bytes;  // Uncompressed text, without trailing spaces
+  uint32_t data_bytes;  // Compressed data
+  uint32_t frames;
+  uint32_t bytes;       // Bytes written, in all frames
+  } EXPORT_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Start an export of the scrollback buffer of lcd, from its oldest line
+    to the bottom of the display. Each data frame carries up to
+    chunk_bytes bytes of compressed data. console is just a number for
+    the first frame, to say which console this is. Nothing is written
+    until export_work() is called. */
+extern EXPORT *export_new (const I2C_LCD *lcd, int console, int chunk_bytes,
+                 EXPORT_WRITE_FN write, void *context);
+extern void    export_destroy (EXPORT *self);
+
+/** Write the next frame. Returns FALSE once the last frame has been
+    written. */
+extern BOOL    export_work (EXPORT *self);
+
+extern const EXPORT_STATS *export_get_stats (const EXPORT *self);
+
+#ifdef __cplusplus
+}
+#endif
+
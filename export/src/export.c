@@ -0,0 +1,321 @@
+/*===========================================================================
+ * export/export.c
+ *
+ * Export of the scrollback buffer over the serial console. See export.h.
+ *
+ * The compressor keeps the text it has sent in a ring buffer, and finds
+ * earlier copies of what comes next through hash chains: for each
+ * position, the most recent earlier position whose next three bytes had
+ * the same hash. Only the first few links of a chain are followed, so
+ * the time taken for each byte is bounded.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <export/export.h>
+
+// The ring buffer has to hold the window, and the line being compressed
+#define EXPORT_RING 2048
+#define EXPORT_RING_MASK (EXPORT_RING - 1)
+
+#define EXPORT_HASH_SIZE 512
+
+// The most links of a hash chain to follow, for each byte
+#define EXPORT_CHAIN 16
+
+#define EXPORT_MIN_MATCH 3
+#define EXPORT_NEAR_MAX (EXPORT_MIN_MATCH + 0x3F)
+#define EXPORT_FAR_MAX (EXPORT_MIN_MATCH + 0x1F)
+
+struct _EXPORT
+  {
+  const I2C_LCD *lcd;
+  int console;
+  int chunk_bytes;
+  EXPORT_WRITE_FN write;
+  void *context;
+  int width;
+  uint32_t next_line;   // Line number of the next line to send
+  uint32_t end_line;    // Line number after the last line to send
+  BOOL begun;           // The first frame has been written
+  uint8_t seq;
+  uint32_t crc;
+  char *line;
+  uint8_t *ring;        // The text so far
+  uint32_t avail;       // Bytes that have been put in the ring
+  uint32_t encoded;     // Bytes that have been compressed
+  uint32_t hashed;      // Bytes that have been put in the hash chains
+  uint32_t *head;       // Most recent position + 1 for each hash, or 0
+  uint32_t *prev;       // Previous position + 1 with the same hash, or 0
+  uint8_t *out;         // Compressed data waiting to be sent
+  int out_len;
+  char *frame;
+  EXPORT_STATS stats;
+  };
+
+static const char base64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*===========================================================================
+ * crc32_update
+ * ========================================================================*/
+static uint32_t crc32_update (uint32_t crc, const uint8_t *p, int n)
+  {
+  crc = ~crc;
+  for (int i = 0; i < n; i++)
+    {
+    crc ^= p[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+    }
+  return ~crc;
+  }
+
+/*===========================================================================
+ * ring_at
+ * ========================================================================*/
+static uint8_t ring_at (const EXPORT *self, uint32_t pos)
+  {
+  return self->ring[pos & EXPORT_RING_MASK];
+  }
+
+/*===========================================================================
+ * hash_at
+ * ========================================================================*/
+static int hash_at (const EXPORT *self, uint32_t pos)
+  {
+  unsigned h = ring_at (self, pos) * 33u ^ ring_at (self, pos + 1) * 5u
+    ^ ring_at (self, pos + 2);
+  return (int)(h % EXPORT_HASH_SIZE);
+  }
+
+/*===========================================================================
+ * insert_hashes
+ * Put every position before 'upto', that has three bytes after it, in
+ * the hash chains.
+ * ========================================================================*/
+static void insert_hashes (EXPORT *self, uint32_t upto)
+  {
+  while (self->hashed < upto && self->hashed + EXPORT_MIN_MATCH
+           <= self->avail)
+    {
+    int h = hash_at (self, self->hashed);
+    self->prev[self->hashed & EXPORT_RING_MASK] = self->head[h];
+    self->head[h] = self->hashed + 1;
+    self->hashed++;
+    }
+  }
+
+/*===========================================================================
+ * find_match
+ * The longest earlier copy of the bytes at pos. Returns its length, or
+ * zero if there's nothing worth a copy, and sets *dist.
+ * ========================================================================*/
+static int find_match (const EXPORT *self, uint32_t pos, uint32_t *dist)
+  {
+  uint32_t left = self->avail - pos;
+  if (left < EXPORT_MIN_MATCH) return 0;
+  int max = (int)MIN (left, (uint32_t)EXPORT_NEAR_MAX);
+  int best = 0;
+  uint32_t link = self->head[hash_at (self, pos)];
+  for (int i = 0; i < EXPORT_CHAIN && link != 0; i++)
+    {
+    uint32_t cand = link - 1;
+    uint32_t d = pos - cand;
+    if (cand >= pos || d > EXPORT_WINDOW) break;
+    int limit = d > 256 ? MIN (max, EXPORT_FAR_MAX) : max;
+    int len = 0;
+    while (len < limit && ring_at (self, cand + len)
+             == ring_at (self, pos + len))
+      len++;
+    // A far copy costs three bytes, so needs to be longer
+    if (len >= (d > 256 ? EXPORT_MIN_MATCH + 1 : EXPORT_MIN_MATCH)
+         && len > best)
+      {
+      best = len;
+      *dist = d;
+      if (len == max) break;
+      }
+    link = self->prev[cand & EXPORT_RING_MASK];
+    }
+  return best;
+  }
+
+/*===========================================================================
+ * compress
+ * Compress everything in the ring that hasn't been compressed yet.
+ * ========================================================================*/
+static void compress (EXPORT *self)
+  {
+  while (self->encoded < self->avail)
+    {
+    uint32_t pos = self->encoded;
+    insert_hashes (self, pos);
+    uint32_t dist = 0;
+    int len = find_match (self, pos, &dist);
+    if (len == 0)
+      {
+      uint8_t c = ring_at (self, pos);
+      if (c >= 0x80) self->out[self->out_len++] = 0xFF;
+      self->out[self->out_len++] = c;
+      self->encoded++;
+      continue;
+      }
+    if (dist <= 256)
+      {
+      self->out[self->out_len++] = 
+        (uint8_t)(0x80 | (len - EXPORT_MIN_MATCH));
+      self->out[self->out_len++] = (uint8_t)(dist - 1);
+      }
+    else
+      {
+      self->out[self->out_len++] = 
+        (uint8_t)(0xC0 | (len - EXPORT_MIN_MATCH));
+      self->out[self->out_len++] = (uint8_t)((dist - 1) >> 8);
+      self->out[self->out_len++] = (uint8_t)(dist - 1);
+      }
+    self->encoded += (uint32_t)len;
+    }
+  }
+
+/*===========================================================================
+ * add_line
+ * ========================================================================*/
+static void add_line (EXPORT *self, uint32_t number)
+  {
+  int len = i2c_lcd_get_line (self->lcd, number, self->line, 
+    I2C_LCD_LINE_MAX + 1);
+  if (len < 0)
+    {
+    self->stats.lost++;
+    return;
+    }
+  self->line[len++] = '\n';
+
+  for (int i = 0; i < len; i++)
+    self->ring[(self->avail + i) & EXPORT_RING_MASK] 
+      = (uint8_t)self->line[i];
+  self->avail += (uint32_t)len;
+  self->crc = crc32_update (self->crc, (const uint8_t *)self->line, len);
+  self->stats.lines++;
+  self->stats.text_bytes += (uint32_t)len;
+  compress (self);
+  }
+
+/*===========================================================================
+ * emit
+ * ========================================================================*/
+static void emit (EXPORT *self, int len)
+  {
+  self->frame[len++] = '\n';
+  self->write (self->frame, len, self->context);
+  self->stats.frames++;
+  self->stats.bytes += (uint32_t)len;
+  }
+
+/*===========================================================================
+ * emit_data
+ * Send up to chunk_bytes of compressed data, as base64.
+ * ========================================================================*/
+static void emit_data (EXPORT *self)
+  {
+  int n = MIN (self->out_len, self->chunk_bytes);
+  int len = sprintf (self->frame, "@SD%u ", (unsigned)self->seq++);
+  for (int i = 0; i < n; i += 3)
+    {
+    uint32_t v = (uint32_t)self->out[i] << 16;
+    if (i + 1 < n) v |= (uint32_t)self->out[i + 1] << 8;
+    if (i + 2 < n) v |= self->out[i + 2];
+    self->frame[len++] = base64[v >> 18];
+    self->frame[len++] = base64[(v >> 12) & 0x3F];
+    self->frame[len++] = i + 1 < n ? base64[(v >> 6) & 0x3F] : '=';
+    self->frame[len++] = i + 2 < n ? base64[v & 0x3F] : '=';
+    }
+  emit (self, len);
+  self->stats.data_bytes += (uint32_t)n;
+  memmove (self->out, self->out + n, self->out_len - n);
+  self->out_len -= n;
+  }
+
+/*===========================================================================
+ * export_new
+ * ========================================================================*/
+EXPORT *export_new (const I2C_LCD *lcd, int console, int chunk_bytes,
+          EXPORT_WRITE_FN write, void *context)
+  {
+  EXPORT *self = malloc (sizeof (EXPORT));
+  memset (self, 0, sizeof (EXPORT));
+  self->lcd = lcd;
+  self->console = console;
+  self->chunk_bytes = MAX (3, chunk_bytes);
+  self->write = write;
+  self->context = context;
+  self->width = i2c_lcd_get_width (lcd);
+
+  self->next_line = i2c_lcd_first_line (lcd);
+  self->end_line = i2c_lcd_end_line (lcd);
+
+  self->line = malloc (I2C_LCD_LINE_MAX + 2);
+  self->ring = malloc (EXPORT_RING);
+  self->head = calloc (EXPORT_HASH_SIZE, sizeof (uint32_t));
+  self->prev = calloc (EXPORT_RING, sizeof (uint32_t));
+  // A line can't compress to more than two bytes a character
+  self->out = malloc (self->chunk_bytes + 2 * (I2C_LCD_LINE_MAX + 1));
+  self->frame = malloc (64 + 4 * (self->chunk_bytes + 2) / 3);
+  return self;
+  }
+
+/*===========================================================================
+ * export_work
+ * ========================================================================*/
+BOOL export_work (EXPORT *self)
+  {
+  if (!self->begun)
+    {
+    self->begun = TRUE;
+    emit (self, sprintf (self->frame, "@SB %d %d %lu", self->console,
+      self->width, (unsigned long)(self->end_line - self->next_line)));
+    return TRUE;
+    }
+
+  while (self->out_len < self->chunk_bytes
+           && self->next_line != self->end_line)
+    add_line (self, self->next_line++);
+
+  if (self->out_len > 0)
+    {
+    emit_data (self);
+    return TRUE;
+    }
+
+  emit (self, sprintf (self->frame, "@SE %lu %lu %lu %08lX",
+    (unsigned long)self->stats.lines, (unsigned long)self->stats.lost,
+    (unsigned long)self->stats.text_bytes, (unsigned long)self->crc));
+  return FALSE;
+  }
+
+/*===========================================================================
+ * export_get_stats
+ * ========================================================================*/
+const EXPORT_STATS *export_get_stats (const EXPORT *self)
+  {
+  return &self->stats;
+  }
+
+/*===========================================================================
+ * export_destroy
+ * ========================================================================*/
+void export_destroy (EXPORT *self)
+  {
+  free (self->line);
+  free (self->ring);
+  free (self->head);
+  free (self->prev);
+  free (self->out);
+  free (self->frame);
+  free (self);
+  }
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <stdarg.h>
 #include <hardware/i2c.h>
 
 #ifndef BOOL
@@ -40,7 +41,9 @@ typedef int BOOL;
 // Setting 0x02 for RW assumes that the RS pin on the HD44780 is
 //   connected to pin 1 on the I2C controller. This is a common choice, but
 //   not universal.
-// Note that this pin is not used in the current application.
+// This pin is not used as RW: it is held low, except by the transport
+//   from lcd_transport_i2c_new_dual(), for which it is wired to the 
+//   enable line of a 40x4 panel's second controller.
 #define I2C_LCD_RW 0x02
 
 // Setting 0x04 for enable assumes that the enable pin on the HD44780 is
@@ -57,7 +60,30 @@ typedef int BOOL;
 //   time will be a bit longer, because of the I2C protocol overhead
 #define I2C_LCD_DELAY 600
 
+// Flags returned by i2c_lcd_get_panel_flags()
+#define I2C_LCD_PANEL_BACKLIGHT  0x01
+#define I2C_LCD_PANEL_DISPLAY_ON 0x02
+#define I2C_LCD_PANEL_CURSOR_ON  0x04
+#define I2C_LCD_PANEL_BLINK_ON   0x08
+
+// The widest a display can be: a 40x2, or a 40x4 with two controllers
+#define I2C_LCD_MAX_WIDTH 0x28
+
+// The longest logical line the scrollback buffer keeps. A line that 
+//   wraps on to more rows than this is broken, and the rest of it kept
+//   as a line of its own.
+#define I2C_LCD_LINE_MAX 255
+
 typedef struct _I2C_LCD I2C_LCD;
+typedef struct _LCD_TRANSPORT LCD_TRANSPORT;
+
+/** A function that is called with each line of 'width' characters, 
+    not null-terminated, as the cursor leaves it. The width is the 
+    display's at the time, which i2c_lcd_set_geometry() can change. 
+    'continued' is TRUE if the line carries on the one above it, because
+    that one wrapped. */
+typedef void (*I2C_LCD_LINE_FN) (const char *line, int width, 
+              BOOL continued, void *context);
 
 #ifdef __cplusplus
 extern "C" {
@@ -66,17 +92,101 @@ extern "C" {
 extern I2C_LCD *i2c_lcd_new (int width, int height, int addr, i2c_inst_t *i2c, 
                               int sda, int scl, int i2c_baud, 
                               int scrollback_pages);
+/** Create a display that uses the specified transport, which might
+    be I2C, GPIO, or a mock -- see lcd_transport.h. The display takes
+    ownership of the transport, and destroys it in i2c_lcd_destroy(). */
+extern I2C_LCD *i2c_lcd_new_with_transport (int width, int height, 
+                              LCD_TRANSPORT *transport, 
+                              int scrollback_pages);
+/** Create a display without initializing it, so that the program can
+    get on with other things while the display starts up. Initialize the 
+    display by calling i2c_lcd_init_step() until it returns TRUE, waiting
+    at least *delay_us microseconds between calls. Until then, no other 
+    functions should be used on the display. */
+extern I2C_LCD *i2c_lcd_new_deferred (int width, int height, 
+                              LCD_TRANSPORT *transport, 
+                              int scrollback_pages);
+extern BOOL     i2c_lcd_init_step (I2C_LCD *self, uint32_t *delay_us);
+/** TRUE once the display has been initialized. */
+extern BOOL     i2c_lcd_ready (const I2C_LCD *self);
+/** Destroy a display or a console. The transport is destroyed along 
+    with the last console that uses it. */
 extern void     i2c_lcd_destroy (I2C_LCD* self);
 
+/** Create a virtual console on the same panel as display. A console is
+    an I2C_LCD in its own right, with its own cursor, settings and 
+    scrollback buffer, and can be used with all the i2c_lcd_ functions.
+    Only one console -- initially, the display itself -- is shown on 
+    the panel at a time; the others are updated only in RAM. */
+extern I2C_LCD *i2c_lcd_new_console (I2C_LCD *display, 
+                              int scrollback_pages);
+/** Show this console on the panel. Only the characters that differ 
+    from what the panel currently shows are sent. The display on/off
+    state and the backlight belong to the panel, not to the console; 
+    other display commands sent to a console that is not shown take 
+    effect when it is activated. */
+extern void     i2c_lcd_activate (I2C_LCD *self);
+/** TRUE if this console is the one shown on the panel. */
+extern BOOL     i2c_lcd_is_active (const I2C_LCD *self);
+
 extern void     i2c_lcd_display_on (I2C_LCD* self);
 extern void     i2c_lcd_display_off (I2C_LCD* self);
 
 extern void     i2c_lcd_backlight_on (I2C_LCD* self);
 extern void     i2c_lcd_backlight_off (I2C_LCD* self);
+/** TRUE if the backlight is on. The backlight belongs to the panel, 
+    so all its consoles give the same answer. */
+extern BOOL     i2c_lcd_is_backlight_on (const I2C_LCD* self);
+
+/** Turn the panel's display and backlight off, to save power. The 
+    HD44780 keeps its display RAM, and the driver its copy, so 
+    i2c_lcd_wake() brings everything back without redrawing anything.
+    On the I2C transport, each is a single write: the backlight is 
+    changed along with the display control command. (On a 40x4 with the
+    cursor showing, it is two, one for each controller.) Anything 
+    printed to the console that the panel shows wakes it; status 
+    updates, and output to other consoles, don't. Sleep belongs to the
+    panel, so all its consoles give the same answer. */
+extern void     i2c_lcd_sleep (I2C_LCD *self);
+extern void     i2c_lcd_wake (I2C_LCD *self);
+extern BOOL     i2c_lcd_is_asleep (const I2C_LCD *self);
 
+/** Rows are counted from the top of the scrolling region, which is not
+    the top of the display if there are status rows above it. */
 extern void     i2c_lcd_set_cursor (I2C_LCD *self, int row, int col);
+/** Get the current cursor position. Either pointer may be NULL. */
+extern void     i2c_lcd_get_cursor (const I2C_LCD *self, int *row, int *col);
+extern int      i2c_lcd_get_width (const I2C_LCD *self);
+/** The number of rows in the scrolling region. This is the height of
+    the display, less any status rows. */
+extern int      i2c_lcd_get_height (const I2C_LCD *self);
 extern void     i2c_lcd_print_string (I2C_LCD *self, const char *s);
 extern void     i2c_lcd_print_char (I2C_LCD *self, const char c);
+/** Print n characters, which need not be null-terminated. Runs of 
+    ordinary characters are sent to the display in a single batch, which 
+    is much faster than printing them one at a time. */
+extern void     i2c_lcd_print_chars (I2C_LCD *self, const char *s, int n);
+
+/** Formatted output, without the C library's printf, and without 
+    allocating memory. The conversions are %d, %i, %u, %x, %X, %c, %s,
+    and %%, with the flags '-', '0', and '+', a width, and an 'l' for
+    long arguments. A width or precision of '*' is taken from the 
+    arguments. A precision on %s is the most characters to print, and on
+    %x the fewest digits. Unlike printf, a precision on %d, %i or %u 
+    makes the number fixed-point, with that many digits after a decimal
+    point, so ("%.2d", 1234) prints "12.34", and ("%.1d", -5) "-0.5".
+    The arguments are the same as printf would take, so the compiler
+    checks them. Output stops at a conversion that isn't supported. 
+    Returns the number of characters printed. */
+extern int      i2c_lcd_printf (I2C_LCD *self, const char *fmt, ...)
+                  __attribute__ ((format (printf, 2, 3)));
+extern int      i2c_lcd_vprintf (I2C_LCD *self, const char *fmt, 
+                  va_list ap);
+/** Format as i2c_lcd_printf() does, into a buffer of size bytes, which
+    is always null-terminated. Returns the length the output would have
+    had with no limit, as snprintf() does. */
+extern int      i2c_lcd_format (char *buf, int size, const char *fmt, ...)
+                  __attribute__ ((format (printf, 3, 4)));
 
 /** Move cursor down and to the start of the line. */ 
 extern void     i2c_lcd_new_line (I2C_LCD *self);
@@ -94,6 +204,8 @@ extern void     i2c_lcd_cursor_off (I2C_LCD *self);
 extern void     i2c_lcd_wrapping_on (I2C_LCD *self);
 /** Turn off line-wrapping and scrolling. */
 extern void     i2c_lcd_wrapping_off (I2C_LCD *self);
+/** TRUE if line-wrapping and scrolling are on. */
+extern BOOL     i2c_lcd_is_wrapping (const I2C_LCD *self);
 
 /** Clears the display and sets the cursor to the top left */
 extern void     i2c_lcd_clear (I2C_LCD *self, BOOL clear_scrollback);
@@ -111,8 +223,148 @@ extern void     i2c_lcd_backspace (I2C_LCD *self);
 /* Destructive backspace -- moves cursor and overwrites with space. */
 extern void     i2c_lcd_del (I2C_LCD *self);
 
+/** Scrollback navigation. These functions only move the scrollback 
+    position; the display is redrawn by i2c_lcd_update(), or when 
+    anything is next printed. So a run of movements -- an auto-repeated 
+    page up, say -- costs only one redraw, of the final position. And
+    since only the characters that differ are sent, a redraw costs at 
+    most one screenful, however far the jump. Printing anything returns
+    the display to the live position. */
 extern void i2c_lcd_scrollback_line_up (I2C_LCD *self);
 extern void i2c_lcd_scrollback_line_down (I2C_LCD *self);
+extern void i2c_lcd_scrollback_page_up (I2C_LCD *self);
+extern void i2c_lcd_scrollback_page_down (I2C_LCD *self);
+/** Go to the oldest line in the scrollback buffer. */
+extern void i2c_lcd_scrollback_top (I2C_LCD *self);
+/** Go back to the live display. */
+extern void i2c_lcd_scrollback_live (I2C_LCD *self);
+/** The number of lines that the display is scrolled back. */
+extern int  i2c_lcd_get_scrollback (const I2C_LCD *self);
+/** Draw any scrollback movement that hasn't been drawn yet. */
+extern void i2c_lcd_update (I2C_LCD *self);
+
+/** The scrollback buffer holds logical lines -- the text between line
+    breaks -- rather than rows of the display, so that it can be shown
+    at any width. The functions below that count in lines mean rows of
+    the display at its current width: the logical lines above the 
+    display, broken into rows, followed by the rows on the display. 
+    Rows are worked out only as they're needed, and the most recent 
+    position is remembered, so moving a few rows at a time is cheap 
+    however big the buffer is. */
+
+/** The number of lines in the scrollback buffer, including the lines
+    currently on the display. */
+extern int  i2c_lcd_scrollback_lines (const I2C_LCD *self);
+/** Copy line n of the scrollback buffer into buf, which must have room
+    for width + 1 characters. Line 0 is the oldest; the last 'height'
+    lines are the ones currently on the display. */
+extern void i2c_lcd_get_scrollback_line (const I2C_LCD *self, int n, 
+              char *buf);
+/** The number of lines above the display. The first of them is line
+    scrollback_lines - height - history, which is line 0. */
+extern int  i2c_lcd_scrollback_history (const I2C_LCD *self);
+
+/** Logical lines are numbered, from when the console was created, so 
+    that a line can be found again after the display has scrolled. 
+    These are the numbers of the oldest line that is still held, and of
+    the line after the last one on the display. The lines on the display
+    are numbered as they will be when they scroll off it. Clearing the
+    scrollback buffer moves the numbers on, so that no old number refers
+    to a line that is still held. */
+extern uint32_t i2c_lcd_first_line (const I2C_LCD *self);
+extern uint32_t i2c_lcd_end_line (const I2C_LCD *self);
+/** Copy logical line 'number' into buf, without trailing spaces, and 
+    null-terminated; at most size - 1 characters are copied. Returns the
+    length, or -1 if the line is no longer held. A buffer of 
+    I2C_LCD_LINE_MAX + 1 characters holds any line. */
+extern int  i2c_lcd_get_line (const I2C_LCD *self, uint32_t number, 
+              char *buf, int size);
+
+/** Each logical line carries the time it was started -- when the first
+    character was written to it -- in seconds since start-up, at a cost
+    of a little over two bytes a line. A line that nothing was written
+    to has the time of the one before, and lines put back with 
+    i2c_lcd_restore_line() have time zero. A line is never given an 
+    earlier time than the one before it. Times more than nine hours 
+    after the line at the start of their block of 32 are rounded down 
+    to 64 seconds. */
+
+/** Put the time that logical line 'number' was started in *seconds.
+    Returns FALSE if the line is no longer held, or is a row on the
+    display that nothing has been written to yet. */
+extern BOOL i2c_lcd_get_line_time (const I2C_LCD *self, uint32_t number, 
+              uint32_t *seconds);
+/** Scroll back to the first line in the scrollback buffer (above the
+    display) that was started at or after 'seconds', so that it is at 
+    the top of the display, and put its number in *number, if number is
+    not NULL. The line is found by a binary search. If every line above
+    the display is older, the display goes back to the live view, and
+    FALSE is returned. As with the other scrollback movements, the 
+    display is redrawn by i2c_lcd_update(). */
+extern BOOL i2c_lcd_scrollback_seek (I2C_LCD *self, uint32_t seconds,
+              uint32_t *number);
+
+/** The bytes of RAM allocated for this console: the object, the 
+    display and status rows, and the scrollback buffer. The panel and 
+    the transport, which the consoles share, are not included. */
+extern int  i2c_lcd_get_memory (const I2C_LCD *self);
+/** The bytes of RAM that each page of scrollback costs this console. */
+extern int  i2c_lcd_scrollback_page_bytes (const I2C_LCD *self);
+
+/** Change the size of the display, for a panel of a different size. 
+    The lines on the display join the scrollback buffer, and the display
+    is cleared. Nothing in the scrollback buffer is redrawn or moved: 
+    its rows at the new width are worked out as they're needed. Any 
+    status region is kept, but cleared. Each console on the panel needs
+    to be told. */
+extern void i2c_lcd_set_geometry (I2C_LCD *self, int width, int height);
+
+/** Set aside 'rows' rows, at the top or the bottom of the display, as 
+    a status region that doesn't scroll. Scrolling, new lines, clearing 
+    and scrollback affect only the other rows. This clears the scrolling
+    region and its scrollback buffer, so it's best done at start-up. 
+    Zero rows removes the status region. */
+extern void i2c_lcd_set_status_region (I2C_LCD *self, int rows, 
+              BOOL at_top);
+/** Write s into status row 'row', starting at column col, and clipped
+    at the edge of the display. Only the characters that differ from 
+    what's already there are sent, so this is cheap to call often. The
+    cursor is not moved. */
+extern void i2c_lcd_set_status (I2C_LCD *self, int row, int col, 
+              const char *s);
+extern int  i2c_lcd_get_status_rows (const I2C_LCD *self);
+
+/** Have fn called whenever the cursor leaves a line, because of a 
+    line feed or wrapping. This is intended for keeping a record of what
+    has been displayed, so fn should be quick. */
+extern void i2c_lcd_set_line_callback (I2C_LCD *self, I2C_LCD_LINE_FN fn, 
+              void *context);
+
+/** Add a line of len characters to the scrollback buffer, above the
+    lines on the screen, as if it had scrolled off the top. If continued
+    is TRUE, it carries on the line before. Nothing is sent to the 
+    display. This is for restoring the scrollback buffer after a reset,
+    perhaps from a display of a different width. */
+extern void i2c_lcd_restore_line (I2C_LCD *self, const char *line, int len,
+              BOOL continued);
+
+/** What the panel actually shows, whichever console is on it, as 
+    recorded by the driver. This is for mirroring the panel somewhere 
+    else. Rows are panel rows, counted from the top of the display,
+    including any status rows. */
+extern int  i2c_lcd_get_panel_rows (const I2C_LCD *self);
+/** Copy panel row 'row' into buf, which must have room for width + 1
+    characters. */
+extern void i2c_lcd_get_panel_row (const I2C_LCD *self, int row, char *buf);
+/** The position of the HD44780's cursor, or -1, -1 if it is not on a 
+    visible character cell. */
+extern void i2c_lcd_get_panel_cursor (const I2C_LCD *self, int *row, 
+              int *col);
+/** A combination of the I2C_LCD_PANEL_ flags. */
+extern int  i2c_lcd_get_panel_flags (const I2C_LCD *self);
+/** A count that goes up whenever anything is sent to the panel. If it 
+    hasn't changed, neither has the panel. */
+extern uint32_t i2c_lcd_panel_changes (const I2C_LCD *self);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,74 @@
+/*============================================================================
+ *  i2c_lcd/i2c_trace.h
+ *
+ *  A record, in a RAM ring buffer, of every transfer that the I2C 
+ *  transport makes to the PCF8574, so that what went over the bus, and
+ *  when, can be looked at on a host -- see tools/i2c_vcd, which turns 
+ *  it into a waveform. The transport only records transfers once 
+ *  lcd_transport_i2c_set_trace() has turned tracing on; until then, the
+ *  cost is one test per transfer.
+ *
+ *  Trace format. A trace is a header followed by a sequence of records.
+ *
+ *    header:  'I' '2' 'C' 'T'  version (1 byte)  flags (1 byte)
+ *             reserved (2 bytes)
+ *    record:  time delta, microseconds from the start of the previous
+ *               transfer to the start of this one, as a varint (7 bits
+ *               per byte, least significant first, top bit set on all
+ *               bytes except the last)
+ *             duration, microseconds, as a varint
+ *             address << 1, plus 1 for a read (1 byte)
+ *             result (1 byte): I2C_TRACE_OK, _NAK, or _TIMEOUT
+ *             length (1 byte)
+ *             data (length bytes): written, or read
+ *
+ *  When the ring is full, the oldest records are discarded. The time 
+ *  delta of the first record in a dump is relative to a record that is
+ *  no longer present, and should be ignored.
+ *
+ *  i2c_trace_dump() writes the trace to stdout as hex, between the lines
+ *  "I2CTRACE BEGIN" and "I2CTRACE END".
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ==========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <i2c_lcd/i2c_lcd.h>
+
+#define I2C_TRACE_MAGIC "I2CT"
+#define I2C_TRACE_VERSION 1
+#define I2C_TRACE_HEADER_SIZE 8
+
+// Results of a transfer
+#define I2C_TRACE_OK 0
+#define I2C_TRACE_NAK 1
+#define I2C_TRACE_TIMEOUT 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Allocate a trace buffer of the specified size. Returns FALSE if 
+    there isn't the memory. */
+extern BOOL i2c_trace_init (int bytes);
+
+/** Record one transfer, which started at start_us and took duration_us.
+    'ret' is what the Pico SDK's transfer function returned. */
+extern void i2c_trace_record (uint32_t start_us, uint32_t duration_us, 
+              int addr, BOOL read, const uint8_t *data, int len, int ret);
+
+/** Write the whole trace to stdout, as hex. */
+extern void i2c_trace_dump (void);
+
+/** Discard all recorded transfers. */
+extern void i2c_trace_clear (void);
+
+/** Copy the trace, header included, to buf, as much as fits. Returns
+    the size of the whole trace. */
+extern int  i2c_trace_copy (uint8_t *buf, int size);
+
+#ifdef __cplusplus
+}
+#endif
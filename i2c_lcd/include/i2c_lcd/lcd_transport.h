@@ -0,0 +1,139 @@
+/*============================================================================
+ *  i2c_lcd/lcd_transport.h
+ *
+ *  The connection between the I2C_LCD driver and the HD44780 controller.
+ *  The driver itself only deals in whole bytes -- commands and characters
+ *  -- and leaves it to the transport to get them to the controller. 
+ *  There are three transports:
+ *
+ *  - I2C, via the usual PCF8574 "backpack". This is the original, and
+ *    still the most common, arrangement.
+ *  - GPIO, with the HD44780 wired directly to six (or seven) Pico pins
+ *    in 4-bit mode. This needs more wires, but no I2C bus, and is much
+ *    faster: a character takes about 40us, rather than about 1ms.
+ *  - mock, which keeps an in-memory copy of the controller's display
+ *    RAM and counts what is sent to it, for running the driver without
+ *    a display.
+ *
+ *  A 40x4 panel has two HD44780s, sharing the data lines and RS but each
+ *  with its own enable line: the first drives rows 0 and 1, and the 
+ *  second rows 2 and 3. A transport that can drive both says so by 
+ *  providing select().
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ==========================================================================*/
+
+#pragma once
+
+#include <i2c_lcd/i2c_lcd.h>
+
+// The size of the HD44780's display RAM, as seen by the mock transport
+#define LCD_DDRAM_SIZE 128
+
+// Controller masks for select()
+#define LCD_CONTROLLER_1 0x01
+#define LCD_CONTROLLER_2 0x02
+#define LCD_CONTROLLER_BOTH 0x03
+
+// Error counts for the I2C transport
+typedef struct _LCD_I2C_STATS
+  {
+  int baud;                  // The baud rate currently in use
+  unsigned long writes;      // I2C write transactions, including retries
+  unsigned long naks;        // Writes not acknowledged by the PCF8574
+  unsigned long timeouts;    // Writes that timed out
+  unsigned long fallbacks;   // Times the bus was slowed down by errors
+  } LCD_I2C_STATS;
+
+struct _LCD_TRANSPORT 
+  {
+  /** Send a byte to the HD44780. rs is TRUE for character data, FALSE
+      for a command. The transport is responsible for allowing the
+      controller time to execute the byte. */
+  void (*send_byte) (LCD_TRANSPORT *self, unsigned char b, BOOL rs);
+  /** Send a run of n characters. A transport can do this much more
+      efficiently than n calls to send_byte(). */
+  void (*send_chars) (LCD_TRANSPORT *self, const char *s, int n);
+  /** Choose which controllers, of a panel with two, the bytes that
+      follow go to: a mask of LCD_CONTROLLER_1 and LCD_CONTROLLER_2. A
+      command sent to both is executed by both at once. NULL if the 
+      transport can only drive one controller. */
+  void (*select) (LCD_TRANSPORT *self, int controllers);
+  /** Send a run of characters to each controller of a panel with two,
+      interleaved, so that each controller executes a character while the
+      other is being sent one. Leaves the selection undefined. NULL if 
+      the transport has no better way than sending one run and then 
+      the other. */
+  void (*send_chars_dual) (LCD_TRANSPORT *self, const char *s1, int n1,
+                           const char *s2, int n2);
+  void (*set_backlight) (LCD_TRANSPORT *self, BOOL on);
+  /** Change the backlight along with the next byte sent, rather than 
+      now, so that the two cost one write between them. NULL if the 
+      transport has no cheaper way than set_backlight() then the byte. */
+  void (*set_backlight_later) (LCD_TRANSPORT *self, BOOL on);
+  void (*destroy) (LCD_TRANSPORT *self);
+  };
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A PCF8574 I2C backpack at address addr. This initializes the I2C
+    peripheral, and sets up the specified pins for I2C. The backpack's
+    RW pin (I2C_LCD_RW) is held low. */
+extern LCD_TRANSPORT *lcd_transport_i2c_new (i2c_inst_t *i2c, int addr,
+                        int sda, int scl, int i2c_baud);
+
+/** As lcd_transport_i2c_new(), for a 40x4 panel with two controllers.
+    The backpack's RW pin (I2C_LCD_RW) must be wired to the second 
+    controller's enable line, and the panel's RW pin tied to ground:
+    this transport pulses the RW pin to write to the second 
+    controller. */
+extern LCD_TRANSPORT *lcd_transport_i2c_new_dual (i2c_inst_t *i2c, 
+                        int addr, int sda, int scl, int i2c_baud);
+
+/** Find the fastest standard I2C rate (100k, 400k or 1M baud), up to
+    max_baud, at which the PCF8574 reliably responds, and use it. This
+    should be called before any text is written, as it writes to the
+    PCF8574 (but not to the HD44780). Returns the baud rate chosen. */
+extern int            lcd_transport_i2c_autotune (LCD_TRANSPORT *self,
+                        int max_baud);
+
+extern void           lcd_transport_i2c_get_stats 
+                        (const LCD_TRANSPORT *self, LCD_I2C_STATS *stats);
+
+/** Record every transfer in the I2C trace, which must have been set up
+    with i2c_trace_init() -- see i2c_trace.h. */
+extern void           lcd_transport_i2c_set_trace (LCD_TRANSPORT *self,
+                        BOOL on);
+
+/** An HD44780 wired directly to GPIO pins, in 4-bit mode. The data 
+    lines D4-D7 must be on four consecutive pins, starting at d4. RW
+    should be tied low. backlight may be -1 if the backlight is not
+    switched by the Pico. */
+extern LCD_TRANSPORT *lcd_transport_gpio_new (int rs, int e, int d4,
+                        int backlight);
+
+/** As lcd_transport_gpio_new(), for a panel with two controllers, whose
+    enable lines are on pins e and e2. */
+extern LCD_TRANSPORT *lcd_transport_gpio_new_dual (int rs, int e, int e2,
+                        int d4, int backlight);
+
+/** An in-memory stand-in for a display. */
+extern LCD_TRANSPORT *lcd_transport_mock_new (void);
+
+/** Copy n bytes of the mock display RAM, starting at address addr, 
+    into buf. The second controller's display RAM follows the first's,
+    from address LCD_DDRAM_SIZE. */
+extern void           lcd_transport_mock_read (const LCD_TRANSPORT *self,
+                        int addr, char *buf, int n);
+
+/** Get the number of commands and characters sent to the mock display
+    since it was created. */
+extern void           lcd_transport_mock_counts (const LCD_TRANSPORT *self,
+                        unsigned long *commands, unsigned long *chars);
+
+#ifdef __cplusplus
+}
+#endif
+
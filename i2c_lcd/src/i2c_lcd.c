@@ -1,6 +1,15 @@
 /*============================================================================
  *  i2c_lcd/i2c_lcd.c
  *
+ *  The display-level part of the driver: cursor handling, wrapping,
+ *  scrolling and scrollback. Commands and characters are passed to an
+ *  LCD_TRANSPORT, which knows how the HD44780 is connected -- see
+ *  lcd_transport.h.
+ *
+ *  A 40x4 panel has two HD44780s, each with its own display RAM. The 
+ *  driver treats them as one display RAM of twice the size: addresses 
+ *  from LCD_DDRAM_SIZE up are in the second controller. 
+ *
  *  For a description of the protocol, please see
  *  https://kevinboone.me/pi-lcd.html
  *
@@ -9,13 +18,20 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <hardware/i2c.h>
-#include <hardware/gpio.h>
+#include <pico/stdlib.h>
 #include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
 
-// I don't think these LCD panels were ever made with more than 4 rows
+// I don't think these LCD panels were ever made with more than 4 rows,
+//   or 40 columns
 #define I2C_LCD_MAX_ROWS 4
 
+// Time after power-up before the HD44780 will accept commands
+#define I2C_LCD_POWER_UP_US 40000
+
+// The value of init_state once initialization is complete
+#define I2C_LCD_INIT_DONE 9
+
 #define I2C_LCD_ENTRY_RIGHT 0x00
 #define I2C_LCD_ENTRY_LEFT 0x02
 
@@ -40,8 +56,6 @@
 #define I2C_LCD_BLINK_OFF 0x00
 #define I2C_LCD_BLINK_ON 0x01
 
-#define I2C_LCD_COMMAND 0x00
-
 // HD44780 LCD commands
 
 #define I2C_LCD_CLEAR_DISPLAY 0x01
@@ -53,75 +67,268 @@
 #define I2C_LCD_SET_CGRAM_ADDR 0x40
 #define I2C_LCD_SET_DDRAM_ADDR 0x80
 
+// Runs of unchanged characters shorter than this are re-sent when the
+//   panel is brought up to date, rather than skipped over, because 
+//   moving the cursor costs about as much as sending a few characters
+#define I2C_LCD_DIFF_GAP 3
+
+// Each line in the scrollback buffer carries the time it was started, in
+//   seconds since start-up. Lines are taken in blocks of this many: each
+//   block has the time of its first line in full, and each line a 16-bit
+//   offset from it -- see encode_offset()
+#define I2C_LCD_TIME_BLOCK 32
+
+// A display row that hasn't been written to since it was cleared
+#define I2C_LCD_NO_TIME 0xFFFFFFFFU
+
+// The panel is the physical display, which is shared by all the consoles
+//   created from one display. It keeps a copy of what the HD44780's 
+//   display RAM holds, so that switching consoles need only send the 
+//   characters that differ.
+typedef struct _I2C_LCD_PANEL
+  {
+  LCD_TRANSPORT *transport;
+  struct _I2C_LCD *active;  // The console that the panel shows
+  int consoles;             // The number of consoles sharing the panel
+  int init_state;   // Next step of initialization; see i2c_lcd_init_step()
+  int controllers;          // 2 on a 40x4 panel, otherwise 1
+  int selected;     // The controllers the transport is sending to, or 0 if
+                    //   not known
+  int current;              // The controller that characters go to
+  int cursor;               // The controller that shows the cursor
+  int addr[2];              // Each HD44780's address counter
+  unsigned char display_control; // As last sent to the HD44780
+  BOOL backlight;
+  BOOL asleep;              // Put to sleep by i2c_lcd_sleep()
+  BOOL wake_backlight;      // What to bring back on waking
+  BOOL wake_display;
+  uint32_t changes;         // Counts everything sent to the panel
+  unsigned char ddram[2 * LCD_DDRAM_SIZE];
+  } I2C_LCD_PANEL;
 
 struct _I2C_LCD 
   {
   int width;
-  int height;
-  int addr;
-  i2c_inst_t *i2c;  
+  int height;       // Rows in the scrolling region
+  I2C_LCD_PANEL *panel;
+  int panel_rows;   // Rows on the panel
+  int top;          // Panel row of the first row of the scrolling region
+  int status_rows;  // Rows in the fixed status region, if any
+  int status_top;   // Panel row of the first status row
+  unsigned char *status_buffer;
   int curr_row;
   int curr_col;
-  int scrollback_max_lines;
-  int scrollback;
+  unsigned char *screen;    // The scrolling region, height rows of width
+  unsigned char *continues; // For each row, TRUE if it wrapped from the
+                            //   row above
+  uint32_t *row_time;       // For each row, when it was first written to
+                            //   since it was cleared, or I2C_LCD_NO_TIME
+  // The scrollback buffer: logical lines, one after another in a ring of
+  //   history_size bytes. Lines are numbered, and line k starts at byte
+  //   offset line_start[k % line_slots]; offsets count up for ever, and
+  //   are taken modulo history_size to find the bytes.
+  char *history_text;
+  int history_size;
+  uint32_t *line_start;
+  int line_slots;
+  // Line k's time is block_time[k / I2C_LCD_TIME_BLOCK % time_blocks],
+  //   plus the offset in line_time[k % line_slots]. Times never go
+  //   backwards from one line to the next, so lines can be found by time
+  //   with a binary search.
+  uint16_t *line_time;
+  uint32_t *block_time;
+  int time_blocks;
+  uint32_t first_line;      // Number of the oldest line held
+  uint32_t end_line;        // Number of the line after the newest
+  uint32_t text_end;        // Offset after the last byte of the newest line
+  BOOL open;                // The newest line can still be continued
+  int history;      // Rows above the display at the current width, or -1
+                    //   if they haven't been counted since it changed
+  uint32_t cache_line;      // A line, and the row it starts on, so that 
+  int cache_row;            //   looking up nearby rows is quick
+  int scrollback;   // Lines scrolled back from the live display
+  BOOL view_dirty;  // The display doesn't yet show the scrollback position
   unsigned char display_mode;
   unsigned char display_function;
   unsigned char display_control;
-  unsigned short backlight;
   unsigned char offsets[I2C_LCD_MAX_ROWS];
   BOOL wrap;
   BOOL destructive_backspace;
   BOOL implicit_lf; 
-  unsigned char *scrollback_buffer;
+  I2C_LCD_LINE_FN line_fn;
+  void *line_context;
   };
 
 //#define MIN(x,y) (x < y ? x : y)
 
 /*============================================================================
- * i2c_write_byte 
+ * next_address
+ * In two-line mode, DDRAM runs 0x00-0x27 and 0x40-0x67, and the address
+ * counter wraps from the end of one line to the start of the other.
+ * ==========================================================================*/
+static int next_address (int addr)
+  {
+  addr++;
+  if (addr == 0x28) return 0x40;
+  if (addr == 0x68) return 0x00;
+  return addr;
+  }
+
+/*============================================================================
+ * all_controllers
+ * ==========================================================================*/
+static int all_controllers (const I2C_LCD_PANEL *panel)
+  {
+  return panel->controllers == 2 ? LCD_CONTROLLER_BOTH : LCD_CONTROLLER_1;
+  }
+
+/*============================================================================
+ * select_controllers
+ * Choose the controllers that bytes go to, on a panel with two.
  * ==========================================================================*/
-static void i2c_write_byte (const I2C_LCD *self, unsigned char b)
+static void select_controllers (I2C_LCD_PANEL *panel, int controllers)
   {
-  unsigned char data = b | self->backlight;
-  i2c_write_blocking (self->i2c, self->addr, &data, 1, false);
+  if (panel->selected != controllers && panel->transport->select)
+    panel->transport->select (panel->transport, controllers);
+  panel->selected = controllers;
   }
 
 /*============================================================================
- * pulse_enable_line 
+ * send_to
+ * Send a command to some of the controllers.
  * ==========================================================================*/
-static void pulse_enable_line (const I2C_LCD *self, unsigned char b)
+static void send_to (I2C_LCD_PANEL *panel, int controllers, unsigned char c)
   {
-  sleep_us (I2C_LCD_DELAY);
-  i2c_write_byte (self, b | I2C_LCD_ENABLE);
-  sleep_us (I2C_LCD_DELAY);
-  i2c_write_byte (self, b & ~I2C_LCD_ENABLE);
-  sleep_us (I2C_LCD_DELAY);
+  select_controllers (panel, controllers);
+  panel->changes++;
+  panel->transport->send_byte (panel->transport, c, FALSE);
   }
 
 /*============================================================================
- * send_4bits
+ * send_display_control
+ * Each HD44780 shows a cursor at its own address counter, so on a panel
+ * with two, only the one that has the cursor is told to show it.
  * ==========================================================================*/
-static void send_4bits (const I2C_LCD *self, unsigned char b)
+static void send_display_control (I2C_LCD_PANEL *panel)
   {
-  i2c_write_byte (self, b);
-  pulse_enable_line (self, b);
+  unsigned char c = I2C_LCD_DISPLAY_CONTROL | panel->display_control;
+  unsigned char plain = c & ~(I2C_LCD_CURSOR_ON | I2C_LCD_BLINK_ON);
+  if (panel->controllers == 1 || c == plain)
+    {
+    send_to (panel, all_controllers (panel), c);
+    return;
+    }
+  int with = 1 << panel->cursor;
+  send_to (panel, with, c);
+  send_to (panel, LCD_CONTROLLER_BOTH & ~with, plain);
   }
 
 /*============================================================================
- * send_byte
+ * show_cursor
+ * Move the cursor to the other controller, if it isn't already there.
  * ==========================================================================*/
-static void send_byte (const I2C_LCD *self, unsigned char b, unsigned char mode)
+static void show_cursor (I2C_LCD_PANEL *panel, int controller)
   {
-  send_4bits (self, (b & 0xF0) | mode);
-  send_4bits (self, ((b << 4) & 0xF0) | mode);
+  if (panel->cursor == controller) return;
+  panel->cursor = controller;
+  if (panel->display_control & (I2C_LCD_CURSOR_ON | I2C_LCD_BLINK_ON))
+    send_display_control (panel);
   }
 
 /*============================================================================
  * send_command 
+ * Commands, like characters, only go to the panel if this console is
+ * the one it's showing. We keep track of the commands that change the
+ * display control or clear the display, so we know what the panel 
+ * holds. Commands that set the address go through set_address() 
+ * instead.
  * ==========================================================================*/
 static void send_command (const I2C_LCD *self, unsigned char c)
   {
-  send_byte (self, c, I2C_LCD_COMMAND);
+  I2C_LCD_PANEL *panel = self->panel;
+  if (panel->active != self) return;
+  if ((c & ~0x07) == I2C_LCD_DISPLAY_CONTROL)
+    {
+    panel->display_control = c & 0x07;
+    send_display_control (panel);
+    return;
+    }
+  if (c == I2C_LCD_CLEAR_DISPLAY)
+    {
+    memset (panel->ddram, ' ', sizeof (panel->ddram));
+    panel->addr[0] = 0;
+    panel->addr[1] = 0;
+    panel->current = 0;
+    }
+  send_to (panel, all_controllers (panel), c);
+  // Both controllers' address counters are now at the start
+  if (c == I2C_LCD_CLEAR_DISPLAY) show_cursor (panel, 0);
+  }
+
+/*============================================================================
+ * set_address
+ * Set the address counter of the controller that holds DDRAM address
+ * addr. Characters go there next.
+ * ==========================================================================*/
+static void set_address (const I2C_LCD *self, int addr)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  if (panel->active != self) return;
+  panel->current = addr / LCD_DDRAM_SIZE;
+  panel->addr[panel->current] = addr % LCD_DDRAM_SIZE;
+  send_to (panel, 1 << panel->current, 
+    I2C_LCD_SET_DDRAM_ADDR | panel->addr[panel->current]);
+  }
+
+/*============================================================================
+ * at_address
+ * TRUE if characters sent now would go to DDRAM address addr.
+ * ==========================================================================*/
+static BOOL at_address (const I2C_LCD_PANEL *panel, int addr)
+  {
+  return panel->current == addr / LCD_DDRAM_SIZE
+    && panel->addr[panel->current] == addr % LCD_DDRAM_SIZE;
+  }
+
+/*============================================================================
+ * place_cursor
+ * Set the address, and show the cursor there.
+ * ==========================================================================*/
+static void place_cursor (const I2C_LCD *self, int addr)
+  {
+  set_address (self, addr);
+  if (self->panel->active == self) 
+    show_cursor (self->panel, addr / LCD_DDRAM_SIZE);
+  }
+
+/*============================================================================
+ * store_chars
+ * Note in the copy of display RAM what a controller has been sent.
+ * ==========================================================================*/
+static void store_chars (I2C_LCD_PANEL *panel, int controller, 
+       const char *s, int n)
+  {
+  unsigned char *ddram = panel->ddram + controller * LCD_DDRAM_SIZE;
+  for (int i = 0; i < n; i++)
+    {
+    ddram[panel->addr[controller]] = s[i];
+    panel->addr[controller] = next_address (panel->addr[controller]);
+    }
+  }
+
+/*============================================================================
+ * send_chars
+ * Send a run of characters. The transport can usually do this much more
+ * efficiently than one character at a time.
+ * ==========================================================================*/
+static void send_chars (const I2C_LCD *self, const char *s, int n)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  if (panel->active != self) return;
+  store_chars (panel, panel->current, s, n);
+  select_controllers (panel, 1 << panel->current);
+  panel->changes++;
+  panel->transport->send_chars (panel->transport, s, n);
   }
 
 /*============================================================================
@@ -129,7 +336,483 @@ static void send_command (const I2C_LCD *self, unsigned char c)
  * ==========================================================================*/
 static void send_char (const I2C_LCD *self, char c)
   {
-  send_byte (self, c, I2C_LCD_RS);
+  send_chars (self, &c, 1);
+  }
+
+/*============================================================================
+ * send_chars_dual
+ * Send a run of characters to each controller of a panel with two, at 
+ * the addresses they're at already. 
+ * ==========================================================================*/
+static void send_chars_dual (const I2C_LCD *self, const char *s1, int n1,
+       const char *s2, int n2)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  LCD_TRANSPORT *transport = panel->transport;
+  store_chars (panel, 0, s1, n1);
+  store_chars (panel, 1, s2, n2);
+  panel->changes++;
+  if (transport->send_chars_dual)
+    {
+    transport->send_chars_dual (transport, s1, n1, s2, n2);
+    panel->selected = 0;
+    return;
+    }
+  select_controllers (panel, LCD_CONTROLLER_1);
+  transport->send_chars (transport, s1, n1);
+  select_controllers (panel, LCD_CONTROLLER_2);
+  transport->send_chars (transport, s2, n2);
+  }
+
+/*============================================================================
+ * update_row
+ * Make a row of the panel show 'want' (width characters), sending only
+ * the runs of characters that differ from what it shows already. 
+ * Returns TRUE if anything was sent, in which case the HD44780's cursor
+ * has moved.
+ * ==========================================================================*/
+static BOOL update_row (I2C_LCD *self, int panel_row, const char *want)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  if (panel->active != self) return FALSE;
+  const unsigned char *have = panel->ddram + self->offsets[panel_row];
+  BOOL sent = FALSE;
+  int col = 0;
+  while (col < self->width)
+    {
+    if (have[col] == (unsigned char)want[col]) 
+      {
+      col++;
+      continue;
+      }
+    // Extend the run of changes over any short gaps of unchanged
+    //   characters
+    int end = col + 1, same = 0;
+    while (end + same < self->width && same < I2C_LCD_DIFF_GAP)
+      {
+      if (have[end + same] == (unsigned char)want[end + same])
+        same++;
+      else
+        {
+        end += same + 1;
+        same = 0;
+        }
+      }
+    if (!at_address (panel, self->offsets[panel_row] + col))
+      set_address (self, self->offsets[panel_row] + col);
+    send_chars (self, want + col, end - col);
+    sent = TRUE;
+    col = end;
+    }
+  return sent;
+  }
+
+/*============================================================================
+ * changed_span
+ * The columns from the first that differs to the last, or FALSE if 
+ * none does.
+ * ==========================================================================*/
+static BOOL changed_span (const I2C_LCD *self, int panel_row, 
+       const char *want, int *from, int *to)
+  {
+  const unsigned char *have = self->panel->ddram + self->offsets[panel_row];
+  *from = 0;
+  *to = self->width;
+  while (*from < *to && have[*from] == (unsigned char)want[*from]) 
+    (*from)++;
+  while (*to > *from && have[*to - 1] == (unsigned char)want[*to - 1]) 
+    (*to)--;
+  return *from < *to;
+  }
+
+/*============================================================================
+ * update_pair
+ * Bring a row of each controller up to date together, if both need it:
+ * each gets one run of characters, from its first change to its last,
+ * and the two runs are sent interleaved. Returns FALSE, having sent
+ * nothing, if either row is up to date already.
+ * ==========================================================================*/
+static BOOL update_pair (I2C_LCD *self, int row1, const char *want1, 
+       int row2, const char *want2)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  int from1, to1, from2, to2;
+  if (!changed_span (self, row1, want1, &from1, &to1)
+       || !changed_span (self, row2, want2, &from2, &to2))
+    return FALSE;
+  int addr1 = self->offsets[row1] + from1;
+  int addr2 = self->offsets[row2] + from2;
+  if (panel->addr[0] != addr1) set_address (self, addr1);
+  if (panel->addr[1] != addr2 - LCD_DDRAM_SIZE) set_address (self, addr2);
+  send_chars_dual (self, want1 + from1, to1 - from1, want2 + from2, 
+    to2 - from2);
+  return TRUE;
+  }
+
+/*============================================================================
+ * update_panel
+ * Make the panel show 'rows' -- the scrolling region's rows, width 
+ * apart -- and the status region. On a panel with two controllers, a
+ * row of the first and the row of the second two below it are brought
+ * up to date together, so a full-screen update takes little longer than
+ * half the screen would. Returns TRUE if anything was sent.
+ * ==========================================================================*/
+static BOOL update_panel (I2C_LCD *self, const char *rows)
+  {
+  const char *want[I2C_LCD_MAX_ROWS];
+  for (int i = 0; i < self->height; i++)
+    want[self->top + i] = rows + i * self->width;
+  for (int i = 0; i < self->status_rows; i++)
+    want[self->status_top + i] 
+      = (const char *)self->status_buffer + i * self->width;
+  if (self->panel->active != self) return FALSE;
+
+  BOOL sent = FALSE;
+  int done = 0;
+  if (self->panel->controllers == 2)
+    {
+    for (int r = 0; r < 2 && r + 2 < self->panel_rows; r++)
+      {
+      if (update_pair (self, r, want[r], r + 2, want[r + 2]))
+        {
+        done |= 1 << r | 1 << (r + 2);
+        sent = TRUE;
+        }
+      }
+    }
+  for (int r = 0; r < self->panel_rows; r++)
+    if (!(done & 1 << r) && update_row (self, r, want[r])) sent = TRUE;
+  return sent;
+  }
+
+/*============================================================================
+ * restore_cursor
+ * Put the HD44780's cursor back where the console's cursor is, after
+ * drawing somewhere else.
+ * ==========================================================================*/
+static void restore_cursor (I2C_LCD *self)
+  {
+  place_cursor (self, self->offsets[self->top + self->curr_row] 
+    + self->curr_col);
+  }
+
+/*============================================================================
+ * line_length
+ * The number of bytes held for line k.
+ * ==========================================================================*/
+static int line_length (const I2C_LCD *self, uint32_t k)
+  {
+  uint32_t end = k + 1 == self->end_line 
+    ? self->text_end : self->line_start[(k + 1) % self->line_slots];
+  return (int)(end - self->line_start[k % self->line_slots]);
+  }
+
+/*============================================================================
+ * line_rows
+ * The number of rows line k takes up at the current width. An empty
+ * line still takes one.
+ * ==========================================================================*/
+static int line_rows (const I2C_LCD *self, uint32_t k)
+  {
+  int len = line_length (self, k);
+  return len <= self->width ? 1 : (len + self->width - 1) / self->width;
+  }
+
+/*============================================================================
+ * text_at
+ * ==========================================================================*/
+static char *text_at (const I2C_LCD *self, uint32_t offset)
+  {
+  return self->history_text + offset % (uint32_t)self->history_size;
+  }
+
+/*============================================================================
+ * copy_text
+ * Copy n bytes of the history, starting at offset, which may go round 
+ * the end of the ring.
+ * ==========================================================================*/
+static void copy_text (const I2C_LCD *self, uint32_t offset, char *buf, 
+       int n)
+  {
+  for (int i = 0; i < n; i++) buf[i] = *text_at (self, offset + i);
+  }
+
+/*============================================================================
+ * now_seconds
+ * ==========================================================================*/
+static uint32_t now_seconds (void)
+  {
+  return (uint32_t)(time_us_64() / 1000000);
+  }
+
+/*============================================================================
+ * encode_offset
+ * A line's time, as an offset in seconds from the first in its block. Up
+ * to about nine hours, this is exact; beyond, it is rounded down to 64 
+ * seconds, up to about 24 days, which is as far as it goes. Later times
+ * never give smaller offsets, so times stay in order.
+ * ==========================================================================*/
+static uint16_t encode_offset (uint32_t d)
+  {
+  if (d < 0x8000) return (uint16_t)d;
+  return (uint16_t)(0x8000 | MIN ((d - 0x8000) >> 6, 0x7FFF));
+  }
+
+/*============================================================================
+ * decode_offset
+ * ==========================================================================*/
+static uint32_t decode_offset (uint16_t v)
+  {
+  if (!(v & 0x8000)) return v;
+  return 0x8000 + ((uint32_t)(v & 0x7FFF) << 6);
+  }
+
+/*============================================================================
+ * line_time
+ * The time line k was started, which must be a line in the history.
+ * ==========================================================================*/
+static uint32_t line_time (const I2C_LCD *self, uint32_t k)
+  {
+  uint32_t base = self->block_time[k / I2C_LCD_TIME_BLOCK 
+    % (uint32_t)self->time_blocks];
+  return base + decode_offset (self->line_time[k % self->line_slots]);
+  }
+
+/*============================================================================
+ * stamp_line
+ * Give new line k the time t. A line that nothing was written to has 
+ * the time of the one before. A line is never given an earlier time 
+ * than the one before it, which can only happen if the cursor was moved
+ * up to write on a row that was blank.
+ * ==========================================================================*/
+static void stamp_line (I2C_LCD *self, uint32_t k, uint32_t t)
+  {
+  if (k == self->first_line)
+    {
+    if (t == I2C_LCD_NO_TIME) t = now_seconds();
+    }
+  else
+    {
+    uint32_t before = line_time (self, k - 1);
+    if (t == I2C_LCD_NO_TIME || t < before) t = before;
+    }
+  uint32_t *base = &self->block_time[k / I2C_LCD_TIME_BLOCK 
+    % (uint32_t)self->time_blocks];
+  // The first line held in a block, if not the first of the block, 
+  //   starts it
+  if (k % I2C_LCD_TIME_BLOCK == 0 || k == self->first_line) *base = t;
+  self->line_time[k % self->line_slots] = encode_offset (t - *base);
+  }
+
+/*============================================================================
+ * clear_row_times
+ * ==========================================================================*/
+static void clear_row_times (I2C_LCD *self, int row, int n)
+  {
+  for (int i = row; i < row + n; i++) self->row_time[i] = I2C_LCD_NO_TIME;
+  }
+
+/*============================================================================
+ * touch_row
+ * Note the time that the current row was first written to.
+ * ==========================================================================*/
+static inline void touch_row (I2C_LCD *self)
+  {
+  if (self->row_time[self->curr_row] == I2C_LCD_NO_TIME)
+    self->row_time[self->curr_row] = now_seconds();
+  }
+
+/*============================================================================
+ * forget_oldest
+ * ==========================================================================*/
+static void forget_oldest (I2C_LCD *self)
+  {
+  int rows = line_rows (self, self->first_line);
+  if (self->history >= 0) self->history -= rows;
+  if (self->cache_line == self->first_line)
+    {
+    self->cache_line++;
+    self->cache_row = 0;
+    }
+  else
+    self->cache_row -= rows;
+  self->first_line++;
+  }
+
+/*============================================================================
+ * close_line
+ * The newest line can't be continued any more, so its trailing spaces
+ * can go.
+ * ==========================================================================*/
+static void close_line (I2C_LCD *self)
+  {
+  if (!self->open) return;
+  self->open = FALSE;
+  uint32_t k = self->end_line - 1;
+  int rows = line_rows (self, k);
+  uint32_t start = self->line_start[k % self->line_slots];
+  while (self->text_end > start && *text_at (self, self->text_end - 1) == ' ')
+    self->text_end--;
+  if (self->history >= 0) self->history += line_rows (self, k) - rows;
+  }
+
+/*============================================================================
+ * add_row
+ * Add a row that has left the top of the display, or been restored, to
+ * the scrollback buffer: either as a new line, or on the end of the 
+ * newest line if the row continues it. The oldest lines are forgotten 
+ * to make room. A new line is given the time 'time' -- see stamp_line().
+ * ==========================================================================*/
+static void add_row (I2C_LCD *self, const char *row, int len, 
+       BOOL continued, uint32_t time)
+  {
+  if (self->line_slots == 0) return;
+  uint32_t k = self->end_line - 1;
+  int rows = 0;
+  if (continued && self->open && self->end_line != self->first_line
+       && line_length (self, k) + len <= I2C_LCD_LINE_MAX)
+    rows = line_rows (self, k);
+  else
+    {
+    close_line (self);
+    if (self->end_line - self->first_line == (uint32_t)self->line_slots)
+      forget_oldest (self);
+    k = self->end_line++;
+    self->line_start[k % self->line_slots] = self->text_end;
+    self->open = TRUE;
+    stamp_line (self, k, time);
+    }
+  len = MIN (len, I2C_LCD_LINE_MAX - line_length (self, k));
+
+  // Forget the oldest lines until the new text fits, but never the 
+  //   newest, which the text is going on to the end of
+  while (self->first_line != k && self->text_end + len 
+           - self->line_start[self->first_line % self->line_slots] 
+           > (uint32_t)self->history_size)
+    forget_oldest (self);
+  len = MIN (len, self->history_size - line_length (self, k));
+
+  for (int i = 0; i < len; i++)
+    *text_at (self, self->text_end + i) = row[i];
+  self->text_end += len;
+  if (self->history >= 0) self->history += line_rows (self, k) - rows;
+  }
+
+/*============================================================================
+ * count_history
+ * The number of rows above the display at the current width, which is 
+ * counted again only after the width has changed.
+ * ==========================================================================*/
+static int count_history (const I2C_LCD *self)
+  {
+  if (self->history < 0)
+    {
+    // Only the count is cached; the const is to suit the callers
+    I2C_LCD *mutable_self = (I2C_LCD *)self;
+    int rows = 0;
+    for (uint32_t k = self->first_line; k != self->end_line; k++)
+      rows += line_rows (self, k);
+    mutable_self->history = rows;
+    }
+  return self->history;
+  }
+
+/*============================================================================
+ * find_row
+ * Find history row n: the line it's in, and which row of that line it
+ * is. The search starts from whichever is nearest of the oldest line, 
+ * the newest, and the last one found.
+ * ==========================================================================*/
+static uint32_t find_row (const I2C_LCD *self, int n, int *row_in_line)
+  {
+  I2C_LCD *mutable_self = (I2C_LCD *)self;
+  int history = count_history (self);
+  uint32_t k = self->cache_line;
+  int row = self->cache_row;
+  if (n < row - n)
+    {
+    k = self->first_line;
+    row = 0;
+    }
+  else if (history - n < abs (n - row))
+    {
+    k = self->end_line - 1;
+    row = history - line_rows (self, k);
+    }
+  while (n < row)
+    {
+    k--;
+    row -= line_rows (self, k);
+    }
+  while (k + 1 != self->end_line && n >= row + line_rows (self, k))
+    {
+    row += line_rows (self, k);
+    k++;
+    }
+  mutable_self->cache_line = k;
+  mutable_self->cache_row = row;
+  *row_in_line = n - row;
+  return k;
+  }
+
+/*============================================================================
+ * line_row
+ * The history row that line k starts on. Like find_row(), this counts 
+ * from whichever is nearest of the oldest line, the newest, and the last
+ * one found, and remembers where it got to.
+ * ==========================================================================*/
+static int line_row (const I2C_LCD *self, uint32_t k)
+  {
+  I2C_LCD *mutable_self = (I2C_LCD *)self;
+  int history = count_history (self);
+  uint32_t c = self->cache_line;
+  int row = self->cache_row;
+  uint32_t from_cache = (int32_t)(k - c) < 0 ? c - k : k - c;
+  if (k - self->first_line < from_cache)
+    {
+    c = self->first_line;
+    row = 0;
+    }
+  else if (self->end_line - 1 - k < from_cache)
+    {
+    c = self->end_line - 1;
+    row = history - line_rows (self, c);
+    }
+  while ((int32_t)(k - c) < 0)
+    {
+    c--;
+    row -= line_rows (self, c);
+    }
+  while (c != k)
+    {
+    row += line_rows (self, c);
+    c++;
+    }
+  mutable_self->cache_line = c;
+  mutable_self->cache_row = row;
+  return row;
+  }
+
+/*============================================================================
+ * get_row
+ * Copy row n of everything the console holds -- the history, at the 
+ * current width, then the display -- into buf, which must have room for
+ * width characters.
+ * ==========================================================================*/
+static void get_row (const I2C_LCD *self, int n, char *buf)
+  {
+  int history = count_history (self);
+  if (n >= history)
+    {
+    memcpy (buf, self->screen + (n - history) * self->width, self->width);
+    return;
+    }
+  int r;
+  uint32_t k = find_row (self, n, &r);
+  int from = r * self->width;
+  int len = MAX (0, MIN (self->width, line_length (self, k) - from));
+  copy_text (self, self->line_start[k % self->line_slots] + from, buf, len);
+  memset (buf + len, ' ', self->width - len);
   }
 
 /*============================================================================
@@ -137,56 +820,87 @@ static void send_char (const I2C_LCD *self, char c)
  * ==========================================================================*/
 static void reset_scrollback (I2C_LCD *self)
   {
-  memset (self->scrollback_buffer, ' ', 
-    self->scrollback_max_lines * self->width);
+  memset (self->screen, ' ', self->height * self->width);
+  memset (self->continues, FALSE, self->height);
+  clear_row_times (self, 0, self->height);
   self->scrollback = 0;
+  self->view_dirty = FALSE;
+  // None of the old line numbers refer to anything now
+  self->first_line = self->end_line;
+  self->open = FALSE;
+  self->history = 0;
+  self->cache_line = self->first_line;
+  self->cache_row = 0;
   }
 
 /*============================================================================
  * dump_scrollback 
  * Dump the scrollback buffer to the display, starting at the position of
- * self->scrollback. 
+ * self->scrollback, and bring the status region up to date. 
  * ==========================================================================*/
 static void dump_scrollback (I2C_LCD *self)
   {
-  int old_curr_row = self->curr_row;
-  int old_curr_col = self->curr_col;
+  char rows[I2C_LCD_MAX_ROWS * I2C_LCD_MAX_WIDTH];
+  int first = count_history (self) - self->scrollback;
+  for (int i = 0; i < self->height; i++)
+    get_row (self, first + i, rows + i * self->width);
+  update_panel (self, rows);
+  }
 
-  int scrollback_start_line = self->scrollback_max_lines - self->height 
-    - self->scrollback;
+/*============================================================================
+ * render_view
+ * Bring the display up to date with the scrollback position, if it has
+ * changed since the display was last drawn. Because only the characters
+ * that differ are sent, a jump of any distance costs at most one 
+ * screenful.
+ * ==========================================================================*/
+static void render_view (I2C_LCD *self)
+  {
+  if (!self->view_dirty) return;
+  self->view_dirty = FALSE;
+  dump_scrollback (self);
+  // Back at the working position, so restore the original cursor
+  if (self->scrollback == 0) restore_cursor (self);
+  }
 
-  for (int i = 0; i < self->height; i++)
-    {
-    int offset = (scrollback_start_line + i) * self->width;
-    i2c_lcd_set_cursor (self, i, 0);
-    for (int j = 0; j < self->width; j++)
-      {
-      send_char (self, self->scrollback_buffer[offset + j]);
-      }
-    }
-  
-  self->curr_row = old_curr_row;
-  self->curr_col = old_curr_col;
+/*============================================================================
+ * scroll_to
+ * Set the scrollback position, without drawing anything.
+ * ==========================================================================*/
+static void scroll_to (I2C_LCD *self, int scrollback)
+  {
+  scrollback = MAX (0, MIN (scrollback, count_history (self)));
+  if (scrollback == self->scrollback) return;
+  self->scrollback = scrollback;
+  self->view_dirty = TRUE;
   }
 
 /*============================================================================
  *  cancel_scrollback
  *  Reset the display to the bottom of the scrollback buffer, that is, to
- *    the display that would have been visible before scrolling back. Only
- *    do this if, in fact, a scrollback is in force -- it causes an ugly
- *    flicker otherwise.
+ *    the display that would have been visible before scrolling back. 
+ *    Any scrollback movement that hasn't been drawn yet is drawn now, 
+ *    so that output appears in the right place.
  * ==========================================================================*/
 static void cancel_scrollback (I2C_LCD *self)
   {
-  if (self->scrollback > 0)
-    {
-    self->scrollback = 0;
-    dump_scrollback (self);
-    i2c_lcd_set_cursor (self, self->curr_row, self->curr_col);
-    }
+  scroll_to (self, 0);
+  render_view (self);
   }
 
 
+/*============================================================================
+ * line_done
+ * The cursor is leaving the current line, so tell the application (if
+ * it wants to know) what the line holds.
+ * ==========================================================================*/
+static void line_done (I2C_LCD *self)
+  {
+  if (!self->line_fn) return;
+  self->line_fn ((const char *)self->screen + self->curr_row * self->width,
+    self->width, self->continues[self->curr_row], self->line_context);
+  }
+
 /*============================================================================
  * scroll_up 
  * ==========================================================================*/
@@ -194,92 +908,276 @@ static void scroll_up (I2C_LCD *self)
   {
   int orig_col = self->curr_col;
 
-  // Shift scrollback buffer up one line
-
-  memmove (self->scrollback_buffer, self->scrollback_buffer + self->width,
-             self->width * (self->scrollback_max_lines - 1));
-  memset (self->scrollback_buffer + (self->scrollback_max_lines - 1) 
-            * self->width, ' ', self->width);
+  // The top row goes into the scrollback buffer, and the rest move up
+
+  add_row (self, (const char *)self->screen, self->width, 
+    self->continues[0], self->row_time[0]);
+  memmove (self->screen, self->screen + self->width,
+             self->width * (self->height - 1));
+  memset (self->screen + (self->height - 1) * self->width, ' ', 
+    self->width);
+  memmove (self->continues, self->continues + 1, self->height - 1);
+  self->continues[self->height - 1] = FALSE;
+  memmove (self->row_time, self->row_time + 1, 
+    (self->height - 1) * sizeof (uint32_t));
+  clear_row_times (self, self->height - 1, 1);
+  
+  // Redraw the scrolling region. Only the characters that have changed
+  //   are sent, and the status region, if there is one, is left alone 
+  //   -- so we don't clear the display.
   
-  // clear display
+  update_panel (self, (const char *)self->screen);
 
-  i2c_lcd_clear (self, FALSE);
+  // Set to original_column 
+  i2c_lcd_set_cursor (self, self->height - 1, orig_col); 
+  }
 
-  // Dump bottom (height - 1) lines from the scrollback buffer to the display
-  
-  for (int i = 0; i < self->height - 1; i++)
+/*============================================================================
+ * wrap_line
+ * The cursor has reached the end of the row, so carry on at the start of
+ * the next, which continues the same logical line.
+ * ==========================================================================*/
+static void wrap_line (I2C_LCD *self)
+  {
+  i2c_lcd_new_line (self);
+  self->continues[self->curr_row] = TRUE;
+  }
+
+/*============================================================================
+ * set_offsets
+ * Work out where each row starts in the HD44780's display RAM.
+ * ==========================================================================*/
+static void set_offsets (I2C_LCD *self)
+  {
+  if (self->panel->controllers == 2)
     {
-    int offset = (self->scrollback_max_lines - self->height + i + 0) 
-      * self->width;
-    i2c_lcd_set_cursor (self, i, 0);
-    for (int j = 0; j < self->width; j++)
-      {
-      send_char (self, self->scrollback_buffer[offset + j]);
-      }
+    // Rows 2 and 3 are rows 0 and 1 of the second controller
+    self->offsets[0] = 0;
+    self->offsets[1] = 0x40;
+    self->offsets[2] = LCD_DDRAM_SIZE;
+    self->offsets[3] = LCD_DDRAM_SIZE + 0x40;
+    return;
     }
+  self->offsets[0] = 0;
+  self->offsets[1] = 0x40;
+  self->offsets[2] = self->width;
+  self->offsets[3] = 0x40 + self->width;
+  }
 
-  // Set to original_column 
-  i2c_lcd_set_cursor (self, self->height - 1, orig_col); 
+/*============================================================================
+ * alloc_screen
+ * ==========================================================================*/
+static void alloc_screen (I2C_LCD *self)
+  {
+  free (self->screen);
+  free (self->continues);
+  free (self->row_time);
+  self->screen = malloc (self->width * self->height);
+  self->continues = malloc (self->height);
+  self->row_time = malloc (self->height * sizeof (uint32_t));
+  clear_row_times (self, 0, self->height);
   }
 
 /*============================================================================
- *  i2c_lcd_new 
+ *  new_console
  * ==========================================================================*/
-I2C_LCD *i2c_lcd_new (int width, int height, int addr, i2c_inst_t *i2c, 
-                       int sda, int scl, int i2c_baud, int scrollback_pages)
+static I2C_LCD *new_console (int width, int height, I2C_LCD_PANEL *panel,
+                       int scrollback_pages)
   {
   I2C_LCD *self = malloc (sizeof (I2C_LCD));
-  self->width = width;
+  self->width = MAX (1, MIN (width, I2C_LCD_MAX_WIDTH));
+  width = self->width;
   self->height = height;
-  self->addr = addr;
-  self->i2c = i2c;
+  self->panel = panel;
+  self->panel_rows = height;
+  self->top = 0;
+  self->status_rows = 0;
+  self->status_top = 0;
+  self->status_buffer = NULL;
+  panel->consoles++;
   self->wrap = TRUE; 
   self->implicit_lf = TRUE;
   self->destructive_backspace = TRUE; 
-  self->scrollback_max_lines = scrollback_pages * self->height; 
-  self->scrollback_buffer = malloc (self->width * self->scrollback_max_lines);
+  // The rows on the display aren't part of the history, so the buffer
+  //   has the same number of rows above the display as it used to have
+  //   when the display was part of it
+  self->line_slots = MAX (0, scrollback_pages - 1) * self->height;
+  self->history_size = self->line_slots * self->width;
+  self->history_text = malloc (MAX (1, self->history_size));
+  self->line_start = malloc (MAX (1, self->line_slots) * sizeof (uint32_t));
+  self->line_time = malloc (MAX (1, self->line_slots) * sizeof (uint16_t));
+  // Enough blocks that the newest line's never has the oldest's slot
+  self->time_blocks = self->line_slots / I2C_LCD_TIME_BLOCK + 2;
+  self->block_time = malloc (self->time_blocks * sizeof (uint32_t));
+  self->first_line = 0;
+  self->end_line = 0;
+  self->text_end = 0;
+  self->screen = NULL;
+  self->continues = NULL;
+  self->row_time = NULL;
+  alloc_screen (self);
   reset_scrollback (self);
 
-  i2c_init (i2c, i2c_baud);
-  gpio_set_function (sda, GPIO_FUNC_I2C);
-  gpio_set_function (scl, GPIO_FUNC_I2C);
-  gpio_pull_up (sda);
-  gpio_pull_up (scl);
-  self->backlight = 0;
   self->display_mode = I2C_LCD_ENTRY_LEFT | I2C_LCD_ENTRY_SHIFT_DECREMENT;
   self->display_function 
                     = I2C_LCD_MODE_4_BIT | I2C_LCD_LINE_2 | I2C_LCD_DOTS_5X8;
   self->display_control 
                     = I2C_LCD_DISPLAY_ON | I2C_LCD_CURSOR_ON | I2C_LCD_BLINK_OFF;
 
-  self->offsets[0] = 0;
-  self->offsets[1] = 0x40;
-  self->offsets[2] = width;
-  self->offsets[3] = 0x40 + width;
+  set_offsets (self);
   
   self->curr_row = 0;
   self->curr_col = 0;
-  
-  // Basic init sequence. It's an ugly workaround for the fact that we
-  //   don't know whether the unit starts up in 4-bit or 8-bit mode.
-  send_command (self, 0x03);
-  send_command (self, 0x03);
-  send_command (self, 0x03);
-  send_command (self, 0x02);
+  self->line_fn = NULL;
+  self->line_context = NULL;
+  return self;
+  }
 
-  send_command (self, I2C_LCD_ENTRY_MODE_SET | self->display_mode);
-  send_command (self, I2C_LCD_FUNCTION_SET | self->display_function);
+/*============================================================================
+ *  i2c_lcd_new 
+ * ==========================================================================*/
+I2C_LCD *i2c_lcd_new (int width, int height, int addr, i2c_inst_t *i2c, 
+                       int sda, int scl, int i2c_baud, int scrollback_pages)
+  {
+  LCD_TRANSPORT *transport = lcd_transport_i2c_new (i2c, addr, sda, scl, 
+    i2c_baud);
+  return i2c_lcd_new_with_transport (width, height, transport, 
+    scrollback_pages);
+  }
 
-  i2c_lcd_display_on (self);
+/*============================================================================
+ *  i2c_lcd_new_with_transport
+ * ==========================================================================*/
+I2C_LCD *i2c_lcd_new_with_transport (int width, int height, 
+                       LCD_TRANSPORT *transport, int scrollback_pages)
+  {
+  I2C_LCD *self = i2c_lcd_new_deferred (width, height, transport, 
+    scrollback_pages);
+  uint32_t delay_us;
+  while (!i2c_lcd_init_step (self, &delay_us))
+    sleep_us (delay_us);
+  return self;
+  }
 
-  // We might as well start with the backlight on -- this is the usual
-  //   power-on state of these I2C LCD devices. The application call 
-  //   always turn it off with i2c_lcd_backlight_off() later if necessary.
-  i2c_lcd_backlight_on (self);
+/*============================================================================
+ *  controllers_needed
+ *  One HD44780 can only drive 80 characters, so a 40x4 panel has two.
+ *  Only a transport made for two controllers can select between them
+ *  (lcd_transport_gpio_new_dual(), lcd_transport_i2c_new_dual()): on 
+ *  any other, the panel is driven as one controller.
+ * ==========================================================================*/
+static int controllers_needed (const LCD_TRANSPORT *transport, int width, 
+       int height)
+  {
+  return transport->select && height > 2 && width > 0x14 ? 2 : 1;
+  }
 
+/*============================================================================
+ *  i2c_lcd_new_deferred
+ * ==========================================================================*/
+I2C_LCD *i2c_lcd_new_deferred (int width, int height, 
+                       LCD_TRANSPORT *transport, int scrollback_pages)
+  {
+  I2C_LCD_PANEL *panel = malloc (sizeof (I2C_LCD_PANEL));
+  panel->transport = transport;
+  panel->consoles = 0;
+  panel->init_state = 0;
+  panel->controllers = controllers_needed (transport, width, height);
+  panel->selected = LCD_CONTROLLER_1;
+  panel->current = 0;
+  panel->cursor = 0;
+  panel->addr[0] = 0;
+  panel->addr[1] = 0;
+  panel->display_control = 0;
+  panel->backlight = FALSE;
+  panel->asleep = FALSE;
+  panel->wake_backlight = FALSE;
+  panel->wake_display = FALSE;
+  panel->changes = 0;
+  memset (panel->ddram, ' ', sizeof (panel->ddram));
+
+  I2C_LCD *self = new_console (width, height, panel, scrollback_pages);
+  panel->active = self;
   return self;
   }
 
+/*============================================================================
+ *  i2c_lcd_new_console
+ *  The console gets the panel's size: display->height is only the rows
+ *  that scroll, if a status region has been set aside.
+ * ==========================================================================*/
+I2C_LCD *i2c_lcd_new_console (I2C_LCD *display, int scrollback_pages)
+  {
+  return new_console (display->width, display->panel_rows, display->panel, 
+    scrollback_pages);
+  }
+
+/*============================================================================
+ *  i2c_lcd_init_step
+ *  Each step sends one command, and says how long to wait before the 
+ *  next. The delays are the ones the HD44780 datasheet gives for 
+ *  initialization by instruction. 
+ * ==========================================================================*/
+BOOL i2c_lcd_init_step (I2C_LCD *self, uint32_t *delay_us)
+  {
+  *delay_us = 0;
+  switch (self->panel->init_state++)
+    {
+    case 0:
+      // The HD44780 needs 40ms after power-up before it accepts commands
+      {
+      uint64_t since_boot = to_us_since_boot (get_absolute_time());
+      if (since_boot < I2C_LCD_POWER_UP_US)
+        *delay_us = (uint32_t)(I2C_LCD_POWER_UP_US - since_boot);
+      }
+      return FALSE;
+    // Basic init sequence. It's an ugly workaround for the fact that we
+    //   don't know whether the unit starts up in 4-bit or 8-bit mode.
+    case 1:
+      send_command (self, 0x03);
+      *delay_us = 4100;
+      return FALSE;
+    case 2:
+      send_command (self, 0x03);
+      *delay_us = 100;
+      return FALSE;
+    case 3:
+      send_command (self, 0x03);
+      return FALSE;
+    case 4:
+      send_command (self, 0x02);
+      return FALSE;
+    case 5:
+      send_command (self, I2C_LCD_ENTRY_MODE_SET | self->display_mode);
+      return FALSE;
+    case 6:
+      send_command (self, I2C_LCD_FUNCTION_SET | self->display_function);
+      return FALSE;
+    case 7:
+      i2c_lcd_display_on (self);
+      return FALSE;
+    case 8:
+      // We might as well start with the backlight on -- this is the usual
+      //   power-on state of these I2C LCD devices. The application call 
+      //   always turn it off with i2c_lcd_backlight_off() later if 
+      //   necessary.
+      i2c_lcd_backlight_on (self);
+      return TRUE;
+    default:
+      // Already done
+      self->panel->init_state = I2C_LCD_INIT_DONE;
+      return TRUE;
+    }
+  }
+
+/*============================================================================
+ *  i2c_lcd_ready
+ * ==========================================================================*/
+BOOL i2c_lcd_ready (const I2C_LCD *self)
+  {
+  return self->panel->init_state >= I2C_LCD_INIT_DONE;
+  }
+
 /*============================================================================
  *  i2c_lcd_display_on
  * ==========================================================================*/
@@ -303,8 +1201,9 @@ void i2c_lcd_display_off (I2C_LCD* self)
  * ==========================================================================*/
 void i2c_lcd_backlight_on (I2C_LCD* self)
   {
-  self->backlight = I2C_LCD_BACKLIGHT;
-  i2c_write_byte (self, self->backlight); 
+  self->panel->backlight = TRUE;
+  self->panel->changes++;
+  self->panel->transport->set_backlight (self->panel->transport, TRUE);
   }
 
 /*============================================================================
@@ -312,8 +1211,86 @@ void i2c_lcd_backlight_on (I2C_LCD* self)
  * ==========================================================================*/
 void i2c_lcd_backlight_off (I2C_LCD* self)
   {
-  self->backlight = 0;
-  i2c_write_byte (self, self->backlight); 
+  self->panel->backlight = FALSE;
+  self->panel->changes++;
+  self->panel->transport->set_backlight (self->panel->transport, FALSE);
+  }
+
+/*============================================================================
+ *  set_backlight_with_next
+ *  Change the backlight along with the next byte sent to the panel, if 
+ *  the transport can, so that it costs no write of its own.
+ * ==========================================================================*/
+static void set_backlight_with_next (I2C_LCD_PANEL *panel, BOOL on)
+  {
+  LCD_TRANSPORT *transport = panel->transport;
+  panel->backlight = on;
+  panel->changes++;
+  if (transport->set_backlight_later)
+    transport->set_backlight_later (transport, on);
+  else
+    transport->set_backlight (transport, on);
+  }
+
+/*============================================================================
+ *  i2c_lcd_sleep
+ *  The display control command that turns the display off carries the 
+ *  backlight with it.
+ * ==========================================================================*/
+void i2c_lcd_sleep (I2C_LCD *self)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  I2C_LCD *active = panel->active;
+  if (panel->asleep || !active) return;
+  panel->asleep = TRUE;
+  panel->wake_backlight = panel->backlight;
+  panel->wake_display = (panel->display_control & I2C_LCD_DISPLAY_ON) != 0;
+  set_backlight_with_next (panel, FALSE);
+  active->display_control &= ~I2C_LCD_DISPLAY_ON;
+  send_command (active, I2C_LCD_DISPLAY_CONTROL | active->display_control);
+  }
+
+/*============================================================================
+ *  i2c_lcd_wake
+ *  The HD44780 keeps its display RAM while the display is off, so there
+ *  is nothing to redraw: one display control command, carrying the 
+ *  backlight, brings everything back.
+ * ==========================================================================*/
+void i2c_lcd_wake (I2C_LCD *self)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  I2C_LCD *active = panel->active;
+  if (!panel->asleep || !active) return;
+  panel->asleep = FALSE;
+  set_backlight_with_next (panel, panel->wake_backlight);
+  if (panel->wake_display) active->display_control |= I2C_LCD_DISPLAY_ON;
+  send_command (active, I2C_LCD_DISPLAY_CONTROL | active->display_control);
+  }
+
+/*============================================================================
+ *  i2c_lcd_is_asleep
+ * ==========================================================================*/
+BOOL i2c_lcd_is_asleep (const I2C_LCD *self)
+  {
+  return self->panel->asleep;
+  }
+
+/*============================================================================
+ *  wake_for_output
+ *  Anything printed to the console that the panel shows wakes it, so 
+ *  that nothing is written where it can't be seen.
+ * ==========================================================================*/
+static inline void wake_for_output (I2C_LCD *self)
+  {
+  if (self->panel->asleep && self->panel->active == self) i2c_lcd_wake (self);
+  }
+
+/*============================================================================
+ *  i2c_lcd_is_backlight_on
+ * ==========================================================================*/
+BOOL i2c_lcd_is_backlight_on (const I2C_LCD* self)
+  {
+  return self->panel->backlight;
   }
 
 /*============================================================================
@@ -325,7 +1302,32 @@ void i2c_lcd_set_cursor (I2C_LCD *self, int row, int col)
   row = MIN (row, self->height - 1);
   self->curr_row = row;
   self->curr_col = col;
-  send_command (self, I2C_LCD_SET_DDRAM_ADDR | (self->offsets[row] + col));
+  place_cursor (self, self->offsets[self->top + row] + col);
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_cursor
+ * ==========================================================================*/
+void i2c_lcd_get_cursor (const I2C_LCD *self, int *row, int *col)
+  {
+  if (row) *row = self->curr_row;
+  if (col) *col = self->curr_col;
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_width
+ * ==========================================================================*/
+int i2c_lcd_get_width (const I2C_LCD *self)
+  {
+  return self->width;
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_height
+ * ==========================================================================*/
+int i2c_lcd_get_height (const I2C_LCD *self)
+  {
+  return self->height;
   }
 
 /*============================================================================
@@ -333,10 +1335,40 @@ void i2c_lcd_set_cursor (I2C_LCD *self, int row, int col)
  * ==========================================================================*/
 void i2c_lcd_print_string (I2C_LCD *self, const char *s) 
   {
-  while (*s)
+  i2c_lcd_print_chars (self, s, strlen (s));
+  }
+
+/*============================================================================
+ *  i2c_lcd_print_chars
+ *  Runs of ordinary characters that fit on the current line are sent
+ *  in a single batch. Anything else goes through i2c_lcd_print_char().
+ * ==========================================================================*/
+void i2c_lcd_print_chars (I2C_LCD *self, const char *s, int n) 
+  {
+  wake_for_output (self);
+  cancel_scrollback (self);
+  int i = 0;
+  while (i < n)
     {
-    i2c_lcd_print_char (self, *s);
-    s++;
+    int run = 0;
+    int room = self->width - self->curr_col;
+    while (run < room && i + run < n && (unsigned char)s[i + run] >= 32 
+           && s[i + run] != 127)
+      run++;
+    if (run == 0)
+      {
+      i2c_lcd_print_char (self, s[i]);
+      i++;
+      continue;
+      }
+    send_chars (self, s + i, run);
+    touch_row (self);
+    memcpy (self->screen + self->curr_row * self->width + self->curr_col, 
+      s + i, run);
+    self->curr_col += run;
+    i += run;
+    if (self->wrap && self->curr_col >= self->width)
+      wrap_line (self);
     }
   }
 
@@ -345,9 +1377,11 @@ void i2c_lcd_print_string (I2C_LCD *self, const char *s)
  * ==========================================================================*/
 void i2c_lcd_line_feed (I2C_LCD *self) 
   {
+  line_done (self);
   self->curr_row++;
   if (self->curr_row >= self->height)
     scroll_up (self);
+  self->continues[self->curr_row] = FALSE;
   i2c_lcd_set_cursor (self, self->curr_row, self->curr_col);
   }
 
@@ -416,6 +1450,7 @@ void i2c_lcd_del (I2C_LCD *self)
  * ==========================================================================*/
 void i2c_lcd_new_line (I2C_LCD *self) 
   {
+  line_done (self);
   if (self->curr_row >= self->height - 1)
     {
     scroll_up (self);
@@ -424,6 +1459,7 @@ void i2c_lcd_new_line (I2C_LCD *self)
     {
     self->curr_row++;
     }
+  self->continues[self->curr_row] = FALSE;
   i2c_lcd_set_cursor (self, self->curr_row, 0);
   }
 
@@ -432,6 +1468,7 @@ void i2c_lcd_new_line (I2C_LCD *self)
  * ==========================================================================*/
 void i2c_lcd_print_char (I2C_LCD *self, const char c) 
   {
+  wake_for_output (self);
   cancel_scrollback (self);
   switch (c)
     {
@@ -457,16 +1494,18 @@ void i2c_lcd_print_char (I2C_LCD *self, const char c)
       break;
     default:
       send_char (self, c);
-      int scrollback_row = self->scrollback_max_lines - self->height 
-        + self->curr_row;
-      self->scrollback_buffer 
-        [scrollback_row * self->width + self->curr_col] = c;
+      // With wrapping off, the cursor can go past the end of the row
+      if (self->curr_col < self->width)
+        {
+        self->screen[self->curr_row * self->width + self->curr_col] = c;
+        touch_row (self);
+        }
       self->curr_col++;
       if (self->wrap)
         {
         if (self->curr_col >= (int)self->width)
           {
-          i2c_lcd_new_line (self);
+          wrap_line (self);
           }
         }
     }
@@ -477,8 +1516,18 @@ void i2c_lcd_print_char (I2C_LCD *self, const char c)
  * ==========================================================================*/
 void  i2c_lcd_clear (I2C_LCD *self, BOOL clear_scrollback)
   {
-  send_command (self, I2C_LCD_CLEAR_DISPLAY); 
+  memset (self->screen, ' ', self->height * self->width);
+  memset (self->continues, FALSE, self->height);
+  clear_row_times (self, 0, self->height);
+  if (self->status_rows == 0)
+    send_command (self, I2C_LCD_CLEAR_DISPLAY); 
+  else
+    {
+    // Clearing the display would clear the status region too
+    update_panel (self, (const char *)self->screen);
+    }
   self->curr_row = 0; self->curr_col = 0;
+  if (self->status_rows > 0) restore_cursor (self);
 
   if (clear_scrollback)
     {
@@ -503,6 +1552,14 @@ void  i2c_lcd_wrapping_off (I2C_LCD *self)
   self->wrap = FALSE;
   }
 
+/*============================================================================
+ *  i2c_lcd_is_wrapping
+ * ==========================================================================*/
+BOOL  i2c_lcd_is_wrapping (const I2C_LCD *self)
+  {
+  return self->wrap;
+  }
+
 /*============================================================================
  *  i2c_lcd_destructive_backspace_on
  * ==========================================================================*/
@@ -540,38 +1597,495 @@ void i2c_lcd_destructive_backspace_off (I2C_LCD *self)
  * ==========================================================================*/
 void i2c_lcd_scrollback_line_up (I2C_LCD *self)
   {
-  int scrollback_start_line = self->scrollback_max_lines - self->height 
-    - self->scrollback - 1;
+  scroll_to (self, self->scrollback + 1);
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_line_down
+ * ==========================================================================*/
+void i2c_lcd_scrollback_line_down (I2C_LCD *self)
+  {
+  scroll_to (self, self->scrollback - 1);
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_page_up
+ * ==========================================================================*/
+void i2c_lcd_scrollback_page_up (I2C_LCD *self)
+  {
+  scroll_to (self, self->scrollback + self->height);
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_page_down
+ * ==========================================================================*/
+void i2c_lcd_scrollback_page_down (I2C_LCD *self)
+  {
+  scroll_to (self, self->scrollback - self->height);
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_top
+ * ==========================================================================*/
+void i2c_lcd_scrollback_top (I2C_LCD *self)
+  {
+  scroll_to (self, count_history (self));
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_live
+ * ==========================================================================*/
+void i2c_lcd_scrollback_live (I2C_LCD *self)
+  {
+  scroll_to (self, 0);
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_scrollback
+ * ==========================================================================*/
+int i2c_lcd_get_scrollback (const I2C_LCD *self)
+  {
+  return self->scrollback;
+  }
+
+/*============================================================================
+ *  i2c_lcd_update
+ * ==========================================================================*/
+void i2c_lcd_update (I2C_LCD *self)
+  {
+  render_view (self);
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_lines
+ * ==========================================================================*/
+int i2c_lcd_scrollback_lines (const I2C_LCD *self)
+  {
+  return count_history (self) + self->height;
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_history
+ * ==========================================================================*/
+int i2c_lcd_scrollback_history (const I2C_LCD *self)
+  {
+  return count_history (self);
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_scrollback_line
+ * ==========================================================================*/
+void i2c_lcd_get_scrollback_line (const I2C_LCD *self, int n, char *buf)
+  {
+  get_row (self, n, buf);
+  buf[self->width] = 0;
+  }
+
+/*============================================================================
+ *  i2c_lcd_first_line
+ * ==========================================================================*/
+uint32_t i2c_lcd_first_line (const I2C_LCD *self)
+  {
+  return self->first_line;
+  }
+
+/*============================================================================
+ *  screen_line_starts
+ *  TRUE if display row r starts a logical line, rather than continuing
+ *  one. The top row can only continue the newest line in the history.
+ * ==========================================================================*/
+static BOOL screen_line_starts (const I2C_LCD *self, int r)
+  {
+  if (r > 0) return !self->continues[r];
+  return !(self->continues[0] && self->open);
+  }
+
+/*============================================================================
+ *  i2c_lcd_end_line
+ * ==========================================================================*/
+uint32_t i2c_lcd_end_line (const I2C_LCD *self)
+  {
+  uint32_t end = self->end_line;
+  for (int r = 0; r < self->height; r++)
+    if (screen_line_starts (self, r)) end++;
+  return end;
+  }
+
+/*============================================================================
+ *  append_screen_rows
+ *  Add display row r, and the rows after it that continue the same line,
+ *  to the len characters in buf, up to room characters in all. Returns
+ *  the new length.
+ * ==========================================================================*/
+static int append_screen_rows (const I2C_LCD *self, int r, char *buf, 
+       int len, int room)
+  {
+  do
+    {
+    int n = MIN (room - len, self->width);
+    memcpy (buf + len, self->screen + r * self->width, n);
+    len += n;
+    r++;
+    } while (r < self->height && !screen_line_starts (self, r));
+  return len;
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_line
+ * ==========================================================================*/
+int i2c_lcd_get_line (const I2C_LCD *self, uint32_t number, char *buf, 
+      int size)
+  {
+  int len, room = size - 1;
+  if ((int32_t)(number - self->first_line) < 0) return -1;
+  if ((int32_t)(number - self->end_line) < 0)
+    {
+    len = MIN (room, line_length (self, number));
+    copy_text (self, self->line_start[number % self->line_slots], buf, len);
+    // The newest line in the history may carry on at the top of the 
+    //   display
+    if (number + 1 == self->end_line && !screen_line_starts (self, 0))
+      len = append_screen_rows (self, 0, buf, len, room);
+    }
+  else
+    {
+    // Find the display row that the line starts on
+    uint32_t k = self->end_line;
+    int r;
+    for (r = 0; r < self->height; r++)
+      if (screen_line_starts (self, r) && k++ == number) break;
+    if (r == self->height) return -1;
+    len = append_screen_rows (self, r, buf, 0, room);
+    }
+  while (len > 0 && buf[len - 1] == ' ') len--;
+  buf[len] = 0;
+  return len;
+  }
 
-  if (scrollback_start_line > 0)
+/*============================================================================
+ *  i2c_lcd_get_line_time
+ * ==========================================================================*/
+BOOL i2c_lcd_get_line_time (const I2C_LCD *self, uint32_t number, 
+      uint32_t *seconds)
+  {
+  if ((int32_t)(number - self->first_line) < 0) return FALSE;
+  if ((int32_t)(number - self->end_line) < 0)
     {
-    self->scrollback++;
-    dump_scrollback (self);
+    *seconds = line_time (self, number);
+    return TRUE;
     }
+  uint32_t k = self->end_line;
+  for (int r = 0; r < self->height; r++)
+    if (screen_line_starts (self, r) && k++ == number)
+      {
+      *seconds = self->row_time[r];
+      return self->row_time[r] != I2C_LCD_NO_TIME;
+      }
+  return FALSE;
   }
 
 /*============================================================================
- *  i2c_lcd_scrollback_line_down
+ *  i2c_lcd_scrollback_seek
+ *  A binary search of the lines' times, which are in order. 
  * ==========================================================================*/
-void i2c_lcd_scrollback_line_down (I2C_LCD *self)
+BOOL i2c_lcd_scrollback_seek (I2C_LCD *self, uint32_t seconds, 
+      uint32_t *number)
+  {
+  uint32_t lo = self->first_line;
+  uint32_t hi = self->end_line;
+  while (lo != hi)
+    {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (line_time (self, mid) < seconds)
+      lo = mid + 1;
+    else
+      hi = mid;
+    }
+  if (number) *number = lo;
+  if (lo == self->end_line)
+    {
+    scroll_to (self, 0);
+    return FALSE;
+    }
+  scroll_to (self, count_history (self) - line_row (self, lo));
+  return TRUE;
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_memory
+ * ==========================================================================*/
+int i2c_lcd_get_memory (const I2C_LCD *self)
+  {
+  return (int)sizeof (I2C_LCD) 
+    + self->height * (self->width + 1)
+    + self->status_rows * self->width
+    + self->height * (int)sizeof (uint32_t)
+    + MAX (1, self->history_size) 
+    + MAX (1, self->line_slots) * (int)(sizeof (uint32_t) + sizeof (uint16_t))
+    + self->time_blocks * (int)sizeof (uint32_t);
+  }
+
+/*============================================================================
+ *  i2c_lcd_scrollback_page_bytes
+ *  A page is a screenful of rows, each of which can hold a line.
+ * ==========================================================================*/
+int i2c_lcd_scrollback_page_bytes (const I2C_LCD *self)
+  {
+  return self->height 
+    * (self->width + (int)(sizeof (uint32_t) + sizeof (uint16_t)));
+  }
+
+/*============================================================================
+ *  i2c_lcd_set_geometry
+ * ==========================================================================*/
+void i2c_lcd_set_geometry (I2C_LCD *self, int width, int height)
+  {
+  height = MAX (1, MIN (height, I2C_LCD_MAX_ROWS));
+  // Rows 2 and 3 follow on from rows 0 and 1 in display RAM, unless 
+  //   they're on a second controller
+  BOOL two = self->panel->transport->select != NULL;
+  width = MAX (1, MIN (width, height > 2 && !two ? 0x14 : 0x28));
+
+  // Everything on the display, down to the cursor or the last row that
+  //   holds anything, joins the history
+  line_done (self);
+  int rows = self->curr_row + 1;
+  for (int r = rows; r < self->height; r++)
+    {
+    const unsigned char *row = self->screen + r * self->width;
+    for (int c = 0; c < self->width; c++)
+      if (row[c] != ' ') rows = r + 1;
+    }
+  for (int r = 0; r < rows; r++)
+    add_row (self, (const char *)self->screen + r * self->width, 
+      self->width, self->continues[r], self->row_time[r]);
+  close_line (self);
+
+  BOOL at_top = self->status_rows > 0 && self->top > 0;
+  self->width = width;
+  self->panel_rows = height;
+  self->status_rows = MIN (self->status_rows, height - 1);
+  self->height = height - self->status_rows;
+  self->top = at_top ? self->status_rows : 0;
+  self->status_top = at_top ? 0 : self->height;
+  self->panel->controllers = controllers_needed (self->panel->transport,
+    width, height);
+  set_offsets (self);
+  free (self->status_buffer);
+  self->status_buffer = NULL;
+  if (self->status_rows > 0)
+    {
+    self->status_buffer = malloc (self->status_rows * width);
+    memset (self->status_buffer, ' ', self->status_rows * width);
+    }
+  alloc_screen (self);
+  memset (self->screen, ' ', self->height * width);
+  memset (self->continues, FALSE, self->height);
+
+  // The rows of the history will be counted when they're next needed
+  self->history = -1;
+  self->cache_line = self->first_line;
+  self->cache_row = 0;
+  self->scrollback = 0;
+  self->view_dirty = FALSE;
+  self->curr_row = 0;
+  self->curr_col = 0;
+  if (!i2c_lcd_ready (self)) return;
+  send_command (self, I2C_LCD_CLEAR_DISPLAY);
+  restore_cursor (self);
+  }
+
+/*============================================================================
+ *  i2c_lcd_set_line_callback
+ * ==========================================================================*/
+void i2c_lcd_set_line_callback (I2C_LCD *self, I2C_LCD_LINE_FN fn, 
+       void *context)
+  {
+  self->line_fn = fn;
+  self->line_context = context;
+  }
+
+/*============================================================================
+ *  i2c_lcd_restore_line
+ * ==========================================================================*/
+void i2c_lcd_restore_line (I2C_LCD *self, const char *line, int len,
+       BOOL continued)
+  {
+  // When it was written isn't known, except that it was before anything
+  //   since start-up
+  add_row (self, line, len, continued, 0);
+  }
+
+/*============================================================================
+ *  i2c_lcd_set_status_region
+ * ==========================================================================*/
+void i2c_lcd_set_status_region (I2C_LCD *self, int rows, BOOL at_top)
+  {
+  // Leave at least one row to scroll
+  rows = MAX (0, MIN (rows, self->panel_rows - 1));
+  free (self->status_buffer);
+  self->status_buffer = NULL;
+  if (rows > 0)
+    {
+    self->status_buffer = malloc (rows * self->width);
+    memset (self->status_buffer, ' ', rows * self->width);
+    }
+  self->status_rows = rows;
+  self->height = self->panel_rows - rows;
+  self->top = at_top ? rows : 0;
+  self->status_top = at_top ? 0 : self->height;
+
+  // Start again, with an empty scrolling region
+  alloc_screen (self);
+  reset_scrollback (self);
+  self->curr_row = 0;
+  self->curr_col = 0;
+  if (!i2c_lcd_ready (self)) return;
+  update_panel (self, (const char *)self->screen);
+  restore_cursor (self);
+  }
+
+/*============================================================================
+ *  i2c_lcd_set_status
+ *  Only the characters that have changed are sent to the panel, and the
+ *  cursor is put back where it was only if something was sent. 
+ * ==========================================================================*/
+void i2c_lcd_set_status (I2C_LCD *self, int row, int col, const char *s)
+  {
+  if (row < 0 || row >= self->status_rows || col < 0 || col >= self->width) 
+    return;
+  int n = MIN ((int)strlen (s), self->width - col);
+  unsigned char *line = self->status_buffer + row * self->width;
+  memcpy (line + col, s, n);
+  if (update_row (self, self->status_top + row, (const char *)line)
+       && self->scrollback == 0)
+    restore_cursor (self);
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_status_rows
+ * ==========================================================================*/
+int i2c_lcd_get_status_rows (const I2C_LCD *self)
+  {
+  return self->status_rows;
+  }
+
+/*============================================================================
+ *  i2c_lcd_activate
+ *  Work out what this console should show -- which depends on how far
+ *  it's scrolled back -- and send only the runs of characters that 
+ *  differ from what the panel already shows. 
+ * ==========================================================================*/
+void i2c_lcd_activate (I2C_LCD *self)
+  {
+  I2C_LCD_PANEL *panel = self->panel;
+  if (panel->active == self) return;
+  panel->active = self;
+  self->view_dirty = FALSE;
+
+  dump_scrollback (self);
+
+  // The cursor position and cursor style belong to the console, but 
+  //   whether the display is on belongs to the panel
+  unsigned char control = (self->display_control & ~I2C_LCD_DISPLAY_ON)
+    | (panel->display_control & I2C_LCD_DISPLAY_ON);
+  self->display_control = control;
+  if (control != panel->display_control)
+    send_command (self, I2C_LCD_DISPLAY_CONTROL | control);
+  if (self->scrollback == 0) restore_cursor (self);
+  }
+
+/*============================================================================
+ *  i2c_lcd_is_active
+ * ==========================================================================*/
+BOOL i2c_lcd_is_active (const I2C_LCD *self)
+  {
+  return self->panel->active == self;
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_panel_rows
+ * ==========================================================================*/
+int i2c_lcd_get_panel_rows (const I2C_LCD *self)
+  {
+  return self->panel_rows;
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_panel_row
+ * ==========================================================================*/
+void i2c_lcd_get_panel_row (const I2C_LCD *self, int row, char *buf)
+  {
+  memcpy (buf, self->panel->ddram + self->offsets[row], self->width);
+  buf[self->width] = 0;
+  }
+
+/*============================================================================
+ *  i2c_lcd_get_panel_cursor
+ *  The HD44780's address counter, worked back to a row and column. 
+ * ==========================================================================*/
+void i2c_lcd_get_panel_cursor (const I2C_LCD *self, int *row, int *col)
   {
-  if (self->scrollback > 0)
+  const I2C_LCD_PANEL *panel = self->panel;
+  int addr = panel->cursor * LCD_DDRAM_SIZE + panel->addr[panel->cursor];
+  *row = -1;
+  *col = -1;
+  for (int r = 0; r < self->panel_rows; r++)
     {
-    self->scrollback--;
-    dump_scrollback (self);
-    // If we reduce scrollback from 1 to 0, we are effectively at
-    //   the working position. So restore the original cursor.
-    if (self->scrollback == 0)
-      i2c_lcd_set_cursor (self, self->curr_row, self->curr_col);
+    if (addr >= self->offsets[r] && addr < self->offsets[r] + self->width)
+      {
+      *row = r;
+      *col = addr - self->offsets[r];
+      return;
+      }
     }
   }
 
+/*============================================================================
+ *  i2c_lcd_get_panel_flags
+ * ==========================================================================*/
+int i2c_lcd_get_panel_flags (const I2C_LCD *self)
+  {
+  const I2C_LCD_PANEL *panel = self->panel;
+  int flags = 0;
+  if (panel->backlight) flags |= I2C_LCD_PANEL_BACKLIGHT;
+  if (panel->display_control & I2C_LCD_DISPLAY_ON) 
+    flags |= I2C_LCD_PANEL_DISPLAY_ON;
+  if (panel->display_control & I2C_LCD_CURSOR_ON) 
+    flags |= I2C_LCD_PANEL_CURSOR_ON;
+  if (panel->display_control & I2C_LCD_BLINK_ON) 
+    flags |= I2C_LCD_PANEL_BLINK_ON;
+  return flags;
+  }
+
+/*============================================================================
+ *  i2c_lcd_panel_changes
+ * ==========================================================================*/
+uint32_t i2c_lcd_panel_changes (const I2C_LCD *self)
+  {
+  return self->panel->changes;
+  }
+
 /*============================================================================
  *  i2c_lcd_destroy
  * ==========================================================================*/
 void i2c_lcd_destroy (I2C_LCD* self)
   {
-  free (self->scrollback_buffer);
+  I2C_LCD_PANEL *panel = self->panel;
+  if (panel->active == self) panel->active = NULL;
+  if (--panel->consoles == 0)
+    {
+    panel->transport->destroy (panel->transport);
+    free (panel);
+    }
+  free (self->screen);
+  free (self->continues);
+  free (self->history_text);
+  free (self->line_start);
+  free (self->line_time);
+  free (self->block_time);
+  free (self->row_time);
+  free (self->status_buffer);
   free (self);
   }
 
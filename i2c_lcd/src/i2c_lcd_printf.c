@@ -0,0 +1,263 @@
+/*============================================================================
+ *  i2c_lcd/i2c_lcd_printf.c
+ *
+ *  Formatted output to the display, without the C library's printf.
+ *  Only what a small display needs is supported -- integers in decimal
+ *  and hex, fixed-point numbers, characters, strings, and padding -- so
+ *  the code is small, uses a few dozen bytes of stack, and never
+ *  allocates. The output is collected in a buffer on the stack and
+ *  printed with i2c_lcd_print_chars(), so a line of it goes to the
+ *  display as one batch.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ==========================================================================*/
+
+#include <stdarg.h>
+#include <string.h>
+#include <i2c_lcd/i2c_lcd.h>
+
+// Output is sent to the display in pieces of this size. A line of the
+//   widest display fits in one.
+#define PRINTF_CHUNK 40
+
+// Where formatted output goes: either a caller's buffer, which is
+//   not allowed to overflow, or a chunk that is printed when it's full
+typedef struct _OUT
+  {
+  char *buf;
+  int size;
+  int len;      // Characters in buf
+  int total;    // Characters produced
+  I2C_LCD *lcd; // NULL if the output is to a caller's buffer
+  } OUT;
+
+/*============================================================================
+ *  put
+ * ==========================================================================*/
+static void put (OUT *out, char c)
+  {
+  if (out->len == out->size)
+    {
+    if (!out->lcd)
+      {
+      out->total++;
+      return;
+      }
+    i2c_lcd_print_chars (out->lcd, out->buf, out->len);
+    out->len = 0;
+    }
+  out->buf[out->len++] = c;
+  out->total++;
+  }
+
+/*============================================================================
+ *  pad
+ * ==========================================================================*/
+static void pad (OUT *out, char c, int n)
+  {
+  while (n-- > 0) put (out, c);
+  }
+
+/*============================================================================
+ *  put_field
+ *  Put a field of len characters, with a prefix (a sign, or a decimal
+ *  point's integer part) that zero padding goes after, and then 
+ *  'zeros' leading zeros that a precision asked for.
+ * ==========================================================================*/
+static void put_field (OUT *out, const char *prefix, int prefix_len,
+    int zeros, const char *s, int len, int width, BOOL left, BOOL zero)
+  {
+  int fill = width - prefix_len - zeros - len;
+  if (!left && !zero) pad (out, ' ', fill);
+  for (int i = 0; i < prefix_len; i++) put (out, prefix[i]);
+  if (!left && zero) pad (out, '0', fill);
+  pad (out, '0', zeros);
+  for (int i = 0; i < len; i++) put (out, s[i]);
+  if (left) pad (out, ' ', fill);
+  }
+
+/*============================================================================
+ *  format
+ * ==========================================================================*/
+static void format (OUT *out, const char *fmt, va_list ap)
+  {
+  // Room for a 64-bit number in decimal, and a decimal point
+  char digits[24];
+
+  for (; *fmt; fmt++)
+    {
+    if (*fmt != '%')
+      {
+      put (out, *fmt);
+      continue;
+      }
+    fmt++;
+
+    BOOL left = FALSE, zero = FALSE, plus = FALSE;
+    for (;; fmt++)
+      {
+      if (*fmt == '-') left = TRUE;
+      else if (*fmt == '0') zero = TRUE;
+      else if (*fmt == '+') plus = TRUE;
+      else break;
+      }
+    int width = 0;
+    if (*fmt == '*')
+      {
+      width = va_arg (ap, int);
+      if (width < 0) { left = TRUE; width = -width; }
+      fmt++;
+      }
+    else
+      while (*fmt >= '0' && *fmt <= '9') width = width * 10 + *fmt++ - '0';
+    int precision = -1;
+    if (*fmt == '.')
+      {
+      fmt++;
+      precision = 0;
+      if (*fmt == '*')
+        {
+        precision = va_arg (ap, int);
+        fmt++;
+        }
+      else
+        while (*fmt >= '0' && *fmt <= '9')
+          precision = precision * 10 + *fmt++ - '0';
+      }
+    BOOL is_long = FALSE;
+    while (*fmt == 'l')
+      {
+      is_long = TRUE;
+      fmt++;
+      }
+
+    switch (*fmt)
+      {
+      case 'd':
+      case 'i':
+      case 'u':
+        {
+        unsigned long v;
+        BOOL negative = FALSE;
+        if (*fmt == 'u')
+          v = is_long ? va_arg (ap, unsigned long) : va_arg (ap, unsigned);
+        else
+          {
+          long n = is_long ? va_arg (ap, long) : va_arg (ap, int);
+          negative = n < 0;
+          v = negative ? 0 - (unsigned long)n : (unsigned long)n;
+          }
+        // A precision puts that many digits after a decimal point
+        if (precision > 9) precision = 9;
+        int len = 0;
+        char *p = digits + sizeof (digits);
+        do
+          {
+          *--p = (char)('0' + v % 10);
+          v /= 10;
+          len++;
+          if (len == precision)
+            {
+            *--p = '.';
+            len++;
+            if (v == 0)
+              {
+              *--p = '0';
+              len++;
+              }
+            }
+          } while (v || len < precision);
+        char sign = negative ? '-' : '+';
+        put_field (out, &sign, (negative || plus) ? 1 : 0, 0, p, len,
+          width, left, zero);
+        }
+        break;
+      case 'x':
+      case 'X':
+        {
+        const char *hex = *fmt == 'x' ? "0123456789abcdef"
+                                      : "0123456789ABCDEF";
+        unsigned long v = is_long ? va_arg (ap, unsigned long)
+                                  : va_arg (ap, unsigned);
+        int len = 0;
+        char *p = digits + sizeof (digits);
+        do
+          {
+          *--p = hex[v & 0xF];
+          v >>= 4;
+          len++;
+          } while (v);
+        // The precision can be any size, so its zeros aren't put in 
+        //   digits. As in printf, it overrides the '0' flag.
+        int zeros = precision > len ? precision - len : 0;
+        if (precision >= 0) zero = FALSE;
+        put_field (out, NULL, 0, zeros, p, len, width, left, zero);
+        }
+        break;
+      case 'c':
+        digits[0] = (char)va_arg (ap, int);
+        put_field (out, NULL, 0, 0, digits, 1, width, left, FALSE);
+        break;
+      case 's':
+        {
+        const char *s = va_arg (ap, const char *);
+        if (!s) s = "(null)";
+        int len = 0;
+        while (s[len] && (precision < 0 || len < precision)) len++;
+        put_field (out, NULL, 0, 0, s, len, width, left, FALSE);
+        }
+        break;
+      case '%':
+        put (out, '%');
+        break;
+      case 0:
+        return;
+      default:
+        // Not supported: show it as it was, and stop, because what 
+        //   argument it would take, if any, isn't known, and taking the
+        //   wrong one would throw out all the rest
+        put (out, '%');
+        put (out, *fmt);
+        return;
+      }
+    }
+  }
+
+/*============================================================================
+ *  i2c_lcd_vprintf
+ * ==========================================================================*/
+int i2c_lcd_vprintf (I2C_LCD *self, const char *fmt, va_list ap)
+  {
+  char chunk[PRINTF_CHUNK];
+  OUT out = { chunk, sizeof (chunk), 0, 0, self };
+  format (&out, fmt, ap);
+  if (out.len) i2c_lcd_print_chars (self, chunk, out.len);
+  return out.total;
+  }
+
+/*============================================================================
+ *  i2c_lcd_printf
+ * ==========================================================================*/
+int i2c_lcd_printf (I2C_LCD *self, const char *fmt, ...)
+  {
+  va_list ap;
+  va_start (ap, fmt);
+  int n = i2c_lcd_vprintf (self, fmt, ap);
+  va_end (ap);
+  return n;
+  }
+
+/*============================================================================
+ *  i2c_lcd_format
+ * ==========================================================================*/
+int i2c_lcd_format (char *buf, int size, const char *fmt, ...)
+  {
+  va_list ap;
+  va_start (ap, fmt);
+  OUT out = { buf, size > 0 ? size - 1 : 0, 0, 0, NULL };
+  format (&out, fmt, ap);
+  va_end (ap);
+  if (size > 0) buf[out.len] = 0;
+  return out.total;
+  }
+
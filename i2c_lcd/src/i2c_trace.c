@@ -0,0 +1,88 @@
+/*============================================================================
+ *  i2c_lcd/i2c_trace.c
+ *
+ *  Capture of I2C transfers into a RAM ring buffer. See i2c_trace.h for
+ *  the trace format. 
+ *
+ *  As in usb_kbd/hid_trace.c, the records are kept in a trace_ring:
+ *  two varints, and three bytes before the data, the third of which is
+ *  its length.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <trace_ring/trace_ring.h>
+#include <i2c_lcd/i2c_trace.h>
+
+// Longest possible record: two varints of up to five bytes, three 
+//   header bytes, and up to 255 bytes of data
+#define I2C_TRACE_MAX_RECORD (2 * TRACE_RING_VARINT_MAX + 3 + 255)
+
+static TRACE_RING *ring = NULL;
+static uint32_t last_us = 0;
+
+/*============================================================================
+ *  i2c_trace_init
+ * ==========================================================================*/
+BOOL i2c_trace_init (int bytes)
+  {
+  trace_ring_destroy (ring);
+  ring = trace_ring_new (bytes, 2, 3, I2C_TRACE_MAGIC, I2C_TRACE_VERSION);
+  i2c_trace_clear ();
+  return ring != NULL;
+  }
+
+/*============================================================================
+ *  i2c_trace_clear
+ * ==========================================================================*/
+void i2c_trace_clear (void)
+  {
+  if (ring) trace_ring_clear (ring);
+  last_us = time_us_32();
+  }
+
+/*============================================================================
+ *  i2c_trace_record
+ * ==========================================================================*/
+void i2c_trace_record (uint32_t start_us, uint32_t duration_us, int addr, 
+       BOOL read, const uint8_t *data, int len, int ret)
+  {
+  if (!ring) return;
+  if (len > 255) len = 255;
+
+  uint8_t rec[I2C_TRACE_MAX_RECORD];
+  int n = trace_ring_put_varint (rec, start_us - last_us);
+  last_us = start_us;
+  n += trace_ring_put_varint (rec + n, duration_us);
+  rec[n++] = (uint8_t)((addr << 1) | (read ? 1 : 0));
+  rec[n++] = ret == len ? I2C_TRACE_OK 
+    : ret == PICO_ERROR_TIMEOUT ? I2C_TRACE_TIMEOUT : I2C_TRACE_NAK;
+  // Nothing was read if the read failed
+  if (read && ret != len) len = 0;
+  rec[n++] = (uint8_t)len;
+  memcpy (rec + n, data, len);
+  n += len;
+  trace_ring_record (ring, rec, n);
+  }
+
+/*============================================================================
+ *  i2c_trace_copy
+ * ==========================================================================*/
+int i2c_trace_copy (uint8_t *buf, int size)
+  {
+  return ring ? trace_ring_copy (ring, buf, size) : 0;
+  }
+
+/*============================================================================
+ *  i2c_trace_dump
+ * ==========================================================================*/
+void i2c_trace_dump (void)
+  {
+  if (ring)
+    trace_ring_dump (ring, "I2CTRACE");
+  else
+    printf ("I2C tracing is off\n");
+  }
@@ -0,0 +1,195 @@
+/*============================================================================
+ *  i2c_lcd/lcd_transport_gpio.c
+ *
+ *  Transport for an HD44780 wired directly to the Pico's GPIO pins, in
+ *  4-bit mode. The HD44780 runs at 5V, but will accept 3.3V logic levels
+ *  on its inputs. Since RW is tied low, we can never read the busy flag,
+ *  so we have to allow the worst-case execution time after each byte. 
+ *  Rather than sleeping after each byte, we note the time at which the
+ *  controller will be ready, and only wait if the next byte arrives 
+ *  before then. So the time taken to execute one byte overlaps with 
+ *  whatever the program does to produce the next.
+ *
+ *  A panel with two controllers has an enable pin for each, and each has
+ *  its own ready time. So a byte for one controller need not wait for
+ *  the other to finish, and runs of characters for the two can be sent
+ *  interleaved, in little more time than one of them would take.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ==========================================================================*/
+
+#include <stdlib.h>
+#include <pico/stdlib.h>
+#include <hardware/gpio.h>
+#include <i2c_lcd/lcd_transport.h>
+
+// Execution time of most commands, and of a character write, in 
+//   microseconds. The datasheet says 37us; we allow a little extra for 
+//   slow clones.
+#define LCD_GPIO_EXEC_US 45
+
+// Execution time of the clear and home commands, which the datasheet
+//   gives as 1.52ms
+#define LCD_GPIO_SLOW_EXEC_US 2000
+
+typedef struct _LCD_GPIO
+  {
+  LCD_TRANSPORT transport;
+  int rs;
+  int e[2];                     // Enable pins, -1 if there's no second
+  int d4;
+  int backlight;
+  uint32_t mask;               // RS and D4-D7
+  int selected;                // Controllers that bytes go to
+  absolute_time_t busy_until[2];  // When each controller will next be ready
+  } LCD_GPIO;
+
+/*============================================================================
+ * enable_mask
+ * The enable pins of the selected controllers.
+ * ==========================================================================*/
+static uint32_t enable_mask (const LCD_GPIO *self)
+  {
+  uint32_t mask = 0;
+  for (int i = 0; i < 2; i++)
+    if ((self->selected & (1 << i)) && self->e[i] >= 0) 
+      mask |= 1u << self->e[i];
+  return mask;
+  }
+
+/*============================================================================
+ * send_4bits
+ * Set up RS and the data lines, and pulse enable. The HD44780 needs
+ * at least 450ns of enable pulse, and 1us between pulses.
+ * ==========================================================================*/
+static void send_4bits (const LCD_GPIO *self, unsigned char nibble, BOOL rs)
+  {
+  uint32_t value = ((uint32_t)(nibble & 0x0F) << self->d4) 
+    | (rs ? 1u << self->rs : 0);
+  uint32_t enable = enable_mask (self);
+  gpio_put_masked (self->mask, value);
+  gpio_set_mask (enable);
+  busy_wait_us_32 (1);
+  gpio_clr_mask (enable);
+  busy_wait_us_32 (1);
+  }
+
+/*============================================================================
+ * send_byte
+ * ==========================================================================*/
+static void send_byte (LCD_TRANSPORT *transport, unsigned char b, BOOL rs)
+  {
+  LCD_GPIO *self = (LCD_GPIO *)transport;
+  // Clear and home are slow. So are the first few commands of the 
+  //   initialization sequence, where the controller might still be in
+  //   8-bit mode, and treat each nibble as a complete command.
+  uint32_t exec_us = (!rs && b < 0x04) 
+    ? LCD_GPIO_SLOW_EXEC_US : LCD_GPIO_EXEC_US;
+  for (int i = 0; i < 2; i++)
+    if (self->selected & (1 << i)) busy_wait_until (self->busy_until[i]);
+  send_4bits (self, b >> 4, rs);
+  if (exec_us == LCD_GPIO_SLOW_EXEC_US) busy_wait_us_32 (exec_us);
+  send_4bits (self, b & 0x0F, rs);
+  absolute_time_t ready = make_timeout_time_us (exec_us);
+  for (int i = 0; i < 2; i++)
+    if (self->selected & (1 << i)) self->busy_until[i] = ready;
+  }
+
+/*============================================================================
+ * send_chars
+ * ==========================================================================*/
+static void send_chars (LCD_TRANSPORT *transport, const char *s, int n)
+  {
+  for (int i = 0; i < n; i++)
+    send_byte (transport, (unsigned char)s[i], TRUE);
+  }
+
+/*============================================================================
+ * select_controllers
+ * ==========================================================================*/
+static void select_controllers (LCD_TRANSPORT *transport, int controllers)
+  {
+  ((LCD_GPIO *)transport)->selected = controllers;
+  }
+
+/*============================================================================
+ * send_chars_dual
+ * A character for each controller in turn. Each waits only for its own
+ * controller, which has been executing while the other was sent one.
+ * ==========================================================================*/
+static void send_chars_dual (LCD_TRANSPORT *transport, const char *s1, 
+       int n1, const char *s2, int n2)
+  {
+  for (int i = 0; i < n1 || i < n2; i++)
+    {
+    if (i < n1)
+      {
+      select_controllers (transport, LCD_CONTROLLER_1);
+      send_byte (transport, (unsigned char)s1[i], TRUE);
+      }
+    if (i < n2)
+      {
+      select_controllers (transport, LCD_CONTROLLER_2);
+      send_byte (transport, (unsigned char)s2[i], TRUE);
+      }
+    }
+  }
+
+/*============================================================================
+ * set_backlight
+ * ==========================================================================*/
+static void set_backlight (LCD_TRANSPORT *transport, BOOL on)
+  {
+  LCD_GPIO *self = (LCD_GPIO *)transport;
+  if (self->backlight >= 0) gpio_put (self->backlight, on);
+  }
+
+/*============================================================================
+ * destroy
+ * ==========================================================================*/
+static void destroy (LCD_TRANSPORT *transport)
+  {
+  free (transport);
+  }
+
+/*============================================================================
+ *  lcd_transport_gpio_new
+ * ==========================================================================*/
+LCD_TRANSPORT *lcd_transport_gpio_new (int rs, int e, int d4, int backlight)
+  {
+  return lcd_transport_gpio_new_dual (rs, e, -1, d4, backlight);
+  }
+
+/*============================================================================
+ *  lcd_transport_gpio_new_dual
+ * ==========================================================================*/
+LCD_TRANSPORT *lcd_transport_gpio_new_dual (int rs, int e, int e2, int d4, 
+                 int backlight)
+  {
+  LCD_GPIO *self = malloc (sizeof (LCD_GPIO));
+  self->transport.send_byte = send_byte;
+  self->transport.send_chars = send_chars;
+  self->transport.select = e2 >= 0 ? select_controllers : NULL;
+  self->transport.send_chars_dual = e2 >= 0 ? send_chars_dual : NULL;
+  self->transport.set_backlight = set_backlight;
+  self->transport.set_backlight_later = NULL;
+  self->transport.destroy = destroy;
+  self->rs = rs;
+  self->e[0] = e;
+  self->e[1] = e2;
+  self->d4 = d4;
+  self->backlight = backlight;
+  self->mask = (0x0Fu << d4) | (1u << rs);
+  self->selected = LCD_CONTROLLER_1;
+  self->busy_until[0] = nil_time;
+  self->busy_until[1] = nil_time;
+
+  uint32_t pins = self->mask | (1u << e);
+  if (e2 >= 0) pins |= 1u << e2;
+  if (backlight >= 0) pins |= 1u << backlight;
+  gpio_init_mask (pins);
+  gpio_set_dir_out_masked (pins);
+  gpio_put_masked (pins, 0);
+  return &self->transport;
+  }
+
@@ -0,0 +1,497 @@
+/*============================================================================
+ *  i2c_lcd/lcd_transport_i2c.c
+ *
+ *  Transport for an HD44780 behind a PCF8574 I2C backpack. Every write to
+ *  the PCF8574 sets all eight of its outputs: four data lines, RS, RW, 
+ *  enable, and the backlight. So sending a nibble takes three I2C writes
+ *  -- set up the data, raise enable, lower enable. 
+ *
+ *  Every write is checked. A write that fails -- because the PCF8574
+ *  didn't acknowledge, or the bus timed out -- is counted, and retried.
+ *  If errors keep appearing, the bus is stepped down to the next
+ *  slower rate. At start-up, lcd_transport_i2c_autotune() can step the bus
+ *  up to the fastest rate that works reliably.
+ *
+ *  On a 40x4 panel made with lcd_transport_i2c_new_dual(), the second
+ *  controller's enable line is on the pin that is RW on smaller panels
+ *  (which is otherwise just held low). A run of characters for each 
+ *  controller can then go in the same I2C transaction, interleaved, so
+ *  the bytes for one controller take up the time the other needs to
+ *  execute, instead of idle padding.
+ *
+ *  For a description of the protocol, please see
+ *  https://kevinboone.me/pi-lcd.html
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ==========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <hardware/i2c.h>
+#include <hardware/gpio.h>
+#include <i2c_lcd/lcd_transport.h>
+#include <i2c_lcd/i2c_trace.h>
+
+// Execution time of a character write, in microseconds. The datasheet
+//   says 37us; we allow a little extra for slow clones.
+#define I2C_LCD_CHAR_TIME 45
+
+// Size of the buffer used to batch I2C writes
+#define I2C_LCD_BATCH_SIZE 128
+
+// The number of recent errors at which the bus is stepped down to a
+//   slower rate. One error is forgiven for every I2C_LCD_ERROR_DECAY 
+//   successful writes, so occasional glitches don't slow the bus down.
+#define I2C_LCD_ERROR_LIMIT 3
+#define I2C_LCD_ERROR_DECAY 256
+
+// The number of write-and-read-back tests that must all pass for 
+//   autotuning to accept a baud rate
+#define I2C_LCD_PROBE_COUNT 32
+
+// The standard I2C rates: standard mode, fast mode, and fast mode plus
+static const int rates[] = { 100000, 400000, 1000000 };
+#define NUM_RATES (int)(sizeof (rates) / sizeof (rates[0]))
+
+typedef struct _LCD_I2C
+  {
+  LCD_TRANSPORT transport;
+  i2c_inst_t *i2c;  
+  int addr;
+  unsigned char backlight;
+  unsigned char enable;  // The enable lines of the selected controllers
+  int char_pad;        // Idle bytes needed after each batched character
+  int baud;            // The actual rate, which the SDK rounds
+  int nominal;         // The rate that was asked for
+  int rate;            // Standard rates slower than the nominal one, so
+                       //   rates[rate - 1] is the next one down
+  int recent_errors;   
+  int successes;       // Successful writes since an error was forgiven
+  BOOL trace;          // Record every transfer -- see i2c_trace.h
+  LCD_I2C_STATS stats;
+  } LCD_I2C;
+
+/*============================================================================
+ * set_char_pad
+ * Work out how many idle bytes to send after each batched character, to
+ * give the HD44780 time to execute it, at the specified baud rate. Each
+ * byte takes nine bit times (eight bits, and an acknowledgement).
+ * ==========================================================================*/
+static void set_char_pad (LCD_I2C *self, int i2c_baud)
+  {
+  int byte_ns = 9000000 / (i2c_baud / 1000);
+  int needed = (I2C_LCD_CHAR_TIME * 1000 + byte_ns - 1) / byte_ns;
+  // There's always one byte (the next enable pulse) before the next
+  //   character is latched.
+  self->char_pad = needed > 1 ? needed - 1 : 0;
+  }
+
+/*============================================================================
+ * set_baud
+ * ==========================================================================*/
+static void set_baud (LCD_I2C *self, int baud)
+  {
+  // Steps are worked out from the nominal rate, not the actual one,
+  //   which can be a little above or below it
+  self->nominal = baud;
+  self->rate = 0;
+  while (self->rate < NUM_RATES && rates[self->rate] < baud) self->rate++;
+  self->baud = (int)i2c_set_baudrate (self->i2c, baud);
+  set_char_pad (self, self->baud);
+  self->stats.baud = self->baud;
+  self->recent_errors = 0;
+  self->successes = 0;
+  }
+
+/*============================================================================
+ * timeout_us
+ * A generous time limit for an I2C transfer of len bytes: twice the 
+ * time the bytes (and the address) should take, plus a millisecond.
+ * ==========================================================================*/
+static unsigned int timeout_us (const LCD_I2C *self, int len)
+  {
+  return (unsigned int)((len + 1) * 18000000LL / self->baud) + 1000;
+  }
+
+/*============================================================================
+ * note_result
+ * Count the result of an I2C transfer, and step the bus down to the next 
+ * slower rate if there have been too many errors recently.
+ * ==========================================================================*/
+static void note_result (LCD_I2C *self, int ret, int len)
+  {
+  self->stats.writes++;
+  if (ret == len)
+    {
+    if (self->recent_errors > 0 && ++self->successes >= I2C_LCD_ERROR_DECAY)
+      {
+      self->recent_errors--;
+      self->successes = 0;
+      }
+    return;
+    }
+
+  if (ret == PICO_ERROR_TIMEOUT)
+    self->stats.timeouts++;
+  else
+    self->stats.naks++;
+
+  if (++self->recent_errors >= I2C_LCD_ERROR_LIMIT)
+    {
+    if (self->rate > 0)
+      {
+      set_baud (self, rates[self->rate - 1]);
+      self->stats.fallbacks++;
+      }
+    else
+      self->recent_errors = 0; // Nowhere slower to go
+    }
+  }
+
+/*============================================================================
+ * transfer
+ * Write len bytes to the PCF8574, or read them from it, once, and 
+ * record the transfer if tracing is on. Returns what the SDK does.
+ * ==========================================================================*/
+static int transfer (LCD_I2C *self, unsigned char *data, int len, 
+      BOOL read)
+  {
+  uint32_t start = self->trace ? time_us_32() : 0;
+  int ret = read 
+    ? i2c_read_timeout_us (self->i2c, self->addr, data, len, false, 
+      timeout_us (self, len))
+    : i2c_write_timeout_us (self->i2c, self->addr, data, len, false, 
+      timeout_us (self, len));
+  if (self->trace)
+    i2c_trace_record (start, time_us_32() - start, self->addr, read, data,
+      len, ret);
+  return ret;
+  }
+
+/*============================================================================
+ * i2c_write
+ * Write len bytes to the PCF8574. A failed write is retried enough times
+ * that, if the failures are because the bus is too fast, the bus will
+ * have been slowed down before we give up. Returns FALSE if all the 
+ * retries fail.
+ * ==========================================================================*/
+static BOOL i2c_write (LCD_I2C *self, const unsigned char *data, int len)
+  {
+  for (int attempt = 0; attempt <= I2C_LCD_ERROR_LIMIT; attempt++)
+    {
+    int ret = transfer (self, (unsigned char *)data, len, FALSE);
+    note_result (self, ret, len);
+    if (ret == len) return TRUE;
+    }
+  return FALSE;
+  }
+
+/*============================================================================
+ * i2c_write_byte 
+ * ==========================================================================*/
+static void i2c_write_byte (LCD_I2C *self, unsigned char b)
+  {
+  unsigned char data = b | self->backlight;
+  i2c_write (self, &data, 1);
+  }
+
+/*============================================================================
+ * pulse_enable_line 
+ * ==========================================================================*/
+static void pulse_enable_line (LCD_I2C *self, unsigned char b)
+  {
+  sleep_us (I2C_LCD_DELAY);
+  i2c_write_byte (self, b | self->enable);
+  sleep_us (I2C_LCD_DELAY);
+  i2c_write_byte (self, b & ~self->enable);
+  sleep_us (I2C_LCD_DELAY);
+  }
+
+/*============================================================================
+ * send_4bits
+ * ==========================================================================*/
+static void send_4bits (LCD_I2C *self, unsigned char b)
+  {
+  i2c_write_byte (self, b);
+  pulse_enable_line (self, b);
+  }
+
+/*============================================================================
+ * put_char
+ * Add the four PCF8574 writes that send a character to the controllers
+ * whose enable lines are in 'enable'. Returns the new length.
+ * ==========================================================================*/
+static int put_char (const LCD_I2C *self, unsigned char *buff, int len, 
+       unsigned char c, unsigned char mode, unsigned char enable)
+  {
+  unsigned char hi = (c & 0xF0) | mode | self->backlight;
+  unsigned char lo = ((c << 4) & 0xF0) | mode | self->backlight;
+  buff[len++] = hi | enable;
+  buff[len++] = hi;
+  buff[len++] = lo | enable;
+  buff[len++] = lo;
+  return len;
+  }
+
+/*============================================================================
+ * send_batch
+ * Send a run of bytes, batching all the PCF8574 writes into a single
+ * I2C transaction. This avoids the I2C overheads, and the sleeps in 
+ * pulse_enable_line(): the time taken to transfer each byte on the bus is
+ * enough to satisfy the HD44780's timing requirements. Since RS doesn't 
+ * change within a run, the data can be set up at the same time as the 
+ * enable line is raised, so each nibble needs only two writes. At higher
+ * baud rates, the bus is faster than the HD44780, so we pad each byte
+ * with idle bytes (char_pad) to give it time to execute. 
+ * ==========================================================================*/
+static void send_batch (LCD_I2C *self, const char *s, int n, 
+       unsigned char mode)
+  {
+  unsigned char buff[I2C_LCD_BATCH_SIZE];
+  int per_char = 5 + self->char_pad;
+  int len = 0;
+  // Set up RS before the first enable pulse
+  buff[len++] = mode | self->backlight; 
+  for (int i = 0; i < n; i++)
+    {
+    if (len + per_char > I2C_LCD_BATCH_SIZE)
+      {
+      i2c_write (self, buff, len);
+      len = 0;
+      }
+    len = put_char (self, buff, len, (unsigned char)s[i], mode, 
+      self->enable);
+    for (int j = 0; j < self->char_pad; j++, len++) buff[len] = buff[len - 1];
+    }
+  if (len > 0) i2c_write (self, buff, len);
+  }
+
+/*============================================================================
+ * send_byte
+ * Commands other than clear and home (and the 4-bit mode set-up, which
+ * uses the same codes) take no longer to execute than a character, so
+ * they can be batched in the same way. The others go the slow way.
+ * ==========================================================================*/
+static void send_byte (LCD_TRANSPORT *transport, unsigned char b, BOOL rs)
+  {
+  LCD_I2C *self = (LCD_I2C *)transport;
+  unsigned char mode = rs ? I2C_LCD_RS : 0;
+  if (rs || b >= 4)
+    {
+    char c = (char)b;
+    send_batch (self, &c, 1, mode);
+    return;
+    }
+  send_4bits (self, (b & 0xF0) | mode);
+  send_4bits (self, ((b << 4) & 0xF0) | mode);
+  }
+
+/*============================================================================
+ * send_chars
+ * ==========================================================================*/
+static void send_chars (LCD_TRANSPORT *transport, const char *s, int n)
+  {
+  send_batch ((LCD_I2C *)transport, s, n, I2C_LCD_RS);
+  }
+
+/*============================================================================
+ * select_controllers
+ * ==========================================================================*/
+static void select_controllers (LCD_TRANSPORT *transport, int controllers)
+  {
+  LCD_I2C *self = (LCD_I2C *)transport;
+  self->enable = ((controllers & LCD_CONTROLLER_1) ? I2C_LCD_ENABLE : 0)
+    | ((controllers & LCD_CONTROLLER_2) ? I2C_LCD_RW : 0);
+  }
+
+/*============================================================================
+ * send_chars_dual
+ * As send_batch(), but a character for each controller in turn. The 
+ * writes for one controller's character count towards the time that
+ * the other needs to execute its own, so idle bytes are needed only 
+ * where they don't cover it -- at 1M baud, or when one run is longer
+ * than the other.
+ * ==========================================================================*/
+static void send_chars_dual (LCD_TRANSPORT *transport, const char *s1, 
+       int n1, const char *s2, int n2)
+  {
+  LCD_I2C *self = (LCD_I2C *)transport;
+  unsigned char buff[I2C_LCD_BATCH_SIZE];
+  const char *s[2] = { s1, s2 };
+  int n[2] = { n1, n2 };
+  static const unsigned char enable[2] = { I2C_LCD_ENABLE, I2C_LCD_RW };
+  // Where each controller last latched a character, in buff
+  int last[2] = { -I2C_LCD_BATCH_SIZE, -I2C_LCD_BATCH_SIZE };
+  int per_round = 2 * (4 + self->char_pad);
+  int len = 0;
+  buff[len++] = I2C_LCD_RS | self->backlight; 
+  for (int i = 0; i < n1 || i < n2; i++)
+    {
+    if (len + per_round > I2C_LCD_BATCH_SIZE)
+      {
+      // Start the next write with the last byte of this one, so that
+      //   idle bytes can be added from the start
+      i2c_write (self, buff, len);
+      buff[0] = buff[len - 1];
+      last[0] -= len - 1;
+      last[1] -= len - 1;
+      len = 1;
+      }
+    for (int c = 0; c < 2; c++)
+      {
+      if (i >= n[c]) continue;
+      // The character is latched two bytes after it starts, and must 
+      //   be char_pad + 2 bytes after the last
+      while (len < last[c] + self->char_pad + 1) 
+        {
+        buff[len] = buff[len - 1];
+        len++;
+        }
+      len = put_char (self, buff, len, (unsigned char)s[c][i], I2C_LCD_RS,
+        enable[c]);
+      last[c] = len - 1;
+      }
+    }
+  // And time to execute the last characters, as send_batch() allows
+  while (len < MAX (last[0], last[1]) + self->char_pad + 1) 
+    {
+    buff[len] = buff[len - 1];
+    len++;
+    }
+  i2c_write (self, buff, len);
+  }
+
+/*============================================================================
+ * set_backlight
+ * ==========================================================================*/
+static void set_backlight (LCD_TRANSPORT *transport, BOOL on)
+  {
+  LCD_I2C *self = (LCD_I2C *)transport;
+  self->backlight = on ? I2C_LCD_BACKLIGHT : 0;
+  i2c_write_byte (self, self->backlight); 
+  }
+
+/*============================================================================
+ * set_backlight_later
+ * The backlight is a PCF8574 output, like the HD44780's lines, so it is
+ * set by every write: this just changes what the next one sets it to.
+ * ==========================================================================*/
+static void set_backlight_later (LCD_TRANSPORT *transport, BOOL on)
+  {
+  LCD_I2C *self = (LCD_I2C *)transport;
+  self->backlight = on ? I2C_LCD_BACKLIGHT : 0;
+  }
+
+/*============================================================================
+ * destroy
+ * ==========================================================================*/
+static void destroy (LCD_TRANSPORT *transport)
+  {
+  free (transport);
+  }
+
+/*============================================================================
+ *  new_transport
+ * ==========================================================================*/
+static LCD_TRANSPORT *new_transport (i2c_inst_t *i2c, int addr, 
+                  int sda, int scl, int i2c_baud, BOOL dual)
+  {
+  LCD_I2C *self = malloc (sizeof (LCD_I2C));
+  self->transport.send_byte = send_byte;
+  self->transport.send_chars = send_chars;
+  self->transport.select = dual ? select_controllers : NULL;
+  self->transport.send_chars_dual = dual ? send_chars_dual : NULL;
+  self->transport.set_backlight = set_backlight;
+  self->transport.set_backlight_later = set_backlight_later;
+  self->transport.destroy = destroy;
+  self->i2c = i2c;
+  self->addr = addr;
+  self->backlight = 0;
+  self->enable = I2C_LCD_ENABLE;
+  self->trace = FALSE;
+  memset (&self->stats, 0, sizeof (LCD_I2C_STATS));
+
+  i2c_init (i2c, i2c_baud);
+  set_baud (self, i2c_baud);
+  gpio_set_function (sda, GPIO_FUNC_I2C);
+  gpio_set_function (scl, GPIO_FUNC_I2C);
+  gpio_pull_up (sda);
+  gpio_pull_up (scl);
+  return &self->transport;
+  }
+
+/*============================================================================
+ *  lcd_transport_i2c_new
+ * ==========================================================================*/
+LCD_TRANSPORT *lcd_transport_i2c_new (i2c_inst_t *i2c, int addr, 
+                  int sda, int scl, int i2c_baud)
+  {
+  return new_transport (i2c, addr, sda, scl, i2c_baud, FALSE);
+  }
+
+/*============================================================================
+ *  lcd_transport_i2c_new_dual
+ * ==========================================================================*/
+LCD_TRANSPORT *lcd_transport_i2c_new_dual (i2c_inst_t *i2c, int addr, 
+                  int sda, int scl, int i2c_baud)
+  {
+  return new_transport (i2c, addr, sda, scl, i2c_baud, TRUE);
+  }
+
+/*============================================================================
+ * probe
+ * Test whether the PCF8574 works reliably at the current baud rate, by
+ * writing a set of patterns and reading them back. The enable line is
+ * kept low throughout, so the HD44780 ignores the data lines. The 
+ * backlight pin is not compared, because it usually drives a 
+ * transistor, which can hold the pin low when it is set high.
+ * ==========================================================================*/
+static BOOL probe (LCD_I2C *self)
+  {
+  static const unsigned char patterns[] = { 0xF0, 0x00, 0xA1, 0x50 };
+  for (int i = 0; i < I2C_LCD_PROBE_COUNT; i++)
+    {
+    unsigned char out = patterns[i % sizeof (patterns)] | self->backlight;
+    unsigned char in;
+    if (transfer (self, &out, 1, FALSE) != 1) return FALSE;
+    if (transfer (self, &in, 1, TRUE) != 1) return FALSE;
+    if ((in ^ out) & ~I2C_LCD_BACKLIGHT) return FALSE;
+    }
+  return TRUE;
+  }
+
+/*============================================================================
+ *  lcd_transport_i2c_autotune
+ * ==========================================================================*/
+int lcd_transport_i2c_autotune (LCD_TRANSPORT *transport, int max_baud)
+  {
+  LCD_I2C *self = (LCD_I2C *)transport;
+  int good = self->nominal;
+  if (!probe (self)) return self->baud; // Not even the starting rate works
+  for (int i = self->rate; i < NUM_RATES && rates[i] <= max_baud; i++)
+    {
+    if (rates[i] <= good) continue;
+    set_baud (self, rates[i]);
+    if (!probe (self)) break;
+    good = rates[i];
+    }
+  set_baud (self, good);
+  return self->baud;
+  }
+
+/*============================================================================
+ *  lcd_transport_i2c_get_stats
+ * ==========================================================================*/
+void lcd_transport_i2c_get_stats (const LCD_TRANSPORT *transport, 
+       LCD_I2C_STATS *stats)
+  {
+  *stats = ((const LCD_I2C *)transport)->stats;
+  }
+
+/*============================================================================
+ *  lcd_transport_i2c_set_trace
+ * ==========================================================================*/
+void lcd_transport_i2c_set_trace (LCD_TRANSPORT *transport, BOOL on)
+  {
+  ((LCD_I2C *)transport)->trace = on;
+  }
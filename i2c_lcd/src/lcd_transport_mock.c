@@ -0,0 +1,140 @@
+/*============================================================================
+ *  i2c_lcd/lcd_transport_mock.c
+ *
+ *  A transport that isn't connected to anything. It models just enough of
+ *  the HD44780 -- the display RAM and the address counter -- to show 
+ *  what a real display would show, and counts the commands and 
+ *  characters it receives. There are two controllers, as on a 40x4 
+ *  panel; a smaller panel only uses the first.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ==========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <i2c_lcd/lcd_transport.h>
+
+typedef struct _LCD_MOCK
+  {
+  LCD_TRANSPORT transport;
+  unsigned char ddram[2][LCD_DDRAM_SIZE];
+  int addr[2];
+  int selected;
+  unsigned long commands;
+  unsigned long chars;
+  } LCD_MOCK;
+
+/*============================================================================
+ * send_byte
+ * Only the commands that affect the display RAM are modelled. The
+ * display RAM is treated as a single block, which is not quite how
+ * the real thing works in two-line mode; but it's good enough to 
+ * see what was written where.
+ * ==========================================================================*/
+static void send_byte (LCD_TRANSPORT *transport, unsigned char b, BOOL rs)
+  {
+  LCD_MOCK *self = (LCD_MOCK *)transport;
+  if (rs)
+    self->chars++;
+  else
+    self->commands++;
+  for (int i = 0; i < 2; i++)
+    {
+    if (!(self->selected & (1 << i))) continue;
+    if (rs)
+      {
+      self->ddram[i][self->addr[i]] = b;
+      self->addr[i] = (self->addr[i] + 1) % LCD_DDRAM_SIZE;
+      }
+    else if (b & 0x80)
+      self->addr[i] = b & 0x7F;
+    else if (b == 0x01)
+      {
+      memset (self->ddram[i], ' ', LCD_DDRAM_SIZE);
+      self->addr[i] = 0;
+      }
+    else if ((b & 0xFE) == 0x02)
+      self->addr[i] = 0;
+    }
+  }
+
+/*============================================================================
+ * send_chars
+ * ==========================================================================*/
+static void send_chars (LCD_TRANSPORT *transport, const char *s, int n)
+  {
+  for (int i = 0; i < n; i++)
+    send_byte (transport, (unsigned char)s[i], TRUE);
+  }
+
+/*============================================================================
+ * select_controllers
+ * ==========================================================================*/
+static void select_controllers (LCD_TRANSPORT *transport, int controllers)
+  {
+  ((LCD_MOCK *)transport)->selected = controllers;
+  }
+
+/*============================================================================
+ * set_backlight
+ * ==========================================================================*/
+static void set_backlight (LCD_TRANSPORT *transport, BOOL on)
+  {
+  (void)transport; (void)on;
+  }
+
+/*============================================================================
+ * destroy
+ * ==========================================================================*/
+static void destroy (LCD_TRANSPORT *transport)
+  {
+  free (transport);
+  }
+
+/*============================================================================
+ *  lcd_transport_mock_new
+ * ==========================================================================*/
+LCD_TRANSPORT *lcd_transport_mock_new (void)
+  {
+  LCD_MOCK *self = malloc (sizeof (LCD_MOCK));
+  self->transport.send_byte = send_byte;
+  self->transport.send_chars = send_chars;
+  self->transport.select = select_controllers;
+  self->transport.send_chars_dual = NULL;
+  self->transport.set_backlight = set_backlight;
+  self->transport.set_backlight_later = NULL;
+  self->transport.destroy = destroy;
+  memset (self->ddram, ' ', sizeof (self->ddram));
+  self->addr[0] = 0;
+  self->addr[1] = 0;
+  self->selected = LCD_CONTROLLER_1;
+  self->commands = 0;
+  self->chars = 0;
+  return &self->transport;
+  }
+
+/*============================================================================
+ *  lcd_transport_mock_read
+ * ==========================================================================*/
+void lcd_transport_mock_read (const LCD_TRANSPORT *transport, int addr, 
+       char *buf, int n)
+  {
+  const LCD_MOCK *self = (const LCD_MOCK *)transport;
+  for (int i = 0; i < n; i++)
+    {
+    int a = (addr + i) % (2 * LCD_DDRAM_SIZE);
+    buf[i] = (char)self->ddram[a / LCD_DDRAM_SIZE][a % LCD_DDRAM_SIZE];
+    }
+  }
+
+/*============================================================================
+ *  lcd_transport_mock_counts
+ * ==========================================================================*/
+void lcd_transport_mock_counts (const LCD_TRANSPORT *transport, 
+       unsigned long *commands, unsigned long *chars)
+  {
+  const LCD_MOCK *self = (const LCD_MOCK *)transport;
+  if (commands) *commands = self->commands;
+  if (chars) *chars = self->chars;
+  }
+
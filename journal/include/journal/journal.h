@@ -0,0 +1,91 @@
+/*===========================================================================
+ * journal/journal.h
+ *
+ * A journal of display lines in flash, so that the scrollback buffer 
+ * survives a reset. Lines are added to the journal in RAM, which is 
+ * quick, and written to flash later, a page at a time, by calls to
+ * journal_work(). The application should only call journal_work() when 
+ * nothing else is going on, because the Pico can't run code from flash, 
+ * or take interrupts, while the flash is being written or erased. 
+ *
+ * The journal occupies a number of sectors at the end of flash, and is
+ * written as a log: pages are written in order, round and round the
+ * region, so every sector is erased equally often. The sector after
+ * the one being written is erased in advance, when there is nothing to
+ * write, so that writing a page never has to wait for an erase.
+ *
+ * Each page holds a header -- a magic number, a sequence number, the 
+ * line width, and which lines wrapped from the line before -- and as 
+ * many lines of that width as will fit; a line of another width starts
+ * a new page. Pages of any line width can be read back, so the journal
+ * of one display can be restored to a display of another size, and a 
+ * display can change size while it is being journalled. At start-up, 
+ * journal_restore() finds the page with the highest sequence number
+ * by reading only the page headers, and then reads back just the pages
+ * it needs.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <i2c_lcd/i2c_lcd.h>
+
+typedef struct _JOURNAL JOURNAL;
+
+/** Called with each line restored: 'width' characters, not 
+    null-terminated, and whether the line continues the one before. 
+    The width is that of the display that wrote the line, which need
+    not be the width of the journal now. */
+typedef void (*JOURNAL_LINE_FN) (const char *line, int width, 
+               BOOL continued, void *context);
+
+typedef struct _JOURNAL_STATS
+  {
+  uint32_t lines;          // Lines added
+  uint32_t lines_dropped;  // Lines lost because the RAM queue was full
+  uint32_t pages_written;
+  uint32_t erases;
+  uint32_t restored;       // Lines restored at start-up
+  uint32_t restore_us;     // Time taken to restore them
+  } JOURNAL_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Create a journal of lines of up to 'width' characters, in the last 
+    'sectors' sectors of flash. Up to ram_lines lines can wait in
+    RAM to be written, each taking 'width' bytes. */
+extern JOURNAL *journal_new (int width, int sectors, int ram_lines);
+extern void     journal_destroy (JOURNAL *self);
+
+/** Call fn for each of the last max_lines lines in the journal, oldest 
+    first, and work out where to write next. This should be called 
+    once, before any lines are added. Returns the number of lines. */
+extern int      journal_restore (JOURNAL *self, int max_lines, 
+                  JOURNAL_LINE_FN fn, void *context);
+
+/** Add a line of 'width' characters, and whether it continues the line
+    before. This only copies the line into RAM. A line wider than the
+    journal was created for is cut short. */
+extern void     journal_add_line (JOURNAL *self, const char *line, 
+                  int width, BOOL continued);
+
+/** TRUE if there are lines waiting to be written to flash. */
+extern BOOL     journal_pending (const JOURNAL *self);
+
+/** Do one flash operation, if there's one to do: write a page of 
+    lines, or erase a sector ahead of the writing. A part-filled page 
+    is only written if flush is TRUE. Erasing a sector takes about 50ms, 
+    and writing a page about 1ms, with interrupts disabled. Returns
+    TRUE if it did something, in which case there might be more to do. */
+extern BOOL     journal_work (JOURNAL *self, BOOL flush);
+
+extern const JOURNAL_STATS *journal_get_stats (const JOURNAL *self);
+
+#ifdef __cplusplus
+}
+#endif
+
@@ -0,0 +1,357 @@
+/*===========================================================================
+ * journal/journal.c
+ *
+ * A journal of display lines in flash. See journal.h.
+ *
+ * Flash can be read directly, through the XIP window, so reading the
+ * journal is just a matter of looking at memory. Writing and erasing
+ * need the SDK flash functions, with interrupts disabled.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/flash.h>
+#include <hardware/sync.h>
+#include <journal/journal.h>
+
+#define JOURNAL_MAGIC 0x324E524AU  // "JRN2"
+
+// Lines in a page, at most: one for each bit of JOURNAL_HEADER.continued
+#define JOURNAL_MAX_SLOTS 32
+
+#define PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+typedef struct _JOURNAL_HEADER
+  {
+  uint32_t magic;
+  uint32_t seq;      // Increases by one for each page written
+  uint16_t width;    // Line width
+  uint16_t count;    // Lines in this page
+  uint32_t continued; // Bit i is set if line i continues the line before
+  } JOURNAL_HEADER;
+
+struct _JOURNAL
+  {
+  int width;            // The widest line
+  int sectors;
+  int pages;
+  uint32_t base;        // Flash offset of the start of the journal
+  int ram_lines;
+  char *queue;          // Lines waiting to be written, 'width' apart
+  uint16_t *queue_width;
+  BOOL *queue_continued;
+  int queue_head;
+  int queue_count;
+  int write_page;       // The next page to write
+  uint32_t seq;         // Sequence number for the next page
+  int erased_sector;    // A sector known to be blank, or -1
+  JOURNAL_STATS stats;
+  uint8_t page[FLASH_PAGE_SIZE];
+  };
+
+/*===========================================================================
+ * page_offset
+ * ========================================================================*/
+static uint32_t page_offset (const JOURNAL *self, int page)
+  {
+  return self->base + (uint32_t)page * FLASH_PAGE_SIZE;
+  }
+
+/*===========================================================================
+ * flash_ptr
+ * The address at which a flash offset can be read.
+ * ========================================================================*/
+static const uint8_t *flash_ptr (uint32_t offset)
+  {
+  return (const uint8_t *)(uintptr_t)(XIP_BASE + offset);
+  }
+
+/*===========================================================================
+ * slots_for
+ * The number of lines of a given width that fit in a page.
+ * ========================================================================*/
+static int slots_for (int width)
+  {
+  return MIN (JOURNAL_MAX_SLOTS, 
+    (FLASH_PAGE_SIZE - (int)sizeof (JOURNAL_HEADER)) / width);
+  }
+
+/*===========================================================================
+ * read_header
+ * Returns TRUE if the page holds valid journal lines, of any width.
+ * ========================================================================*/
+static BOOL read_header (const JOURNAL *self, int page, JOURNAL_HEADER *h)
+  {
+  memcpy (h, flash_ptr (page_offset (self, page)), sizeof (JOURNAL_HEADER));
+  return h->magic == JOURNAL_MAGIC && h->width > 0
+    && h->width <= FLASH_PAGE_SIZE - sizeof (JOURNAL_HEADER)
+    && h->count > 0 && h->count <= slots_for (h->width);
+  }
+
+/*===========================================================================
+ * is_blank
+ * ========================================================================*/
+static BOOL is_blank (uint32_t offset, uint32_t len)
+  {
+  const uint8_t *p = flash_ptr (offset);
+  for (uint32_t i = 0; i < len; i++)
+    if (p[i] != 0xFF) return FALSE;
+  return TRUE;
+  }
+
+/*===========================================================================
+ * erase_sector
+ * ========================================================================*/
+static void erase_sector (JOURNAL *self, int sector)
+  {
+  uint32_t ints = save_and_disable_interrupts();
+  flash_range_erase (self->base + (uint32_t)sector * FLASH_SECTOR_SIZE,
+    FLASH_SECTOR_SIZE);
+  restore_interrupts (ints);
+  self->erased_sector = sector;
+  self->stats.erases++;
+  }
+
+/*===========================================================================
+ * page_lines
+ * The number of lines at the head of the queue that go in the next 
+ * page: those of the same width as the first, up to as many as fit.
+ * 'full' is set if no more lines could join them.
+ * ========================================================================*/
+static int page_lines (const JOURNAL *self, BOOL *full)
+  {
+  if (self->queue_count == 0)
+    {
+    *full = FALSE;
+    return 0;
+    }
+  int width = self->queue_width[self->queue_head];
+  int slots = slots_for (width);
+  int n = 0;
+  while (n < self->queue_count && n < slots
+       && self->queue_width[(self->queue_head + n) % self->ram_lines] 
+            == width)
+    n++;
+  *full = n == slots || n < self->queue_count;
+  return n;
+  }
+
+/*===========================================================================
+ * write_page
+ * Write up to one page's worth of lines from the queue.
+ * ========================================================================*/
+static void write_page (JOURNAL *self)
+  {
+  BOOL full;
+  int n = page_lines (self, &full);
+  int width = self->queue_width[self->queue_head];
+  JOURNAL_HEADER h = { JOURNAL_MAGIC, self->seq, (uint16_t)width,
+    (uint16_t)n, 0 };
+  memset (self->page, 0xFF, FLASH_PAGE_SIZE);
+  for (int i = 0; i < n; i++)
+    {
+    int slot = (self->queue_head + i) % self->ram_lines;
+    memcpy (self->page + sizeof (h) + i * width,
+      self->queue + slot * self->width, width);
+    if (self->queue_continued[slot]) h.continued |= 1U << i;
+    }
+  memcpy (self->page, &h, sizeof (h));
+
+  uint32_t ints = save_and_disable_interrupts();
+  flash_range_program (page_offset (self, self->write_page), self->page,
+    FLASH_PAGE_SIZE);
+  restore_interrupts (ints);
+
+  self->queue_head = (self->queue_head + n) % self->ram_lines;
+  self->queue_count -= n;
+  int sector = self->write_page / PAGES_PER_SECTOR;
+  self->write_page = (self->write_page + 1) % self->pages;
+  // A sector we've filled is no longer blank
+  if (self->write_page % PAGES_PER_SECTOR == 0 
+       && self->erased_sector == sector) 
+    self->erased_sector = -1;
+  self->seq++;
+  self->stats.pages_written++;
+  }
+
+/*===========================================================================
+ * journal_new
+ * ========================================================================*/
+JOURNAL *journal_new (int width, int sectors, int ram_lines)
+  {
+  JOURNAL *self = malloc (sizeof (JOURNAL));
+  memset (self, 0, sizeof (JOURNAL));
+  // We need at least two sectors, so that one can be erased while the
+  //   other holds the most recent lines
+  if (sectors < 2) sectors = 2;
+  self->width = width;
+  self->sectors = sectors;
+  self->pages = sectors * PAGES_PER_SECTOR;
+  self->base = PICO_FLASH_SIZE_BYTES - (uint32_t)sectors * FLASH_SECTOR_SIZE;
+  self->ram_lines = ram_lines;
+  self->queue = malloc (ram_lines * width);
+  self->queue_width = malloc (ram_lines * sizeof (uint16_t));
+  self->queue_continued = malloc (ram_lines * sizeof (BOOL));
+  self->write_page = 0;
+  self->seq = 1;
+  self->erased_sector = -1;
+  return self;
+  }
+
+/*===========================================================================
+ * journal_restore
+ * ========================================================================*/
+int journal_restore (JOURNAL *self, int max_lines, JOURNAL_LINE_FN fn,
+      void *context)
+  {
+  uint32_t start = time_us_32();
+  JOURNAL_HEADER h;
+
+  // Find the most recent page
+  int newest = -1;
+  uint32_t newest_seq = 0;
+  for (int p = 0; p < self->pages; p++)
+    {
+    if (!read_header (self, p, &h)) continue;
+    if (newest < 0 || (int32_t)(h.seq - newest_seq) > 0)
+      {
+      newest = p;
+      newest_seq = h.seq;
+      }
+    }
+  if (newest < 0) return 0;
+
+  // Work back from it, through pages with consecutive sequence numbers,
+  //   until we have enough lines
+  read_header (self, newest, &h);
+  int first = newest;
+  int n_pages = 1;
+  int lines = h.count;
+  while (lines < max_lines && n_pages < self->pages)
+    {
+    int prev = (first + self->pages - 1) % self->pages;
+    if (!read_header (self, prev, &h) || h.seq != newest_seq - n_pages)
+      break;
+    first = prev;
+    lines += h.count;
+    n_pages++;
+    }
+
+  // Hand over the lines, oldest first, skipping any we don't need
+  int skip = lines > max_lines ? lines - max_lines : 0;
+  for (int i = 0; i < n_pages; i++)
+    {
+    int p = (first + i) % self->pages;
+    read_header (self, p, &h);
+    const char *text = (const char *)flash_ptr (page_offset (self, p))
+      + sizeof (JOURNAL_HEADER);
+    for (int j = 0; j < h.count; j++)
+      {
+      if (skip > 0)
+        skip--;
+      else
+        fn (text + j * h.width, h.width, (h.continued >> j) & 1, context);
+      }
+    }
+
+  self->write_page = (newest + 1) % self->pages;
+  self->seq = newest_seq + 1;
+  self->stats.restored = (uint32_t)MIN (lines, max_lines);
+  self->stats.restore_us = time_us_32() - start;
+  return (int)self->stats.restored;
+  }
+
+/*===========================================================================
+ * journal_add_line
+ * ========================================================================*/
+void journal_add_line (JOURNAL *self, const char *line, int width, 
+      BOOL continued)
+  {
+  if (self->queue_count == self->ram_lines)
+    {
+    // Lose the oldest line, rather than the newest
+    self->queue_head = (self->queue_head + 1) % self->ram_lines;
+    self->queue_count--;
+    self->stats.lines_dropped++;
+    }
+  int slot = (self->queue_head + self->queue_count) % self->ram_lines;
+  width = MAX (1, MIN (width, self->width));
+  memcpy (self->queue + slot * self->width, line, width);
+  self->queue_width[slot] = (uint16_t)width;
+  self->queue_continued[slot] = continued;
+  self->queue_count++;
+  self->stats.lines++;
+  }
+
+/*===========================================================================
+ * journal_pending
+ * ========================================================================*/
+BOOL journal_pending (const JOURNAL *self)
+  {
+  return self->queue_count > 0;
+  }
+
+/*===========================================================================
+ * journal_work
+ * ========================================================================*/
+BOOL journal_work (JOURNAL *self, BOOL flush)
+  {
+  int sector = self->write_page / PAGES_PER_SECTOR;
+  BOOL full;
+  if (page_lines (self, &full) > 0 && (full || flush))
+    {
+    // Normally the page is blank, because its sector was erased in 
+    //   advance. If it isn't -- the first write after start-up, or after
+    //   a reset in the middle of writing -- erase the sector first. 
+    //   But if earlier pages in the sector hold the latest lines, move on
+    //   to the next sector, rather than erase them.
+    if (self->erased_sector != sector
+         && !is_blank (page_offset (self, self->write_page), FLASH_PAGE_SIZE))
+      {
+      if (self->write_page % PAGES_PER_SECTOR != 0)
+        {
+        sector = (sector + 1) % self->sectors;
+        self->write_page = sector * PAGES_PER_SECTOR;
+        }
+      erase_sector (self, sector);
+      }
+    else
+      write_page (self);
+    return TRUE;
+    }
+
+  // Nothing to write, so make sure the next sector is ready
+  int next = (sector + 1) % self->sectors;
+  if (self->erased_sector == next) return FALSE;
+  if (is_blank (self->base + (uint32_t)next * FLASH_SECTOR_SIZE,
+        FLASH_SECTOR_SIZE))
+    {
+    self->erased_sector = next;
+    return FALSE;
+    }
+  erase_sector (self, next);
+  return TRUE;
+  }
+
+/*===========================================================================
+ * journal_get_stats
+ * ========================================================================*/
+const JOURNAL_STATS *journal_get_stats (const JOURNAL *self)
+  {
+  return &self->stats;
+  }
+
+/*===========================================================================
+ * journal_destroy
+ * ========================================================================*/
+void journal_destroy (JOURNAL *self)
+  {
+  free (self->queue);
+  free (self->queue_width);
+  free (self->queue_continued);
+  free (self);
+  }
+
@@ -19,6 +19,35 @@
 #define KBD_KEY_LEFT 1005
 #define KBD_KEY_HOME 1006
 #define KBD_KEY_END 1007
+// Function keys F1-F12 have consecutive codes
+#define KBD_KEY_F1 1008
+#define KBD_KEY_F12 1019
+
+// Key bindings. A binding table has an action for every key code and
+//   combination of modifiers, at the index given by KBD_BIND_SLOT(), so
+//   looking up a key is a single array access. Action 0 means the key is
+//   not bound. KBD_BIND_SLOT() is a constant expression, so a table can
+//   be filled in at compile time:
+//
+//   static unsigned char bindings[KBD_BIND_SLOTS] =
+//     { [KBD_BIND_SLOT (KBD_KEY_UP, KBD_FLAG_SHIFT)] = MY_ACTION_UP };
+//
+//   The code is the one given to kbd_raw_key_down(), so shift is 
+//   already part of it: Shift+Ctrl+L is code 'L' with flags 
+//   KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, where Ctrl+L is 'l' with
+//   KBD_FLAG_CONTROL.
+//
+//   The codes that can be bound are the ASCII ones, below KBD_BIND_ASCII,
+//   and KBD_KEY_DOWN to KBD_KEY_F12, whose slots follow on from them.
+#define KBD_BIND_NONE 0
+#define KBD_BIND_MODS 8
+#define KBD_BIND_ASCII 128
+#define KBD_BIND_KEYS (KBD_BIND_ASCII + KBD_KEY_F12 - KBD_KEY_DOWN + 1)
+#define KBD_BIND_SLOTS (KBD_BIND_KEYS * KBD_BIND_MODS)
+#define KBD_BIND_SLOT(code, flags) \
+  (((code) < KBD_BIND_ASCII ? (code) \
+    : (code) - KBD_KEY_DOWN + KBD_BIND_ASCII) * KBD_BIND_MODS \
+    + ((flags) & (KBD_BIND_MODS - 1)))
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,9 +62,30 @@ extern void kbd_raw_key_down (int code, int flags);
 
 /* Convert the code and flags from raw_key_down to an ASCII value, if
    possible. If no conversion is possible (e.g., it's an arrow key) 
-   then return zero. */
+   then return zero. Ctrl gives the control character whether or not
+   shift is also held, so Ctrl+A and Shift+Ctrl+A are both 1, and
+   Ctrl+[ and Shift+Ctrl+{ are both ESC. Keys with Alt held have no
+   ASCII value, and are left for key bindings. */
 extern char kbd_to_ascii (int code, int flags);
 
+/* The slot in a binding table for this key, or -1 if the code is 
+   not one that can be bound. */
+extern int kbd_bind_slot (int code, int flags);
+
+/* The action this key is bound to, or KBD_BIND_NONE. */
+extern int kbd_binding (const unsigned char *bindings, int code, 
+             int flags);
+
+/* Bind a key to an action, replacing whatever it was bound to before.
+   Binding it to KBD_BIND_NONE unbinds it. Returns the action it was 
+   bound to, or -1 if the key can't be bound. */
+extern int kbd_bind (unsigned char *bindings, int code, int flags, 
+             int action);
+
+/* Write the name of a key, such as "Shift+Ctrl+L" or "Alt+F1", to buf,
+   which should be at least 24 characters. */
+extern void kbd_key_name (int code, int flags, char *buf, int size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,7 @@
  * Copyright (c)2022 Kevin Boone, GPL v3.0
  * ========================================================================*/
 
+#include <stdio.h>
 #include <kbd/kbd.h>
 
 /*===========================================================================
@@ -19,14 +20,94 @@ char kbd_to_ascii (int code, int flags)
   //   support US keyboards. Virtual keys like 'up' and 'F1' also
   //   generate codes > 127, and these also cannot meaningfully be
   //   converted.
-  if (code > 127) return 0;
-  
-  // We have more work to do here. What about shift-ctrl, shift-alt, etc?
+  if (code < 0 || code > 127) return 0;
+
+  // A terminal would send Alt+key as ESC and the key, which is not
+  //   one character. 
+  if (flags & KBD_FLAG_ALT) return 0;
+
   if (flags & KBD_FLAG_CONTROL)
-     return (code & ~0x60);
+    {
+    // Shift has already been applied to the code, so a letter may be
+    //   either case, and Ctrl+[ and Shift+Ctrl+{ are both ESC. Ctrl+@
+    //   and Ctrl+` would be NUL, which we can't return.
+    if (code >= '@' && code <= '~') return code & 0x1F;
+    switch (code)
+      {
+      case '?': return 127; 
+      // The unshifted keys of ^ and _, as an xterm has them
+      case '6': return 0x1E;
+      case '-': case '/': return 0x1F;
+      }
+    // Control characters, like Enter and backspace, are unchanged.
+    //   Digits and the rest of the punctuation have no control 
+    //   character.
+    return code < 32 ? code : 0;
+    }
 
   return code; 
   }
 
+/*===========================================================================
+ * kbd_bind_slot
+ * ========================================================================*/
+int kbd_bind_slot (int code, int flags)
+  {
+  if ((code >= 0 && code < KBD_BIND_ASCII) 
+       || (code >= KBD_KEY_DOWN && code <= KBD_KEY_F12))
+    return KBD_BIND_SLOT (code, flags);
+  return -1;
+  }
+
+/*===========================================================================
+ * kbd_binding
+ * ========================================================================*/
+int kbd_binding (const unsigned char *bindings, int code, int flags)
+  {
+  int slot = kbd_bind_slot (code, flags);
+  return slot < 0 ? KBD_BIND_NONE : bindings[slot];
+  }
+
+/*===========================================================================
+ * kbd_bind
+ * ========================================================================*/
+int kbd_bind (unsigned char *bindings, int code, int flags, int action)
+  {
+  int slot = kbd_bind_slot (code, flags);
+  if (slot < 0 || action < 0 || action > 255) return -1;
+  int old = bindings[slot];
+  bindings[slot] = (unsigned char)action;
+  return old;
+  }
 
+/*===========================================================================
+ * kbd_key_name
+ * ========================================================================*/
+void kbd_key_name (int code, int flags, char *buf, int size)
+  {
+  static const char *const keys[] = 
+    { "Down", "Up", "PgDn", "PgUp", "Right", "Left", "Home", "End" };
+  char key[8];
+  if (code >= KBD_KEY_F1 && code <= KBD_KEY_F12)
+    snprintf (key, sizeof (key), "F%d", code - KBD_KEY_F1 + 1);
+  else if (code >= KBD_KEY_DOWN && code < KBD_KEY_F1)
+    snprintf (key, sizeof (key), "%s", keys[code - KBD_KEY_DOWN]);
+  else if (code == KBD_KEY_ENTER)
+    snprintf (key, sizeof (key), "Enter");
+  else if (code == KBD_KEY_BS)
+    snprintf (key, sizeof (key), "BS");
+  else if (code == '\t')
+    snprintf (key, sizeof (key), "Tab");
+  else if (code == 27)
+    snprintf (key, sizeof (key), "Esc");
+  else if (code == ' ')
+    snprintf (key, sizeof (key), "Space");
+  else if (code > ' ' && code < 127)
+    snprintf (key, sizeof (key), "%c", code);
+  else
+    snprintf (key, sizeof (key), "%d", code);
+  snprintf (buf, size, "%s%s%s%s", flags & KBD_FLAG_SHIFT ? "Shift+" : "",
+    flags & KBD_FLAG_CONTROL ? "Ctrl+" : "", 
+    flags & KBD_FLAG_ALT ? "Alt+" : "", key);
+  }
 
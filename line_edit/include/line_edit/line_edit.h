@@ -0,0 +1,54 @@
+/*===========================================================================
+ * line_edit/line_edit.h
+ *
+ * A simple line editor that sits between the keyboard and the I2C LCD
+ * display. It supports insertion and deletion anywhere in the line,
+ * cursor movement, and a history of previous lines.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <i2c_lcd/i2c_lcd.h>
+
+typedef struct _LINE_EDIT LINE_EDIT;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Create a line editor that writes to the specified display. max_len is
+    the longest line that can be edited, and history the number of
+    previous lines that are retained. The line starts at the display's
+    current cursor position. */
+extern LINE_EDIT *line_edit_new (I2C_LCD *i2c_lcd, int max_len,
+                                  int history);
+extern void       line_edit_destroy (LINE_EDIT *self);
+
+/** Handle a keystroke, as delivered to kbd_raw_key_down(). Returns TRUE
+    if the line editor consumed the key. If it returns FALSE, the caller
+    should deal with the key itself -- and call line_edit_reset() if
+    it writes to the display. */
+extern BOOL       line_edit_key (LINE_EDIT *self, int code, int flags);
+
+/** Insert n characters at the cursor position, repainting the rest of
+    the line just once. Returns the number of characters inserted, which
+    will be less than n if the line is full. */
+extern int        line_edit_insert_chars (LINE_EDIT *self, const char *s,
+                    int n);
+
+/** Leave the line on the display as it is, with the display cursor at
+    the end of it, and start a new line there. The line is not added
+    to the history. */
+extern void       line_edit_finish (LINE_EDIT *self);
+
+/** Abandon the line being edited, and start a new one at the display's
+    current cursor position. The history is not affected. */
+extern void       line_edit_reset (LINE_EDIT *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+
@@ -0,0 +1,310 @@
+/*===========================================================================
+ * line_edit/line_edit.c
+ *
+ * A line editor for the I2C LCD display. The editor keeps its own copy of
+ * the line being edited, and only ever repaints the part of the line
+ * that has changed. For example, inserting a character in the middle of
+ * a line repaints only the characters from the insertion point to the end
+ * of the line.
+ *
+ * The editor does not know the absolute screen position of the line --
+ * if the display scrolls while the line is being edited, the line moves.
+ * Instead, it keeps track of which character in the line the display
+ * cursor is on, and works out screen positions relative to the display's
+ * current cursor position. This only works if the whole line fits on the
+ * screen, so the length of the line is limited accordingly.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <kbd/kbd.h>
+#include <line_edit/line_edit.h>
+
+struct _LINE_EDIT
+  {
+  I2C_LCD *i2c_lcd;
+  int max_len;
+  int limit;           // Longest line that will fit on the screen
+  int len;
+  int pos;             // Position of the editing cursor in the line
+  int shown;           // Position in the line of the display's cursor
+  char *line;
+  char *saved;         // The line being edited, when browsing history
+  int saved_len;
+  int history_size;
+  int history_count;
+  int history_head;    // Slot that the next history line will go into
+  int history_browse;  // -1 if not browsing, 0 for most recent line, etc
+  char *history;       // history_size lines, each max_len + 1 bytes
+  };
+
+/*===========================================================================
+ * history_line
+ * Get history line n, where zero is the most recent line.
+ * ========================================================================*/
+static char *history_line (const LINE_EDIT *self, int n)
+  {
+  int slot = (self->history_head - 1 - n + self->history_size)
+    % self->history_size;
+  return self->history + slot * (self->max_len + 1);
+  }
+
+/*===========================================================================
+ * history_add
+ * ========================================================================*/
+static void history_add (LINE_EDIT *self)
+  {
+  if (self->len == 0 || self->history_size == 0) return;
+  self->line[self->len] = 0;
+  // Don't fill up the history with repeats of the same line
+  if (self->history_count > 0
+       && strcmp (history_line (self, 0), self->line) == 0) return;
+  strcpy (self->history + self->history_head * (self->max_len + 1),
+    self->line);
+  self->history_head = (self->history_head + 1) % self->history_size;
+  if (self->history_count < self->history_size) self->history_count++;
+  }
+
+/*===========================================================================
+ * move_display_cursor
+ * Move the display cursor to character 'pos' in the line, working
+ * relative to the display cursor's current position.
+ * ========================================================================*/
+static void move_display_cursor (LINE_EDIT *self, int pos)
+  {
+  if (pos == self->shown) return;
+  int row, col;
+  int width = i2c_lcd_get_width (self->i2c_lcd);
+  i2c_lcd_get_cursor (self->i2c_lcd, &row, &col);
+  int lin = row * width + col + pos - self->shown;
+  if (lin < 0) lin = 0;
+  i2c_lcd_set_cursor (self->i2c_lcd, lin / width, lin % width);
+  self->shown = pos;
+  }
+
+/*===========================================================================
+ * repaint
+ * Redraw the line from character 'from' to the end. If the line was
+ * previously longer (old_len), blank out the characters that are no
+ * longer used. Then put the display cursor back where the editing
+ * cursor is.
+ * ========================================================================*/
+static void repaint (LINE_EDIT *self, int from, int old_len)
+  {
+  static const char spaces[] = "        ";
+  move_display_cursor (self, from);
+  if (self->len > from)
+    i2c_lcd_print_chars (self->i2c_lcd, self->line + from, 
+      self->len - from);
+  for (int i = self->len; i < old_len; i += sizeof (spaces) - 1)
+    i2c_lcd_print_chars (self->i2c_lcd, spaces, 
+      MIN (old_len - i, (int)sizeof (spaces) - 1));
+  self->shown = MAX (self->len, old_len);
+  move_display_cursor (self, self->pos);
+  }
+
+/*===========================================================================
+ * replace_line
+ * Replace the whole line with new text, as when recalling history. Only
+ * the part after the common prefix of the old and new lines is redrawn.
+ * ========================================================================*/
+static void replace_line (LINE_EDIT *self, const char *s, int n)
+  {
+  if (n > self->limit) n = self->limit;
+  int common = 0;
+  while (common < n && common < self->len && self->line[common] == s[common])
+    common++;
+  int old_len = self->len;
+  memcpy (self->line, s, n);
+  self->len = n;
+  self->pos = n;
+  repaint (self, common, old_len);
+  }
+
+/*===========================================================================
+ * line_edit_insert_chars
+ * ========================================================================*/
+int line_edit_insert_chars (LINE_EDIT *self, const char *s, int n)
+  {
+  if (n > self->limit - self->len) n = self->limit - self->len;
+  if (n <= 0) return 0;
+  memmove (self->line + self->pos + n, self->line + self->pos,
+    self->len - self->pos);
+  memcpy (self->line + self->pos, s, n);
+  self->len += n;
+  self->pos += n;
+  repaint (self, self->pos - n, self->len - n);
+  return n;
+  }
+
+/*===========================================================================
+ * delete_char
+ * Delete the character at position pos.
+ * ========================================================================*/
+static void delete_char (LINE_EDIT *self, int pos)
+  {
+  if (pos < 0 || pos >= self->len) return;
+  memmove (self->line + pos, self->line + pos + 1, self->len - pos - 1);
+  self->len--;
+  self->pos = pos;
+  repaint (self, pos, self->len + 1);
+  }
+
+/*===========================================================================
+ * history_up
+ * ========================================================================*/
+static void history_up (LINE_EDIT *self)
+  {
+  if (self->history_browse + 1 >= self->history_count) return;
+  if (self->history_browse < 0)
+    {
+    memcpy (self->saved, self->line, self->len);
+    self->saved_len = self->len;
+    }
+  self->history_browse++;
+  const char *s = history_line (self, self->history_browse);
+  replace_line (self, s, strlen (s));
+  }
+
+/*===========================================================================
+ * history_down
+ * ========================================================================*/
+static void history_down (LINE_EDIT *self)
+  {
+  if (self->history_browse < 0) return;
+  self->history_browse--;
+  if (self->history_browse < 0)
+    replace_line (self, self->saved, self->saved_len);
+  else
+    {
+    const char *s = history_line (self, self->history_browse);
+    replace_line (self, s, strlen (s));
+    }
+  }
+
+/*===========================================================================
+ * line_edit_new
+ * ========================================================================*/
+LINE_EDIT *line_edit_new (I2C_LCD *i2c_lcd, int max_len, int history)
+  {
+  LINE_EDIT *self = malloc (sizeof (LINE_EDIT));
+  self->i2c_lcd = i2c_lcd;
+  self->max_len = max_len;
+  self->line = malloc (max_len + 1);
+  self->saved = malloc (max_len + 1);
+  self->history_size = history;
+  self->history_count = 0;
+  self->history_head = 0;
+  self->history = malloc (history * (max_len + 1));
+  line_edit_reset (self);
+  return self;
+  }
+
+/*===========================================================================
+ * line_edit_reset
+ * ========================================================================*/
+void line_edit_reset (LINE_EDIT *self)
+  {
+  int col;
+  int width = i2c_lcd_get_width (self->i2c_lcd);
+  int height = i2c_lcd_get_height (self->i2c_lcd);
+  i2c_lcd_get_cursor (self->i2c_lcd, NULL, &col);
+  // Leave room for the cursor after the last character, so that the
+  //   start of the line never scrolls off the top of the screen.
+  self->limit = MIN (self->max_len, width * height - col - 1);
+  if (self->limit < 0) self->limit = 0;
+  self->len = 0;
+  self->pos = 0;
+  self->shown = 0;
+  self->saved_len = 0;
+  self->history_browse = -1;
+  }
+
+/*===========================================================================
+ * line_edit_finish
+ * ========================================================================*/
+void line_edit_finish (LINE_EDIT *self)
+  {
+  move_display_cursor (self, self->len);
+  line_edit_reset (self);
+  }
+
+/*===========================================================================
+ * line_edit_key
+ * ========================================================================*/
+BOOL line_edit_key (LINE_EDIT *self, int code, int flags)
+  {
+  // Shifted arrow keys, shifted home and end, and page up and down, are
+  //   left for the application (e.g., scrollback)
+  if (flags & KBD_FLAG_SHIFT)
+    {
+    if (code == KBD_KEY_UP || code == KBD_KEY_DOWN) return FALSE;
+    if (code == KBD_KEY_HOME || code == KBD_KEY_END) return FALSE;
+    }
+  if (code == KBD_KEY_PGUP || code == KBD_KEY_PGDN) return FALSE;
+
+  switch (code)
+    {
+    case KBD_KEY_LEFT:
+      if (self->pos > 0) self->pos--;
+      move_display_cursor (self, self->pos);
+      return TRUE;
+    case KBD_KEY_RIGHT:
+      if (self->pos < self->len) self->pos++;
+      move_display_cursor (self, self->pos);
+      return TRUE;
+    case KBD_KEY_HOME:
+      self->pos = 0;
+      move_display_cursor (self, self->pos);
+      return TRUE;
+    case KBD_KEY_END:
+      self->pos = self->len;
+      move_display_cursor (self, self->pos);
+      return TRUE;
+    case KBD_KEY_UP:
+      history_up (self);
+      return TRUE;
+    case KBD_KEY_DOWN:
+      history_down (self);
+      return TRUE;
+    }
+
+  char c = kbd_to_ascii (code, flags);
+  switch (c)
+    {
+    case 0:
+      return FALSE;
+    case KBD_KEY_BS:
+      delete_char (self, self->pos - 1);
+      return TRUE;
+    case 4: // ctrl-D -- delete the character under the cursor
+      delete_char (self, self->pos);
+      return TRUE;
+    case KBD_KEY_ENTER:
+      move_display_cursor (self, self->len);
+      history_add (self);
+      i2c_lcd_print_char (self->i2c_lcd, c);
+      line_edit_reset (self);
+      return TRUE;
+    }
+
+  if (c < 32 || c == 127) return FALSE;
+
+  line_edit_insert_chars (self, &c, 1);
+  return TRUE;
+  }
+
+/*===========================================================================
+ * line_edit_destroy
+ * ========================================================================*/
+void line_edit_destroy (LINE_EDIT *self)
+  {
+  free (self->history);
+  free (self->saved);
+  free (self->line);
+  free (self);
+  }
+
@@ -6,10 +6,23 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pico/stdlib.h>
 #include <hardware/i2c.h>
+#include <hardware/structs/scb.h>
 #include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include <i2c_lcd/i2c_trace.h>
 #include <usb_kbd/usb_kbd.h>
+#include <usb_kbd/hid_trace.h>
 #include <kbd/kbd.h>
+#include <line_edit/line_edit.h>
+#include <sched/sched.h>
+#include <burst/burst.h>
+#include <journal/journal.h>
+#include <mirror/mirror.h>
+#include <export/export.h>
+#include <memstat/memstat.h>
+#include <stall/stall.h>
 #include "bsp/board.h"
 #include "config.h"
 
@@ -19,73 +32,1330 @@
 //   associate a specific keyboard with a specific display device. 
 //   This isn't a problem in practice -- it's just unsightly.
 I2C_LCD *i2c_lcd;
+LINE_EDIT *line_edit;
+
+// Virtual consoles, each with its own line editor. i2c_lcd and line_edit
+//   are the ones for the console currently on the panel. Console 0 is 
+//   the display itself.
+static I2C_LCD *consoles[NUM_CONSOLES];
+static LINE_EDIT *line_edits[NUM_CONSOLES];
+static int console = 0;
+
+// What a key can be bound to. The consoles' actions are consecutive.
+typedef enum _KEY_ACTION
+  {
+  KEY_ACTION_NONE = KBD_BIND_NONE,
+  KEY_ACTION_LINE_UP,
+  KEY_ACTION_LINE_DOWN,
+  KEY_ACTION_PAGE_UP,
+  KEY_ACTION_PAGE_DOWN,
+  KEY_ACTION_TOP,
+  KEY_ACTION_LIVE,
+  KEY_ACTION_CLEAR,
+  KEY_ACTION_BACKLIGHT,
+  KEY_ACTION_WRAP,
+  KEY_ACTION_CONSOLE_1,
+  KEY_ACTIONS = KEY_ACTION_CONSOLE_1 + NUM_CONSOLES
+  } KEY_ACTION;
+
+static const char *const key_action_names[KEY_ACTION_CONSOLE_1] =
+  {
+  "nothing", "scroll up a line", "scroll down a line", "scroll up a page",
+  "scroll down a page", "scroll to the top", "scroll to the bottom",
+  "clear the screen", "turn the backlight on or off", 
+  "turn wrapping on or off"
+  };
+
+// Alt+F1, Alt+F2... switch consoles, for as many consoles as there are
+#define CONSOLE_KEY(n) [KBD_BIND_SLOT (KBD_KEY_F1 + (n), KBD_FLAG_ALT)] = \
+  ((n) < NUM_CONSOLES ? KEY_ACTION_CONSOLE_1 + (n) : KEY_ACTION_NONE)
+
+// The action each key is bound to, indexed by key code and modifiers,
+//   so that finding a key's action is one lookup. The bindings are set
+//   here at compile time, and can be changed at run time with the 'K' 
+//   serial command. Bound keys are acted on before the line editor 
+//   sees them. 
+static unsigned char key_bindings[KBD_BIND_SLOTS] =
+  {
+  [KBD_BIND_SLOT (KBD_KEY_UP, KBD_FLAG_SHIFT)] = KEY_ACTION_LINE_UP,
+  [KBD_BIND_SLOT (KBD_KEY_DOWN, KBD_FLAG_SHIFT)] = KEY_ACTION_LINE_DOWN,
+  [KBD_BIND_SLOT (KBD_KEY_PGUP, 0)] = KEY_ACTION_PAGE_UP,
+  [KBD_BIND_SLOT (KBD_KEY_PGDN, 0)] = KEY_ACTION_PAGE_DOWN,
+  [KBD_BIND_SLOT (KBD_KEY_PGUP, KBD_FLAG_SHIFT)] = KEY_ACTION_PAGE_UP,
+  [KBD_BIND_SLOT (KBD_KEY_PGDN, KBD_FLAG_SHIFT)] = KEY_ACTION_PAGE_DOWN,
+  [KBD_BIND_SLOT (KBD_KEY_HOME, KBD_FLAG_SHIFT)] = KEY_ACTION_TOP,
+  [KBD_BIND_SLOT (KBD_KEY_END, KBD_FLAG_SHIFT)] = KEY_ACTION_LIVE,
+  [KBD_BIND_SLOT ('l', KBD_FLAG_ALT)] = KEY_ACTION_CLEAR,
+  [KBD_BIND_SLOT ('b', KBD_FLAG_ALT)] = KEY_ACTION_BACKLIGHT,
+  [KBD_BIND_SLOT ('w', KBD_FLAG_ALT)] = KEY_ACTION_WRAP,
+  CONSOLE_KEY (0), CONSOLE_KEY (1), CONSOLE_KEY (2), CONSOLE_KEY (3),
+  CONSOLE_KEY (4), CONSOLE_KEY (5), CONSOLE_KEY (6), CONSOLE_KEY (7),
+  CONSOLE_KEY (8), CONSOLE_KEY (9), CONSOLE_KEY (10), CONSOLE_KEY (11)
+  };
+
+// Rebinding a key with the 'K' serial command: the action is chosen 
+//   on the serial console, then the key is pressed on the keyboard
+typedef enum _BIND_STATE
+  {
+  BIND_IDLE,
+  BIND_CHOOSING,
+  BIND_WAITING
+  } BIND_STATE;
+static BIND_STATE bind_state = BIND_IDLE;
+static int bind_action;
+
+// The time typed after the 'g' serial command, or a length of -1 when 
+//   one isn't being typed
+static char seek_entry[12];
+static int seek_len = -1;
+
+// Statistics of the time taken to switch consoles
+static uint32_t switch_count = 0;
+static uint32_t switch_last_us = 0;
+static uint32_t switch_max_us = 0;
+static uint32_t switch_overruns = 0;
+
+// The display's transport, which belongs to i2c_lcd, kept for the
+//   transport statistics
+static LCD_TRANSPORT *lcd_transport;
+
+// Statistics of the time from the USB callback receiving a keystroke
+//   to its character reaching the display, counting only keys that
+//   draw one.
+static uint32_t glyph_count = 0;
+static uint32_t glyph_min_us = UINT32_MAX;
+static uint32_t glyph_max_us = 0;
+static uint64_t glyph_total_us = 0;
+
+// Keystrokes are queued by the USB callback, and dealt with by the
+//   display task. This keeps the time spent updating the display out of
+//   the USB stack, and lets the scheduler account for each separately.
+typedef struct _KEY_EVENT
+  {
+  int code;
+  int flags;
+  int dev;          // USB device that sent the keystroke
+  uint32_t time_us; // Time the keystroke arrived
+  } KEY_EVENT;
+
+static KEY_EVENT key_queue[KEY_QUEUE_SIZE];
+static int key_head = 0; 
+static int key_tail = 0;
+static uint32_t keys_dropped = 0;
+
+static int display_task_id;
+static int lcd_init_task_id;
+
+// Times since boot, in microseconds, at which the USB host and the 
+//   display became ready, and at which the first keystroke arrived and
+//   was displayed. 
+static uint32_t boot_usb_us = 0;
+static uint32_t boot_display_us = 0;
+static uint32_t boot_first_key_us = 0;
+static uint32_t boot_first_key_shown_us = 0;
+
+// Rapid bursts of keystrokes, as from a barcode scanner, are collected
+//   here and displayed in one go. See burst_output().
+static BURST *burst;
+
+#if JOURNAL_SECTORS > 0
+// Lines that leave the display are recorded in a journal in flash, and
+//   put back in the scrollback buffer at start-up. The journal is written
+//   by journal_task(), only when the keyboard has been quiet for a while.
+static JOURNAL *journal;
+static int journal_task_id;
+#endif
+static uint32_t last_key_us = 0;
+
+// Mirroring of the panel to a host, over the serial console. The mirror
+//   task sends what has changed every MIRROR_INTERVAL_MS, while 
+//   mirroring is on.
+static MIRROR *mirror;
+static int mirror_task_id;
+static BOOL mirroring = MIRROR_AT_BOOT;
+static uint32_t mirror_key_frame_us = 0;
+
+// An export of a console's scrollback buffer, while one is in progress.
+//   The export task sends it a frame at a time.
+static EXPORT *export;
+static int export_task_id;
+
+// Idle power saving. The idle task puts the panel to sleep when the
+//   keyboard has been quiet for IDLE_SLEEP_MS, and the display task
+//   wakes it on a keystroke. The driver wakes it itself for output,
+//   which the idle task notices from idle_asleep. Wake latency is from
+//   the keystroke arriving to the panel being on again.
+static uint64_t idle_since_us = 0;
+static BOOL idle_asleep = FALSE;
+static uint32_t idle_sleeps = 0;
+static uint32_t idle_key_wakes = 0;
+static uint32_t idle_output_wakes = 0;
+static uint32_t wake_last_us = 0;
+static uint32_t wake_max_us = 0;
+static uint64_t wake_total_us = 0;
+static uint32_t wake_write_us = 0;
 
 /*===========================================================================
  * blink_led_task
- * Called in the main scanning loop. We flash the LED just to indicate that
- * the program hasn't crashed.
+ * A periodic task. We flash the LED just to indicate that the program 
+ * hasn't crashed.
  * ========================================================================*/
-void blink_led_task (void)
+static void blink_led_task (void *context)
   {
-  const uint32_t interval_ms = 1000;
-  static uint32_t start_ms = 0;
+  (void)context;
   static bool led_state = false;
-  if(board_millis() - start_ms < interval_ms) { return; }
-  start_ms += interval_ms;
-  board_led_write(led_state);
+  board_led_write (led_state);
   led_state = !led_state;
   }
 
 /*===========================================================================
- * kbd_raw_key_down is called by the USB HID code whenever a
- * key is pressed. The value 'code' does not take account of which
- * modifiers are pressed -- call kbd_to_ascii() to deal wity that.
+ * status_task
+ * A periodic task, that updates the status line of every console, if
+ * there is one. Only the characters that change -- usually just the 
+ * last digit of the time -- are sent to the display, and only for the
+ * console that's showing.
  * ========================================================================*/
-void kbd_raw_key_down (int code, int flags)
+static void status_task (void *context)
+  {
+  (void)context;
+  if (!i2c_lcd_ready (i2c_lcd)) return;
+  // The same clock as the scrollback buffer's times, so that the 'g'
+  //   command can be given a time read from here
+  uint32_t secs = (uint32_t)(time_us_64() / 1000000);
+  for (int i = 0; i < NUM_CONSOLES; i++)
+    {
+    char s[48];
+    i2c_lcd_format (s, sizeof (s), "F%d %*s%02lu:%02lu:%02lu", i + 1, 
+      LCD_WIDTH - 11, "", (unsigned long)(secs / 3600), 
+      (unsigned long)(secs / 60 % 60), (unsigned long)(secs % 60));
+    i2c_lcd_set_status (consoles[i], 0, 0, s);
+    }
+  }
+
+/*===========================================================================
+ * usb_task
+ * A polled task, that dispatches USB events. Keystrokes end up in 
+ * kbd_raw_key_down().
+ * ========================================================================*/
+static void usb_task (void *context)
+  {
+  (void)context;
+  usb_kbd_scan();
+  }
+
+/*===========================================================================
+ * chars_available
+ * Called (in interrupt context) by the stdio driver when characters
+ * arrive on the serial console. The interrupt alone is enough to wake
+ * the main loop -- we just make sure.
+ * ========================================================================*/
+static void chars_available (void *param)
+  {
+  (void)param;
+  __sev();
+  }
+
+/*===========================================================================
+ * print_latency
+ * ========================================================================*/
+static void print_latency (void)
+  {
+  if (glyph_count == 0)
+    {
+    printf ("No keystrokes yet\n");
+    return;
+    }
+  printf ("Key-to-glyph latency: %lu keys, min %lu us, "
+    "mean %lu us, max %lu us\n", (unsigned long)glyph_count, 
+    (unsigned long)glyph_min_us,
+    (unsigned long)(glyph_total_us / glyph_count), 
+    (unsigned long)glyph_max_us);
+  }
+
+/*===========================================================================
+ * print_boot_times
+ * ========================================================================*/
+static void print_boot_times (void)
+  {
+  printf ("Boot: USB ready at %lu us, display ready at %lu us\n",
+    (unsigned long)boot_usb_us, (unsigned long)boot_display_us);
+  if (boot_first_key_us)
+    printf ("First keystroke at %lu us, %s %lu us\n",
+      (unsigned long)boot_first_key_us, 
+      boot_first_key_shown_us ? "displayed at" : "not yet displayed",
+      (unsigned long)boot_first_key_shown_us);
+#if JOURNAL_SECTORS > 0
+  const JOURNAL_STATS *st = journal_get_stats (journal);
+  printf ("Restored %lu lines from flash in %lu us\n",
+    (unsigned long)st->restored, (unsigned long)st->restore_us);
+#endif
+  }
+
+/*===========================================================================
+ * print_console_stats
+ * ========================================================================*/
+static void print_console_stats (void)
+  {
+  printf ("Console %d of %d\n", console + 1, NUM_CONSOLES);
+  printf ("Switches: %lu, last %lu us, max %lu us, over %d us: %lu\n",
+    (unsigned long)switch_count, (unsigned long)switch_last_us,
+    (unsigned long)switch_max_us, CONSOLE_SWITCH_BUDGET_US,
+    (unsigned long)switch_overruns);
+  }
+
+/*===========================================================================
+ * print_journal_stats
+ * ========================================================================*/
+static void print_journal_stats (void)
+  {
+#if JOURNAL_SECTORS > 0
+  const JOURNAL_STATS *st = journal_get_stats (journal);
+  printf ("Journal: %lu lines restored in %lu us\n", 
+    (unsigned long)st->restored, (unsigned long)st->restore_us);
+  printf ("Lines: %lu, dropped: %lu, pending: %s\n", 
+    (unsigned long)st->lines, (unsigned long)st->lines_dropped,
+    journal_pending (journal) ? "yes" : "no");
+  printf ("Pages written: %lu, sectors erased: %lu\n", 
+    (unsigned long)st->pages_written, (unsigned long)st->erases);
+#else
+  printf ("Journal is disabled\n");
+#endif
+  }
+
+/*===========================================================================
+ * print_mirror_stats
+ * ========================================================================*/
+static void print_mirror_stats (void)
+  {
+  const MIRROR_STATS *st = mirror_get_stats (mirror);
+  printf ("Mirroring %s\n", mirroring ? "on" : "off");
+  printf ("Frames: %lu (%lu key frames, %lu split), %lu bytes, "
+    "%lu cells\n", (unsigned long)st->frames, (unsigned long)st->key_frames,
+    (unsigned long)st->split_frames, (unsigned long)st->bytes,
+    (unsigned long)st->cells);
+  }
+
+/*===========================================================================
+ * frame_write
+ * Called by the mirror and the export with each frame.
+ * ========================================================================*/
+static void frame_write (const char *s, int n, void *context)
+  {
+  (void)context;
+  fwrite (s, 1, n, stdout);
+  fflush (stdout);
+  }
+
+/*===========================================================================
+ * start_mirror
+ * Turn on mirroring, starting with a key frame.
+ * ========================================================================*/
+static void start_mirror (void)
+  {
+  mirroring = TRUE;
+  mirror_key_frame (mirror);
+  mirror_key_frame_us = time_us_32();
+  sched_start (mirror_task_id, 0);
+  }
+
+/*===========================================================================
+ * print_i2c_stats
+ * ========================================================================*/
+static void print_i2c_stats (void)
+  {
+#if LCD_BUS == LCD_BUS_I2C
+  LCD_I2C_STATS st;
+  lcd_transport_i2c_get_stats (lcd_transport, &st);
+  printf ("I2C baud rate: %d\n", st.baud);
+  printf ("Writes: %lu, NAKs: %lu, timeouts: %lu, fallbacks: %lu\n",
+    st.writes, st.naks, st.timeouts, st.fallbacks);
+#else
+  (void)lcd_transport;
+  printf ("Display is not on I2C\n");
+#endif
+  }
+
+/*===========================================================================
+ * dump_i2c_trace
+ * Dump the trace of the display's I2C transfers, and start a new one,
+ * so that the next dump has only what happened in between.
+ * ========================================================================*/
+static void dump_i2c_trace (void)
+  {
+#if LCD_BUS == LCD_BUS_I2C
+  if (I2C_TRACE_BYTES > 0)
+    {
+    i2c_trace_dump();
+    i2c_trace_clear();
+    return;
+    }
+#endif
+  printf ("I2C tracing is off\n");
+  }
+
+/*===========================================================================
+ * print_memory_stats
+ * Where the RAM has gone, and how much more scrollback would fit. Stack
+ * figures are the deepest each stack has been since boot.
+ * ========================================================================*/
+static void print_memory_stats (void)
+  {
+  const MEMSTAT_STATS *st = memstat_get_stats();
+  printf ("RAM: %lu bytes, static data: %lu\n", (unsigned long)st->ram,
+    (unsigned long)st->static_bytes);
+  printf ("Heap: %lu in use, high-water %lu, of %lu\n", 
+    (unsigned long)st->heap_used, (unsigned long)st->heap_high,
+    (unsigned long)st->heap_limit);
+  for (int i = 0; i < MEMSTAT_CORES; i++)
+    {
+    if (st->stack_high[i] == 0)
+      printf ("Core %d stack: not used, of %lu\n", i, 
+        (unsigned long)st->stack_size[i]);
+    else
+      printf ("Core %d stack: high-water %lu, of %lu\n", i, 
+        (unsigned long)st->stack_high[i], (unsigned long)st->stack_size[i]);
+    }
+  printf ("Heap at start-up:");
+  for (int i = 0; i < MEMSTAT_PARTS; i++)
+    printf (" %s %lu", memstat_part_name (i), 
+      (unsigned long)st->part_heap[i]);
+  printf ("\n");
+
+  int per_console = i2c_lcd_get_memory (consoles[0]);
+  int per_page = i2c_lcd_scrollback_page_bytes (consoles[0]);
+  long spare = (long)st->heap_limit - (long)st->heap_high;
+  printf ("Each console: %d bytes, %d pages of %d bytes\n", per_console,
+    SCROLLBACK_PAGES, per_page);
+  if (spare > 0 && per_page > 0)
+    printf ("Free heap would hold %ld more pages per console\n", 
+      spare / per_page / NUM_CONSOLES);
+  }
+
+/*===========================================================================
+ * stage_name
+ * ========================================================================*/
+static const char *stage_name (int stage)
+  {
+  if (stage == STALL_LOOP) return "main loop";
+  if (stage == STALL_ASLEEP) return "sleep";
+  return sched_task_name (stage);
+  }
+
+/*===========================================================================
+ * print_stall_record
+ * ========================================================================*/
+static void print_stall_record (const STALL_RECORD *r)
+  {
+  printf ("Passes: %lu, longest stage: %s, %lu us\n", 
+    (unsigned long)r->passes, stage_name (r->worst_stage), 
+    (unsigned long)r->worst_us);
+  printf ("Stages over %d us: %lu\n", STALL_BUDGET_US, 
+    (unsigned long)r->slow);
+  int n = r->slow < STALL_HISTORY ? (int)r->slow : STALL_HISTORY;
+  for (int i = n; i > 0; i--)
+    {
+    const STALL_EVENT *e = &r->recent[(r->slow - i) % STALL_HISTORY];
+    printf ("  at %lu ms: %s, %lu us\n", (unsigned long)e->at_ms,
+      stage_name (e->stage), (unsigned long)e->us);
+    }
+  }
+
+/*===========================================================================
+ * print_stall_reset
+ * What the program was doing when the watchdog last reset it. The 
+ * watchdog fires timeout_ms after it was last fed, so that is how long
+ * the stage that was running had been going.
+ * ========================================================================*/
+static void print_stall_reset (void)
+  {
+  const STALL_RECORD *r = stall_last_reset();
+  if (!r)
+    {
+    printf ("No watchdog reset\n");
+    return;
+    }
+  uint32_t stuck_us = r->timeout_ms * 1000 
+    - (r->stage_start_us - r->fed_us);
+  printf ("Watchdog reset (%lu since power-on): stuck in %s for %lu ms\n",
+    (unsigned long)r->resets + 1, stage_name (r->stage), 
+    (unsigned long)(stuck_us / 1000));
+  print_stall_record (r);
+  }
+
+/*===========================================================================
+ * print_stall_stats
+ * ========================================================================*/
+static void print_stall_stats (void)
+  {
+  const STALL_RECORD *r = stall_get_record();
+  if (r->timeout_ms)
+    printf ("Watchdog: %lu ms, %lu resets since power-on\n", 
+      (unsigned long)r->timeout_ms, (unsigned long)r->resets);
+  else
+    printf ("Watchdog is off\n");
+  print_stall_record (r);
+  print_stall_reset();
+  }
+
+/*===========================================================================
+ * print_power_stats
+ * ========================================================================*/
+static void print_power_stats (void)
+  {
+  if (IDLE_SLEEP_MS == 0)
+    printf ("Idle sleep is off\n");
+  else
+    printf ("Display %s; sleeps after %lu s idle\n",
+      idle_asleep ? "asleep" : "awake",
+      (unsigned long)(IDLE_SLEEP_MS / 1000));
+  printf ("Sleeps: %lu, woken by a key: %lu, by output: %lu\n",
+    (unsigned long)idle_sleeps, (unsigned long)idle_key_wakes,
+    (unsigned long)idle_output_wakes);
+  if (idle_key_wakes == 0) return;
+  printf ("Key to display on: last %lu us, mean %lu us, max %lu us\n",
+    (unsigned long)wake_last_us,
+    (unsigned long)(wake_total_us / idle_key_wakes),
+    (unsigned long)wake_max_us);
+  printf ("Last wake write: %lu us\n", (unsigned long)wake_write_us);
+  }
+
+/*===========================================================================
+ * key_action_name
+ * ========================================================================*/
+static void key_action_name (int action, char *buf, int size)
+  {
+  if (action >= KEY_ACTION_CONSOLE_1 && action < KEY_ACTIONS)
+    snprintf (buf, size, "switch to console %d", 
+      action - KEY_ACTION_CONSOLE_1 + 1);
+  else if (action >= 0 && action < KEY_ACTION_CONSOLE_1)
+    snprintf (buf, size, "%s", key_action_names[action]);
+  else
+    snprintf (buf, size, "action %d", action);
+  }
+
+/*===========================================================================
+ * print_bindings
+ * ========================================================================*/
+static void print_bindings (void)
+  {
+  for (int code = 0; code <= KBD_KEY_F12; code++)
+    {
+    // After the ASCII codes, skip to the first of the special keys
+    if (code == KBD_BIND_ASCII) code = KBD_KEY_DOWN;
+    for (int flags = 0; flags < KBD_BIND_MODS; flags++)
+      {
+      int action = kbd_binding (key_bindings, code, flags);
+      if (action == KEY_ACTION_NONE) continue;
+      char key[24], name[48];
+      kbd_key_name (code, flags, key, sizeof (key));
+      key_action_name (action, name, sizeof (name));
+      printf ("%-16s %s\n", key, name);
+      }
+    }
+  }
+
+/*===========================================================================
+ * start_binding
+ * The first step of the 'K' command: list the actions, to be chosen by
+ * their letters.
+ * ========================================================================*/
+static void start_binding (void)
+  {
+  for (int i = 0; i < KEY_ACTIONS; i++)
+    {
+    char name[48];
+    key_action_name (i, name, sizeof (name));
+    printf ("%c  %s\n", 'a' + i, name);
+    }
+  printf ("Which action? (any other key to cancel)\n");
+  bind_state = BIND_CHOOSING;
+  }
+
+/*===========================================================================
+ * choose_binding
+ * The second step of the 'K' command: the action has been chosen, and 
+ * the next key pressed on the keyboard will be bound to it.
+ * ========================================================================*/
+static void choose_binding (int c)
+  {
+  if (c < 'a' || c >= 'a' + KEY_ACTIONS)
+    {
+    printf ("Cancelled\n");
+    bind_state = BIND_IDLE;
+    return;
+    }
+  char name[48];
+  bind_action = c - 'a';
+  key_action_name (bind_action, name, sizeof (name));
+  printf ("Press the key to %s\n", name);
+  bind_state = BIND_WAITING;
+  }
+
+/*===========================================================================
+ * format_time
+ * Seconds since start-up, as h:mm:ss, as on the status line.
+ * ========================================================================*/
+static void format_time (uint32_t secs, char *buf, int size)
+  {
+  snprintf (buf, size, "%lu:%02lu:%02lu", (unsigned long)(secs / 3600),
+    (unsigned long)(secs / 60 % 60), (unsigned long)(secs % 60));
+  }
+
+/*===========================================================================
+ * parse_time
+ * h:mm:ss, h:mm, or a number of seconds. Returns FALSE if it's none of
+ * these.
+ * ========================================================================*/
+static BOOL parse_time (const char *s, uint32_t *secs)
+  {
+  uint32_t field[3];
+  int fields = 0;
+  const char *p = s;
+  while (fields < 3)
+    {
+    if (*p < '0' || *p > '9') return FALSE;
+    uint32_t v = 0;
+    while (*p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    field[fields++] = v;
+    if (*p != ':') break;
+    p++;
+    }
+  if (*p) return FALSE;
+  if (fields == 1)
+    *secs = field[0];
+  else
+    *secs = field[0] * 3600 + field[1] * 60 + (fields == 3 ? field[2] : 0);
+  return TRUE;
+  }
+
+/*===========================================================================
+ * seek_time
+ * The end of the 'g' command: scroll the console that's showing back to
+ * the first line started at or after the time typed.
+ * ========================================================================*/
+static void seek_time (void)
+  {
+  uint32_t secs, number, t;
+  if (!parse_time (seek_entry, &secs))
+    {
+    printf ("Not a time: use h:mm:ss, h:mm, or seconds\n");
+    return;
+    }
+  char when[16];
+  if (!i2c_lcd_scrollback_seek (i2c_lcd, secs, &number))
+    printf ("Nothing above the display from then on: showing the live "
+      "display\n");
+  else if (i2c_lcd_get_line_time (i2c_lcd, number, &t))
+    {
+    char line[I2C_LCD_LINE_MAX + 1];
+    i2c_lcd_get_line (i2c_lcd, number, line, sizeof (line));
+    format_time (t, when, sizeof (when));
+    printf ("%s %s\n", when, line);
+    }
+  i2c_lcd_update (i2c_lcd);
+  }
+
+/*===========================================================================
+ * seek_entry_char
+ * A character of the time typed after the 'g' command. Enter ends it,
+ * and anything that can't be part of a time cancels it.
+ * ========================================================================*/
+static void seek_entry_char (int c)
+  {
+  if (c == '\r' || c == '\n')
+    {
+    printf ("\n");
+    seek_entry[seek_len] = 0;
+    seek_len = -1;
+    seek_time();
+    }
+  else if ((c == 8 || c == 127) && seek_len > 0)
+    {
+    seek_len--;
+    printf ("\b \b");
+    }
+  else if (((c >= '0' && c <= '9') || c == ':') 
+       && seek_len < (int)sizeof (seek_entry) - 1)
+    {
+    seek_entry[seek_len++] = (char)c;
+    putchar (c);
+    }
+  else if (c != 8 && c != 127)
+    {
+    printf ("\nCancelled\n");
+    seek_len = -1;
+    }
+  }
+
+/*===========================================================================
+ * serial_command_task
+ * A polled task. Handle single-character commands from the serial
+ * console (the USB port is in use by the keyboard, so this will be the
+ * UART).
+ * ========================================================================*/
+static void serial_command_task (void *context)
+  {
+  (void)context;
+  int c = getchar_timeout_us (0);
+  if (c == PICO_ERROR_TIMEOUT) return;
+  if (bind_state == BIND_CHOOSING)
+    {
+    choose_binding (c);
+    return;
+    }
+  if (seek_len >= 0)
+    {
+    seek_entry_char (c);
+    return;
+    }
+  switch (c)
+    {
+    case 't': // Dump the HID report trace
+      hid_trace_dump();
+      break;
+    case 'T': // Clear the HID report trace
+      hid_trace_clear();
+      break;
+    case 'l': // Show the keystroke latency
+      print_latency();
+      break;
+    case 's': // Show task statistics
+      sched_print_stats();
+      printf ("Keystrokes dropped: %lu\n", (unsigned long)keys_dropped);
+      printf ("Bursts: %lu, %lu characters\n", 
+        (unsigned long)burst_count (burst), 
+        (unsigned long)burst_chars (burst));
+      break;
+    case 'S': // Reset task statistics
+      sched_reset_stats();
+      stall_reset_stats();
+      break;
+    case 'b': // Show boot times
+      print_boot_times();
+      break;
+    case 'i': // Show I2C statistics
+      print_i2c_stats();
+      break;
+    case 'I': // Dump the I2C trace, and start a new one
+      dump_i2c_trace();
+      break;
+    case 'j': // Show journal statistics
+      print_journal_stats();
+      break;
+    case 'v': // Show virtual console statistics
+      print_console_stats();
+      break;
+    case 'm': // Turn mirroring on or off
+      if (mirroring)
+        {
+        mirroring = FALSE;
+        print_mirror_stats();
+        }
+      else
+        start_mirror();
+      break;
+    case 'M': // Turn mirroring on, and send the whole screen again
+      start_mirror();
+      break;
+    case 'k': // Show key bindings
+      print_bindings();
+      break;
+    case 'K': // Bind a key
+      start_binding();
+      break;
+    case 'r': // Show RAM use
+      print_memory_stats();
+      break;
+    case 'w': // Show stalls, and what the last watchdog reset found
+      print_stall_stats();
+      break;
+    case 'p': // Show idle sleep, and wake latency
+      print_power_stats();
+      break;
+    case 'g': // Scroll back to a time
+      printf ("Go to time (h:mm:ss since start-up): ");
+      seek_len = 0;
+      break;
+    case 'x': // Export the scrollback buffer
+      if (export)
+        printf ("An export is already in progress\n");
+      else
+        {
+        export = export_new (i2c_lcd, console + 1, EXPORT_CHUNK_BYTES,
+          frame_write, NULL);
+        sched_start (export_task_id, 0);
+        }
+      break;
+    }
+  }
+
+/*===========================================================================
+ * switch_console
+ * ========================================================================*/
+static void switch_console (int n)
   {
-  //char s[10];
-  //sprintf (s, "%d %02X ", code, flags);
-  //sprintf (s, "%d ", c, flags);
-  //i2c_lcd_print_string (i2c_lcd, s);
-  switch (code)
+  if (n == console) return;
+  uint32_t start = time_us_32();
+  i2c_lcd_activate (consoles[n]);
+  uint32_t elapsed = time_us_32() - start;
+  console = n;
+  i2c_lcd = consoles[n];
+  line_edit = line_edits[n];
+
+  switch_count++;
+  switch_last_us = elapsed;
+  if (elapsed > switch_max_us) switch_max_us = elapsed;
+  if (elapsed > CONSOLE_SWITCH_BUDGET_US) switch_overruns++;
+  }
+
+/*===========================================================================
+ * do_key_action
+ * ========================================================================*/
+static void do_key_action (int action)
+  {
+  switch (action)
     {
-    // Handle scrollback using up/down keys. All other keys, pass 
-    //   straight through to the display.
-    case KBD_KEY_UP:
+    // Scrollback movements are only drawn when the key queue is empty 
+    //   -- see display_task() -- so a run of them costs one redraw
+    case KEY_ACTION_LINE_UP:
       i2c_lcd_scrollback_line_up (i2c_lcd);
       break;
-    case KBD_KEY_DOWN:
+    case KEY_ACTION_LINE_DOWN:
       i2c_lcd_scrollback_line_down (i2c_lcd);
       break;
-    // TODO scrollback page up/down
+    case KEY_ACTION_PAGE_UP:
+      i2c_lcd_scrollback_page_up (i2c_lcd);
+      break;
+    case KEY_ACTION_PAGE_DOWN:
+      i2c_lcd_scrollback_page_down (i2c_lcd);
+      break;
+    case KEY_ACTION_TOP:
+      i2c_lcd_scrollback_top (i2c_lcd);
+      break;
+    case KEY_ACTION_LIVE:
+      i2c_lcd_scrollback_live (i2c_lcd);
+      break;
+    case KEY_ACTION_CLEAR:
+      // Unlike ctrl-L, this keeps the scrollback buffer
+      i2c_lcd_clear (i2c_lcd, FALSE);
+      line_edit_reset (line_edit);
+      break;
+    case KEY_ACTION_BACKLIGHT:
+      if (i2c_lcd_is_backlight_on (i2c_lcd))
+        i2c_lcd_backlight_off (i2c_lcd);
+      else
+        i2c_lcd_backlight_on (i2c_lcd);
+      break;
+    case KEY_ACTION_WRAP:
+      if (i2c_lcd_is_wrapping (i2c_lcd))
+        i2c_lcd_wrapping_off (i2c_lcd);
+      else
+        i2c_lcd_wrapping_on (i2c_lcd);
+      break;
     default:
-      char c = kbd_to_ascii (code, flags);
-      i2c_lcd_print_char (i2c_lcd, c);
+      if (action >= KEY_ACTION_CONSOLE_1 && action < KEY_ACTIONS)
+        switch_console (action - KEY_ACTION_CONSOLE_1);
     }
   }
 
 /*===========================================================================
- * start here
+ * handle_key
  * ========================================================================*/
-int main (void)
+static void handle_key (int code, int flags)
   {
-  // Initialize the display
-  i2c_lcd = i2c_lcd_new (LCD_WIDTH, LCD_HEIGHT, I2C_LCD_ADDRESS, 
-     PICO_DEFAULT_I2C_INSTANCE,
-     PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, I2C_BAUD, 
-     SCROLLBACK_PAGES);
+  if (bind_state == BIND_WAITING)
+    {
+    char key[24];
+    kbd_key_name (code, flags, key, sizeof (key));
+    if (kbd_bind (key_bindings, code, flags, bind_action) < 0)
+      printf ("%s can't be bound\n", key);
+    else
+      printf ("Bound %s\n", key);
+    bind_state = BIND_IDLE;
+    return;
+    }
+
+  int action = kbd_binding (key_bindings, code, flags);
+  if (action != KEY_ACTION_NONE)
+    {
+    do_key_action (action);
+    return;
+    }
+
+  // The line editor gets the keys that aren't bound. It leaves alone
+  //   the ones it doesn't handle, like those with Alt held.
+  if (line_edit_key (line_edit, code, flags)) return;
+
+  char c = kbd_to_ascii (code, flags);
+  if (c == 0) return;
+  i2c_lcd_print_char (i2c_lcd, c);
+  // Anything else that gets to the display (e.g., ctrl-L) ends 
+  //   the line being edited.
+  line_edit_reset (line_edit);
+  }
+
+/*===========================================================================
+ * burst_output
+ * Called by the burst detector at the end of a burst. Insert the whole
+ * burst into the line being edited, which repaints the line just once.
+ * If it doesn't all fit, the rest is written straight to the display, 
+ * which is also batched. Either way, nothing is lost.
+ * ========================================================================*/
+static void burst_output (const char *s, int n, void *context)
+  {
+  (void)context;
+  int done = line_edit_insert_chars (line_edit, s, n);
+  if (done < n)
+    {
+    line_edit_finish (line_edit);
+    i2c_lcd_print_chars (i2c_lcd, s + done, n - done);
+    line_edit_reset (line_edit);
+    }
+  }
 
-  // Write some initial text, so we know the display is working
-  i2c_lcd_set_cursor (i2c_lcd, 0, 0);
-  i2c_lcd_print_string (i2c_lcd, "Hello ");
+#if JOURNAL_SECTORS > 0
+/*===========================================================================
+ * journal_line
+ * Called by the display as each line is completed. Just queue the line,
+ * and have journal_task() write it to flash later.
+ * ========================================================================*/
+static void journal_line (const char *line, int width, BOOL continued, 
+              void *context)
+  {
+  (void)context;
+  journal_add_line (journal, line, width, continued);
+  sched_start (journal_task_id, JOURNAL_QUIET_MS * 1000);
+  }
+
+/*===========================================================================
+ * restore_line
+ * Called by journal_restore() with each line from flash. The lines may
+ * have been written by a display of a different width; the scrollback
+ * buffer keeps whole lines, so they are shown rewrapped.
+ * ========================================================================*/
+static void restore_line (const char *line, int width, BOOL continued, 
+              void *context)
+  {
+  (void)context;
+  i2c_lcd_restore_line (i2c_lcd, line, width, continued);
+  }
+
+/*===========================================================================
+ * journal_task
+ * A one-shot task, started when a line is added to the journal. It does
+ * one flash operation at a time -- a page write or a sector erase -- and
+ * only when the keyboard has been quiet for JOURNAL_QUIET_MS. Otherwise
+ * it puts itself off until it has. 
+ * ========================================================================*/
+static void journal_task (void *context)
+  {
+  (void)context;
+  uint32_t end_us;
+  uint32_t quiet_us = time_us_32() - last_key_us;
+  if (key_tail != key_head || burst_pending (burst, &end_us) 
+       || quiet_us < JOURNAL_QUIET_MS * 1000)
+    {
+    sched_start (journal_task_id, JOURNAL_QUIET_MS * 1000);
+    return;
+    }
+  if (journal_work (journal, quiet_us >= JOURNAL_FLUSH_MS * 1000))
+    sched_start (journal_task_id, 0);
+  else if (journal_pending (journal))
+    sched_start (journal_task_id, JOURNAL_FLUSH_MS * 1000 - quiet_us);
+  }
+#endif
+
+/*===========================================================================
+ * mirror_task
+ * A one-shot task, that restarts itself every MIRROR_INTERVAL_MS while 
+ * mirroring is on, and sends a frame of whatever has changed on the 
+ * panel. The UART blocks while a frame goes out, so nothing is sent
+ * while there are keystrokes to deal with -- the changes they make 
+ * go in the next frame.
+ * ========================================================================*/
+static void mirror_task (void *context)
+  {
+  (void)context;
+  if (!mirroring) return;
+  uint32_t end_us;
+  if (i2c_lcd_ready (i2c_lcd) && key_tail == key_head 
+       && !burst_pending (burst, &end_us))
+    {
+    uint32_t now = time_us_32();
+    if (now - mirror_key_frame_us >= MIRROR_KEY_FRAME_MS * 1000)
+      {
+      mirror_key_frame (mirror);
+      mirror_key_frame_us = now;
+      }
+    mirror_poll (mirror);
+    }
+  sched_start (mirror_task_id, MIRROR_INTERVAL_MS * 1000);
+  }
 
+/*===========================================================================
+ * export_task
+ * A one-shot task, that sends the next frame of an export, and restarts
+ * itself until the export is finished. Like mirroring, it stands aside
+ * while there are keystrokes to deal with.
+ * ========================================================================*/
+static void export_task (void *context)
+  {
+  (void)context;
+  if (!export) return;
+  uint32_t end_us;
+  if (key_tail != key_head || burst_pending (burst, &end_us))
+    {
+    sched_start (export_task_id, MIRROR_INTERVAL_MS * 1000);
+    return;
+    }
+  if (export_work (export))
+    {
+    sched_start (export_task_id, 0);
+    return;
+    }
+  const EXPORT_STATS *st = export_get_stats (export);
+  printf ("Exported %lu lines (%lu lost), %lu bytes of text in %lu bytes\n",
+    (unsigned long)st->lines, (unsigned long)st->lost,
+    (unsigned long)st->text_bytes, (unsigned long)st->bytes);
+  export_destroy (export);
+  export = NULL;
+  }
+
+/*===========================================================================
+ * lcd_init_task
+ * A one-shot task that initializes the display a step at a time, 
+ * restarting itself after the delay that each step needs. Between 
+ * steps, the other tasks -- USB in particular -- get to run.
+ * ========================================================================*/
+static void lcd_init_task (void *context)
+  {
+  (void)context;
+#if LCD_BUS == LCD_BUS_I2C
+  static BOOL tuned = FALSE;
+  if (!tuned)
+    {
+    printf ("I2C baud rate: %d\n", 
+      lcd_transport_i2c_autotune (lcd_transport, I2C_BAUD_MAX));
+    tuned = TRUE;
+    sched_start (lcd_init_task_id, 0);
+    return;
+    }
+#endif
+  uint32_t delay_us;
+  if (!i2c_lcd_init_step (i2c_lcd, &delay_us))
+    {
+    sched_start (lcd_init_task_id, delay_us);
+    return;
+    }
+  boot_display_us = time_us_32();
+  idle_since_us = time_us_64();
+
+  // Write some initial text, so we know the display is working. The
+  //   other consoles are labelled, so it's clear which one is showing.
+  for (int i = NUM_CONSOLES - 1; i >= 0; i--)
+    {
+    i2c_lcd_set_cursor (consoles[i], 0, 0);
+    if (i == 0)
+      i2c_lcd_print_string (consoles[i], "Hello ");
+    else
+      i2c_lcd_printf (consoles[i], "Console %d ", i + 1);
+    line_edit_reset (line_edits[i]);
+    }
+  print_boot_times();
+
+  // Deal with any keystrokes that arrived while the display was starting
+  sched_start (display_task_id, 0);
+  }
+
+/*===========================================================================
+ * idle_task
+ * A periodic task. Put the panel to sleep when the keyboard has been
+ * quiet for long enough, and count the times the driver woke it for
+ * output.
+ * ========================================================================*/
+static void idle_task (void *context)
+  {
+  (void)context;
+  if (!i2c_lcd_ready (i2c_lcd)) return;
+  uint64_t now = time_us_64();
+  if (idle_asleep)
+    {
+    if (i2c_lcd_is_asleep (i2c_lcd)) return;
+    idle_asleep = FALSE;
+    idle_output_wakes++;
+    idle_since_us = now;
+    return;
+    }
+  if (now - idle_since_us < (uint64_t)IDLE_SLEEP_MS * 1000) return;
+  i2c_lcd_sleep (i2c_lcd);
+  idle_asleep = TRUE;
+  idle_sleeps++;
+  }
+
+/*===========================================================================
+ * wake_for_key
+ * Restart the idle time, and wake the panel if it is asleep. Returns
+ * TRUE if it was.
+ * ========================================================================*/
+static BOOL wake_for_key (uint32_t key_us)
+  {
+  idle_since_us = time_us_64();
+  if (!i2c_lcd_is_asleep (i2c_lcd)) return FALSE;
+  uint32_t start = time_us_32();
+  i2c_lcd_wake (i2c_lcd);
+  uint32_t end = time_us_32();
+  idle_asleep = FALSE;
+  idle_key_wakes++;
+  wake_write_us = end - start;
+  wake_last_us = end - key_us;
+  wake_total_us += wake_last_us;
+  if (wake_last_us > wake_max_us) wake_max_us = wake_last_us;
+  return TRUE;
+  }
+
+/*===========================================================================
+ * display_task
+ * A one-shot task, started whenever a keystroke is queued, or when a 
+ * burst of keystrokes is due to end. Deal with all the keystrokes in 
+ * the queue.
+ * ========================================================================*/
+static void display_task (void *context)
+  {
+  (void)context;
+  // lcd_init_task() will start us again when the display is ready
+  if (!i2c_lcd_ready (i2c_lcd)) return;
+
+  while (key_tail != key_head)
+    {
+    KEY_EVENT *e = &key_queue[key_tail];
+    key_tail = (key_tail + 1) % KEY_QUEUE_SIZE;
+
+    // Any key wakes the display, and the one that does can be dropped
+    if (wake_for_key (e->time_us) && IDLE_SWALLOW_WAKE_KEY) continue;
+
+    // Ordinary characters might be part of a burst. Anything else --
+    //   including Enter, which scanners send at the end of a scan --
+    //   ends any burst that is in progress.
+    BOOL buffered = FALSE;
+    char c = kbd_to_ascii (e->code, e->flags);
+    BOOL glyph = c >= 32 && c < 127 && bind_state == BIND_IDLE
+      && kbd_binding (key_bindings, e->code, e->flags) == KEY_ACTION_NONE;
+    if (glyph)
+      buffered = burst_add (burst, e->dev, e->time_us, c);
+    else
+      burst_flush (burst);
+    if (buffered) continue;
+
+    handle_key (e->code, e->flags);
+    if (boot_first_key_shown_us == 0) boot_first_key_shown_us = time_us_32();
+
+    // Cursor movements, bindings and the like draw nothing, so aren't
+    //   counted. The key may have waited in the queue through several
+    //   passes of the main loop, so the time is from when it arrived.
+    if (!glyph) continue;
+    uint32_t latency = time_us_32() - e->time_us;
+    glyph_count++;
+    glyph_total_us += latency;
+    if (latency < glyph_min_us) glyph_min_us = latency;
+    if (latency > glyph_max_us) glyph_max_us = latency;
+    }
+
+  // Draw the final scrollback position, if it has moved
+  i2c_lcd_update (i2c_lcd);
+
+  // If a burst is in progress, come back when it is due to end
+  uint32_t now = time_us_32();
+  burst_check (burst, now);
+  uint32_t end_us;
+  if (burst_pending (burst, &end_us))
+    sched_start (display_task_id, end_us - now + 1);
+  }
+
+/*===========================================================================
+ * kbd_raw_key_down is called by the USB HID code whenever a
+ * key is pressed. The value 'code' does not take account of which
+ * modifiers are pressed -- call kbd_to_ascii() to deal wity that.
+ * ========================================================================*/
+void kbd_raw_key_down (int code, int flags)
+  {
+  int next = (key_head + 1) % KEY_QUEUE_SIZE;
+  if (next == key_tail)
+    {
+    keys_dropped++;
+    return;
+    }
+  key_queue[key_head].code = code;
+  key_queue[key_head].flags = flags;
+  key_queue[key_head].dev = usb_kbd_current_device();
+  key_queue[key_head].time_us = time_us_32();
+  if (boot_first_key_us == 0) boot_first_key_us = key_queue[key_head].time_us;
+  last_key_us = key_queue[key_head].time_us;
+  key_head = next;
+  sched_start (display_task_id, 0);
+  }
+
+/*===========================================================================
+ * app_init
+ * Set up the hardware and the tasks. This is separate from main() so that
+ * the host-side tools in tools/ can set up the program in the same way.
+ * ========================================================================*/
+void app_init (void)
+  {
+  stdio_init_all();
+
+  // Start capturing HID reports before the keyboard can be attached
+  memstat_begin (MEMSTAT_USB);
+  if (HID_TRACE_BYTES > 0) hid_trace_init (HID_TRACE_BYTES);
+
+  // Start the USB host first, so that the keyboard can enumerate while
+  //   the display is starting up. Keystrokes that arrive before the
+  //   display is ready wait in the key queue.
   usb_kbd_init();
+  memstat_end();
+  boot_usb_us = time_us_32();
+
+  // Create the display, using whichever bus it's connected to. It's
+  //   initialized a step at a time by lcd_init_task().
+  memstat_begin (MEMSTAT_DISPLAY);
+#if LCD_BUS == LCD_BUS_GPIO && LCD_GPIO_E2 >= 0
+  LCD_TRANSPORT *transport = lcd_transport_gpio_new_dual (LCD_GPIO_RS, 
+     LCD_GPIO_E, LCD_GPIO_E2, LCD_GPIO_D4, LCD_GPIO_BACKLIGHT);
+#elif LCD_BUS == LCD_BUS_GPIO
+  LCD_TRANSPORT *transport = lcd_transport_gpio_new (LCD_GPIO_RS, 
+     LCD_GPIO_E, LCD_GPIO_D4, LCD_GPIO_BACKLIGHT);
+#elif LCD_BUS == LCD_BUS_MOCK
+  LCD_TRANSPORT *transport = lcd_transport_mock_new();
+#elif LCD_I2C_DUAL
+  LCD_TRANSPORT *transport = lcd_transport_i2c_new_dual 
+     (PICO_DEFAULT_I2C_INSTANCE, I2C_LCD_ADDRESS, 
+     PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, I2C_BAUD);
+#else
+  LCD_TRANSPORT *transport = lcd_transport_i2c_new 
+     (PICO_DEFAULT_I2C_INSTANCE, I2C_LCD_ADDRESS, 
+     PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, I2C_BAUD);
+#endif
+  lcd_transport = transport;
+#if LCD_BUS == LCD_BUS_I2C
+  // Trace the display's I2C traffic from the start, so that its 
+  //   initialization is in the trace too
+  if (I2C_TRACE_BYTES > 0 && i2c_trace_init (I2C_TRACE_BYTES))
+    lcd_transport_i2c_set_trace (transport, TRUE);
+#endif
+  i2c_lcd = i2c_lcd_new_deferred (LCD_WIDTH, LCD_HEIGHT, transport,
+     SCROLLBACK_PAGES);
+
+  // The other consoles are only drawn in RAM until they are switched to
+  consoles[0] = i2c_lcd;
+  for (int i = 1; i < NUM_CONSOLES; i++)
+    consoles[i] = i2c_lcd_new_console (i2c_lcd, SCROLLBACK_PAGES);
+  for (int i = 0; i < NUM_CONSOLES; i++)
+    i2c_lcd_set_status_region (consoles[i], STATUS_ROWS, STATUS_AT_TOP);
+  memstat_end();
+
+#if JOURNAL_SECTORS > 0
+  // Put back the lines that were in the scrollback buffer before the
+  //   reset. This only reads flash, and doesn't touch the display.
+  //   The display never gets wider than LCD_WIDTH here; a program that
+  //   widened it with i2c_lcd_set_geometry() would create the journal
+  //   for I2C_LCD_MAX_WIDTH, or its wider lines would be cut short.
+  memstat_begin (MEMSTAT_JOURNAL);
+  journal = journal_new (LCD_WIDTH, JOURNAL_SECTORS, JOURNAL_RAM_LINES);
+  memstat_end();
+  journal_restore (journal, (SCROLLBACK_PAGES - 1) * LCD_HEIGHT, 
+     restore_line, NULL);
+  i2c_lcd_set_line_callback (i2c_lcd, journal_line, NULL);
+#endif
+
+  memstat_begin (MEMSTAT_KEYBOARD);
+  for (int i = 0; i < NUM_CONSOLES; i++)
+    line_edits[i] = line_edit_new (consoles[i], LINE_EDIT_MAX, 
+      LINE_EDIT_HISTORY);
+  line_edit = line_edits[0];
+  burst = burst_new (BURST_MAX_CHARS, BURST_GAP_US, burst_output, NULL);
+  memstat_end();
+  memstat_begin (MEMSTAT_OTHER);
+  mirror = mirror_new (i2c_lcd, MIRROR_MAX_BYTES, frame_write, NULL);
+  memstat_end();
 
-  // Loop, dispatching USB events to the handler and blinking the LED
+  // Have the stdio driver interrupt us when serial input arrives, 
+  //   so we don't have to poll for it.
+  stdio_set_chars_available_callback (chars_available, NULL);
+
+  // USB events are the most urgent, because the keyboard is waiting
+  //   for us to ask for the next report. The LED is the least urgent.
+  sched_add_polled ("usb", usb_task, NULL, 30, 0);
+  lcd_init_task_id = sched_add_oneshot ("lcd init", lcd_init_task, NULL, 
+    25, 0);
+  sched_start (lcd_init_task_id, 0);
+  display_task_id = sched_add_oneshot ("display", display_task, NULL, 20, 
+    DISPLAY_BUDGET_US);
+  sched_add_polled ("serial", serial_command_task, NULL, 10, 0);
+#if JOURNAL_SECTORS > 0
+  journal_task_id = sched_add_oneshot ("journal", journal_task, NULL, 5, 0);
+#endif
+  mirror_task_id = sched_add_oneshot ("mirror", mirror_task, NULL, 3, 0);
+  export_task_id = sched_add_oneshot ("export", export_task, NULL, 2, 0);
+  if (mirroring) start_mirror();
+  sched_add_periodic ("blink", blink_led_task, NULL, 1000000, 0, 0);
+  if (STATUS_ROWS > 0)
+    sched_add_periodic ("status", status_task, NULL, 1000000, 1, 0);
+  if (IDLE_SLEEP_MS > 0)
+    sched_add_periodic ("idle", idle_task, NULL, 1000000, 0, 0);
+
+  // Watch the main loop, and say what was stuck if the watchdog reset
+  //   us. This is done last, once the tasks have names, and so the 
+  //   start-up work doesn't count against the watchdog.
+  sched_set_hook (stall_stage);
+  stall_init (STALL_WATCHDOG_MS, STALL_BUDGET_US);
+  if (stall_last_reset()) print_stall_reset();
+  }
+
+/*===========================================================================
+ * app_ready
+ * TRUE once the program has finished starting up, and keystrokes will 
+ * appear on the display.
+ * ========================================================================*/
+bool app_ready (void)
+  {
+  return i2c_lcd_ready (i2c_lcd);
+  }
+
+/*===========================================================================
+ * app_poll
+ * One pass of the main loop. Returns the time at which the next pass
+ * is needed, if no interrupt arrives first.
+ * ========================================================================*/
+absolute_time_t app_poll (void)
+  {
+  stall_pass();
+  return sched_run();
+  }
+
+/*===========================================================================
+ * start here
+ * ========================================================================*/
+int main (void)
+  {
+  // Before anything else, so that the stacks are painted before they
+  //   are used
+  memstat_init();
+  app_init();
+
+  // Let pending interrupts, even disabled ones, count as events that 
+  //   wake the core from WFE. This closes the gap between checking for
+  //   work and going to sleep.
+  scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
+
+  // Run the tasks that are due. Between passes, the core sleeps until 
+  //   an interrupt arrives (USB, UART), or until the earliest time that
+  //   a task needs to run again. LOOP_MAX_SLEEP_MS is just a safety net,
+  //   in case a wake-up is ever missed.
   while (1) 
     {
-    usb_kbd_scan();
-    blink_led_task();
+    absolute_time_t next = app_poll();
+    absolute_time_t limit = make_timeout_time_ms (LOOP_MAX_SLEEP_MS);
+    if (absolute_time_diff_us (limit, next) > 0) next = limit;
+    stall_stage (STALL_ASLEEP);
+    best_effort_wfe_or_timeout (next);
     }
   }
-
@@ -0,0 +1,75 @@
+/*===========================================================================
+ * memstat/memstat.h
+ *
+ * How much of the RP2040's RAM the program uses: the static data, the
+ * heap (now, and the most it has ever taken), and the deepest each
+ * core's stack has reached. The heap taken by each part of the program
+ * while it starts up is recorded too, by bracketing the code that 
+ * creates it with memstat_begin() and memstat_end().
+ *
+ * Stack depth is found by painting: memstat_init() fills the unused
+ * part of each core's stack with a pattern, and memstat_get_stats() 
+ * looks for the lowest word that has been overwritten. So the depth is
+ * the deepest since start-up, interrupts included, not just the depth 
+ * at the moment. A stack that has been used right down to its limit may
+ * have gone further; the RP2040 doesn't stop it.
+ *
+ * The figures come from the linker's symbols and newlib's mallinfo(), 
+ * so they are only available on the device; elsewhere they are zero. 
+ * The static data of each module is in the linker's map file -- see
+ * tools/ram_map.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MEMSTAT_CORES 2
+
+typedef enum
+  {
+  MEMSTAT_DISPLAY = 0,  // The display and its consoles' scrollback
+  MEMSTAT_KEYBOARD,     // Line editors, burst detection
+  MEMSTAT_USB,          // USB host, HID trace
+  MEMSTAT_JOURNAL,
+  MEMSTAT_OTHER,
+  MEMSTAT_PARTS
+  } MEMSTAT_PART;
+
+typedef struct _MEMSTAT_STATS
+  {
+  uint32_t ram;             // Bytes of SRAM
+  uint32_t static_bytes;    // Everything below the heap: data and bss
+  uint32_t heap_limit;      // The most the heap can take
+  uint32_t heap_used;       // Allocated now
+  uint32_t heap_high;       // The most the heap has ever taken from RAM
+  uint32_t stack_size[MEMSTAT_CORES];
+  uint32_t stack_high[MEMSTAT_CORES];  // Deepest use; 0 if never used
+  uint32_t part_heap[MEMSTAT_PARTS];   // Allocated by each part
+  } MEMSTAT_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Paint the stacks. Call this first thing in main(), before the stack
+    has been used much. */
+extern void memstat_init (void);
+
+/** Count the heap allocated from now until memstat_end() as part of 
+    'part'. Calls can't be nested. */
+extern void memstat_begin (MEMSTAT_PART part);
+extern void memstat_end (void);
+
+extern const char *memstat_part_name (MEMSTAT_PART part);
+
+/** Bring the figures up to date. Looking for the stack depth reads each
+    stack, which takes a few microseconds per kilobyte. */
+extern const MEMSTAT_STATS *memstat_get_stats (void);
+
+#ifdef __cplusplus
+}
+#endif
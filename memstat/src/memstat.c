@@ -0,0 +1,138 @@
+/*===========================================================================
+ * memstat/memstat.c
+ *
+ * RAM use. See memstat.h.
+ *
+ * The layout is the one the Pico SDK's default linker script gives:
+ * static data from the start of RAM, then the heap, which can grow to
+ * __StackLimit (the end of the main 256kB). Core 0's stack is in the
+ * 4kB SCRATCH_Y bank, and core 1's in SCRATCH_X; each is nominally the
+ * size of its .stack_dummy section, counted down from its top.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <pico/stdlib.h>
+#include <memstat/memstat.h>
+
+#if PICO_ON_DEVICE
+#include <malloc.h>
+#include <hardware/regs/addressmap.h>
+
+// Symbols defined by the linker script
+extern char end[];
+extern char __StackLimit[];
+extern char __StackTop[], __StackBottom[];
+extern char __StackOneTop[], __StackOneBottom[];
+#endif
+
+// What an unused stack word holds
+#define MEMSTAT_PAINT 0x5AFE57ACU
+
+// Words just below the current stack pointer that are left unpainted,
+//   for the painting function's own frame
+#define MEMSTAT_MARGIN 64
+
+static MEMSTAT_STATS stats;
+static MEMSTAT_PART current_part;
+static uint32_t part_start;
+
+/*===========================================================================
+ * heap_in_use
+ * ========================================================================*/
+static uint32_t heap_in_use (void)
+  {
+#if PICO_ON_DEVICE
+  return (uint32_t)mallinfo().uordblks;
+#else
+  return 0;
+#endif
+  }
+
+#if PICO_ON_DEVICE
+/*===========================================================================
+ * paint
+ * Not inlined, so that its frame is below the caller's, out of the way
+ * of what it paints.
+ * ========================================================================*/
+static void __attribute__((noinline)) paint (uint32_t *from, uint32_t *to)
+  {
+  while (from < to) *from++ = MEMSTAT_PAINT;
+  }
+
+/*===========================================================================
+ * stack_depth
+ * The bytes of a stack that have ever been used: everything above the
+ * lowest word that isn't paint.
+ * ========================================================================*/
+static uint32_t stack_depth (const char *bottom, const char *top)
+  {
+  const uint32_t *p = (const uint32_t *)bottom;
+  while ((const char *)p < top && *p == MEMSTAT_PAINT) p++;
+  return (uint32_t)(top - (const char *)p);
+  }
+#endif
+
+/*===========================================================================
+ * memstat_init
+ * ========================================================================*/
+void memstat_init (void)
+  {
+#if PICO_ON_DEVICE
+  // Core 0 is running on its stack, so paint only what's below us.
+  //   Core 1's isn't in use yet, so all of it.
+  uint32_t here;
+  paint ((uint32_t *)__StackBottom, &here - MEMSTAT_MARGIN);
+  paint ((uint32_t *)__StackOneBottom, (uint32_t *)__StackOneTop);
+
+  stats.ram = SRAM_END - SRAM_BASE;
+  stats.static_bytes = (uint32_t)(end - (char *)SRAM_BASE);
+  stats.heap_limit = (uint32_t)(__StackLimit - end);
+  stats.stack_size[0] = (uint32_t)(__StackTop - __StackBottom);
+  stats.stack_size[1] = (uint32_t)(__StackOneTop - __StackOneBottom);
+#endif
+  }
+
+/*===========================================================================
+ * memstat_begin
+ * ========================================================================*/
+void memstat_begin (MEMSTAT_PART part)
+  {
+  current_part = part;
+  part_start = heap_in_use();
+  }
+
+/*===========================================================================
+ * memstat_end
+ * ========================================================================*/
+void memstat_end (void)
+  {
+  stats.part_heap[current_part] += heap_in_use() - part_start;
+  }
+
+/*===========================================================================
+ * memstat_part_name
+ * ========================================================================*/
+const char *memstat_part_name (MEMSTAT_PART part)
+  {
+  static const char *const names[MEMSTAT_PARTS] =
+    { "display", "keyboard", "USB", "journal", "other" };
+  return part < MEMSTAT_PARTS ? names[part] : "?";
+  }
+
+/*===========================================================================
+ * memstat_get_stats
+ * ========================================================================*/
+const MEMSTAT_STATS *memstat_get_stats (void)
+  {
+#if PICO_ON_DEVICE
+  struct mallinfo mi = mallinfo();
+  stats.heap_used = (uint32_t)mi.uordblks;
+  // newlib never gives memory back to sbrk(), so the arena is as big as
+  //   the heap has ever been
+  stats.heap_high = (uint32_t)mi.arena;
+  stats.stack_high[0] = stack_depth (__StackBottom, __StackTop);
+  stats.stack_high[1] = stack_depth (__StackOneBottom, __StackOneTop);
+#endif
+  return &stats;
+  }
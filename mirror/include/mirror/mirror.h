@@ -0,0 +1,85 @@
+/*===========================================================================
+ * mirror/mirror.h
+ *
+ * Mirroring of the display to a host, over the serial console. The
+ * driver keeps a copy of what the panel shows (see
+ * i2c_lcd_get_panel_row()), so mirroring needs nothing from the panel
+ * itself: mirror_poll() compares the driver's copy with what it last
+ * sent, and writes out only the differences. It is meant to be called
+ * from a low-priority task, every few tens of milliseconds, so however
+ * fast the display changes, the changes in between are sent as one
+ * frame. A frame is never longer than max_bytes; what doesn't fit is
+ * sent by the next call.
+ *
+ * Every frame is a line of printable ASCII, starting with '@', so that
+ * frames can share the serial console with other output. There are two
+ * kinds:
+ *
+ *   @K<seq> <rows> <cols>
+ *     A key frame. The viewer should make its screen this size, and
+ *     blank it. Update frames that follow fill it in.
+ *
+ *   @U<seq> <flags> <row> <col>[ <row>,<col>,<n>:<text>]...
+ *     An update. flags is a hex combination of the I2C_LCD_PANEL_ flags
+ *     (backlight, display on, cursor on, blink). row and col are the
+ *     cursor position, or -1 -1 if the cursor is not on the screen.
+ *     Each <row>,<col>,<n>:<text> puts n characters on the screen at
+ *     row, col. In text, characters outside the printable ASCII range,
+ *     and the backslash itself, are written as \xHH; anything else
+ *     stands for itself, spaces included.
+ *
+ * seq goes up by one for every frame, and wraps from 255 to 0. If a
+ * viewer sees a gap, it has missed something, and what it shows can't
+ * be trusted until the next key frame.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <i2c_lcd/i2c_lcd.h>
+
+// The smallest useful frame: a header, and one escaped character
+#define MIRROR_MIN_BYTES 48
+
+typedef struct _MIRROR MIRROR;
+
+// Called with each frame, including its final newline
+typedef void (*MIRROR_WRITE_FN) (const char *s, int n, void *context);
+
+typedef struct _MIRROR_STATS
+  {
+  uint32_t frames;        // Frames written, including key frames
+  uint32_t key_frames;
+  uint32_t bytes;         // Bytes written
+  uint32_t cells;         // Character cells sent
+  uint32_t split_frames;  // Frames cut short by max_bytes
+  } MIRROR_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Create a mirror of the panel that lcd is shown on -- which console
+    doesn't matter. Frames are handed to write, and are never longer
+    than max_bytes (or MIRROR_MIN_BYTES, if that is more). The first
+    call to mirror_poll() sends a key frame. */
+extern MIRROR *mirror_new (const I2C_LCD *lcd, int max_bytes,
+                 MIRROR_WRITE_FN write, void *context);
+extern void    mirror_destroy (MIRROR *self);
+
+/** Send a key frame, and then the whole screen, on the next call to
+    mirror_poll(). */
+extern void    mirror_key_frame (MIRROR *self);
+
+/** Write one frame, if anything has changed since the last one. Returns
+    TRUE if there is more to send, because the frame was cut short. */
+extern BOOL    mirror_poll (MIRROR *self);
+
+extern const MIRROR_STATS *mirror_get_stats (const MIRROR *self);
+
+#ifdef __cplusplus
+}
+#endif
+
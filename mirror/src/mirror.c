@@ -0,0 +1,236 @@
+/*===========================================================================
+ * mirror/mirror.c
+ *
+ * Mirroring of the display to a host. See mirror.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mirror/mirror.h>
+
+// Runs of unchanged characters shorter than this are sent again, rather
+//   than starting a new cell range, which costs about this many bytes
+#define MIRROR_GAP 6
+
+struct _MIRROR
+  {
+  const I2C_LCD *lcd;
+  int max_bytes;
+  MIRROR_WRITE_FN write;
+  void *context;
+  int rows;
+  int cols;
+  char *sent;           // What the viewer has been sent, rows * cols
+  char *row;            // One row of the panel, with room for a null
+  char *frame;          // The frame being built
+  int len;              // Bytes in frame
+  uint8_t seq;
+  BOOL key_frame;       // A key frame is due
+  BOOL more;            // The last frame was cut short
+  uint32_t changes;     // The panel's change count, when last sent
+  int flags;            // Flags and cursor, as last sent
+  int cursor_row;
+  int cursor_col;
+  MIRROR_STATS stats;
+  };
+
+/*===========================================================================
+ * escaped_len
+ * ========================================================================*/
+static int escaped_len (unsigned char c)
+  {
+  return (c < 32 || c > 126 || c == '\\') ? 4 : 1;
+  }
+
+/*===========================================================================
+ * append_escaped
+ * ========================================================================*/
+static void append_escaped (MIRROR *self, unsigned char c)
+  {
+  if (escaped_len (c) == 1)
+    self->frame[self->len++] = (char)c;
+  else
+    self->len += sprintf (self->frame + self->len, "\\x%02X", c);
+  }
+
+/*===========================================================================
+ * emit
+ * ========================================================================*/
+static void emit (MIRROR *self)
+  {
+  self->frame[self->len++] = '\n';
+  self->write (self->frame, self->len, self->context);
+  self->stats.frames++;
+  self->stats.bytes += (uint32_t)self->len;
+  self->seq++;
+  }
+
+/*===========================================================================
+ * add_range
+ * Add as much as will fit of the n characters at row, col. Returns the
+ * number of characters added.
+ * ========================================================================*/
+static int add_range (MIRROR *self, int row, int col, int n)
+  {
+  char header[24];
+  int header_len = snprintf (header, sizeof (header), " %d,%d,%d:",
+    row, col, n);
+  // Leave room for the newline
+  int room = self->max_bytes - 1 - self->len - header_len;
+  int k = 0, text_len = 0;
+  while (k < n)
+    {
+    int l = escaped_len ((unsigned char)self->row[col + k]);
+    if (text_len + l > room) break;
+    text_len += l;
+    k++;
+    }
+  if (k == 0) return 0;
+  self->len += sprintf (self->frame + self->len, " %d,%d,%d:", row, col, k);
+  for (int i = 0; i < k; i++)
+    append_escaped (self, (unsigned char)self->row[col + i]);
+  memcpy (self->sent + row * self->cols + col, self->row + col, k);
+  self->stats.cells += (uint32_t)k;
+  return k;
+  }
+
+/*===========================================================================
+ * fit_display
+ * Make room for the display at its current size, and start again with a
+ * key frame if it has changed.
+ * ========================================================================*/
+static void fit_display (MIRROR *self)
+  {
+  int rows = i2c_lcd_get_panel_rows (self->lcd);
+  int cols = i2c_lcd_get_width (self->lcd);
+  if (self->sent && rows == self->rows && cols == self->cols) return;
+  self->rows = rows;
+  self->cols = cols;
+  free (self->sent);
+  free (self->row);
+  self->sent = malloc (rows * cols);
+  self->row = malloc (cols + 1);
+  self->key_frame = TRUE;
+  }
+
+/*===========================================================================
+ * mirror_new
+ * ========================================================================*/
+MIRROR *mirror_new (const I2C_LCD *lcd, int max_bytes, MIRROR_WRITE_FN write,
+          void *context)
+  {
+  MIRROR *self = malloc (sizeof (MIRROR));
+  memset (self, 0, sizeof (MIRROR));
+  self->lcd = lcd;
+  self->max_bytes = max_bytes < MIRROR_MIN_BYTES ? MIRROR_MIN_BYTES
+    : max_bytes;
+  self->write = write;
+  self->context = context;
+  self->frame = malloc (self->max_bytes + 1);
+  fit_display (self);
+  return self;
+  }
+
+/*===========================================================================
+ * mirror_key_frame
+ * ========================================================================*/
+void mirror_key_frame (MIRROR *self)
+  {
+  self->key_frame = TRUE;
+  }
+
+/*===========================================================================
+ * mirror_poll
+ * ========================================================================*/
+BOOL mirror_poll (MIRROR *self)
+  {
+  fit_display (self);
+  if (self->key_frame)
+    {
+    self->len = sprintf (self->frame, "@K%u %d %d", (unsigned)self->seq,
+      self->rows, self->cols);
+    emit (self);
+    self->stats.key_frames++;
+    memset (self->sent, ' ', self->rows * self->cols);
+    // Make sure the flags and cursor go in the next update
+    self->flags = -1;
+    self->key_frame = FALSE;
+    self->more = TRUE;
+    return TRUE;
+    }
+
+  uint32_t changes = i2c_lcd_panel_changes (self->lcd);
+  if (!self->more && changes == self->changes) return FALSE;
+  self->changes = changes;
+
+  int flags = i2c_lcd_get_panel_flags (self->lcd);
+  int cursor_row, cursor_col;
+  i2c_lcd_get_panel_cursor (self->lcd, &cursor_row, &cursor_col);
+  self->len = sprintf (self->frame, "@U%u %X %d %d", (unsigned)self->seq,
+    flags, cursor_row, cursor_col);
+  BOOL changed = flags != self->flags || cursor_row != self->cursor_row
+    || cursor_col != self->cursor_col;
+  self->flags = flags;
+  self->cursor_row = cursor_row;
+  self->cursor_col = cursor_col;
+
+  // Send the ranges that differ from what we sent last, joining up
+  //   ranges with short gaps between them
+  BOOL full = FALSE;
+  for (int r = 0; r < self->rows && !full; r++)
+    {
+    i2c_lcd_get_panel_row (self->lcd, r, self->row);
+    const char *sent = self->sent + r * self->cols;
+    int col = 0;
+    while (col < self->cols && !full)
+      {
+      if (sent[col] == self->row[col])
+        {
+        col++;
+        continue;
+        }
+      int end = col + 1, same = 0;
+      for (int c = end; c < self->cols && same < MIRROR_GAP; c++)
+        {
+        if (sent[c] == self->row[c])
+          same++;
+        else
+          {
+          end = c + 1;
+          same = 0;
+          }
+        }
+      int n = add_range (self, r, col, end - col);
+      if (n > 0) changed = TRUE;
+      if (n < end - col) full = TRUE;
+      col += n;
+      }
+    }
+
+  self->more = full;
+  if (full) self->stats.split_frames++;
+  if (changed) emit (self);
+  return full;
+  }
+
+/*===========================================================================
+ * mirror_get_stats
+ * ========================================================================*/
+const MIRROR_STATS *mirror_get_stats (const MIRROR *self)
+  {
+  return &self->stats;
+  }
+
+/*===========================================================================
+ * mirror_destroy
+ * ========================================================================*/
+void mirror_destroy (MIRROR *self)
+  {
+  free (self->sent);
+  free (self->row);
+  free (self->frame);
+  free (self);
+  }
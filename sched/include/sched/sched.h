@@ -0,0 +1,106 @@
+/*===========================================================================
+ * sched/sched.h
+ *
+ * A simple cooperative scheduler for the main loop. Tasks are functions
+ * that run to completion -- the scheduler can't interrupt them. There
+ * are three kinds of task:
+ *
+ * - polled tasks (period zero) run on every pass of the main loop, that
+ *   is, whenever the core wakes up. They are used for things that are
+ *   driven by interrupts, like USB.
+ * - periodic tasks run every 'period' microseconds.
+ * - one-shot tasks run once, 'delay' microseconds after they are
+ *   started, and then stay idle until started again.
+ *
+ * When several tasks are due, they run in order of priority, highest
+ * first. Once the tasks run in a pass have used up the time slice
+ * (SCHED_SLICE_US), no more tasks are started, and the remaining ones
+ * wait for the next pass.
+ *
+ * For each task, the scheduler records the number of calls, and the
+ * total and worst-case execution times. A task can also be given a
+ * budget -- calls that take longer are counted as overruns. A hook can
+ * be told as each task starts and returns, so that something else -- a
+ * watchdog, say -- can see which task is running.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <pico/stdlib.h>
+
+// Maximum number of tasks. Tasks are never removed, so this only
+//   needs to be as large as the number the program creates.
+#define SCHED_MAX_TASKS 12
+
+// The time, in microseconds, after which the scheduler will not start
+//   any more tasks in the current pass.
+#define SCHED_SLICE_US 20000
+
+typedef void (*SCHED_FN) (void *context);
+
+// Called with a task's ID as the task starts, and with -1 as it returns
+typedef void (*SCHED_HOOK) (int id);
+
+typedef struct _SCHED_STATS
+  {
+  uint32_t calls;
+  uint32_t overruns;
+  uint32_t worst_us;
+  uint64_t total_us;
+  } SCHED_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Add a task that runs every time the core wakes up. Returns a task
+    ID, or -1 if there are too many tasks. budget_us may be zero, for
+    no budget. */
+extern int  sched_add_polled (const char *name, SCHED_FN fn, void *context,
+              int priority, uint32_t budget_us);
+
+/** Add a task that runs every period_us microseconds, starting
+    period_us from now. */
+extern int  sched_add_periodic (const char *name, SCHED_FN fn,
+              void *context, uint32_t period_us, int priority,
+              uint32_t budget_us);
+
+/** Add a one-shot task. It is idle until started by sched_start(). */
+extern int  sched_add_oneshot (const char *name, SCHED_FN fn,
+              void *context, int priority, uint32_t budget_us);
+
+/** Make a task due delay_us from now. For a one-shot task, this
+    starts (or restarts) it. For a periodic task, this brings forward
+    its next run. Interrupt handlers should not call this -- they should
+    just set a flag and let the core wake up. */
+extern void sched_start (int id, uint32_t delay_us);
+
+/** Stop a one-shot task that has been started but has not yet run. */
+extern void sched_cancel (int id);
+
+/** Run the tasks that are due, in order of priority. Returns the time
+    at which the next task is due -- this might be in the past, if the
+    time slice ran out. */
+extern absolute_time_t sched_run (void);
+
+extern const SCHED_STATS *sched_get_stats (int id);
+
+/** The name a task was added with, or "?" if there is no such task. */
+extern const char *sched_task_name (int id);
+
+/** Set the hook that is called around each task, or NULL for none. */
+extern void sched_set_hook (SCHED_HOOK hook);
+
+/** Write a table of task statistics to stdout. */
+extern void sched_print_stats (void);
+
+extern void sched_reset_stats (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
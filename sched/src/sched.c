@@ -0,0 +1,242 @@
+/*===========================================================================
+ * sched/sched.c
+ *
+ * A simple cooperative scheduler. See sched.h.
+ *
+ * There are only ever a handful of tasks, so the scheduler just looks
+ * through all of them to find the next one to run, rather than keeping
+ * them sorted.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <sched/sched.h>
+
+typedef enum
+  {
+  SCHED_POLLED = 0,
+  SCHED_PERIODIC,
+  SCHED_ONESHOT
+  } SCHED_KIND;
+
+typedef struct _SCHED_TASK
+  {
+  const char *name;
+  SCHED_FN fn;
+  void *context;
+  SCHED_KIND kind;
+  int priority;
+  uint32_t period_us;
+  uint32_t budget_us;
+  bool armed;
+  absolute_time_t due;
+  SCHED_STATS stats;
+  } SCHED_TASK;
+
+static SCHED_TASK tasks[SCHED_MAX_TASKS];
+static int num_tasks = 0;
+static SCHED_HOOK hook = NULL;
+
+/*===========================================================================
+ * add_task
+ * ========================================================================*/
+static int add_task (const char *name, SCHED_FN fn, void *context,
+      SCHED_KIND kind, uint32_t period_us, int priority, uint32_t budget_us)
+  {
+  if (num_tasks >= SCHED_MAX_TASKS) return -1;
+  SCHED_TASK *t = &tasks[num_tasks];
+  memset (t, 0, sizeof (SCHED_TASK));
+  t->name = name;
+  t->fn = fn;
+  t->context = context;
+  t->kind = kind;
+  t->period_us = period_us;
+  t->priority = priority;
+  t->budget_us = budget_us;
+  t->armed = (kind == SCHED_PERIODIC);
+  t->due = make_timeout_time_us (period_us);
+  return num_tasks++;
+  }
+
+/*===========================================================================
+ * is_due
+ * ========================================================================*/
+static bool is_due (const SCHED_TASK *t, absolute_time_t now)
+  {
+  if (t->kind == SCHED_POLLED) return true;
+  return t->armed && absolute_time_diff_us (t->due, now) >= 0;
+  }
+
+/*===========================================================================
+ * run_task
+ * ========================================================================*/
+static void run_task (SCHED_TASK *t)
+  {
+  switch (t->kind)
+    {
+    case SCHED_ONESHOT:
+      // Disarm before running, so the task can restart itself
+      t->armed = false;
+      break;
+    case SCHED_PERIODIC:
+      t->due = delayed_by_us (t->due, t->period_us);
+      // Don't try to catch up on missed runs
+      if (time_reached (t->due)) t->due = make_timeout_time_us (t->period_us);
+      break;
+    default:
+      break;
+    }
+
+  if (hook) hook ((int)(t - tasks));
+  uint32_t start = time_us_32();
+  t->fn (t->context);
+  uint32_t elapsed = time_us_32() - start;
+  if (hook) hook (-1);
+
+  t->stats.calls++;
+  t->stats.total_us += elapsed;
+  if (elapsed > t->stats.worst_us) t->stats.worst_us = elapsed;
+  if (t->budget_us && elapsed > t->budget_us) t->stats.overruns++;
+  }
+
+/*===========================================================================
+ * sched_add_polled
+ * ========================================================================*/
+int sched_add_polled (const char *name, SCHED_FN fn, void *context,
+      int priority, uint32_t budget_us)
+  {
+  return add_task (name, fn, context, SCHED_POLLED, 0, priority, budget_us);
+  }
+
+/*===========================================================================
+ * sched_add_periodic
+ * ========================================================================*/
+int sched_add_periodic (const char *name, SCHED_FN fn, void *context,
+      uint32_t period_us, int priority, uint32_t budget_us)
+  {
+  return add_task (name, fn, context, SCHED_PERIODIC, period_us, priority,
+    budget_us);
+  }
+
+/*===========================================================================
+ * sched_add_oneshot
+ * ========================================================================*/
+int sched_add_oneshot (const char *name, SCHED_FN fn, void *context,
+      int priority, uint32_t budget_us)
+  {
+  return add_task (name, fn, context, SCHED_ONESHOT, 0, priority, budget_us);
+  }
+
+/*===========================================================================
+ * sched_start
+ * ========================================================================*/
+void sched_start (int id, uint32_t delay_us)
+  {
+  if (id < 0 || id >= num_tasks) return;
+  SCHED_TASK *t = &tasks[id];
+  absolute_time_t due = make_timeout_time_us (delay_us);
+  // Starting a task that is already pending only ever brings it forward
+  if (t->armed && absolute_time_diff_us (t->due, due) > 0) return;
+  t->due = due;
+  t->armed = true;
+  }
+
+/*===========================================================================
+ * sched_cancel
+ * ========================================================================*/
+void sched_cancel (int id)
+  {
+  if (id < 0 || id >= num_tasks) return;
+  if (tasks[id].kind == SCHED_ONESHOT) tasks[id].armed = false;
+  }
+
+/*===========================================================================
+ * sched_run
+ * ========================================================================*/
+absolute_time_t sched_run (void)
+  {
+  absolute_time_t now = get_absolute_time();
+  uint32_t pass_start = time_us_32();
+  bool ran[SCHED_MAX_TASKS] = { false };
+
+  while (time_us_32() - pass_start < SCHED_SLICE_US)
+    {
+    int best = -1;
+    for (int i = 0; i < num_tasks; i++)
+      {
+      if (ran[i] || !is_due (&tasks[i], now)) continue;
+      if (best < 0 || tasks[i].priority > tasks[best].priority) best = i;
+      }
+    if (best < 0) break;
+    ran[best] = true;
+    run_task (&tasks[best]);
+    }
+
+  // Tasks that were due, but didn't get to run because the time slice
+  //   ran out, are still due now, and will make the result a time
+  //   in the past.
+  absolute_time_t next = at_the_end_of_time;
+  for (int i = 0; i < num_tasks; i++)
+    {
+    const SCHED_TASK *t = &tasks[i];
+    if (t->kind == SCHED_POLLED || !t->armed) continue;
+    if (absolute_time_diff_us (t->due, next) > 0) next = t->due;
+    }
+  return next;
+  }
+
+/*===========================================================================
+ * sched_get_stats
+ * ========================================================================*/
+const SCHED_STATS *sched_get_stats (int id)
+  {
+  if (id < 0 || id >= num_tasks) return NULL;
+  return &tasks[id].stats;
+  }
+
+/*===========================================================================
+ * sched_task_name
+ * ========================================================================*/
+const char *sched_task_name (int id)
+  {
+  if (id < 0 || id >= num_tasks) return "?";
+  return tasks[id].name;
+  }
+
+/*===========================================================================
+ * sched_set_hook
+ * ========================================================================*/
+void sched_set_hook (SCHED_HOOK fn)
+  {
+  hook = fn;
+  }
+
+/*===========================================================================
+ * sched_print_stats
+ * ========================================================================*/
+void sched_print_stats (void)
+  {
+  printf ("%-10s %8s %12s %8s %8s %8s\n", "task", "calls", "total us",
+    "mean us", "worst us", "overruns");
+  for (int i = 0; i < num_tasks; i++)
+    {
+    const SCHED_STATS *s = &tasks[i].stats;
+    printf ("%-10s %8lu %12llu %8lu %8lu %8lu\n", tasks[i].name,
+      (unsigned long)s->calls, (unsigned long long)s->total_us,
+      (unsigned long)(s->calls ? s->total_us / s->calls : 0),
+      (unsigned long)s->worst_us, (unsigned long)s->overruns);
+    }
+  }
+
+/*===========================================================================
+ * sched_reset_stats
+ * ========================================================================*/
+void sched_reset_stats (void)
+  {
+  for (int i = 0; i < num_tasks; i++)
+    memset (&tasks[i].stats, 0, sizeof (SCHED_STATS));
+  }
+
@@ -0,0 +1,92 @@
+/*===========================================================================
+ * stall/stall.h
+ *
+ * Watching the main loop for stalls. stall_init() arms the RP2040's
+ * hardware watchdog, and each pass of the main loop feeds it, in
+ * stall_pass(). If a pass ever takes longer than the watchdog's timeout
+ * -- because something is stuck in a loop, or waiting for hardware that
+ * never answers -- the RP2040 resets.
+ *
+ * Each pass is made of stages: the scheduler's tasks, the time between
+ * them, and the sleep between passes. stall_stage() is called as each
+ * stage starts, and times the one that has just ended. Stages that take
+ * longer than a budget are counted, and the most recent of them kept.
+ *
+ * All of this, including the stage running now, is kept in a record in
+ * RAM that the C runtime doesn't clear at start-up. So, after a
+ * watchdog reset, the record says what the program was doing when it
+ * stopped, and what was slow in the time before. stall_init() looks for
+ * it, and keeps a copy, for stall_last_reset(), before starting a new
+ * one.
+ *
+ * The record is updated with a few stores per task, so watching costs
+ * next to nothing.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Stages that are not tasks. A task's stage is its scheduler ID.
+#define STALL_LOOP   -1  // The main loop, between tasks
+#define STALL_ASLEEP -2  // Waiting for an interrupt, between passes
+
+// The number of over-budget stages kept in the record
+#define STALL_HISTORY 8
+
+typedef struct _STALL_EVENT
+  {
+  int32_t stage;
+  uint32_t us;     // How long it took
+  uint32_t at_ms;  // When it ended, in milliseconds since start-up
+  } STALL_EVENT;
+
+typedef struct _STALL_RECORD
+  {
+  uint32_t magic;
+  int32_t stage;           // The stage running now
+  uint32_t stage_start_us;
+  uint32_t fed_us;         // When the watchdog was last fed
+  uint32_t passes;
+  uint32_t slow;           // Stages that took longer than the budget
+  uint32_t worst_us;       // The longest stage, and which it was
+  int32_t worst_stage;
+  STALL_EVENT recent[STALL_HISTORY]; // The next goes in slow % HISTORY
+  uint32_t resets;         // Watchdog resets since the power came on
+  uint32_t timeout_ms;     // The watchdog's timeout
+  uint32_t check;          // ~magic
+  } STALL_RECORD;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Look for a record left by a watchdog reset, start a new one, and
+    arm the watchdog with a timeout of timeout_ms (zero to leave it
+    off; the RP2040 can manage no more than about 8000). Stages longer
+    than budget_us are recorded. */
+extern void stall_init (uint32_t timeout_ms, uint32_t budget_us);
+
+/** Feed the watchdog. Call this at the start of each pass of the main
+    loop. */
+extern void stall_pass (void);
+
+/** Note that 'stage' has started: a task's ID, or STALL_LOOP or
+    STALL_ASLEEP. The stage that has just ended is timed, and recorded
+    if it went over budget, unless it was sleep. This fits the
+    scheduler's hook, for which task -1 means no task. */
+extern void stall_stage (int stage);
+
+extern const STALL_RECORD *stall_get_record (void);
+
+/** The record as it was when the watchdog last reset the RP2040, or
+    NULL if the last reset wasn't the watchdog's. */
+extern const STALL_RECORD *stall_last_reset (void);
+
+extern void stall_reset_stats (void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,138 @@
+/*===========================================================================
+ * stall/stall.c
+ *
+ * Watching the main loop for stalls. See stall.h.
+ *
+ * The record is in the .uninitialized_data section, which the Pico
+ * SDK's start-up code neither loads nor zeroes, and which a watchdog
+ * reset doesn't touch. At power-on it holds whatever the RAM came up
+ * with, so it is only believed if its magic number and check word are
+ * both right.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/watchdog.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <stall/stall.h>
+
+#define STALL_MAGIC 0x57A11ED5U
+
+// The RP2040's watchdog counter runs out at a little over 8 seconds
+#define STALL_MAX_TIMEOUT_MS 8000
+
+static STALL_RECORD __uninitialized_ram (record);
+static STALL_RECORD last;
+static BOOL have_last = FALSE;
+static uint32_t budget;
+
+/*===========================================================================
+ * record_valid
+ * ========================================================================*/
+static BOOL record_valid (void)
+  {
+  return record.magic == STALL_MAGIC && record.check == ~STALL_MAGIC;
+  }
+
+/*===========================================================================
+ * stall_init
+ * ========================================================================*/
+void stall_init (uint32_t timeout_ms, uint32_t budget_us)
+  {
+  uint32_t resets = 0;
+  have_last = FALSE;
+  if (record_valid())
+    {
+    resets = record.resets;
+    if (watchdog_caused_reboot())
+      {
+      last = record;
+      have_last = TRUE;
+      resets++;
+      }
+    }
+
+  if (timeout_ms > STALL_MAX_TIMEOUT_MS) timeout_ms = STALL_MAX_TIMEOUT_MS;
+  budget = budget_us;
+  memset (&record, 0, sizeof (record));
+  record.stage = STALL_LOOP;
+  record.stage_start_us = time_us_32();
+  record.fed_us = record.stage_start_us;
+  record.worst_stage = STALL_LOOP;
+  record.resets = resets;
+  record.timeout_ms = timeout_ms;
+  record.magic = STALL_MAGIC;
+  record.check = ~STALL_MAGIC;
+
+  // Paused while a debugger has the core stopped, or every breakpoint
+  //   would reset it
+  if (timeout_ms > 0) watchdog_enable (timeout_ms, TRUE);
+  }
+
+/*===========================================================================
+ * stall_pass
+ * ========================================================================*/
+void stall_pass (void)
+  {
+  if (record.timeout_ms > 0) watchdog_update();
+  record.passes++;
+  stall_stage (STALL_LOOP);
+  record.fed_us = record.stage_start_us;
+  }
+
+/*===========================================================================
+ * stall_stage
+ * ========================================================================*/
+void stall_stage (int stage)
+  {
+  uint32_t now = time_us_32();
+  uint32_t elapsed = now - record.stage_start_us;
+  int ended = record.stage;
+  record.stage = stage;
+  record.stage_start_us = now;
+  if (ended == STALL_ASLEEP) return;
+
+  if (elapsed > record.worst_us)
+    {
+    record.worst_us = elapsed;
+    record.worst_stage = ended;
+    }
+  if (budget && elapsed > budget)
+    {
+    STALL_EVENT *e = &record.recent[record.slow % STALL_HISTORY];
+    e->stage = ended;
+    e->us = elapsed;
+    e->at_ms = (uint32_t)(time_us_64() / 1000);
+    record.slow++;
+    }
+  }
+
+/*===========================================================================
+ * stall_get_record
+ * ========================================================================*/
+const STALL_RECORD *stall_get_record (void)
+  {
+  return &record;
+  }
+
+/*===========================================================================
+ * stall_last_reset
+ * ========================================================================*/
+const STALL_RECORD *stall_last_reset (void)
+  {
+  return have_last ? &last : NULL;
+  }
+
+/*===========================================================================
+ * stall_reset_stats
+ * ========================================================================*/
+void stall_reset_stats (void)
+  {
+  record.passes = 0;
+  record.slow = 0;
+  record.worst_us = 0;
+  record.worst_stage = STALL_LOOP;
+  memset (record.recent, 0, sizeof (record.recent));
+  }
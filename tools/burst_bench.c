@@ -0,0 +1,209 @@
+/*===========================================================================
+ * tools/burst_bench.c
+ *
+ * A benchmark for barcode-scanner burst handling. It simulates a scanner
+ * typing bursts of characters (by default, 100 characters at one report
+ * per millisecond, followed by Enter), pushes the reports through the
+ * firmware on the simulated Pico, and checks that every burst arrives on
+ * the display intact.
+ *
+ * The simulation models the one way that characters can be lost on a
+ * real device: a scanner can only hold a few reports while it waits for
+ * the host to ask for the next one. The firmware asks for the next
+ * report only when its main loop gets round to the USB task, so if
+ * the display holds up the main loop for too long, the scanner's queue
+ * overflows. The depth of the scanner's queue is set with -f.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pico/stdlib.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include "config.h"
+#include "replay.h"
+
+// Defined in main.c
+extern I2C_LCD *i2c_lcd;
+extern absolute_time_t app_poll (void);
+
+typedef struct _SCAN_REPORT
+  {
+  uint64_t time_us;
+  uint8_t data[8];
+  } SCAN_REPORT;
+
+/*===========================================================================
+ * char_to_report
+ * Fill in a boot keyboard report for an alphanumeric character.
+ * ========================================================================*/
+static void char_to_report (char c, uint8_t *data)
+  {
+  memset (data, 0, 8);
+  if (c >= 'a' && c <= 'z')
+    data[2] = 0x04 + (c - 'a');
+  else if (c >= 'A' && c <= 'Z')
+    {
+    data[0] = 0x02; // Left shift
+    data[2] = 0x04 + (c - 'A');
+    }
+  else if (c >= '1' && c <= '9')
+    data[2] = 0x1E + (c - '1');
+  else if (c == '0')
+    data[2] = 0x27;
+  else if (c == '\r')
+    data[2] = 0x28;
+  }
+
+/*===========================================================================
+ * screen_text
+ * All the text in the scrollback buffer, run together. Because the
+ * display wraps, a long line reads continuously across rows.
+ * ========================================================================*/
+static char *screen_text (void)
+  {
+  int lines = i2c_lcd_scrollback_lines (i2c_lcd);
+  int width = i2c_lcd_get_width (i2c_lcd);
+  char *text = malloc (lines * width + 1);
+  for (int i = 0; i < lines; i++)
+    i2c_lcd_get_scrollback_line (i2c_lcd, i, text + i * width);
+  return text;
+  }
+
+/*===========================================================================
+ * usage
+ * ========================================================================*/
+static void usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [-n bursts] [-l length] [-i interval_us] "
+    "[-f fifo] [-g gap_ms]\n", argv0);
+  fprintf (stderr, "  -n  number of bursts (default 20)\n");
+  fprintf (stderr, "  -l  characters per burst (default 100)\n");
+  fprintf (stderr, "  -i  time between reports, us (default 1000)\n");
+  fprintf (stderr, "  -f  reports the scanner can queue (default 2)\n");
+  fprintf (stderr, "  -g  time between bursts, ms (default 500)\n");
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int bursts = 20, length = 100, fifo = 2;
+  uint32_t interval_us = 1000, gap_ms = 500;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:l:i:f:g:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'n': bursts = atoi (optarg); break;
+      case 'l': length = atoi (optarg); break;
+      case 'i': interval_us = (uint32_t)atoi (optarg); break;
+      case 'f': fifo = atoi (optarg); break;
+      case 'g': gap_ms = (uint32_t)atoi (optarg); break;
+      default: usage (argv[0]); return 1;
+      }
+    }
+
+  replay_init_firmware();
+  host_lcd_reset_stats();
+  srand (1);
+
+  static const char alnum[] = "abcdefghijklmnopqrstuvwxyz"
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  int max_reports = 2 * (length + 1);
+  SCAN_REPORT *reports = malloc (max_reports * sizeof (SCAN_REPORT));
+  char *expected = malloc (length + 1);
+
+  unsigned long lost = 0, intact = 0;
+  uint64_t worst_wait = 0, busy = 0;
+  uint64_t wall_start = replay_wall_us();
+
+  for (int b = 0; b < bursts; b++)
+    {
+    // Make up a burst: a key-down and a key-up report for each
+    //   character, then Enter
+    for (int i = 0; i < length; i++)
+      expected[i] = alnum[rand() % (sizeof (alnum) - 1)];
+    expected[length] = 0;
+    uint64_t t = time_us_64() + (uint64_t)gap_ms * 1000;
+    int n = 0;
+    for (int i = 0; i <= length; i++)
+      {
+      reports[n].time_us = t;
+      char_to_report (i < length ? expected[i] : '\r', reports[n].data);
+      t += interval_us;
+      n++;
+      reports[n].time_us = t;
+      memset (reports[n].data, 0, 8);
+      t += interval_us;
+      n++;
+      }
+
+    // Deliver the reports. Each pass of the firmware's main loop can
+    //   take one report from the scanner. Reports that the scanner
+    //   can't hold while the firmware is busy are lost.
+    int next = 0;
+    while (next < n)
+      {
+      if (time_us_64() < reports[next].time_us)
+        host_advance_us (reports[next].time_us - time_us_64());
+      int waiting = 0;
+      while (next + waiting < n
+             && reports[next + waiting].time_us <= time_us_64())
+        waiting++;
+      if (waiting > fifo)
+        {
+        // The scanner has no room for the newest reports
+        int excess = waiting - fifo;
+        memmove (&reports[next + fifo], &reports[next + waiting],
+          (n - next - waiting) * sizeof (SCAN_REPORT));
+        n -= excess;
+        lost += excess;
+        }
+      uint64_t wait = time_us_64() - reports[next].time_us;
+      if (wait > worst_wait) worst_wait = wait;
+
+      REPLAY_RECORD rec = { 0, 1, 0, 8, reports[next].data };
+      uint64_t start = time_us_64();
+      replay_report (&rec);
+      busy += time_us_64() - start;
+      next++;
+      }
+
+    // Let any pending tasks finish
+    for (int i = 0; i < 10; i++)
+      {
+      absolute_time_t due = app_poll();
+      if (due != at_the_end_of_time && due > time_us_64())
+        host_advance_us (due - time_us_64());
+      }
+
+    char *text = screen_text();
+    if (strstr (text, expected)) intact++;
+    free (text);
+    }
+  uint64_t wall = replay_wall_us() - wall_start;
+
+  const HOST_LCD_STATS *st = host_lcd_stats();
+  printf ("bursts:              %d x %d characters, %u us/report\n",
+    bursts, length, interval_us);
+  printf ("bursts intact:       %lu of %d\n", intact, bursts);
+  printf ("reports lost:        %lu (scanner queue %d)\n", lost, fifo);
+  printf ("worst report wait:   %.3f ms\n", worst_wait / 1000.0);
+  printf ("device busy time:    %.3f ms (%.3f ms/burst)\n", busy / 1000.0,
+    bursts ? busy / 1000.0 / bursts : 0.0);
+  printf ("I2C:                 %lu transactions, %lu bytes\n",
+    st->i2c_transactions, st->i2c_bytes);
+  printf ("host time:           %.3f ms\n", wall / 1000.0);
+
+  free (expected);
+  free (reports);
+  return (lost == 0 && intact == (unsigned long)bursts) ? 0 : 1;
+  }
+
@@ -0,0 +1,176 @@
+/*===========================================================================
+ * tools/console_switch.c
+ *
+ * Measures how long it takes to switch virtual consoles, and checks that
+ * the panel shows the right thing afterwards.
+ *
+ * Four consoles are set up on one simulated panel. Each is given a
+ * screenful of text -- some of it the same on every console, as a
+ * status line or prompt would be, and some different -- while it is
+ * not on the panel, so it's drawn only in RAM. Then the tool switches
+ * round the consoles repeatedly, timing each switch in simulated time,
+ * and compares the panel with the console's own text. For comparison,
+ * it also times redrawing the whole screen, which is what a switch
+ * would cost without the diff.
+ *
+ * This is done for the I2C transport at each standard rate, and for
+ * the GPIO transport.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+
+#define CONSOLES 4
+#define MAX_WIDTH 40
+
+// One frame at 60Hz
+#define FRAME_US 16667
+
+/*===========================================================================
+ * fill_console
+ * Write a screenful of text, with a first line that's the same on every
+ * console, and the rest different. The last line is left part-written,
+ * as it would be while something is being typed.
+ * ========================================================================*/
+static void fill_console (I2C_LCD *lcd, int n, int width, int height)
+  {
+  char line[MAX_WIDTH + 16];
+  i2c_lcd_set_cursor (lcd, 0, 0);
+  snprintf (line, sizeof (line), "%-*.*s", width, width, "12:00  READY");
+  i2c_lcd_print_chars (lcd, line, width);
+  for (int r = 1; r < height; r++)
+    {
+    snprintf (line, sizeof (line), "%c%d: %s", 'a' + n, r,
+      "the quick brown fox jumps over");
+    int len = (r == height - 1) ? width / 2 : width;
+    i2c_lcd_set_cursor (lcd, r, 0);
+    i2c_lcd_print_chars (lcd, line, MIN (len, (int)strlen (line)));
+    }
+  }
+
+/*===========================================================================
+ * panel_matches
+ * ========================================================================*/
+static BOOL panel_matches (I2C_LCD *lcd, int width, int height)
+  {
+  char want[MAX_WIDTH + 1], have[MAX_WIDTH + 1];
+  int lines = i2c_lcd_scrollback_lines (lcd);
+  for (int r = 0; r < height; r++)
+    {
+    i2c_lcd_get_scrollback_line (lcd, lines - height + r, want);
+    host_lcd_get_row (r, have);
+    if (memcmp (want, have, width) != 0) return FALSE;
+    }
+  int row, col, prow, pcol;
+  i2c_lcd_get_cursor (lcd, &row, &col);
+  host_lcd_get_cursor (&prow, &pcol);
+  return row == prow && col == pcol;
+  }
+
+/*===========================================================================
+ * run
+ * Returns the number of failures.
+ * ========================================================================*/
+static int run (const char *name, BOOL gpio, unsigned int baud, int width,
+      int height, int switches)
+  {
+  host_lcd_set_geometry (width, height);
+  LCD_TRANSPORT *t;
+  if (gpio)
+    {
+    host_lcd_set_gpio (LCD_GPIO_RS, LCD_GPIO_E, LCD_GPIO_D4);
+    t = lcd_transport_gpio_new (LCD_GPIO_RS, LCD_GPIO_E, LCD_GPIO_D4, -1);
+    }
+  else
+    {
+    host_lcd_set_gpio (-1, -1, -1);
+    t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE, I2C_LCD_ADDRESS,
+      PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, baud);
+    }
+
+  I2C_LCD *consoles[CONSOLES];
+  consoles[0] = i2c_lcd_new_with_transport (width, height, t, 2);
+  for (int i = 1; i < CONSOLES; i++)
+    consoles[i] = i2c_lcd_new_console (consoles[0], 2);
+  for (int i = CONSOLES - 1; i >= 0; i--)
+    fill_console (consoles[i], i, width, height);
+
+  // What a switch would cost if the whole screen were redrawn
+  char line[MAX_WIDTH + 1];
+  uint64_t start = time_us_64();
+  for (int r = 0; r < height; r++)
+    {
+    i2c_lcd_get_scrollback_line (consoles[0],
+      i2c_lcd_scrollback_lines (consoles[0]) - height + r, line);
+    i2c_lcd_set_cursor (consoles[0], r, 0);
+    i2c_lcd_print_chars (consoles[0], line, width);
+    }
+  uint64_t full_us = time_us_64() - start;
+
+  int failures = 0;
+  uint64_t total = 0, worst = 0;
+  for (int i = 1; i <= switches; i++)
+    {
+    I2C_LCD *next = consoles[i % CONSOLES];
+    start = time_us_64();
+    i2c_lcd_activate (next);
+    uint64_t elapsed = time_us_64() - start;
+    total += elapsed;
+    if (elapsed > worst) worst = elapsed;
+    if (!panel_matches (next, width, height)) failures++;
+    }
+
+  printf ("%-9s %2dx%d  %-12.3f %-12.3f %-12.3f %s\n", name, width, height,
+    full_us / 1000.0, (double)total / switches / 1000.0, worst / 1000.0,
+    failures ? "WRONG" : (worst > FRAME_US ? "ok, slow" : "ok"));
+
+  for (int i = CONSOLES - 1; i >= 0; i--)
+    i2c_lcd_destroy (consoles[i]);
+  return failures;
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int switches = 100;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'n': switches = atoi (optarg); break;
+      default:
+        fprintf (stderr, "Usage: %s [-n switches]\n", argv[0]);
+        return 1;
+      }
+    }
+
+  printf ("%-9s %-6s %-12s %-12s %-12s %s\n", "bus", "size", "redraw ms",
+    "switch ms", "worst ms", "panel");
+  int failures = 0;
+  static const int sizes[][2] = { { 16, 2 }, { 20, 4 } };
+  for (int s = 0; s < 2; s++)
+    {
+    int w = sizes[s][0], h = sizes[s][1];
+    failures += run ("I2C 100k", FALSE, 100000, w, h, switches);
+    failures += run ("I2C 400k", FALSE, 400000, w, h, switches);
+    failures += run ("I2C 1M", FALSE, 1000000, w, h, switches);
+    failures += run ("GPIO", TRUE, 0, w, h, switches);
+    }
+  printf ("\n%s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+  }
+
@@ -0,0 +1,182 @@
+/*===========================================================================
+ * tools/dual_bench.c
+ *
+ * Measures full-screen updates of a 40x4 panel, which has two HD44780s,
+ * and checks that the panel shows the right thing afterwards.
+ *
+ * A console on a simulated 40x4 panel is given more lines than fit, so
+ * that it has scrolled. Then the tool times, in simulated time, the
+ * updates that change every row: a new line that scrolls the display
+ * up, and paging back through the scrollback buffer and forward again.
+ * Each is done twice: with the rows of the two controllers sent
+ * interleaved, so that each controller executes a character while the
+ * other is sent one, and with one controller's rows sent after the
+ * other's, as they would be without interleaving.
+ *
+ * After each update, the panel is compared with the console, and the
+ * simulated HD44780s check that no byte reached either of them while
+ * it was still executing the last, and that only one shows a cursor.
+ *
+ * This is done for the I2C transport at each standard rate, and for
+ * the GPIO transport.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+
+#define WIDTH 40
+#define HEIGHT 4
+#define LINES 12
+#define ROUNDS 10
+
+// A pin for the second controller's enable line, on the GPIO transport
+#define GPIO_E2 (LCD_GPIO_D4 + 4)
+
+typedef struct _TIMES
+  {
+  double scroll_ms;
+  double page_ms;
+  } TIMES;
+
+/*===========================================================================
+ * print_line
+ * Print a line that fills the width, and is different from every other.
+ * ========================================================================*/
+static void print_line (I2C_LCD *lcd, int n)
+  {
+  char line[WIDTH + 1];
+  snprintf (line, sizeof (line), "%03d the quick brown fox jumps over %03d",
+    n, n);
+  i2c_lcd_print_chars (lcd, line, (int)strlen (line));
+  }
+
+/*===========================================================================
+ * panel_matches
+ * ========================================================================*/
+static BOOL panel_matches (I2C_LCD *lcd)
+  {
+  char want[WIDTH + 1], have[WIDTH + 1];
+  int first = i2c_lcd_scrollback_lines (lcd) - HEIGHT
+    - i2c_lcd_get_scrollback (lcd);
+  for (int r = 0; r < HEIGHT; r++)
+    {
+    i2c_lcd_get_scrollback_line (lcd, first + r, want);
+    host_lcd_get_row (r, have);
+    if (memcmp (want, have, WIDTH) != 0) return FALSE;
+    }
+  if (host_lcd_cursors() > 1) return FALSE;
+  if (i2c_lcd_get_scrollback (lcd) > 0) return TRUE;
+  int row, col, prow, pcol;
+  i2c_lcd_get_cursor (lcd, &row, &col);
+  host_lcd_get_cursor (&prow, &pcol);
+  return row == prow && col == pcol;
+  }
+
+/*===========================================================================
+ * run
+ * Returns the number of failures.
+ * ========================================================================*/
+static int run (BOOL gpio, unsigned int baud, BOOL interleave,
+      TIMES *times)
+  {
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  LCD_TRANSPORT *t;
+  if (gpio)
+    {
+    host_lcd_set_gpio_dual (LCD_GPIO_RS, LCD_GPIO_E, GPIO_E2, LCD_GPIO_D4);
+    t = lcd_transport_gpio_new_dual (LCD_GPIO_RS, LCD_GPIO_E, GPIO_E2,
+      LCD_GPIO_D4, -1);
+    }
+  else
+    {
+    host_lcd_set_gpio (-1, -1, -1);
+    t = lcd_transport_i2c_new_dual (PICO_DEFAULT_I2C_INSTANCE, 
+      I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+      baud);
+    }
+  // Without send_chars_dual(), the driver sends one controller's run,
+  //   and then the other's
+  if (!interleave) t->send_chars_dual = NULL;
+
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT, t, 4);
+  for (int i = 0; i < LINES; i++)
+    {
+    print_line (lcd, i);
+    i2c_lcd_print_char (lcd, '\n');
+    }
+  host_lcd_reset_stats();
+
+  int failures = 0;
+  uint64_t scroll_us = 0, page_us = 0;
+  for (int i = 0; i < ROUNDS; i++)
+    {
+    // A new line, then the newline that scrolls every row up
+    print_line (lcd, LINES + i);
+    uint64_t start = time_us_64();
+    i2c_lcd_print_char (lcd, '\n');
+    scroll_us += time_us_64() - start;
+    if (!panel_matches (lcd)) failures++;
+
+    start = time_us_64();
+    i2c_lcd_scrollback_page_up (lcd);
+    i2c_lcd_update (lcd);
+    page_us += time_us_64() - start;
+    if (!panel_matches (lcd)) failures++;
+
+    start = time_us_64();
+    i2c_lcd_scrollback_page_down (lcd);
+    i2c_lcd_update (lcd);
+    page_us += time_us_64() - start;
+    if (!panel_matches (lcd)) failures++;
+    }
+  if (host_lcd_stats()->lcd_overruns > 0) failures++;
+
+  times->scroll_ms = scroll_us / 1000.0 / ROUNDS;
+  times->page_ms = page_us / 1000.0 / ROUNDS / 2;
+  i2c_lcd_destroy (lcd);
+  return failures;
+  }
+
+/*===========================================================================
+ * compare
+ * ========================================================================*/
+static int compare (const char *name, BOOL gpio, unsigned int baud)
+  {
+  TIMES dual, serial;
+  int failures = run (gpio, baud, TRUE, &dual);
+  failures += run (gpio, baud, FALSE, &serial);
+  printf ("%-9s %-10.3f %-10.3f %-10.3f %-10.3f %-6.2f %s\n", name,
+    dual.scroll_ms, serial.scroll_ms, dual.page_ms, serial.page_ms,
+    (serial.scroll_ms + serial.page_ms) / (dual.scroll_ms + dual.page_ms),
+    failures ? "WRONG" : "ok");
+  return failures;
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  printf ("%-9s %-21s %-21s %-6s %s\n", "", "scroll ms", "page ms", "",
+    "");
+  printf ("%-9s %-10s %-10s %-10s %-10s %-6s %s\n", "bus", "together",
+    "one, one", "together", "one, one", "gain", "panel");
+  int failures = 0;
+  failures += compare ("I2C 100k", FALSE, 100000);
+  failures += compare ("I2C 400k", FALSE, 400000);
+  failures += compare ("I2C 1M", FALSE, 1000000);
+  failures += compare ("GPIO", TRUE, 0);
+  printf ("\n%s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+  }
+
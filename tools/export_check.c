@@ -0,0 +1,225 @@
+/*===========================================================================
+ * tools/export_check.c
+ *
+ * Checks that a scrollback export comes back intact through the host
+ * decoder, and measures how well it compresses, and how long each frame
+ * takes.
+ *
+ * A 20x4 display is given a scrollback buffer of 50 pages, and filled
+ * with the sort of thing it might show in use: log lines with times and
+ * readings, prompts, short and empty lines, lines long enough to wrap,
+ * and now and then a character outside ASCII. The buffer is exported, 
+ * and the frames are unpacked as export_decode would unpack them. The 
+ * text must be exactly the buffer's logical lines, with trailing spaces
+ * removed, and wrapped lines joined up again.
+ *
+ * Then it's done again, with a line printed between every two frames,
+ * as if the display were busy during the export. The oldest lines
+ * scroll out of the buffer before they can be sent, and must be counted
+ * as lost; the rest must come back as they were.
+ *
+ * With -o, the frames are also written to a file, as they would appear
+ * in a log of the serial console, for trying out export_decode.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include <export/export.h>
+#include "export_unpack.h"
+#include "config.h"
+#include "replay.h"
+
+#define WIDTH 20
+#define HEIGHT 4
+#define PAGES 50
+#define CHUNK 48
+
+// Serial console baud rate, for working out how long frames take to send
+#define UART_BAUD 115200
+
+static EXPORT_READER reader;
+static BOOL finished;
+static char frame_line[256];
+static FILE *log_file;
+
+/*===========================================================================
+ * write_frame
+ * ========================================================================*/
+static void write_frame (const char *s, int n, void *context)
+  {
+  (void)context;
+  memcpy (frame_line, s, n);
+  frame_line[n] = 0;
+  if (log_file) fputs (frame_line, log_file);
+  if (export_reader_line (&reader, frame_line)) finished = TRUE;
+  }
+
+/*===========================================================================
+ * print_line
+ * Print line i of some made-up output.
+ * ========================================================================*/
+static void print_line (I2C_LCD *lcd, int i)
+  {
+  char s[64];
+  switch (rand() % 7)
+    {
+    case 0:
+      snprintf (s, sizeof (s), "> read %d", i % 8);
+      break;
+    case 1:
+      s[0] = 0;
+      break;
+    case 2:
+      snprintf (s, sizeof (s), "ERR %d", rand() % 4);
+      break;
+    case 3:
+      snprintf (s, sizeof (s), "temp %d.%d%cC", 18 + rand() % 6,
+        rand() % 10, (char)0xDF);
+      break;
+    case 4:
+      snprintf (s, sizeof (s), "%02d:%02d:%02d sensor %d reads %d mV",
+        i / 3600 % 24, i / 60 % 60, i % 60, rand() % 8, rand() % 5000);
+      break;
+    default:
+      snprintf (s, sizeof (s), "%02d:%02d:%02d OK %d", i / 3600 % 24,
+        i / 60 % 60, i % 60, rand() % 1000);
+      break;
+    }
+  i2c_lcd_print_string (lcd, s);
+  i2c_lcd_print_char (lcd, '\r');
+  }
+
+/*===========================================================================
+ * expected_text
+ * The buffer's logical lines, from the oldest, without trailing spaces. 
+ * If all_but_last is set, the line the cursor is on is left out, since
+ * it will be printed over.
+ * ========================================================================*/
+static char *expected_text (I2C_LCD *lcd, BOOL all_but_last)
+  {
+  uint32_t first = i2c_lcd_first_line (lcd);
+  uint32_t end = i2c_lcd_end_line (lcd) - (all_but_last ? 1 : 0);
+  char *text = malloc ((size_t)(end - first) * (I2C_LCD_LINE_MAX + 1) + 1);
+  size_t len = 0;
+  for (uint32_t n = first; n != end; n++)
+    {
+    len += (size_t)i2c_lcd_get_line (lcd, n, text + len, 
+      I2C_LCD_LINE_MAX + 1);
+    text[len++] = '\n';
+    }
+  text[len] = 0;
+  return text;
+  }
+
+/*===========================================================================
+ * run
+ * Returns TRUE if the export came back as it should.
+ * ========================================================================*/
+static BOOL run (I2C_LCD *lcd, int lines_between)
+  {
+  // Snapshot of what the export should contain, if nothing changes
+  char *expect = expected_text (lcd, lines_between > 0);
+  // What the buffer would take as rows of the display
+  unsigned long buffer = (unsigned long)i2c_lcd_scrollback_lines (lcd) 
+    * WIDTH;
+  export_reader_init (&reader);
+  finished = FALSE;
+  EXPORT *e = export_new (lcd, 1, CHUNK, write_frame, NULL);
+  uint64_t worst_us = 0, total_us = 0;
+  int frames = 0, printed = 0;
+  while (1)
+    {
+    uint64_t start = replay_wall_us();
+    BOOL more = export_work (e);
+    uint64_t t = replay_wall_us() - start;
+    total_us += t;
+    if (t > worst_us) worst_us = t;
+    frames++;
+    if (!more) break;
+    for (int k = 0; k < lines_between; k++)
+      print_line (lcd, 10000 + printed++);
+    }
+
+  const EXPORT_STATS *st = export_get_stats (e);
+  BOOL ok = finished && reader.error == NULL;
+  if (ok && lines_between == 0)
+    ok = strcmp (reader.text, expect) == 0 && st->lost == 0;
+  else if (ok)
+    {
+    // Lines that were lost are missing from the start. The rest are 
+    //   as they were, having kept their numbers as they scrolled, except
+    //   the one the cursor was on, which has been printed over since.
+    const char *p = expect;
+    for (uint32_t k = 0; k < st->lost; k++) p = strchr (p, '\n') + 1;
+    ok = st->lost > 0 && strncmp (reader.text, p, strlen (p)) == 0;
+    }
+
+  printf ("%-10s %-7lu %-6lu %-8lu %-8lu %-8lu %-7d %-9.1f %-9lu %s\n",
+    lines_between ? "busy" : "quiet", (unsigned long)st->lines,
+    (unsigned long)st->lost, buffer,
+    (unsigned long)st->text_bytes, (unsigned long)st->bytes, frames,
+    (double)total_us / frames, (unsigned long)worst_us,
+    ok ? "ok" : (reader.error ? reader.error : "WRONG"));
+  printf ("  UART time: %.1f ms in all, %.2f ms per frame at %d baud\n",
+    st->bytes * 10000.0 / UART_BAUD, st->bytes * 10000.0 / UART_BAUD
+    / frames, UART_BAUD);
+
+  export_destroy (e);
+  export_reader_free (&reader);
+  free (expect);
+  return ok;
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int opt;
+  while ((opt = getopt (argc, argv, "o:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'o':
+        log_file = fopen (optarg, "w");
+        if (!log_file)
+          {
+          perror (optarg);
+          return 1;
+          }
+        break;
+      default:
+        fprintf (stderr, "Usage: %s [-o log]\n", argv[0]);
+        return 1;
+      }
+    }
+
+  srand (1);
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    1000000);
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT, t, PAGES);
+  for (int i = 0; i < PAGES * HEIGHT * 2; i++) print_line (lcd, i);
+
+  printf ("%-10s %-7s %-6s %-8s %-8s %-8s %-7s %-9s %-9s %s\n",
+    "display", "lines", "lost", "buffer", "text", "sent", "frames",
+    "mean us", "worst us", "result");
+  BOOL ok = run (lcd, 0);
+  ok = run (lcd, 1) && ok;
+  printf ("\n%s\n", ok ? "passed" : "FAILED");
+  i2c_lcd_destroy (lcd);
+  if (log_file) fclose (log_file);
+  return ok ? 0 : 1;
+  }
+
@@ -0,0 +1,93 @@
+/*===========================================================================
+ * tools/export_decode.c
+ *
+ * Gets the text of scrollback exports (the 'x' serial command) out of a
+ * log of the Pico's serial console. Other console output in the log is
+ * ignored. The text of each export goes to standard output, and a
+ * summary of it to standard error.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "export_unpack.h"
+
+/*===========================================================================
+ * usage
+ * ========================================================================*/
+static void usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [-n number] [log]\n", argv0);
+  fprintf (stderr, "  -n  write only this export (1 is the first in the "
+    "log, -1 the last)\n");
+  fprintf (stderr, "With no log file, the log is read from standard "
+    "input.\n");
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int want = 0;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'n': want = atoi (optarg); break;
+      default: usage (argv[0]); return 1;
+      }
+    }
+
+  FILE *f = stdin;
+  if (optind < argc)
+    {
+    f = fopen (argv[optind], "r");
+    if (!f)
+      {
+      perror (argv[optind]);
+      return 1;
+      }
+    }
+
+  EXPORT_READER r;
+  export_reader_init (&r);
+  char *line = NULL, *last = NULL;
+  size_t size = 0;
+  int found = 0, bad = 0;
+  while (getline (&line, &size, f) >= 0)
+    {
+    if (!export_reader_line (&r, line)) continue;
+    found++;
+    if (want > 0 && found != want) continue;
+    fprintf (stderr, "Export %d: console %d, %lu lines (%lu lost), %s\n",
+      found, r.console, r.lines, r.lost, r.error ? r.error : "ok");
+    if (r.error)
+      {
+      bad++;
+      continue;
+      }
+    if (want < 0)
+      {
+      // Keep only the last one
+      free (last);
+      last = strdup (r.text);
+      }
+    else
+      fwrite (r.text, 1, r.text_len, stdout);
+    }
+  if (last) fputs (last, stdout);
+
+  if (found == 0) fprintf (stderr, "No exports found\n");
+  free (last);
+  free (line);
+  export_reader_free (&r);
+  if (f != stdin) fclose (f);
+  return (found == 0 || bad) ? 1 : 0;
+  }
+
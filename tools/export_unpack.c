@@ -0,0 +1,207 @@
+/*===========================================================================
+ * tools/export_unpack.c
+ *
+ * Unpacking of scrollback exports. See export_unpack.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "export_unpack.h"
+
+// Must match EXPORT_WINDOW in export.h
+#define WINDOW 1024
+
+/*===========================================================================
+ * crc32
+ * ========================================================================*/
+static uint32_t crc32 (const char *p, size_t n)
+  {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < n; i++)
+    {
+    crc ^= (uint8_t)p[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+    }
+  return ~crc;
+  }
+
+/*===========================================================================
+ * base64_value
+ * ========================================================================*/
+static int base64_value (char c)
+  {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+  }
+
+/*===========================================================================
+ * add_data
+ * Decode base64, and add it to the compressed data. Returns false if it
+ * isn't valid base64.
+ * ========================================================================*/
+static bool add_data (EXPORT_READER *r, const char *p)
+  {
+  while (*p && *p != '\n' && *p != '\r')
+    {
+    int v[4], n = 0;
+    for (int i = 0; i < 4; i++)
+      {
+      if (!p[i]) return false;
+      if (p[i] == '=') { v[i] = 0; continue; }
+      v[i] = base64_value (p[i]);
+      if (v[i] < 0) return false;
+      n = i;
+      }
+    if (r->data_len + 3 > r->data_size)
+      {
+      r->data_size = r->data_size ? r->data_size * 2 : 4096;
+      r->data = realloc (r->data, r->data_size);
+      }
+    uint32_t bits = (uint32_t)v[0] << 18 | v[1] << 12 | v[2] << 6 | v[3];
+    for (int i = 0; i < n; i++)
+      r->data[r->data_len++] = (uint8_t)(bits >> (16 - 8 * i));
+    p += 4;
+    }
+  return true;
+  }
+
+/*===========================================================================
+ * export_decompress
+ * ========================================================================*/
+long export_decompress (const uint8_t *data, size_t n, char **out)
+  {
+  size_t size = 4096, len = 0;
+  char *text = malloc (size);
+  size_t i = 0;
+  while (i < n)
+    {
+    uint8_t b = data[i++];
+    size_t copy = 0, dist = 0;
+    if (b < 0x80 || b == 0xFF)
+      {
+      if (b == 0xFF)
+        {
+        if (i >= n) goto bad;
+        b = data[i++];
+        }
+      if (len + 1 > size) text = realloc (text, size *= 2);
+      text[len++] = (char)b;
+      continue;
+      }
+    if (b < 0xC0)
+      {
+      if (i >= n) goto bad;
+      copy = (b & 0x3F) + 3;
+      dist = (size_t)data[i++] + 1;
+      }
+    else if (b < 0xE0)
+      {
+      if (i + 1 >= n) goto bad;
+      copy = (b & 0x1F) + 3;
+      dist = ((size_t)data[i] << 8 | data[i + 1]) + 1;
+      i += 2;
+      }
+    else
+      goto bad;
+    if (dist > len || dist > WINDOW) goto bad;
+    while (len + copy > size) text = realloc (text, size *= 2);
+    // Byte by byte, because the copy may overlap what it produces
+    for (size_t k = 0; k < copy; k++, len++)
+      text[len] = text[len - dist];
+    }
+  text = realloc (text, len + 1);
+  text[len] = 0;
+  *out = text;
+  return (long)len;
+
+bad:
+  free (text);
+  *out = NULL;
+  return -1;
+  }
+
+/*===========================================================================
+ * export_reader_init
+ * ========================================================================*/
+void export_reader_init (EXPORT_READER *r)
+  {
+  memset (r, 0, sizeof (EXPORT_READER));
+  }
+
+/*===========================================================================
+ * export_reader_free
+ * ========================================================================*/
+void export_reader_free (EXPORT_READER *r)
+  {
+  free (r->text);
+  free (r->data);
+  memset (r, 0, sizeof (EXPORT_READER));
+  }
+
+/*===========================================================================
+ * export_reader_line
+ * ========================================================================*/
+bool export_reader_line (EXPORT_READER *r, const char *line)
+  {
+  if (strncmp (line, "@S", 2) != 0) return false;
+
+  if (line[2] == 'B')
+    {
+    unsigned long lines;
+    free (r->text);
+    r->text = NULL;
+    r->text_len = 0;
+    r->data_len = 0;
+    r->error = NULL;
+    r->next_seq = 0;
+    r->in_export = sscanf (line + 3, "%d %d %lu", &r->console, &r->width,
+      &lines) == 3;
+    return false;
+    }
+  if (!r->in_export) return false;
+
+  if (line[2] == 'D')
+    {
+    char *p;
+    long seq = strtol (line + 3, &p, 10);
+    if (r->error) return false;
+    if (seq != r->next_seq)
+      r->error = "a data frame is missing";
+    else if (*p != ' ' || !add_data (r, p + 1))
+      r->error = "a data frame is damaged";
+    r->next_seq = (r->next_seq + 1) % 256;
+    return false;
+    }
+
+  if (line[2] == 'E')
+    {
+    unsigned long bytes, crc;
+    r->in_export = false;
+    if (sscanf (line + 3, "%lu %lu %lu %lx", &r->lines, &r->lost, &bytes,
+          &crc) != 4)
+      {
+      r->error = "the end frame is damaged";
+      return true;
+      }
+    if (r->error) return true;
+    long len = export_decompress (r->data, r->data_len, &r->text);
+    if (len < 0)
+      r->error = "the compressed data is not valid";
+    else if ((unsigned long)len != bytes
+              || crc32 (r->text, (size_t)len) != (uint32_t)crc)
+      r->error = "the text does not match its checksum";
+    else
+      r->text_len = (size_t)len;
+    return true;
+    }
+  return false;
+  }
+
@@ -0,0 +1,46 @@
+/*===========================================================================
+ * tools/export_unpack.h
+ *
+ * Unpacking of scrollback exports from the Pico's serial console output.
+ * The frame format and the compression are described in
+ * export/include/export/export.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _EXPORT_READER
+  {
+  bool in_export;       // Between @SB and @SE
+  int next_seq;
+  // The export, once @SE has arrived
+  int console;
+  int width;
+  unsigned long lines;  // Lines in the text
+  unsigned long lost;   // Lines the Pico lost before it could send them
+  char *text;           // The text, null-terminated
+  size_t text_len;
+  uint8_t *data;        // Compressed data
+  size_t data_len;
+  size_t data_size;
+  const char *error;    // NULL if the export is complete and correct
+  } EXPORT_READER;
+
+extern void export_reader_init (EXPORT_READER *r);
+extern void export_reader_free (EXPORT_READER *r);
+
+/** Take one line of console output. Returns true when it finishes an
+    export, which is then in r->text, unless r->error says what was
+    wrong with it. Lines that aren't export frames are ignored. */
+extern bool export_reader_line (EXPORT_READER *r, const char *line);
+
+/** Expand n bytes of compressed data into *out, which the caller must
+    free. Returns the length of the text, or -1 if the data is not
+    valid. */
+extern long export_decompress (const uint8_t *data, size_t n, char **out);
+
@@ -0,0 +1,146 @@
+/*===========================================================================
+ * tools/hid_replay.c
+ *
+ * Replay a HID report trace (see usb_kbd/hid_trace.h) through the
+ * firmware's keyboard and display code, on a Linux host. The firmware
+ * sources are compiled unchanged against the simulated Pico in host/,
+ * so the reports go through exactly the same path that they would on
+ * the device: tuh_hid_report_received_cb(), process_kbd_report(),
+ * kbd_raw_key_down() in main.c, and the I2C LCD driver.
+ *
+ * By default, the trace is replayed as fast as possible, and the tool
+ * reports throughput -- both on the host, and in simulated device time.
+ * The simulated figures show how long the device would spend processing
+ * each report, and how far it would fall behind the keyboard. With -r,
+ * the trace is replayed at its recorded timing, and the simulated panel
+ * is redrawn on the terminal after each report.
+ *
+ * The trace file can be raw binary, or the text that hid_trace_dump()
+ * writes to the serial console (other lines in the file are ignored, so
+ * a complete console log can be used).
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <usb_kbd/hid_trace.h>
+#include "config.h"
+#include "replay.h"
+
+/*===========================================================================
+ * usage
+ * ========================================================================*/
+static void usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [-r] [-q] trace\n", argv0);
+  fprintf (stderr, "  -r  replay at recorded timing, showing the panel\n");
+  fprintf (stderr, "  -q  don't show the panel at the end\n");
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int realtime = 0, quiet = 0;
+  int opt;
+  while ((opt = getopt (argc, argv, "rq")) != -1)
+    {
+    switch (opt)
+      {
+      case 'r': realtime = 1; break;
+      case 'q': quiet = 1; break;
+      default: usage (argv[0]); return 1;
+      }
+    }
+  if (optind != argc - 1)
+    {
+    usage (argv[0]);
+    return 1;
+    }
+
+  size_t size;
+  uint8_t *trace = replay_load (argv[optind], &size);
+  if (!trace) return 1;
+
+  replay_init_firmware();
+  host_lcd_reset_stats();
+
+  // 'recorded' is the time at which the keyboard sent the report, on
+  //   the device's clock. The device's clock itself only moves on when
+  //   the firmware does some work, or when we skip forward to the next
+  //   report. If the clock has already passed the time of the next 
+  //   report when it arrives, the device is falling behind.
+  uint64_t recorded = time_us_64();
+  uint64_t first_recorded = recorded;
+  uint64_t max_lag = 0, max_cost = 0, total_cost = 0;
+  unsigned long reports = 0;
+  uint64_t wall_start = replay_wall_us();
+  size_t pos = HID_TRACE_HEADER_SIZE;
+  REPLAY_RECORD rec;
+  while (replay_next (trace, size, &pos, &rec))
+    {
+    if (reports > 0) recorded += rec.delta_us;
+    if (time_us_64() < recorded) host_advance_us (recorded - time_us_64());
+    uint64_t lag = time_us_64() - recorded;
+    if (lag > max_lag) max_lag = lag;
+
+    if (realtime && reports > 0)
+      {
+      uint64_t due = wall_start + (recorded - first_recorded);
+      uint64_t now = replay_wall_us();
+      if (now < due)
+        {
+        uint64_t wait = due - now;
+        struct timespec ts = { (time_t)(wait / 1000000),
+                               (long)(wait % 1000000) * 1000 };
+        nanosleep (&ts, NULL);
+        }
+      }
+
+    uint64_t start = time_us_64();
+    replay_report (&rec);
+    uint64_t cost = time_us_64() - start;
+    total_cost += cost;
+    if (cost > max_cost) max_cost = cost;
+    reports++;
+
+    if (realtime)
+      {
+      printf ("\033[H\033[2J");
+      host_lcd_render (stdout);
+      fflush (stdout);
+      }
+    }
+  uint64_t wall = replay_wall_us() - wall_start;
+
+  if (!quiet && !realtime) host_lcd_render (stdout);
+
+  const HOST_LCD_STATS *st = host_lcd_stats();
+  printf ("reports:             %lu\n", reports);
+  printf ("host time:           %.3f ms (%.0f reports/s)\n",
+    wall / 1000.0, wall ? reports * 1e6 / wall : 0.0);
+  printf ("device busy time:    %.3f ms (%.1f us/report, worst %.1f us)\n",
+    total_cost / 1000.0, reports ? (double)total_cost / reports : 0.0,
+    (double)max_cost);
+  printf ("device worst lag:    %.3f ms behind the keyboard\n",
+    max_lag / 1000.0);
+  printf ("I2C:                 %lu transactions, %lu bytes, %.3f ms\n",
+    st->i2c_transactions, st->i2c_bytes, st->i2c_busy_us / 1000.0);
+  printf ("LCD:                 %lu commands, %lu characters\n",
+    st->lcd_commands, st->lcd_chars);
+  printf ("sleeping:            %.3f ms\n", st->sleep_us / 1000.0);
+  printf ("busy-waiting:        %.3f ms\n", st->busy_wait_us / 1000.0);
+
+  free (trace);
+  return 0;
+  }
+
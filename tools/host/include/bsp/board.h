@@ -0,0 +1,17 @@
+/*===========================================================================
+ * tools/host/include/bsp/board.h
+ *
+ * The TinyUSB board support functions, on virtual time.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <pico/stdlib.h>
+
+static inline void board_init (void) {}
+static inline uint32_t board_millis (void) 
+  { return (uint32_t)(time_us_64() / 1000); }
+static inline void board_led_write (bool state) { (void)state; }
+
@@ -0,0 +1,32 @@
+/*===========================================================================
+ * tools/host/include/hardware/flash.h
+ *
+ * The simulated flash is an array in host memory, which is "mapped" at
+ * XIP_BASE, so firmware can read it directly, as on the Pico. Erasing
+ * and programming take about as long, in virtual time, as on a real
+ * flash chip.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <pico/stdlib.h>
+
+#define FLASH_PAGE_SIZE 256
+#define FLASH_SECTOR_SIZE 4096
+
+extern uint8_t host_flash[];
+#define XIP_BASE ((uintptr_t)host_flash)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void flash_range_erase (uint32_t flash_offs, size_t count);
+extern void flash_range_program (uint32_t flash_offs, const uint8_t *data, 
+              size_t count);
+
+#ifdef __cplusplus
+}
+#endif
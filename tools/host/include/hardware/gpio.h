@@ -0,0 +1,31 @@
+/*===========================================================================
+ * tools/host/include/hardware/gpio.h
+ *
+ * GPIO set-up functions are accepted, and ignored. Outputs go to the
+ * simulated HD44780, if it's wired to GPIO -- see host/host_pico.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <pico/stdlib.h>
+
+#define GPIO_FUNC_I2C 3
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+static inline void gpio_set_function (unsigned int gpio, int fn)
+  { (void)gpio; (void)fn; }
+static inline void gpio_pull_up (unsigned int gpio) { (void)gpio; }
+static inline void gpio_init (unsigned int gpio) { (void)gpio; }
+static inline void gpio_set_dir (unsigned int gpio, bool out)
+  { (void)gpio; (void)out; }
+static inline void gpio_init_mask (uint32_t mask) { (void)mask; }
+static inline void gpio_set_dir_out_masked (uint32_t mask) { (void)mask; }
+
+extern void gpio_put (unsigned int gpio, bool value);
+extern void gpio_put_masked (uint32_t mask, uint32_t value);
+extern void gpio_set_mask (uint32_t mask);
+extern void gpio_clr_mask (uint32_t mask);
+
@@ -0,0 +1,35 @@
+/*===========================================================================
+ * tools/host/include/hardware/i2c.h
+ *
+ * Simulated I2C bus, with a PCF8574 and HD44780 attached. See
+ * host/host_pico.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <pico/stdlib.h>
+
+#define i2c0 (&host_i2c0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern unsigned int i2c_init (i2c_inst_t *i2c, unsigned int baudrate);
+extern unsigned int i2c_set_baudrate (i2c_inst_t *i2c, unsigned int baudrate);
+extern int i2c_write_blocking (i2c_inst_t *i2c, uint8_t addr,
+             const uint8_t *src, size_t len, bool nostop);
+extern int i2c_read_blocking (i2c_inst_t *i2c, uint8_t addr,
+             uint8_t *dst, size_t len, bool nostop);
+extern int i2c_write_timeout_us (i2c_inst_t *i2c, uint8_t addr,
+             const uint8_t *src, size_t len, bool nostop, 
+             unsigned int timeout_us);
+extern int i2c_read_timeout_us (i2c_inst_t *i2c, uint8_t addr,
+             uint8_t *dst, size_t len, bool nostop, unsigned int timeout_us);
+
+#ifdef __cplusplus
+}
+#endif
+
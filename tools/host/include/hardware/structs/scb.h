@@ -0,0 +1,26 @@
+/*===========================================================================
+ * tools/host/include/hardware/structs/scb.h
+ *
+ * The system control block, as a plain variable. 
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct
+  {
+  uint32_t cpuid;
+  uint32_t icsr;
+  uint32_t vtor;
+  uint32_t aircr;
+  uint32_t scr;
+  } armv6m_scb_hw_t;
+
+extern armv6m_scb_hw_t host_scb;
+
+#define scb_hw (&host_scb)
+#define M0PLUS_SCR_SEVONPEND_BITS 0x00000010
+
@@ -0,0 +1,15 @@
+/*===========================================================================
+ * tools/host/include/hardware/sync.h
+ *
+ * There are no interrupts on the simulated Pico, so there's nothing to
+ * disable.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <pico/stdlib.h>
+
+static inline uint32_t save_and_disable_interrupts (void) { return 0; }
+static inline void restore_interrupts (uint32_t status) { (void)status; }
@@ -0,0 +1,25 @@
+/*===========================================================================
+ * tools/host/include/hardware/watchdog.h
+ *
+ * The simulated watchdog runs on virtual time. If the firmware lets 
+ * time pass beyond the timeout without feeding it, it "resets" the 
+ * Pico -- see host_watchdog_set_reset() in host/host_pico.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <pico/stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void watchdog_enable (uint32_t delay_ms, bool pause_on_debug);
+extern void watchdog_update (void);
+extern bool watchdog_caused_reboot (void);
+
+#ifdef __cplusplus
+}
+#endif
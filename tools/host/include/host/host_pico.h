@@ -0,0 +1,121 @@
+/*===========================================================================
+ * tools/host/include/host/host_pico.h
+ *
+ * Control and inspection of the simulated Pico used by the host tools.
+ *
+ * Time is virtual. It starts at zero, and advances when the firmware
+ * calls sleep_us() or busy-waits, when it transfers data on the I2C bus (at nine bit
+ * times per byte, including the address byte), or when a tool calls
+ * host_advance_us(). This means that the tools run as fast as the
+ * host can manage, while still reporting how long the same work would
+ * take on the device.
+ *
+ * The I2C bus has a PCF8574 at any address, wired to an HD44780 in the
+ * usual way (P0 = RS, P1 = RW, P2 = E, P3 = backlight, P4-P7 = D4-D7).
+ * The bus can be given a speed limit, above which every transfer fails,
+ * as a poorly-wired bus would.
+ * Alternatively, the HD44780 can be connected directly to GPIO pins, in
+ * 4-bit mode -- see host_lcd_set_gpio(). 
+ * The watchdog runs out if the firmware lets virtual time pass beyond
+ * its timeout without feeding it; see host_watchdog_set_reset().
+ * Flash is an array in memory, which keeps its contents for as long as
+ * the tool runs, so a tool can "reset" the firmware and see what it 
+ * recovers from flash.
+ * The HD44780 model keeps its DDRAM, address counter and display
+ * control state, so the tools can show exactly what the panel would
+ * show. It also knows how long each byte takes to execute, and counts
+ * the nibbles that arrive too soon after the last byte. A panel set to
+ * more than 20 columns and more than 2 rows is a 40x4, with two 
+ * HD44780s: the second's enable line is the PCF8574's RW pin.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <pico/stdlib.h>
+
+typedef struct _HOST_LCD_STATS
+  {
+  unsigned long i2c_transactions;
+  unsigned long i2c_bytes;
+  unsigned long i2c_errors;
+  unsigned long lcd_commands;
+  unsigned long lcd_chars;
+  unsigned long lcd_overruns;  // Nibbles sent while the HD44780 was busy
+  unsigned long watchdog_resets;
+  uint64_t i2c_busy_us;
+  uint64_t sleep_us;
+  uint64_t busy_wait_us;
+  } HOST_LCD_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Move virtual time on, as if the device had been idle. An idle 
+    device's main loop still feeds the watchdog, so this doesn't let it
+    run out. */
+extern void     host_advance_us (uint64_t us);
+
+/** When the watchdog runs out, longjmp() to 'reset', as the RP2040 
+    would reset. The firmware is abandoned wherever it had got to. With
+    no 'reset' (the default), the reset is only counted. Either way,
+    watchdog_caused_reboot() is TRUE from then on. */
+extern void     host_watchdog_set_reset (jmp_buf *reset);
+
+/** Set the geometry used to map the HD44780's DDRAM to screen rows.
+    This should match what the firmware was configured with. */
+extern void     host_lcd_set_geometry (int width, int height);
+
+/** Make every I2C transfer fail (not acknowledged) while the bus runs 
+    faster than baud. Zero removes the limit. */
+extern void     host_i2c_set_max_baud (unsigned int baud);
+
+/** The baud rate that the firmware has set on the I2C bus. */
+extern unsigned int host_i2c_get_baud (void);
+
+/** Connect the simulated HD44780 to GPIO pins, rather than to the I2C
+    bus: RS, E, and four consecutive pins for D4-D7. */
+extern void     host_lcd_set_gpio (int rs, int e, int d4);
+
+/** As host_lcd_set_gpio(), for a 40x4 panel, with the second 
+    controller's enable line on pin e2. */
+extern void     host_lcd_set_gpio_dual (int rs, int e, int e2, int d4);
+
+/** Copy row 'row' of the simulated panel into buf, which must have room
+    for width + 1 bytes. */
+extern void     host_lcd_get_row (int row, char *buf);
+
+/** Get the simulated panel's cursor position. */
+extern void     host_lcd_get_cursor (int *row, int *col);
+
+/** The number of controllers showing a cursor (or a blinking block):
+    on a 40x4 panel, this should never be more than one. */
+extern int      host_lcd_cursors (void);
+
+/** TRUE if the backlight is on, and if the display is on. */
+extern bool     host_lcd_backlight (void);
+extern bool     host_lcd_display_on (void);
+
+/** Draw the simulated panel, with a border. */
+extern void     host_lcd_render (FILE *f);
+
+extern const HOST_LCD_STATS *host_lcd_stats (void);
+extern void     host_lcd_reset_stats (void);
+
+/** The number of times that the flash sector containing flash_offs has
+    been erased. */
+extern uint32_t host_flash_erases (uint32_t flash_offs);
+
+/** Set what getchar_timeout_us() returns, for tools that drive the
+    firmware's serial console. The string is consumed one character per
+    call. */
+extern void     host_set_console_input (const char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
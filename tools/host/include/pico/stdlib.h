@@ -0,0 +1,98 @@
+/*===========================================================================
+ * tools/host/include/pico/stdlib.h
+ *
+ * Just enough of the Pico SDK to build the firmware's display and
+ * keyboard code on a Linux host. Time is virtual: it advances only when
+ * the firmware sleeps or busy-waits, or when it transfers data over the (simulated)
+ * I2C bus. See host/host_pico.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifndef MIN
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define PICO_OK 0
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_ERROR_GENERIC -2
+
+#define PICO_DEFAULT_I2C_INSTANCE (&host_i2c0)
+#define PICO_DEFAULT_I2C_SDA_PIN 4
+#define PICO_DEFAULT_I2C_SCL_PIN 5
+
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+typedef uint64_t absolute_time_t;
+
+// As in the SDK, the end of time is the largest signed value, so that
+//   absolute_time_diff_us() works with it
+#define at_the_end_of_time ((absolute_time_t)INT64_MAX)
+#define nil_time ((absolute_time_t)0)
+
+#define __uninitialized_ram(x) x
+#define __not_in_flash_func(x) x
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t host_i2c0;
+
+extern void     sleep_us (uint64_t us);
+extern void     sleep_ms (uint32_t ms);
+extern uint32_t time_us_32 (void);
+extern uint64_t time_us_64 (void);
+
+static inline absolute_time_t get_absolute_time (void)
+  { return time_us_64(); }
+static inline absolute_time_t delayed_by_us (absolute_time_t t, uint64_t us)
+  { return t + us; }
+static inline absolute_time_t delayed_by_ms (absolute_time_t t, uint32_t ms)
+  { return t + (uint64_t)ms * 1000; }
+static inline absolute_time_t make_timeout_time_us (uint64_t us)
+  { return time_us_64() + us; }
+static inline absolute_time_t make_timeout_time_ms (uint32_t ms)
+  { return time_us_64() + (uint64_t)ms * 1000; }
+static inline int64_t absolute_time_diff_us (absolute_time_t from,
+    absolute_time_t to)
+  { return (int64_t)(to - from); }
+static inline absolute_time_t from_us_since_boot (uint64_t us)
+  { return us; }
+static inline uint64_t to_us_since_boot (absolute_time_t t)
+  { return t; }
+static inline uint32_t to_ms_since_boot (absolute_time_t t)
+  { return (uint32_t)(t / 1000); }
+static inline bool time_reached (absolute_time_t t)
+  { return time_us_64() >= t; }
+
+extern void     busy_wait_us_32 (uint32_t us);
+extern void     busy_wait_us (uint64_t us);
+extern void     busy_wait_until (absolute_time_t t);
+extern bool     best_effort_wfe_or_timeout (absolute_time_t t);
+
+static inline void tight_loop_contents (void) {}
+static inline void __wfe (void) {}
+static inline void __sev (void) {}
+
+static inline bool stdio_init_all (void) { return true; }
+extern int      getchar_timeout_us (uint32_t us);
+static inline void stdio_set_chars_available_callback 
+    (void (*fn)(void *), void *param)
+  { (void)fn; (void)param; }
+
+#ifdef __cplusplus
+}
+#endif
+
@@ -0,0 +1,52 @@
+/*===========================================================================
+ * tools/host/include/tusb.h
+ *
+ * The parts of TinyUSB used by the keyboard driver. Every HID interface
+ * is reported to be a keyboard.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <pico/stdlib.h>
+
+typedef struct
+  {
+  uint8_t modifier;
+  uint8_t reserved;
+  uint8_t keycode[6];
+  } hid_keyboard_report_t;
+
+#define KEYBOARD_MODIFIER_LEFTCTRL   0x01
+#define KEYBOARD_MODIFIER_LEFTSHIFT  0x02
+#define KEYBOARD_MODIFIER_LEFTALT    0x04
+#define KEYBOARD_MODIFIER_LEFTGUI    0x08
+#define KEYBOARD_MODIFIER_RIGHTCTRL  0x10
+#define KEYBOARD_MODIFIER_RIGHTSHIFT 0x20
+#define KEYBOARD_MODIFIER_RIGHTALT   0x40
+#define KEYBOARD_MODIFIER_RIGHTGUI   0x80
+
+#define HID_ITF_PROTOCOL_NONE 0
+#define HID_ITF_PROTOCOL_KEYBOARD 1
+
+static inline bool tusb_init (void) { return true; }
+static inline void tuh_task (void) {}
+static inline uint8_t tuh_hid_interface_protocol (uint8_t dev_addr, 
+    uint8_t instance)
+  { (void)dev_addr; (void)instance; return HID_ITF_PROTOCOL_KEYBOARD; }
+static inline bool tuh_hid_receive_report (uint8_t dev_addr, 
+    uint8_t instance)
+  { (void)dev_addr; (void)instance; return true; }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void tuh_hid_report_received_cb (uint8_t dev_addr, uint8_t instance,
+              uint8_t const *report, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
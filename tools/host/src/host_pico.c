@@ -0,0 +1,614 @@
+/*===========================================================================
+ * tools/host/src/host_pico.c
+ *
+ * A simulated Pico, I2C bus, PCF8574 and HD44780, for the host tools. See
+ * host/host_pico.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <hardware/watchdog.h>
+#include <hardware/structs/scb.h>
+#include <hardware/flash.h>
+#include <host/host_pico.h>
+
+// PCF8574 to HD44780 wiring
+#define PCF_RS 0x01
+#define PCF_RW 0x02
+#define PCF_E  0x04
+#define PCF_BL 0x08
+
+struct i2c_inst
+  {
+  unsigned int baud;
+  unsigned int max_baud;  // Transfers fail above this rate; 0 for no limit
+  };
+
+i2c_inst_t host_i2c0 = { 100000, 0 };
+armv6m_scb_hw_t host_scb;
+
+static uint64_t now_us = 0;
+static HOST_LCD_STATS stats;
+static const char *console_input = NULL;
+
+// Execution times of the HD44780, in nanoseconds: clear and home, and
+//   everything else
+#define LCD_SLOW_NS 1520000
+#define LCD_EXEC_NS 37000
+
+// HD44780 state. A 40x4 panel has two.
+typedef struct _HD44780
+  {
+  uint8_t ddram[128];
+  int addr_counter;
+  bool increment;
+  bool display_on;
+  bool cursor_on;
+  bool have_high_nibble;
+  uint8_t high_nibble;
+  uint64_t busy_until_ns;  // When the last byte will have been executed
+  } HD44780;
+
+static HD44780 lcd[2] = { { .increment = true }, { .increment = true } };
+static bool backlight = false;
+static uint8_t pcf_out = 0;
+static int lcd_width = 16;
+static int lcd_height = 2;
+
+// The time at which the byte now being written to the PCF8574, or the 
+//   GPIO pins, appears on the outputs
+static uint64_t write_ns = 0;
+
+// Flash. It starts out all zeros, rather than erased, as if it held
+//   something else. Erasing a sector and programming a page take roughly
+//   the typical times for the Pico's flash chip.
+#define FLASH_ERASE_US 45000
+#define FLASH_PROGRAM_US 700
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+static uint32_t flash_erases[PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE];
+
+// The watchdog: when it runs out, if it has been enabled, and where to
+//   go when it does
+static bool watchdog_armed = false;
+static uint64_t watchdog_timeout_us = 0;
+static uint64_t watchdog_due_us = 0;
+static bool watchdog_fired = false;
+static jmp_buf *watchdog_reset = NULL;
+
+// GPIO state, and the pins that the HD44780 is connected to, if it is
+//   connected directly rather than by I2C
+static uint32_t gpio_out = 0;
+static int gpio_rs = -1;
+static int gpio_e = -1;
+static int gpio_e2 = -1;
+static int gpio_d4 = -1;
+
+/*===========================================================================
+ * dual
+ * TRUE if the panel has two controllers: rows 0 and 1 on the first, and
+ * 2 and 3 on the second. The second's enable line is the PCF8574's RW 
+ * pin.
+ * ========================================================================*/
+static bool dual (void)
+  {
+  return lcd_width > 20 && lcd_height > 2;
+  }
+
+/*===========================================================================
+ * lcd_clear
+ * ========================================================================*/
+static void lcd_clear (HD44780 *h)
+  {
+  memset (h->ddram, ' ', sizeof (h->ddram));
+  h->addr_counter = 0;
+  h->increment = true;
+  }
+
+/*===========================================================================
+ * row_offset
+ * ========================================================================*/
+static int row_offset (int row)
+  {
+  if (dual()) return row % 2 ? 0x40 : 0;
+  switch (row)
+    {
+    case 0: return 0;
+    case 1: return 0x40;
+    case 2: return lcd_width;
+    default: return 0x40 + lcd_width;
+    }
+  }
+
+/*===========================================================================
+ * row_lcd
+ * The controller that shows a row.
+ * ========================================================================*/
+static HD44780 *row_lcd (int row)
+  {
+  return &lcd[dual() && row >= 2 ? 1 : 0];
+  }
+
+/*===========================================================================
+ * next_address
+ * In two-line mode, DDRAM runs 0x00-0x27 and 0x40-0x67, and wraps from
+ * the end of one line to the start of the other.
+ * ========================================================================*/
+static int next_address (int a, bool inc)
+  {
+  if (inc)
+    {
+    a++;
+    if (a == 0x28) a = 0x40;
+    else if (a == 0x68) a = 0x00;
+    }
+  else
+    {
+    a--;
+    if (a == -1) a = 0x67;
+    else if (a == 0x3F) a = 0x27;
+    }
+  return a;
+  }
+
+/*===========================================================================
+ * lcd_execute
+ * ========================================================================*/
+static void lcd_execute (HD44780 *h, uint8_t b, bool rs)
+  {
+  h->busy_until_ns = write_ns + (!rs && b < 0x04 ? LCD_SLOW_NS 
+    : LCD_EXEC_NS);
+  if (rs)
+    {
+    h->ddram[h->addr_counter & 0x7F] = b;
+    h->addr_counter = next_address (h->addr_counter, h->increment);
+    stats.lcd_chars++;
+    return;
+    }
+  stats.lcd_commands++;
+  if (b & 0x80)
+    h->addr_counter = b & 0x7F;
+  else if (b & 0x40)
+    ; // CGRAM address -- not modelled
+  else if (b & 0x20)
+    ; // Function set
+  else if (b & 0x10)
+    {
+    // Cursor or display shift. We only model cursor moves.
+    if (!(b & 0x08)) 
+      h->addr_counter = next_address (h->addr_counter, b & 0x04);
+    }
+  else if (b & 0x08)
+    {
+    h->display_on = (b & 0x04) != 0;
+    h->cursor_on = (b & 0x03) != 0;
+    }
+  else if (b & 0x04)
+    h->increment = (b & 0x02) != 0;
+  else if (b & 0x02)
+    h->addr_counter = 0;
+  else if (b & 0x01)
+    lcd_clear (h);
+  }
+
+/*===========================================================================
+ * lcd_latch
+ * The HD44780 has latched a nibble. In 4-bit mode, every second nibble
+ * completes a byte. A nibble that arrives while the controller is still
+ * executing the last byte is counted as an overrun; a real one might
+ * lose it.
+ * ========================================================================*/
+static void lcd_latch (HD44780 *h, uint8_t nibble, bool rs)
+  {
+  if (write_ns < h->busy_until_ns) stats.lcd_overruns++;
+  if (h->have_high_nibble)
+    {
+    lcd_execute (h, (uint8_t)(h->high_nibble << 4 | nibble), rs);
+    h->have_high_nibble = false;
+    }
+  else
+    {
+    h->high_nibble = nibble;
+    h->have_high_nibble = true;
+    }
+  }
+
+/*===========================================================================
+ * pcf_write
+ * The HD44780 latches data on the falling edge of E. On a panel with
+ * one controller, RW must be low; on a panel with two, RW is the
+ * second one's E.
+ * ========================================================================*/
+static void pcf_write (uint8_t b)
+  {
+  bool falling_e = (pcf_out & PCF_E) && !(b & PCF_E);
+  bool falling_rw = (pcf_out & PCF_RW) && !(b & PCF_RW);
+  if (dual())
+    {
+    if (falling_e) lcd_latch (&lcd[0], pcf_out >> 4, pcf_out & PCF_RS);
+    if (falling_rw) lcd_latch (&lcd[1], pcf_out >> 4, pcf_out & PCF_RS);
+    }
+  else if (falling_e && !(pcf_out & PCF_RW))
+    lcd_latch (&lcd[0], pcf_out >> 4, pcf_out & PCF_RS);
+  pcf_out = b;
+  backlight = (b & PCF_BL) != 0;
+  }
+
+/*===========================================================================
+ * gpio_write
+ * As pcf_write(), for an HD44780 wired directly to the GPIO pins.
+ * ========================================================================*/
+static void gpio_write (uint32_t value)
+  {
+  write_ns = now_us * 1000;
+  for (int i = 0; i < 2; i++)
+    {
+    int e = i == 0 ? gpio_e : gpio_e2;
+    if (e >= 0 && (gpio_out & (1u << e)) && !(value & (1u << e)))
+      lcd_latch (&lcd[i], (gpio_out >> gpio_d4) & 0x0F, 
+        gpio_out & (1u << gpio_rs));
+    }
+  gpio_out = value;
+  }
+
+/*===========================================================================
+ * advance
+ * Move time on, while the firmware is doing something. If that lets the
+ * watchdog run out, the Pico "resets".
+ * ========================================================================*/
+static void advance (uint64_t us)
+  {
+  now_us += us;
+  if (watchdog_armed && now_us >= watchdog_due_us)
+    {
+    // As on the RP2040, the watchdog is off again after the reset
+    watchdog_armed = false;
+    watchdog_fired = true;
+    stats.watchdog_resets++;
+    if (watchdog_reset) longjmp (*watchdog_reset, 1);
+    }
+  }
+
+/*===========================================================================
+ * Pico SDK time functions
+ * ========================================================================*/
+void sleep_us (uint64_t us)
+  {
+  advance (us);
+  stats.sleep_us += us;
+  }
+
+void sleep_ms (uint32_t ms)
+  {
+  sleep_us ((uint64_t)ms * 1000);
+  }
+
+uint32_t time_us_32 (void)
+  {
+  return (uint32_t)now_us;
+  }
+
+uint64_t time_us_64 (void)
+  {
+  return now_us;
+  }
+
+void busy_wait_us_32 (uint32_t us)
+  {
+  busy_wait_us (us);
+  }
+
+void busy_wait_us (uint64_t us)
+  {
+  advance (us);
+  stats.busy_wait_us += us;
+  }
+
+void busy_wait_until (absolute_time_t t)
+  {
+  if (t > now_us) busy_wait_us (t - now_us);
+  }
+
+bool best_effort_wfe_or_timeout (absolute_time_t t)
+  {
+  if (t != at_the_end_of_time && t > now_us) advance (t - now_us);
+  return true;
+  }
+
+int getchar_timeout_us (uint32_t us)
+  {
+  (void)us;
+  if (console_input && *console_input) return *console_input++;
+  return PICO_ERROR_TIMEOUT;
+  }
+
+/*===========================================================================
+ * Pico SDK GPIO functions
+ * ========================================================================*/
+void gpio_put (unsigned int gpio, bool value)
+  {
+  uint32_t bit = 1u << gpio;
+  gpio_write (value ? (gpio_out | bit) : (gpio_out & ~bit));
+  }
+
+void gpio_put_masked (uint32_t mask, uint32_t value)
+  {
+  gpio_write ((gpio_out & ~mask) | (value & mask));
+  }
+
+void gpio_set_mask (uint32_t mask)
+  {
+  gpio_write (gpio_out | mask);
+  }
+
+void gpio_clr_mask (uint32_t mask)
+  {
+  gpio_write (gpio_out & ~mask);
+  }
+
+/*===========================================================================
+ * Pico SDK I2C functions
+ * ========================================================================*/
+unsigned int i2c_init (i2c_inst_t *i2c, unsigned int baudrate)
+  {
+  lcd_clear (&lcd[0]);
+  lcd_clear (&lcd[1]);
+  return i2c_set_baudrate (i2c, baudrate);
+  }
+
+unsigned int i2c_set_baudrate (i2c_inst_t *i2c, unsigned int baudrate)
+  {
+  i2c->baud = baudrate;
+  return baudrate;
+  }
+
+/*===========================================================================
+ * i2c_bus_fails
+ * If the bus is running faster than its limit, the PCF8574 doesn't
+ * recognize its address. We still pay for the address byte.
+ * ========================================================================*/
+static bool i2c_bus_fails (i2c_inst_t *i2c)
+  {
+  if (i2c->max_baud == 0 || i2c->baud <= i2c->max_baud) return false;
+  uint64_t us = (uint64_t)9 * 1000000 / i2c->baud;
+  advance (us);
+  stats.i2c_busy_us += us;
+  stats.i2c_errors++;
+  return true;
+  }
+
+static void i2c_bus_time (i2c_inst_t *i2c, size_t len)
+  {
+  // Address byte plus data, nine clocks each (eight bits and an ACK)
+  uint64_t us = (uint64_t)(len + 1) * 9 * 1000000 / i2c->baud;
+  advance (us);
+  stats.i2c_busy_us += us;
+  stats.i2c_transactions++;
+  stats.i2c_bytes += len;
+  }
+
+int i2c_write_blocking (i2c_inst_t *i2c, uint8_t addr, const uint8_t *src,
+      size_t len, bool nostop)
+  {
+  (void)addr; (void)nostop;
+  uint64_t start_ns = now_us * 1000;
+  i2c_bus_time (i2c, len);
+  for (size_t i = 0; i < len; i++) 
+    {
+    // Each byte is on the outputs once it, and the address, have been
+    //   clocked out
+    write_ns = start_ns + (uint64_t)(i + 2) * 9000000000ULL / i2c->baud;
+    pcf_write (src[i]);
+    }
+  return (int)len;
+  }
+
+int i2c_read_blocking (i2c_inst_t *i2c, uint8_t addr, uint8_t *dst,
+      size_t len, bool nostop)
+  {
+  (void)addr; (void)nostop;
+  i2c_bus_time (i2c, len);
+  for (size_t i = 0; i < len; i++) dst[i] = pcf_out;
+  return (int)len;
+  }
+
+int i2c_write_timeout_us (i2c_inst_t *i2c, uint8_t addr, const uint8_t *src,
+      size_t len, bool nostop, unsigned int timeout_us)
+  {
+  (void)timeout_us;
+  if (i2c_bus_fails (i2c)) return PICO_ERROR_GENERIC;
+  return i2c_write_blocking (i2c, addr, src, len, nostop);
+  }
+
+int i2c_read_timeout_us (i2c_inst_t *i2c, uint8_t addr, uint8_t *dst,
+      size_t len, bool nostop, unsigned int timeout_us)
+  {
+  (void)timeout_us;
+  if (i2c_bus_fails (i2c)) return PICO_ERROR_GENERIC;
+  return i2c_read_blocking (i2c, addr, dst, len, nostop);
+  }
+
+/*===========================================================================
+ * Pico SDK flash functions
+ * ========================================================================*/
+void flash_range_erase (uint32_t flash_offs, size_t count)
+  {
+  for (size_t i = 0; i < count; i += FLASH_SECTOR_SIZE)
+    {
+    flash_erases[(flash_offs + i) / FLASH_SECTOR_SIZE]++;
+    advance (FLASH_ERASE_US);
+    }
+  memset (host_flash + flash_offs, 0xFF, count);
+  }
+
+void flash_range_program (uint32_t flash_offs, const uint8_t *data, 
+       size_t count)
+  {
+  // Programming can only clear bits
+  for (size_t i = 0; i < count; i++)
+    host_flash[flash_offs + i] &= data[i];
+  advance (FLASH_PROGRAM_US * ((count + FLASH_PAGE_SIZE - 1) 
+    / FLASH_PAGE_SIZE));
+  }
+
+/*===========================================================================
+ * Pico SDK watchdog functions
+ * ========================================================================*/
+void watchdog_enable (uint32_t delay_ms, bool pause_on_debug)
+  {
+  (void)pause_on_debug;
+  watchdog_timeout_us = (uint64_t)delay_ms * 1000;
+  watchdog_armed = true;
+  watchdog_update();
+  }
+
+void watchdog_update (void)
+  {
+  watchdog_due_us = now_us + watchdog_timeout_us;
+  }
+
+bool watchdog_caused_reboot (void)
+  {
+  return watchdog_fired;
+  }
+
+/*===========================================================================
+ * host_ functions
+ * ========================================================================*/
+void host_advance_us (uint64_t us)
+  {
+  // The device is idle, but its main loop would still be feeding the
+  //   watchdog
+  now_us += us;
+  if (watchdog_armed) watchdog_update();
+  }
+
+void host_watchdog_set_reset (jmp_buf *reset)
+  {
+  watchdog_reset = reset;
+  }
+
+void host_lcd_set_geometry (int width, int height)
+  {
+  lcd_width = width;
+  lcd_height = height;
+  lcd_clear (&lcd[0]);
+  lcd_clear (&lcd[1]);
+  }
+
+void host_i2c_set_max_baud (unsigned int baud)
+  {
+  host_i2c0.max_baud = baud;
+  }
+
+unsigned int host_i2c_get_baud (void)
+  {
+  return host_i2c0.baud;
+  }
+
+void host_lcd_set_gpio (int rs, int e, int d4)
+  {
+  host_lcd_set_gpio_dual (rs, e, -1, d4);
+  }
+
+void host_lcd_set_gpio_dual (int rs, int e, int e2, int d4)
+  {
+  gpio_rs = rs;
+  gpio_e = e;
+  gpio_e2 = e2;
+  gpio_d4 = d4;
+  // The backlight isn't modelled on GPIO; assume it's wired on
+  backlight = true;
+  }
+
+void host_lcd_get_row (int row, char *buf)
+  {
+  int offset = row_offset (row);
+  const HD44780 *h = row_lcd (row);
+  for (int i = 0; i < lcd_width; i++)
+    {
+    uint8_t c = h->ddram[(offset + i) & 0x7F];
+    buf[i] = (c >= 32 && c < 127) ? (char)c : '?';
+    }
+  buf[lcd_width] = 0;
+  }
+
+void host_lcd_get_cursor (int *row, int *col)
+  {
+  // On a panel with two controllers, the cursor is on the one that's 
+  //   showing one
+  const HD44780 *h = &lcd[dual() && lcd[1].cursor_on ? 1 : 0];
+  *row = 0; *col = 0;
+  for (int r = 0; r < lcd_height; r++)
+    {
+    int offset = row_offset (r);
+    if (row_lcd (r) == h && h->addr_counter >= offset 
+         && h->addr_counter < offset + lcd_width)
+      {
+      *row = r;
+      *col = h->addr_counter - offset;
+      return;
+      }
+    }
+  }
+
+int host_lcd_cursors (void)
+  {
+  return lcd[0].cursor_on + (dual() && lcd[1].cursor_on);
+  }
+
+bool host_lcd_backlight (void)
+  {
+  return backlight;
+  }
+
+bool host_lcd_display_on (void)
+  {
+  return lcd[0].display_on && (!dual() || lcd[1].display_on);
+  }
+
+void host_lcd_render (FILE *f)
+  {
+  char row[128 + 1];
+  int crow, ccol;
+  host_lcd_get_cursor (&crow, &ccol);
+  fputc ('+', f);
+  for (int i = 0; i < lcd_width; i++) fputc ('-', f);
+  fprintf (f, "+ %s%s\n", host_lcd_display_on() ? "" : "[display off] ",
+    backlight ? "" : "[backlight off]");
+  for (int r = 0; r < lcd_height; r++)
+    {
+    host_lcd_get_row (r, row);
+    fprintf (f, "|%s|", row);
+    if (host_lcd_cursors() && r == crow) fprintf (f, " <- cursor col %d", ccol);
+    fputc ('\n', f);
+    }
+  fputc ('+', f);
+  for (int i = 0; i < lcd_width; i++) fputc ('-', f);
+  fprintf (f, "+\n");
+  }
+
+const HOST_LCD_STATS *host_lcd_stats (void)
+  {
+  return &stats;
+  }
+
+void host_lcd_reset_stats (void)
+  {
+  memset (&stats, 0, sizeof (stats));
+  }
+
+uint32_t host_flash_erases (uint32_t flash_offs)
+  {
+  return flash_erases[flash_offs / FLASH_SECTOR_SIZE];
+  }
+
+void host_set_console_input (const char *s)
+  {
+  console_input = s;
+  }
+
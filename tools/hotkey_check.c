@@ -0,0 +1,276 @@
+/*===========================================================================
+ * tools/hotkey_check.c
+ *
+ * Checks the key bindings and kbd_to_ascii(), and measures how long it
+ * takes to find what a key is bound to.
+ *
+ * First, kbd_to_ascii() is given the combinations of Shift, Ctrl, and
+ * Alt that it used to get wrong, and the results compared with what a
+ * terminal would send.
+ *
+ * Then the time to look up a key in the binding table is compared with
+ * searching a list of the same bindings, as a table of (key, action)
+ * pairs would be searched. The table takes the same time however many
+ * keys are bound.
+ *
+ * Last, keyboard reports are pushed through the firmware on the
+ * simulated Pico, to check that the default bindings do what they
+ * should, and that a key bound at run time with the 'K' serial command
+ * takes effect.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <kbd/kbd.h>
+#include "config.h"
+#include "replay.h"
+
+// Defined in main.c
+extern I2C_LCD *i2c_lcd;
+extern absolute_time_t app_poll (void);
+extern bool app_ready (void);
+
+// HID modifier bits
+#define MOD_CTRL 0x01
+#define MOD_SHIFT 0x02
+#define MOD_ALT 0x04
+
+#define LOOKUPS 10000000
+
+typedef struct _ASCII_CASE
+  {
+  int code;
+  int flags;
+  int expect;
+  } ASCII_CASE;
+
+static const ASCII_CASE ascii_cases[] =
+  {
+  { 'a', 0, 'a' },
+  { 'A', KBD_FLAG_SHIFT, 'A' },
+  { 'a', KBD_FLAG_CONTROL, 1 },
+  { 'A', KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, 1 },
+  { 'z', KBD_FLAG_CONTROL, 26 },
+  { '[', KBD_FLAG_CONTROL, 27 },
+  { '{', KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, 27 },
+  { '\\', KBD_FLAG_CONTROL, 28 },
+  { '^', KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, 30 },
+  { '6', KBD_FLAG_CONTROL, 30 },
+  { '_', KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, 31 },
+  { '-', KBD_FLAG_CONTROL, 31 },
+  { '?', KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, 127 },
+  { '1', KBD_FLAG_CONTROL, 0 },
+  { '!', KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, 0 },
+  { '@', KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, 0 },
+  { KBD_KEY_ENTER, KBD_FLAG_CONTROL, KBD_KEY_ENTER },
+  { KBD_KEY_BS, KBD_FLAG_SHIFT | KBD_FLAG_CONTROL, KBD_KEY_BS },
+  { 'a', KBD_FLAG_ALT, 0 },
+  { 'A', KBD_FLAG_SHIFT | KBD_FLAG_ALT, 0 },
+  { 'a', KBD_FLAG_CONTROL | KBD_FLAG_ALT, 0 },
+  { '1', KBD_FLAG_ALT, 0 },
+  { KBD_KEY_UP, KBD_FLAG_CONTROL, 0 },
+  };
+
+typedef struct _PAIR
+  {
+  int code;
+  int flags;
+  int action;
+  } PAIR;
+
+/*===========================================================================
+ * check_ascii
+ * Returns the number of failures.
+ * ========================================================================*/
+static int check_ascii (void)
+  {
+  int failures = 0;
+  int n = sizeof (ascii_cases) / sizeof (ascii_cases[0]);
+  for (int i = 0; i < n; i++)
+    {
+    const ASCII_CASE *c = &ascii_cases[i];
+    int got = (unsigned char)kbd_to_ascii (c->code, c->flags);
+    if (got != c->expect)
+      {
+      char name[24];
+      kbd_key_name (c->code, c->flags, name, sizeof (name));
+      printf ("  %-16s gave %d, should be %d\n", name, got, c->expect);
+      failures++;
+      }
+    }
+  printf ("kbd_to_ascii:        %d of %d right\n", n - failures, n);
+  return failures;
+  }
+
+/*===========================================================================
+ * lookup_list
+ * ========================================================================*/
+static int lookup_list (const PAIR *pairs, int n, int code, int flags)
+  {
+  for (int i = 0; i < n; i++)
+    if (pairs[i].code == code && pairs[i].flags == flags)
+      return pairs[i].action;
+  return KBD_BIND_NONE;
+  }
+
+/*===========================================================================
+ * time_lookups
+ * Bind n keys, and time looking up keys at random, in the table and in
+ * a list. Returns the number of times the two disagreed.
+ * ========================================================================*/
+static int time_lookups (int n)
+  {
+  static unsigned char table[KBD_BIND_SLOTS];
+  static PAIR pairs[KBD_BIND_SLOTS];
+  static int codes[1024], flags[1024];
+  memset (table, 0, sizeof (table));
+  for (int i = 0; i < n; i++)
+    {
+    // Each i gives a different key: one of the 95 printable characters
+    //   or 20 virtual keys, with one of the combinations of modifiers
+    int k = (i * 7919) % (115 * KBD_BIND_MODS);
+    int code = k / KBD_BIND_MODS < 95 ? ' ' + k / KBD_BIND_MODS 
+      : KBD_KEY_DOWN + k / KBD_BIND_MODS - 95;
+    int f = k % KBD_BIND_MODS;
+    pairs[i].code = code;
+    pairs[i].flags = f;
+    pairs[i].action = 1 + i % 200;
+    kbd_bind (table, code, f, pairs[i].action);
+    }
+  // Keys to look up: mostly unbound, as typing would be
+  for (int i = 0; i < 1024; i++)
+    {
+    codes[i] = rand() % 4 ? ' ' + rand() % 95 : KBD_KEY_DOWN + rand() % 20;
+    flags[i] = rand() % 4 ? 0 : rand() % KBD_BIND_MODS;
+    }
+
+  int wrong = 0;
+  volatile int sink = 0;
+  uint64_t start = replay_wall_us();
+  for (int i = 0; i < LOOKUPS; i++)
+    sink += kbd_binding (table, codes[i & 1023], flags[i & 1023]);
+  uint64_t table_us = replay_wall_us() - start;
+  start = replay_wall_us();
+  for (int i = 0; i < LOOKUPS / 10; i++)
+    sink += lookup_list (pairs, n, codes[i & 1023], flags[i & 1023]);
+  uint64_t list_us = (replay_wall_us() - start) * 10;
+  for (int i = 0; i < 1024; i++)
+    if (kbd_binding (table, codes[i], flags[i])
+         != lookup_list (pairs, n, codes[i], flags[i]))
+      wrong++;
+
+  printf ("%-8d %-14.2f %-14.2f %s\n", n, table_us * 1000.0 / LOOKUPS,
+    list_us * 1000.0 / LOOKUPS, wrong ? "WRONG" : "ok");
+  return wrong;
+  }
+
+/*===========================================================================
+ * settle
+ * Run the firmware's tasks until there's nothing left for them to do.
+ * ========================================================================*/
+static void settle (void)
+  {
+  for (int i = 0; i < 20; i++)
+    {
+    absolute_time_t due = app_poll();
+    if (due != at_the_end_of_time && due > time_us_64())
+      host_advance_us (due - time_us_64());
+    }
+  }
+
+/*===========================================================================
+ * press
+ * Press and release a key.
+ * ========================================================================*/
+static void press (uint8_t modifiers, uint8_t keycode)
+  {
+  uint8_t down[8] = { modifiers, 0, keycode, 0, 0, 0, 0, 0 };
+  uint8_t up[8] = { 0 };
+  REPLAY_RECORD rec = { 0, 1, 0, 8, down };
+  replay_report (&rec);
+  host_advance_us (20000);
+  rec.report = up;
+  replay_report (&rec);
+  host_advance_us (20000);
+  settle();
+  }
+
+/*===========================================================================
+ * row_starts
+ * ========================================================================*/
+static bool row_starts (int row, const char *s)
+  {
+  char buf[64];
+  host_lcd_get_row (row, buf);
+  return strncmp (buf, s, strlen (s)) == 0;
+  }
+
+/*===========================================================================
+ * check_firmware
+ * ========================================================================*/
+static void check_firmware (void)
+  {
+  replay_init_firmware();
+  while (!app_ready()) settle();
+  I2C_LCD *first = i2c_lcd;
+
+  printf ("firmware:\n");
+  press (MOD_ALT, 0x0F); // Alt+l
+  replay_expect ("Alt+L clears the screen", row_starts (0, "    "));
+  press (0, 0x04); // a
+  press (MOD_SHIFT, 0x05); // B
+  replay_expect ("a, Shift+B typed", row_starts (0, "aB "));
+  press (MOD_ALT, 0x04); // Alt+a
+  replay_expect ("Alt+a not typed", row_starts (0, "aB "));
+  press (0, 0x50); // Left
+  press (MOD_CTRL | MOD_SHIFT, 0x07); // Shift+Ctrl+D, delete at cursor
+  replay_expect ("Shift+Ctrl+D deletes, as Ctrl+D does",
+    row_starts (0, "a "));
+  press (MOD_ALT, 0x05); // Alt+b
+  replay_expect ("Alt+B turns the backlight off",
+    !host_lcd_backlight());
+  press (MOD_ALT, 0x05);
+  replay_expect ("Alt+B turns it on again", host_lcd_backlight());
+  press (MOD_ALT, 0x3B); // Alt+F2
+  replay_expect ("Alt+F2 switches console", i2c_lcd != first);
+  press (MOD_ALT, 0x3A); // Alt+F1
+  replay_expect ("Alt+F1 switches back", i2c_lcd == first);
+
+  // Bind F5 to clearing the screen, from the serial console: 'K', then
+  //   the action's letter, then the key
+  host_set_console_input ("Kh");
+  settle();
+  press (0, 0x3E); // F5
+  press (0, 0x1B); // x
+  press (0, 0x1C); // y
+  replay_expect ("x, y typed", row_starts (0, "axy"));
+  press (0, 0x3E);
+  replay_expect ("F5, bound at run time, clears the screen",
+    row_starts (0, "   "));
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  int failures = check_ascii();
+
+  printf ("\n%-8s %-14s %-14s\n", "bound", "table ns/key", "list ns/key");
+  static const int sizes[] = { 8, 32, 128, 512 };
+  for (int i = 0; i < 4; i++) failures += time_lookups (sizes[i]);
+  printf ("binding table:       %d bytes\n\n", KBD_BIND_SLOTS);
+
+  check_firmware();
+  failures += replay_failures();
+  printf ("\n%s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+  }
+
@@ -0,0 +1,495 @@
+/*===========================================================================
+ * tools/i2c_decode.c
+ *
+ * Decoding of I2C traces. See i2c_decode.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <i2c_lcd/i2c_trace.h>
+#include "i2c_decode.h"
+
+// A VCD file, or NULL for none, and the time last written to it
+typedef struct _VCD
+  {
+  FILE *f;
+  uint64_t time_ns;
+  bool started;
+  } VCD;
+
+/*===========================================================================
+ * hex_value
+ * ========================================================================*/
+static int hex_value (int c)
+  {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+  }
+
+/*===========================================================================
+ * i2c_trace_load
+ * ========================================================================*/
+uint8_t *i2c_trace_load (const char *filename, size_t *size)
+  {
+  FILE *f = fopen (filename, "rb");
+  if (!f)
+    {
+    perror (filename);
+    return NULL;
+    }
+  size_t cap = 4096, n = 0;
+  uint8_t *buf = malloc (cap);
+  int c;
+  while ((c = fgetc (f)) != EOF)
+    {
+    if (n == cap) buf = realloc (buf, cap *= 2);
+    buf[n++] = (uint8_t)c;
+    }
+  fclose (f);
+
+  // A text dump, saved on its own, starts "I2CTRACE", which starts
+  //   with the magic too
+  if (n >= 4 && memcmp (buf, I2C_TRACE_MAGIC, 4) == 0
+      && !(n >= 8 && memcmp (buf, "I2CTRACE", 8) == 0))
+    {
+    *size = n;
+    return buf;
+    }
+
+  // Not binary -- look for a text dump
+  char *text = malloc (n + 1);
+  memcpy (text, buf, n);
+  text[n] = 0;
+  char *p = strstr (text, "I2CTRACE BEGIN");
+  size_t out = 0;
+  if (p)
+    {
+    p = strchr (p, '\n');
+    while (p && *p)
+      {
+      p++;
+      if (strncmp (p, "I2CTRACE END", 12) == 0) break;
+      while (*p && *p != '\n')
+        {
+        int hi = hex_value (p[0]);
+        int lo = hi >= 0 ? hex_value (p[1]) : -1;
+        if (hi < 0 || lo < 0) { p++; continue; }
+        buf[out++] = (uint8_t)(hi << 4 | lo);
+        p += 2;
+        }
+      }
+    }
+  free (text);
+
+  if (out < I2C_TRACE_HEADER_SIZE || memcmp (buf, I2C_TRACE_MAGIC, 4) != 0)
+    {
+    fprintf (stderr, "%s: not an I2C trace\n", filename);
+    free (buf);
+    return NULL;
+    }
+  *size = out;
+  return buf;
+  }
+
+/*===========================================================================
+ * get_varint
+ * ========================================================================*/
+static uint32_t get_varint (const uint8_t *trace, size_t size, size_t *p)
+  {
+  uint32_t v = 0;
+  int shift = 0;
+  while (*p < size)
+    {
+    uint8_t b = trace[(*p)++];
+    v |= (uint32_t)(b & 0x7F) << shift;
+    shift += 7;
+    if (!(b & 0x80)) break;
+    }
+  return v;
+  }
+
+/*===========================================================================
+ * i2c_trace_next
+ * ========================================================================*/
+int i2c_trace_next (const uint8_t *trace, size_t size, size_t *pos,
+      I2C_TRACE_RECORD *rec)
+  {
+  size_t p = *pos;
+  if (p < I2C_TRACE_HEADER_SIZE) p = I2C_TRACE_HEADER_SIZE;
+  rec->delta_us = get_varint (trace, size, &p);
+  rec->duration_us = get_varint (trace, size, &p);
+  if (p + 3 > size) return 0;
+  rec->addr = trace[p] >> 1;
+  rec->read = trace[p] & 1;
+  rec->result = trace[p + 1];
+  rec->len = trace[p + 2];
+  p += 3;
+  if (p + rec->len > size) return 0;
+  rec->data = trace + p;
+  *pos = p + rec->len;
+  return 1;
+  }
+
+/*===========================================================================
+ * lcd_decoder_init
+ * ========================================================================*/
+void lcd_decoder_init (LCD_DECODER *d, bool dual)
+  {
+  memset (d, 0, sizeof (LCD_DECODER));
+  d->dual = dual;
+  for (int i = 0; i < 2; i++)
+    {
+    LCD_MODEL *m = &d->lcd[i];
+    m->increment = true;
+    m->entry = m->display = m->function = -1;
+    memset (m->ddram, ' ', sizeof (m->ddram));
+    }
+  }
+
+/*===========================================================================
+ * next_address
+ * As the HD44780 counts in two-line mode: 0x00-0x27, then 0x40-0x67.
+ * ========================================================================*/
+static int next_address (int a, bool inc)
+  {
+  if (inc)
+    {
+    a++;
+    if (a == 0x28) a = 0x40;
+    else if (a == 0x68) a = 0x00;
+    }
+  else
+    {
+    a--;
+    if (a == -1) a = 0x67;
+    else if (a == 0x3F) a = 0x27;
+    }
+  return a;
+  }
+
+/*===========================================================================
+ * same
+ * Note the latest of a kind of command, and say whether it was the same
+ * as the last.
+ * ========================================================================*/
+static bool same (int *last, uint8_t b)
+  {
+  bool r = *last == b;
+  *last = b;
+  return r;
+  }
+
+/*===========================================================================
+ * execute
+ * Returns TRUE if the byte was a command that changed nothing.
+ * ========================================================================*/
+static bool execute (LCD_MODEL *m, uint8_t b, bool rs)
+  {
+  if (rs)
+    {
+    m->ddram[m->addr & 0x7F] = b;
+    m->addr = next_address (m->addr, m->increment);
+    return false;
+    }
+  if (b & 0x80)
+    {
+    bool r = m->addr == (b & 0x7F);
+    m->addr = b & 0x7F;
+    return r;
+    }
+  if (b & 0x40) return false;
+  if (b & 0x20) return same (&m->function, b);
+  if (b & 0x10)
+    {
+    if (!(b & 0x08)) m->addr = next_address (m->addr, b & 0x04);
+    return false;
+    }
+  if (b & 0x08) return same (&m->display, b);
+  if (b & 0x04)
+    {
+    m->increment = (b & 0x02) != 0;
+    return same (&m->entry, b);
+    }
+  if (b & 0x02)
+    {
+    bool r = m->addr == 0;
+    m->addr = 0;
+    return r;
+    }
+  if (b & 0x01)
+    {
+    memset (m->ddram, ' ', sizeof (m->ddram));
+    m->addr = 0;
+    m->increment = true;
+    }
+  return false;
+  }
+
+/*===========================================================================
+ * latch
+ * ========================================================================*/
+static int latch (LCD_DECODER *d, int c, LCD_BYTE *out)
+  {
+  LCD_MODEL *m = &d->lcd[c];
+  uint8_t nibble = d->pins >> 4;
+  if (!m->have_high)
+    {
+    m->high = nibble;
+    m->have_high = true;
+    return 0;
+    }
+  m->have_high = false;
+  out->controller = c;
+  out->value = (uint8_t)(m->high << 4 | nibble);
+  out->rs = (d->pins & PCF_RS) != 0;
+  out->redundant = execute (m, out->value, out->rs);
+  return 1;
+  }
+
+/*===========================================================================
+ * lcd_decoder_write
+ * The HD44780 latches on the falling edge of E. On a 40x4, RW is the
+ * second controller's E; otherwise, RW must be low.
+ * ========================================================================*/
+int lcd_decoder_write (LCD_DECODER *d, uint8_t pins, LCD_BYTE out[2])
+  {
+  bool falling_e = (d->pins & PCF_E) && !(pins & PCF_E);
+  bool falling_rw = (d->pins & PCF_RW) && !(pins & PCF_RW);
+  int n = 0;
+  if (d->dual)
+    {
+    if (falling_e) n += latch (d, 0, &out[n]);
+    if (falling_rw) n += latch (d, 1, &out[n]);
+    }
+  else if (falling_e && !(d->pins & PCF_RW))
+    n += latch (d, 0, &out[n]);
+  d->pins = pins;
+  return n;
+  }
+
+/*===========================================================================
+ * lcd_command_name
+ * ========================================================================*/
+const char *lcd_command_name (uint8_t b)
+  {
+  if (b & 0x80) return "DDRAM address";
+  if (b & 0x40) return "CGRAM address";
+  if (b & 0x20) return "function set";
+  if (b & 0x10) return "shift";
+  if (b & 0x08) return "display control";
+  if (b & 0x04) return "entry mode";
+  if (b & 0x02) return "home";
+  if (b & 0x01) return "clear";
+  return "?";
+  }
+
+/*===========================================================================
+ * vcd_at
+ * ========================================================================*/
+static void vcd_at (VCD *v, uint64_t ns)
+  {
+  if (!v->f) return;
+  if (v->started && ns <= v->time_ns) return;
+  fprintf (v->f, "#%llu\n", (unsigned long long)ns);
+  v->time_ns = ns;
+  v->started = true;
+  }
+
+/*===========================================================================
+ * vcd_bits
+ * A value of n bits, as a binary vector.
+ * ========================================================================*/
+static void vcd_bits (VCD *v, uint32_t value, int n, char id)
+  {
+  if (!v->f) return;
+  fputc ('b', v->f);
+  for (int i = n - 1; i >= 0; i--) fputc ((value >> i) & 1 ? '1' : '0', v->f);
+  fprintf (v->f, " %c\n", id);
+  }
+
+/*===========================================================================
+ * vcd_bit
+ * ========================================================================*/
+static void vcd_bit (VCD *v, bool value, char id)
+  {
+  if (v->f) fprintf (v->f, "%d%c\n", value ? 1 : 0, id);
+  }
+
+/*===========================================================================
+ * vcd_header
+ * ========================================================================*/
+static void vcd_header (VCD *v, bool dual)
+  {
+  if (!v->f) return;
+  fprintf (v->f, "$version i2c_vcd $end\n$timescale 1ns $end\n");
+  fprintf (v->f, "$scope module pcf8574 $end\n");
+  fprintf (v->f, "$var wire 1 ! rs $end\n");
+  fprintf (v->f, "$var wire 1 \" %s $end\n", dual ? "e2" : "rw");
+  fprintf (v->f, "$var wire 1 # e $end\n");
+  fprintf (v->f, "$var wire 1 $ backlight $end\n");
+  fprintf (v->f, "$var wire 4 %% data $end\n");
+  fprintf (v->f, "$upscope $end\n$scope module bus $end\n");
+  fprintf (v->f, "$var wire 1 & busy $end\n");
+  fprintf (v->f, "$var wire 1 ' error $end\n");
+  fprintf (v->f, "$var integer 32 ( gap_us $end\n");
+  fprintf (v->f, "$upscope $end\n$scope module hd44780 $end\n");
+  fprintf (v->f, "$var wire 8 ) byte $end\n");
+  fprintf (v->f, "$var wire 1 * rs $end\n");
+  fprintf (v->f, "$var wire 1 + controller $end\n");
+  fprintf (v->f, "$var wire 1 , redundant $end\n");
+  fprintf (v->f, "$upscope $end\n$enddefinitions $end\n");
+  vcd_at (v, 0);
+  fprintf (v->f, "$dumpvars\n");
+  vcd_bit (v, false, '!');
+  vcd_bit (v, false, '"');
+  vcd_bit (v, false, '#');
+  vcd_bit (v, false, '$');
+  vcd_bits (v, 0, 4, '%');
+  vcd_bit (v, false, '&');
+  vcd_bit (v, false, '\'');
+  vcd_bits (v, 0, 32, '(');
+  vcd_bits (v, 0, 8, ')');
+  vcd_bit (v, false, '*');
+  vcd_bit (v, false, '+');
+  vcd_bit (v, false, ',');
+  fprintf (v->f, "$end\n");
+  }
+
+/*===========================================================================
+ * vcd_pins
+ * Write the outputs that have changed.
+ * ========================================================================*/
+static void vcd_pins (VCD *v, uint8_t old, uint8_t pins)
+  {
+  uint8_t changed = old ^ pins;
+  if (changed & PCF_RS) vcd_bit (v, pins & PCF_RS, '!');
+  if (changed & PCF_RW) vcd_bit (v, pins & PCF_RW, '"');
+  if (changed & PCF_E) vcd_bit (v, pins & PCF_E, '#');
+  if (changed & PCF_BL) vcd_bit (v, pins & PCF_BL, '$');
+  if (changed & 0xF0) vcd_bits (v, pins >> 4, 4, '%');
+  }
+
+/*===========================================================================
+ * note_gap
+ * Keep the longest gaps, longest first.
+ * ========================================================================*/
+static void note_gap (I2C_SUMMARY *s, uint64_t at_us, uint32_t us,
+      bool after_byte, const LCD_BYTE *after)
+  {
+  s->gaps++;
+  s->gap_us += us;
+  int i = I2C_LONGEST;
+  while (i > 0 && s->longest[i - 1].us < us) i--;
+  if (i == I2C_LONGEST) return;
+  memmove (&s->longest[i + 1], &s->longest[i],
+    (I2C_LONGEST - 1 - i) * sizeof (I2C_GAP));
+  s->longest[i].at_us = at_us;
+  s->longest[i].us = us;
+  s->longest[i].after_byte = after_byte;
+  if (after_byte) s->longest[i].after = *after;
+  }
+
+/*===========================================================================
+ * i2c_trace_decode
+ * Each byte of a write is on the PCF8574's outputs once it, and the
+ * bytes before it, and the address, have been clocked out. The bytes are
+ * spread evenly through the transfer's duration on that basis.
+ * ========================================================================*/
+void i2c_trace_decode (const uint8_t *trace, size_t size, LCD_DECODER *d,
+      FILE *vcd, I2C_SUMMARY *s)
+  {
+  VCD v = { vcd, 0, false };
+  memset (s, 0, sizeof (I2C_SUMMARY));
+  vcd_header (&v, d->dual);
+
+  size_t pos = 0;
+  I2C_TRACE_RECORD rec;
+  uint64_t start_us = 0, end_us = 0;
+  LCD_BYTE last;
+  bool have_last = false;
+  bool first = true;
+  while (i2c_trace_next (trace, size, &pos, &rec))
+    {
+    // The first delta is from a transfer that's no longer in the trace
+    if (!first) start_us += rec.delta_us;
+    if (!first && start_us > end_us + I2C_GAP_US)
+      note_gap (s, end_us, (uint32_t)(start_us - end_us), have_last, &last);
+    first = false;
+
+    uint64_t start_ns = start_us * 1000;
+    uint64_t duration_ns = (uint64_t)rec.duration_us * 1000;
+    vcd_at (&v, start_ns);
+    vcd_bit (&v, true, '&');
+    vcd_bits (&v, (uint32_t)(start_us > end_us ? start_us - end_us : 0),
+      32, '(');
+    if (rec.result != I2C_TRACE_OK) vcd_bit (&v, true, '\'');
+
+    s->transfers++;
+    s->bytes += rec.len;
+    if (rec.result != I2C_TRACE_OK) s->failed++;
+    if (rec.read) s->reads++;
+    for (int i = 0; i < rec.len && !rec.read; i++)
+      {
+      uint8_t pins = rec.data[i];
+      vcd_at (&v, start_ns + duration_ns * (i + 2) / (rec.len + 1));
+      if (pins == d->pins) s->idle_bytes++;
+      vcd_pins (&v, d->pins, pins);
+      LCD_BYTE out[2];
+      int n = lcd_decoder_write (d, pins, out);
+      for (int k = 0; k < n; k++)
+        {
+        if (out[k].rs) s->chars++;
+        else s->commands++;
+        if (out[k].redundant) s->redundant++;
+        vcd_bits (&v, out[k].value, 8, ')');
+        vcd_bit (&v, out[k].rs, '*');
+        vcd_bit (&v, out[k].controller, '+');
+        vcd_bit (&v, out[k].redundant, ',');
+        last = out[k];
+        have_last = true;
+        }
+      }
+
+    end_us = start_us + rec.duration_us;
+    s->busy_us += rec.duration_us;
+    vcd_at (&v, end_us * 1000);
+    vcd_bit (&v, false, '&');
+    if (rec.result != I2C_TRACE_OK) vcd_bit (&v, false, '\'');
+    }
+  s->span_us = end_us;
+  }
+
+/*===========================================================================
+ * i2c_summary_print
+ * ========================================================================*/
+void i2c_summary_print (const I2C_SUMMARY *s, FILE *f)
+  {
+  fprintf (f, "transfers:   %lu (%lu reads, %lu failed), %lu bytes\n",
+    s->transfers, s->reads, s->failed, s->bytes);
+  fprintf (f, "time:        %.3f ms, bus busy %.3f ms (%.0f%%)\n",
+    s->span_us / 1000.0, s->busy_us / 1000.0,
+    s->span_us ? 100.0 * s->busy_us / s->span_us : 0.0);
+  fprintf (f, "HD44780:     %lu characters, %lu commands, "
+    "%lu that changed nothing\n", s->chars, s->commands, s->redundant);
+  fprintf (f, "idle bytes:  %lu, that changed no output\n", s->idle_bytes);
+  fprintf (f, "gaps:        %lu over %d us, %.3f ms in all\n", s->gaps,
+    I2C_GAP_US, s->gap_us / 1000.0);
+  for (int i = 0; i < I2C_LONGEST && s->longest[i].us; i++)
+    {
+    const I2C_GAP *g = &s->longest[i];
+    fprintf (f, "  %6lu us at %.3f ms", (unsigned long)g->us,
+      g->at_us / 1000.0);
+    if (!g->after_byte)
+      fprintf (f, "\n");
+    else if (g->after.rs)
+      fprintf (f, ", after character 0x%02X\n", g->after.value);
+    else
+      fprintf (f, ", after %s (0x%02X)\n", lcd_command_name (g->after.value),
+        g->after.value);
+    }
+  }
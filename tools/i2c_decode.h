@@ -0,0 +1,145 @@
+/*===========================================================================
+ * tools/i2c_decode.h
+ *
+ * Decoding of the I2C traces that the Pico dumps with the 'I' serial
+ * command. The trace format is described in
+ * i2c_lcd/include/i2c_lcd/i2c_trace.h.
+ *
+ * A trace is a record of what was written to the PCF8574, whose outputs
+ * are the HD44780's RS, RW, E, and D4-D7 lines, and the backlight. The
+ * decoder plays the outputs into a model of the HD44780 (two, on a
+ * 40x4 panel, where RW is the second one's E) to recover the bytes it
+ * received, and notes commands that changed nothing. A trace whose
+ * ring buffer has wrapped may start between the two halves of a byte,
+ * which puts the decoder a nibble out for the rest of it, so it is best
+ * to start a trace ('I') just before what is to be looked at.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// PCF8574 outputs
+#define PCF_RS 0x01
+#define PCF_RW 0x02
+#define PCF_E  0x04
+#define PCF_BL 0x08
+
+typedef struct _I2C_TRACE_RECORD
+  {
+  uint32_t delta_us;     // From the start of the transfer before
+  uint32_t duration_us;
+  uint8_t addr;
+  bool read;
+  uint8_t result;        // I2C_TRACE_OK, _NAK, or _TIMEOUT
+  uint8_t len;
+  const uint8_t *data;
+  } I2C_TRACE_RECORD;
+
+// An HD44780, as far as the decoder follows it
+typedef struct _LCD_MODEL
+  {
+  bool have_high;
+  uint8_t high;
+  int addr;
+  bool increment;
+  int entry;              // The last of each kind of command, or -1
+  int display;
+  int function;
+  uint8_t ddram[128];
+  } LCD_MODEL;
+
+typedef struct _LCD_DECODER
+  {
+  bool dual;              // RW is the second controller's E
+  uint8_t pins;           // The PCF8574's outputs
+  LCD_MODEL lcd[2];
+  } LCD_DECODER;
+
+// A byte that a controller received
+typedef struct _LCD_BYTE
+  {
+  int controller;
+  uint8_t value;
+  bool rs;
+  bool redundant;         // A command that changed nothing
+  } LCD_BYTE;
+
+// The number of longest gaps kept
+#define I2C_LONGEST 5
+
+typedef struct _I2C_GAP
+  {
+  uint64_t at_us;             // When it started, from the first transfer
+  uint32_t us;
+  bool after_byte;            // If anything had been received before it,
+  LCD_BYTE after;             //   the last byte
+  } I2C_GAP;
+
+// What decoding a whole trace found
+typedef struct _I2C_SUMMARY
+  {
+  unsigned long transfers;
+  unsigned long reads;
+  unsigned long failed;
+  unsigned long bytes;
+  unsigned long idle_bytes;   // Writes that changed no output
+  unsigned long chars;
+  unsigned long commands;
+  unsigned long redundant;
+  uint64_t span_us;           // To the end of the last transfer
+  uint64_t busy_us;
+  unsigned long gaps;         // Gaps between transfers over I2C_GAP_US
+  uint64_t gap_us;
+  I2C_GAP longest[I2C_LONGEST]; // Longest first
+  } I2C_SUMMARY;
+
+// Gaps between transfers shorter than this aren't counted; they are
+//   just the time the Pico takes to start the next one
+#define I2C_GAP_US 100
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Load a trace, either binary or as dumped by i2c_trace_dump().
+    Returns the binary trace, including its header, or NULL on error
+    (which has already been reported). The caller must free the
+    result. */
+extern uint8_t *i2c_trace_load (const char *filename, size_t *size);
+
+/** Parse the record at offset *pos, and advance *pos past it. Returns
+    zero at the end of the trace. */
+extern int      i2c_trace_next (const uint8_t *trace, size_t size,
+                  size_t *pos, I2C_TRACE_RECORD *rec);
+
+extern void     lcd_decoder_init (LCD_DECODER *d, bool dual);
+
+/** Take one write to the PCF8574. Returns the number of bytes it
+    completed -- up to two, one per controller -- which are put in
+    out. */
+extern int      lcd_decoder_write (LCD_DECODER *d, uint8_t pins,
+                  LCD_BYTE out[2]);
+
+/** A short description of an HD44780 command. */
+extern const char *lcd_command_name (uint8_t b);
+
+/** Decode a whole trace into d, which must have been initialized, and
+    fill in the summary. If vcd is not NULL, write a VCD waveform to it,
+    with the PCF8574's outputs, the bus activity and the gaps between
+    transfers, and the bytes that the HD44780 received. */
+extern void     i2c_trace_decode (const uint8_t *trace, size_t size,
+                  LCD_DECODER *d, FILE *vcd, I2C_SUMMARY *summary);
+
+/** Print a summary, with the longest gaps, each with the last thing
+    the HD44780 received before it. */
+extern void     i2c_summary_print (const I2C_SUMMARY *s, FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,250 @@
+/*===========================================================================
+ * tools/i2c_trace_check.c
+ *
+ * Checks the I2C trace, and the decoding of it that i2c_vcd does, on the
+ * simulated Pico.
+ *
+ * A console on a simulated 20x4 panel is started with tracing on, and
+ * given enough lines to scroll. The trace should have every transfer
+ * that the simulated bus saw, with the same bytes and the same time on
+ * the bus, and decoding it should give the same DDRAM contents as the
+ * simulated HD44780 has. The same is done for a 40x4 panel, with its
+ * two controllers. Then the 20x4 run is repeated with a ring too small
+ * for it: what is left should be the end of the first trace, and parse
+ * to exactly its end. The waveform written for the first trace should
+ * have its times in order, and each byte that the HD44780 received
+ * should be at a falling edge of E.
+ *
+ * Last, the cost of recording a transfer is measured, on the host.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include <i2c_lcd/i2c_trace.h>
+#include "config.h"
+#include "i2c_decode.h"
+#include "replay.h"
+
+#define BAUD 400000
+#define LINES 12
+#define BIG_RING 65536
+#define SMALL_RING 1024
+#define CALLS 10000000
+
+/*===========================================================================
+ * run
+ * Start a console with tracing on, print to it, and return a copy of
+ * the trace, which the caller must free.
+ * ========================================================================*/
+static uint8_t *run (int width, int height, int ring, size_t *size)
+  {
+  host_lcd_set_geometry (width, height);
+  host_lcd_set_gpio (-1, -1, -1);
+  // A 40x4 is wired for two controllers, as the host simulates it
+  LCD_TRANSPORT *(*new_transport) (i2c_inst_t *, int, int, int, int) =
+    width > 20 && height > 2 ? lcd_transport_i2c_new_dual 
+    : lcd_transport_i2c_new;
+  LCD_TRANSPORT *t = new_transport (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    BAUD);
+  i2c_trace_init (ring);
+  lcd_transport_i2c_set_trace (t, TRUE);
+  host_lcd_reset_stats();
+
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (width, height, t, 4);
+  for (int i = 0; i < LINES; i++)
+    {
+    i2c_lcd_printf (lcd, "%02d the quick brown fox jumps over the lazy dog",
+      i);
+    i2c_lcd_print_char (lcd, '\n');
+    }
+  i2c_lcd_print_string (lcd, "end");
+  i2c_lcd_destroy (lcd);
+
+  int n = i2c_trace_copy (NULL, 0);
+  uint8_t *trace = malloc (n);
+  i2c_trace_copy (trace, n);
+  *size = n;
+  return trace;
+  }
+
+/*===========================================================================
+ * decoded_matches
+ * TRUE if the DDRAM that the decoder followed is what the simulated panel
+ * shows.
+ * ========================================================================*/
+static bool decoded_matches (const LCD_DECODER *d, int width, int height)
+  {
+  static const int offset[4] = { 0x00, 0x40, 0x14, 0x54 };
+  char have[41];
+  for (int r = 0; r < height; r++)
+    {
+    const uint8_t *want;
+    if (d->dual)
+      want = d->lcd[r / 2].ddram + (r % 2 ? 0x40 : 0x00);
+    else
+      want = d->lcd[0].ddram + offset[r];
+    host_lcd_get_row (r, have);
+    if (memcmp (want, have, width) != 0) return false;
+    }
+  return true;
+  }
+
+/*===========================================================================
+ * check_panel
+ * Trace a run on a panel, and check the trace against the simulation.
+ * Returns the trace, for the checks that follow.
+ * ========================================================================*/
+static uint8_t *check_panel (int width, int height, size_t *size,
+      I2C_SUMMARY *s)
+  {
+  printf ("%dx%d, I2C at %dk:\n", width, height, BAUD / 1000);
+  uint8_t *trace = run (width, height, BIG_RING, size);
+  const HOST_LCD_STATS *stats = host_lcd_stats();
+
+  LCD_DECODER d;
+  lcd_decoder_init (&d, height > 2 && width > 20);
+  i2c_trace_decode (trace, *size, &d, NULL, s);
+  replay_expect ("every transfer, and no failures",
+    s->transfers - s->reads == stats->i2c_transactions && s->failed == 0);
+  replay_expect ("every byte", s->bytes == stats->i2c_bytes);
+  replay_expect ("the same time on the bus", s->busy_us == stats->i2c_busy_us);
+  replay_expect ("decoded DDRAM matches the panel",
+    decoded_matches (&d, width, height));
+  return trace;
+  }
+
+/*===========================================================================
+ * first_record_end
+ * ========================================================================*/
+static size_t first_record_end (const uint8_t *trace, size_t size)
+  {
+  size_t pos = 0;
+  I2C_TRACE_RECORD rec;
+  i2c_trace_next (trace, size, &pos, &rec);
+  return pos;
+  }
+
+/*===========================================================================
+ * check_wrap
+ * ========================================================================*/
+static void check_wrap (const uint8_t *whole, size_t whole_size)
+  {
+  printf ("20x4, a %d-byte ring:\n", SMALL_RING);
+  size_t size;
+  uint8_t *trace = run (20, 4, SMALL_RING, &size);
+
+  size_t pos = 0;
+  unsigned long records = 0;
+  I2C_TRACE_RECORD rec;
+  while (i2c_trace_next (trace, size, &pos, &rec)) records++;
+  replay_expect ("the ring wrapped", records > 0 && size < whole_size
+    && size <= SMALL_RING + I2C_TRACE_HEADER_SIZE);
+  replay_expect ("parses to exactly its end", pos == size);
+
+  // The first record's delta is from one that was dropped, so may differ
+  size_t first = first_record_end (trace, size);
+  size_t tail = size - first;
+  replay_expect ("what is left is the end of the whole trace",
+    first < size && memcmp (trace + first, whole + whole_size - tail,
+    tail) == 0);
+  free (trace);
+  }
+
+/*===========================================================================
+ * check_vcd
+ * ========================================================================*/
+static void check_vcd (const uint8_t *trace, size_t size)
+  {
+  printf ("waveform:\n");
+  FILE *f = tmpfile();
+  if (!f)
+    {
+    perror ("tmpfile");
+    replay_expect ("a temporary file for the waveform", FALSE);
+    return;
+    }
+  LCD_DECODER d;
+  I2C_SUMMARY s;
+  lcd_decoder_init (&d, false);
+  i2c_trace_decode (trace, size, &d, f, &s);
+  rewind (f);
+
+  char line[128];
+  bool in_order = true, at_edges = true, dumpvars = false;
+  unsigned long long now = 0;
+  bool falling = false;
+  unsigned long bytes = 0;
+  while (fgets (line, sizeof (line), f))
+    {
+    if (line[0] == '#')
+      {
+      unsigned long long t = strtoull (line + 1, NULL, 10);
+      if (t <= now && now != 0) in_order = false;
+      now = t;
+      falling = false;
+      }
+    else if (strncmp (line, "$dumpvars", 9) == 0)
+      dumpvars = true;
+    else if (strncmp (line, "$end", 4) == 0)
+      dumpvars = false;
+    else if (strcmp (line, "0#\n") == 0)
+      falling = true;
+    else if (line[0] == 'b' && strstr (line, " )\n") && !dumpvars)
+      {
+      bytes++;
+      if (!falling) at_edges = false;
+      }
+    }
+  fclose (f);
+  replay_expect ("times in order", in_order);
+  replay_expect ("every byte at a falling edge of E", at_edges
+    && bytes == s.chars + s.commands && bytes > 0);
+  }
+
+/*===========================================================================
+ * time_record
+ * ========================================================================*/
+static void time_record (void)
+  {
+  static const uint8_t data[4] = { 0x4D, 0x49, 0xDD, 0xD9 };
+  i2c_trace_init (4096);
+  uint64_t start = replay_wall_us();
+  for (int i = 0; i < CALLS; i++)
+    i2c_trace_record ((uint32_t)i * 100, 90, I2C_LCD_ADDRESS, FALSE, data,
+      4, 4);
+  uint64_t us = replay_wall_us() - start;
+  printf ("\nrecording:           %.1f ns a transfer, on the host\n",
+    us * 1000.0 / CALLS);
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  size_t size, dual_size;
+  I2C_SUMMARY s, dual_s;
+  uint8_t *trace = check_panel (20, 4, &size, &s);
+  uint8_t *dual = check_panel (40, 4, &dual_size, &dual_s);
+  check_wrap (trace, size);
+  check_vcd (trace, size);
+
+  printf ("\n20x4 trace, %lu bytes:\n", (unsigned long)size);
+  i2c_summary_print (&s, stdout);
+
+  time_record();
+  free (trace);
+  free (dual);
+  printf ("\n%s\n", replay_failures() ? "FAILED" : "passed");
+  return replay_failures() ? 1 : 0;
+  }
@@ -0,0 +1,134 @@
+/*===========================================================================
+ * tools/i2c_tune.c
+ *
+ * Exercises the I2C display transport's baud rate autotuning and error
+ * fallback, against a simulated I2C bus that fails above a chosen speed.
+ *
+ * For each bus speed limit, the display is set up from scratch, the
+ * transport is autotuned, and a screenful of text is written. The tool
+ * checks that autotuning chose the fastest rate within the limit, and
+ * that the text reached the panel intact. It also shows how long the
+ * text took to write, at the chosen rate.
+ *
+ * Then it checks the fallback: the display is tuned on a fast bus,
+ * and the bus limit is lowered part way through writing the text. The
+ * transport should notice the errors, step down to a rate that works,
+ * and carry on without losing any text.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+
+// The lines are shorter than the display, so that it never wraps or
+//   scrolls
+static const char *lines[] = { "The quick brown fox", "jumps over the",
+  "lazy dog. 012345678", "ABCDEFGHIJKLMNOPQRS" };
+
+#define WIDTH 20
+#define HEIGHT 4
+
+/*===========================================================================
+ * new_display
+ * Set up the simulated panel and a display on it, and autotune. Returns
+ * the transport, whose display is returned in *lcd.
+ * ========================================================================*/
+static LCD_TRANSPORT *new_display (unsigned int limit, I2C_LCD **lcd)
+  {
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  host_i2c_set_max_baud (limit);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    100000);
+  lcd_transport_i2c_autotune (t, 1000000);
+  *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT, t, 1);
+  return t;
+  }
+
+/*===========================================================================
+ * write_line
+ * ========================================================================*/
+static void write_line (I2C_LCD *lcd, int row)
+  {
+  i2c_lcd_set_cursor (lcd, row, 0);
+  i2c_lcd_print_chars (lcd, lines[row], strlen (lines[row]));
+  }
+
+/*===========================================================================
+ * panel_ok
+ * TRUE if the simulated panel shows exactly the text that was written.
+ * ========================================================================*/
+static BOOL panel_ok (void)
+  {
+  char row[WIDTH + 1], expected[WIDTH + 1];
+  for (int r = 0; r < HEIGHT; r++)
+    {
+    snprintf (expected, sizeof (expected), "%-*s", WIDTH, lines[r]);
+    host_lcd_get_row (r, row);
+    if (strcmp (row, expected) != 0) return FALSE;
+    }
+  return TRUE;
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  static const unsigned int limits[] = { 100000, 400000, 1000000, 0 };
+  int failures = 0;
+
+  printf ("%-10s %-10s %-8s %s\n", "bus limit", "chosen", "text",
+    "time to write");
+  for (int i = 0; i < (int)(sizeof (limits) / sizeof (limits[0])); i++)
+    {
+    I2C_LCD *lcd;
+    LCD_TRANSPORT *t = new_display (limits[i], &lcd);
+    LCD_I2C_STATS st;
+    lcd_transport_i2c_get_stats (t, &st);
+
+    uint64_t start = time_us_64();
+    for (int r = 0; r < HEIGHT; r++) write_line (lcd, r);
+    uint64_t elapsed = time_us_64() - start;
+
+    unsigned int expected = limits[i] ? limits[i] : 1000000;
+    BOOL ok = panel_ok();
+    if (!ok || (unsigned int)st.baud != expected) failures++;
+
+    char limit[16];
+    snprintf (limit, sizeof (limit), "%u", limits[i]);
+    printf ("%-10s %-10d %-8s %.3f ms\n", limits[i] ? limit : "none",
+      st.baud, ok ? "ok" : "WRONG", elapsed / 1000.0);
+    i2c_lcd_destroy (lcd);
+    }
+
+  // Fallback: tune on a fast bus, then slow the bus down half way
+  //   through writing the text
+  I2C_LCD *lcd;
+  LCD_TRANSPORT *t = new_display (0, &lcd);
+  write_line (lcd, 0);
+  write_line (lcd, 1);
+  host_i2c_set_max_baud (400000);
+  write_line (lcd, 2);
+  write_line (lcd, 3);
+  LCD_I2C_STATS st;
+  lcd_transport_i2c_get_stats (t, &st);
+  BOOL ok = panel_ok();
+  if (!ok || st.baud != 400000 || st.fallbacks != 1) failures++;
+  printf ("\nfallback:  bus limit dropped from none to 400000\n");
+  printf ("           now %d baud, %lu NAKs, %lu timeouts, %lu fallbacks, "
+    "text %s\n", st.baud, st.naks, st.timeouts, st.fallbacks,
+    ok ? "ok" : "WRONG");
+  i2c_lcd_destroy (lcd);
+
+  printf ("\n%s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+  }
+
@@ -0,0 +1,82 @@
+/*===========================================================================
+ * tools/i2c_vcd.c
+ *
+ * Turns an I2C trace, dumped by the Pico's 'I' serial command, into a
+ * VCD waveform, which a viewer such as GTKWave can show. The waveform
+ * has the PCF8574's outputs -- RS, RW (or E2), E, the backlight, and
+ * the data nibble -- when the bus was busy, the gap before each
+ * transfer, and each byte that the HD44780 received, marked if it was a
+ * command that changed nothing. A summary goes to standard error: how
+ * busy the bus was, how many bytes were padding, and the longest gaps,
+ * each with what the HD44780 had just been sent.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "i2c_decode.h"
+
+/*===========================================================================
+ * usage
+ * ========================================================================*/
+static void usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [-d] trace [vcd]\n", argv0);
+  fprintf (stderr, "  -d  the panel is a 40x4, with two controllers\n");
+  fprintf (stderr, "The trace may be binary, or a log of the serial "
+    "console with a dump in it.\n");
+  fprintf (stderr, "With no VCD file, the waveform goes to standard "
+    "output.\n");
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  bool dual = false;
+  int opt;
+  while ((opt = getopt (argc, argv, "d")) != -1)
+    {
+    switch (opt)
+      {
+      case 'd': dual = true; break;
+      default: usage (argv[0]); return 1;
+      }
+    }
+  if (optind >= argc)
+    {
+    usage (argv[0]);
+    return 1;
+    }
+
+  size_t size;
+  uint8_t *trace = i2c_trace_load (argv[optind], &size);
+  if (!trace) return 1;
+
+  FILE *f = stdout;
+  if (optind + 1 < argc)
+    {
+    f = fopen (argv[optind + 1], "w");
+    if (!f)
+      {
+      perror (argv[optind + 1]);
+      free (trace);
+      return 1;
+      }
+    }
+
+  LCD_DECODER d;
+  I2C_SUMMARY s;
+  lcd_decoder_init (&d, dual);
+  i2c_trace_decode (trace, size, &d, f, &s);
+  i2c_summary_print (&s, stderr);
+
+  if (f != stdout) fclose (f);
+  free (trace);
+  return s.transfers ? 0 : 1;
+  }
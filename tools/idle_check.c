@@ -0,0 +1,226 @@
+/*===========================================================================
+ * tools/idle_check.c
+ *
+ * Checks idle sleep, and waking from it, on the simulated Pico.
+ *
+ * First the driver: a console on a simulated 20x4 panel is given some
+ * text, then put to sleep and woken. Each should be one I2C write, turn
+ * the display and backlight off or on again, and leave what is in the
+ * panel's display RAM alone, so that nothing has to be redrawn. Output
+ * to the console should wake the panel; output to a console that isn't
+ * showing should not. The same is done for a 40x4 panel, with its two
+ * controllers. With the cursor showing, a 40x4 takes a write for each
+ * controller, as only the one with the cursor is told to show it.
+ *
+ * Then the firmware: after IDLE_SLEEP_MS with no keystrokes the panel
+ * should be asleep, and a keystroke should wake it, with the key typed
+ * or not as IDLE_SWALLOW_WAKE_KEY says. The time from the keystroke to
+ * the display being on again is shown with the 'p' serial command.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+#include "replay.h"
+
+// Defined in main.c
+extern I2C_LCD *i2c_lcd;
+extern absolute_time_t app_poll (void);
+
+/*===========================================================================
+ * rows_same
+ * TRUE if the panel shows what was saved in 'rows'. If 'save' is TRUE,
+ * save what it shows instead.
+ * ========================================================================*/
+static BOOL rows_same (char rows[4][41], int height, BOOL save)
+  {
+  char row[41];
+  for (int r = 0; r < height; r++)
+    {
+    host_lcd_get_row (r, row);
+    if (save)
+      strcpy (rows[r], row);
+    else if (strcmp (rows[r], row) != 0)
+      return FALSE;
+    }
+  return TRUE;
+  }
+
+/*===========================================================================
+ * writes_for
+ * The number of I2C writes since the count was last taken, and the
+ * time the bus was busy with them.
+ * ========================================================================*/
+static unsigned long writes_for (uint64_t *busy_us)
+  {
+  const HOST_LCD_STATS *stats = host_lcd_stats();
+  unsigned long n = stats->i2c_transactions;
+  if (busy_us) *busy_us = stats->i2c_busy_us;
+  host_lcd_reset_stats();
+  return n;
+  }
+
+/*===========================================================================
+ * check_panel
+ * ========================================================================*/
+static void check_panel (int width, int height)
+  {
+  printf ("%dx%d:\n", width, height);
+  host_lcd_set_geometry (width, height);
+  host_lcd_set_gpio (-1, -1, -1);
+  // A 40x4 is wired for two controllers, as the host simulates it
+  LCD_TRANSPORT *(*new_transport) (i2c_inst_t *, int, int, int, int) =
+    width > 20 && height > 2 ? lcd_transport_i2c_new_dual 
+    : lcd_transport_i2c_new;
+  LCD_TRANSPORT *t = new_transport (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    400000);
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (width, height, t, 4);
+  I2C_LCD *other = i2c_lcd_new_console (lcd, 4);
+  i2c_lcd_backlight_on (lcd);
+  i2c_lcd_cursor_off (lcd);
+  for (int i = 0; i < height; i++)
+    {
+    i2c_lcd_printf (lcd, "row %d of the panel", i);
+    if (i < height - 1) i2c_lcd_print_char (lcd, '\n');
+    }
+
+  char rows[4][41];
+  rows_same (rows, height, TRUE);
+  writes_for (NULL);
+  uint64_t busy_us;
+  i2c_lcd_sleep (lcd);
+  replay_expect ("sleep is one write", writes_for (NULL) == 1);
+  replay_expect ("display and backlight off", !host_lcd_display_on()
+    && !host_lcd_backlight() && i2c_lcd_is_asleep (other));
+  replay_expect ("display RAM kept", rows_same (rows, height, FALSE));
+  i2c_lcd_wake (lcd);
+  unsigned long writes = writes_for (&busy_us);
+  printf ("    wake: %lu write, %lu us on the bus\n", writes,
+    (unsigned long)busy_us);
+  replay_expect ("wake is one write", writes == 1);
+  replay_expect ("display and backlight on, nothing redrawn",
+    host_lcd_display_on() && host_lcd_backlight()
+    && rows_same (rows, height, FALSE));
+
+  i2c_lcd_sleep (lcd);
+  i2c_lcd_print_string (other, "unseen");
+  replay_expect ("output to another console doesn't wake",
+    i2c_lcd_is_asleep (lcd) && !host_lcd_display_on());
+  i2c_lcd_print_char (lcd, '!');
+  replay_expect ("output to this one does", !i2c_lcd_is_asleep (lcd)
+    && host_lcd_display_on() && host_lcd_backlight());
+
+  i2c_lcd_cursor_on (lcd);
+  i2c_lcd_sleep (lcd);
+  writes_for (NULL);
+  i2c_lcd_wake (lcd);
+  writes = writes_for (NULL);
+  printf ("    wake with the cursor showing: %lu write%s\n", writes,
+    writes == 1 ? "" : "s");
+  replay_expect ("cursor showing: a write per controller",
+    writes == (height > 2 && width > 20 ? 2 : 1));
+  i2c_lcd_destroy (other);
+  i2c_lcd_destroy (lcd);
+  }
+
+/*===========================================================================
+ * run_for
+ * Run the firmware's main loop for a time, as its main() does.
+ * ========================================================================*/
+static void run_for (uint32_t ms)
+  {
+  uint64_t end = time_us_64() + (uint64_t)ms * 1000;
+  while (time_us_64() < end)
+    {
+    absolute_time_t next = app_poll();
+    absolute_time_t limit = make_timeout_time_ms (LOOP_MAX_SLEEP_MS);
+    if (absolute_time_diff_us (limit, next) > 0) next = limit;
+    if (next > end) next = end;
+    if (next > time_us_64()) host_advance_us (next - time_us_64());
+    }
+  }
+
+/*===========================================================================
+ * press
+ * Press and release a key.
+ * ========================================================================*/
+static void press (uint8_t keycode)
+  {
+  uint8_t down[8] = { 0, 0, keycode, 0, 0, 0, 0, 0 };
+  uint8_t up[8] = { 0 };
+  REPLAY_RECORD rec = { 0, 1, 0, 8, down };
+  replay_report (&rec);
+  run_for (20);
+  rec.report = up;
+  replay_report (&rec);
+  run_for (20);
+  }
+
+/*===========================================================================
+ * check_firmware
+ * ========================================================================*/
+static void check_firmware (void)
+  {
+  printf ("firmware, asleep after %d s:\n", IDLE_SLEEP_MS / 1000);
+  if (IDLE_SLEEP_MS == 0)
+    {
+    printf ("  idle sleep is off in config.h\n");
+    return;
+    }
+  host_lcd_set_geometry (LCD_WIDTH, LCD_HEIGHT);
+  replay_init_firmware();
+  press (0x04); // a
+
+  run_for (IDLE_SLEEP_MS - 2000);
+  replay_expect ("awake until the idle time is up",
+    !i2c_lcd_is_asleep (i2c_lcd) && host_lcd_display_on());
+  run_for (3000);
+  replay_expect ("then asleep, display and backlight off",
+    i2c_lcd_is_asleep (i2c_lcd) && !host_lcd_display_on()
+    && !host_lcd_backlight());
+
+  press (0x05); // b
+  replay_expect ("a key wakes it", !i2c_lcd_is_asleep (i2c_lcd)
+    && host_lcd_display_on() && host_lcd_backlight());
+  char row[41];
+  host_lcd_get_row (STATUS_ROWS, row);
+  if (IDLE_SWALLOW_WAKE_KEY)
+    replay_expect ("the key that woke it is dropped",
+      strstr (row, "ab") == NULL);
+  else
+    replay_expect ("the key that woke it is typed",
+      strstr (row, "ab") != NULL);
+
+  run_for (IDLE_SLEEP_MS + 1000);
+  replay_expect ("asleep again", i2c_lcd_is_asleep (i2c_lcd));
+  i2c_lcd_print_string (i2c_lcd, "c");
+  run_for (2000);
+  replay_expect ("output wakes it, and it stays awake",
+    !i2c_lcd_is_asleep (i2c_lcd) && host_lcd_display_on());
+
+  printf ("\n");
+  host_set_console_input ("p");
+  run_for (100);
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  check_panel (20, 4);
+  check_panel (40, 4);
+  check_firmware();
+  printf ("\n%s\n", replay_failures() ? "FAILED" : "passed");
+  return replay_failures() ? 1 : 0;
+  }
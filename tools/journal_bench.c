@@ -0,0 +1,194 @@
+/*===========================================================================
+ * tools/journal_bench.c
+ *
+ * Exercises the flash journal of display lines, on the simulated Pico's
+ * flash. Lines are added and written to flash the way the firmware does
+ * it, then the journal is "reset" -- thrown away and created afresh, as
+ * it would be after a reset -- and the tool checks that the most recent
+ * lines come back, in order, with their marks for lines that continue the
+ * line before. This is done repeatedly, with different
+ * numbers of lines, so that restoring has to pick up in the middle of
+ * sectors, and after the journal has gone round its flash region many
+ * times.
+ *
+ * It reports how long the flash operations took, in simulated time, how
+ * long restoring took on the host, and how evenly the sectors were
+ * erased.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pico/stdlib.h>
+#include <hardware/flash.h>
+#include <host/host_pico.h>
+#include <journal/journal.h>
+#include "replay.h"
+
+#define WIDTH 20
+
+typedef struct _RESTORED
+  {
+  char *lines;
+  BOOL *continued;
+  int count;
+  BOOL bad_width;
+  } RESTORED;
+
+/*===========================================================================
+ * make_line
+ * ========================================================================*/
+static void make_line (unsigned long n, char *line)
+  {
+  char buf[WIDTH + 16];
+  snprintf (buf, sizeof (buf), "line %-*lu", WIDTH, n);
+  memcpy (line, buf, WIDTH);
+  }
+
+/*===========================================================================
+ * is_continued
+ * Whether line n is marked as continuing the line before: some are, as 
+ * long lines on the display would be.
+ * ========================================================================*/
+static BOOL is_continued (unsigned long n)
+  {
+  return n % 3 == 1;
+  }
+
+/*===========================================================================
+ * restore_line
+ * ========================================================================*/
+static void restore_line (const char *line, int width, BOOL continued, 
+              void *context)
+  {
+  RESTORED *r = context;
+  if (width != WIDTH) r->bad_width = TRUE;
+  memcpy (r->lines + r->count * WIDTH, line, WIDTH);
+  r->continued[r->count] = continued;
+  r->count++;
+  }
+
+/*===========================================================================
+ * usage
+ * ========================================================================*/
+static void usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [-s sectors] [-n resets] [-k keep]\n", argv0);
+  fprintf (stderr, "  -s  flash sectors for the journal (default 16)\n");
+  fprintf (stderr, "  -n  number of resets (default 200)\n");
+  fprintf (stderr, "  -k  lines to restore (default 36)\n");
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int sectors = 16, resets = 200, keep = 36;
+  int opt;
+  while ((opt = getopt (argc, argv, "s:n:k:")) != -1)
+    {
+    switch (opt)
+      {
+      case 's': sectors = atoi (optarg); break;
+      case 'n': resets = atoi (optarg); break;
+      case 'k': keep = atoi (optarg); break;
+      default: usage (argv[0]); return 1;
+      }
+    }
+
+  srand (1);
+  RESTORED r;
+  r.lines = malloc ((size_t)keep * WIDTH);
+  r.continued = malloc ((size_t)keep * sizeof (BOOL));
+  char line[WIDTH];
+  unsigned long next_line = 0, failures = 0, ops = 0;
+  uint64_t flash_us = 0, worst_op_us = 0;
+  uint64_t restore_total = 0, restore_worst = 0;
+
+  for (int i = 0; i <= resets; i++)
+    {
+    JOURNAL *j = journal_new (WIDTH, sectors, 64);
+
+    // Restore, and check that we got the most recent lines
+    r.count = 0;
+    r.bad_width = FALSE;
+    uint64_t start = replay_wall_us();
+    journal_restore (j, keep, restore_line, &r);
+    uint64_t elapsed = replay_wall_us() - start;
+    restore_total += elapsed;
+    if (elapsed > restore_worst) restore_worst = elapsed;
+    int expect = next_line < (unsigned long)keep ? (int)next_line : keep;
+    BOOL ok = (r.count == expect) && !r.bad_width;
+    for (int k = 0; ok && k < r.count; k++)
+      {
+      unsigned long n = next_line - r.count + k;
+      make_line (n, line);
+      if (memcmp (line, r.lines + k * WIDTH, WIDTH) != 0
+           || r.continued[k] != is_continued (n)) 
+        ok = FALSE;
+      }
+    if (!ok)
+      {
+      failures++;
+      printf ("reset %d: restored %d lines, expected %d ending at %lu\n",
+        i, r.count, expect, next_line);
+      }
+    if (i == resets)
+      {
+      journal_destroy (j);
+      break;
+      }
+
+    // Add some lines, writing each page as it fills, as the firmware
+    //   would when the keyboard is quiet. Then flush what's left.
+    int n = 1 + rand() % 100;
+    for (int k = 0; k < n; k++)
+      {
+      make_line (next_line, line);
+      journal_add_line (j, line, WIDTH, is_continued (next_line));
+      next_line++;
+      BOOL flush = (k == n - 1);
+      while (1)
+        {
+        uint64_t t = time_us_64();
+        if (!journal_work (j, flush)) break;
+        uint64_t op = time_us_64() - t;
+        flash_us += op;
+        ops++;
+        if (op > worst_op_us) worst_op_us = op;
+        if (!flush && !journal_pending (j)) break;
+        }
+      }
+    journal_destroy (j);
+    }
+
+  uint32_t min_erases = UINT32_MAX, max_erases = 0;
+  uint32_t base = PICO_FLASH_SIZE_BYTES - (uint32_t)sectors * FLASH_SECTOR_SIZE;
+  for (int s = 0; s < sectors; s++)
+    {
+    uint32_t e = host_flash_erases (base + (uint32_t)s * FLASH_SECTOR_SIZE);
+    if (e < min_erases) min_erases = e;
+    if (e > max_erases) max_erases = e;
+    }
+
+  printf ("lines:               %lu, over %d resets\n", next_line, resets);
+  printf ("restores correct:    %lu of %d\n", resets + 1 - failures,
+    resets + 1);
+  printf ("flash operations:    %lu, %.3f ms, worst %.3f ms\n", ops,
+    flash_us / 1000.0, worst_op_us / 1000.0);
+  printf ("sector erases:       min %lu, max %lu (%d sectors)\n",
+    (unsigned long)min_erases, (unsigned long)max_erases, sectors);
+  printf ("restore host time:   mean %.1f us, worst %lu us\n",
+    (double)restore_total / (resets + 1), (unsigned long)restore_worst);
+
+  free (r.lines);
+  free (r.continued);
+  printf ("\n%s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+  }
+
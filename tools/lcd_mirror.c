@@ -0,0 +1,222 @@
+/*===========================================================================
+ * tools/lcd_mirror.c
+ *
+ * A viewer for the display mirror. It reads the Pico's serial console,
+ * from a serial device or from standard input, picks out the mirror
+ * frames, and draws the display on the terminal. Everything else on
+ * the console is shown underneath it, a line at a time.
+ *
+ * Input is read as it arrives, and the screen is drawn once for
+ * everything that has arrived, so a slow terminal doesn't fall behind.
+ *
+ * With -r, the viewer asks the Pico to start mirroring (the 'M' serial
+ * command), and asks again -- at most once a second -- whenever it finds
+ * that it has missed a frame. Without -r, it waits for the next key
+ * frame, which the Pico sends every few seconds.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include "mirror_decode.h"
+
+#define LINE_MAX_LEN 1024
+
+/*===========================================================================
+ * now_ms
+ * ========================================================================*/
+static long long now_ms (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  }
+
+/*===========================================================================
+ * baud_constant
+ * ========================================================================*/
+static speed_t baud_constant (int baud)
+  {
+  switch (baud)
+    {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B115200;
+    }
+  }
+
+/*===========================================================================
+ * open_serial
+ * ========================================================================*/
+static int open_serial (const char *device, int baud)
+  {
+  int fd = open (device, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+    {
+    fprintf (stderr, "Can't open %s: %s\n", device, strerror (errno));
+    return -1;
+    }
+  struct termios t;
+  if (tcgetattr (fd, &t) == 0)
+    {
+    cfmakeraw (&t);
+    cfsetispeed (&t, baud_constant (baud));
+    cfsetospeed (&t, baud_constant (baud));
+    t.c_cflag |= CLOCAL | CREAD;
+    tcsetattr (fd, TCSANOW, &t);
+    }
+  return fd;
+  }
+
+/*===========================================================================
+ * draw
+ * ========================================================================*/
+static void draw (const MIRROR_SCREEN *screen, const char *last_line)
+  {
+  printf ("\033[H");
+  if (screen->rows == 0)
+    {
+    printf ("Waiting for a key frame...\033[K\n\033[J");
+    fflush (stdout);
+    return;
+    }
+  BOOL lit = (screen->flags & I2C_LCD_PANEL_BACKLIGHT) != 0;
+  BOOL on = (screen->flags & I2C_LCD_PANEL_DISPLAY_ON) != 0;
+  BOOL cursor = (screen->flags & I2C_LCD_PANEL_CURSOR_ON) != 0;
+
+  printf ("+");
+  for (int c = 0; c < screen->cols; c++) printf ("-");
+  printf ("+\033[K\n");
+  for (int r = 0; r < screen->rows; r++)
+    {
+    printf ("|%s", lit ? "" : "\033[2m");
+    for (int c = 0; c < screen->cols; c++)
+      {
+      unsigned char ch = (unsigned char)screen->cells[r * screen->cols + c];
+      if (!on) ch = ' ';
+      else if (ch < 32 || ch > 126) ch = '?';
+      BOOL here = on && cursor && r == screen->cursor_row
+        && c == screen->cursor_col;
+      if (here) printf ("\033[7m");
+      putchar (ch);
+      if (here) printf ("\033[27m");
+      }
+    printf ("\033[0m|\033[K\n");
+    }
+  printf ("+");
+  for (int c = 0; c < screen->cols; c++) printf ("-");
+  printf ("+\033[K\n");
+  printf ("backlight %s, display %s, %s; frames %lu, lost %lu, bad %lu"
+    "\033[K\n", lit ? "on" : "off", on ? "on" : "off",
+    screen->synced ? "in step" : "OUT OF STEP", screen->frames,
+    screen->lost, screen->bad);
+  printf ("%s\033[K\n\033[J", last_line);
+  fflush (stdout);
+  }
+
+/*===========================================================================
+ * usage
+ * ========================================================================*/
+static void usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [-b baud] [-r] [device]\n", argv0);
+  fprintf (stderr, "  -b  baud rate of the serial device (default 115200)\n");
+  fprintf (stderr, "  -r  ask the Pico to send the whole screen, at the "
+    "start and when\n      a frame is lost\n");
+  fprintf (stderr, "With no device, the console output is read from "
+    "standard input.\n");
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int baud = 115200;
+  BOOL request = FALSE;
+  int opt;
+  while ((opt = getopt (argc, argv, "b:r")) != -1)
+    {
+    switch (opt)
+      {
+      case 'b': baud = atoi (optarg); break;
+      case 'r': request = TRUE; break;
+      default: usage (argv[0]); return 1;
+      }
+    }
+
+  int fd = 0;
+  if (optind < argc)
+    {
+    fd = open_serial (argv[optind], baud);
+    if (fd < 0) return 1;
+    }
+  else
+    request = FALSE;
+
+  MIRROR_SCREEN screen;
+  mirror_screen_init (&screen);
+  char line[LINE_MAX_LEN + 1], last_line[LINE_MAX_LEN + 1] = "";
+  int len = 0;
+  long long last_request = 0;
+  if (request)
+    {
+    write (fd, "M", 1);
+    last_request = now_ms();
+    }
+
+  printf ("\033[2J");
+  draw (&screen, last_line);
+  while (1)
+    {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll (&pfd, 1, 1000) < 0 && errno != EINTR) break;
+
+    if (pfd.revents & (POLLIN | POLLHUP))
+      {
+      char buf[4096];
+      ssize_t n = read (fd, buf, sizeof (buf));
+      if (n <= 0) break;
+      for (ssize_t i = 0; i < n; i++)
+        {
+        char c = buf[i];
+        if (c == '\r') continue;
+        if (c != '\n')
+          {
+          if (len < LINE_MAX_LEN) line[len++] = c;
+          continue;
+          }
+        line[len] = 0;
+        len = 0;
+        if (mirror_screen_line (&screen, line) == 0)
+          strcpy (last_line, line);
+        }
+      draw (&screen, last_line);
+      }
+
+    if (request && !screen.synced && now_ms() - last_request >= 1000)
+      {
+      write (fd, "M", 1);
+      last_request = now_ms();
+      }
+    }
+
+  mirror_screen_free (&screen);
+  return 0;
+  }
+
@@ -0,0 +1,245 @@
+/*===========================================================================
+ * tools/mirror_check.c
+ *
+ * Checks that a viewer can rebuild the display from the mirror's frames,
+ * and measures how much the mirror sends.
+ *
+ * A 20x4 display, with a status line and four consoles, is given a long
+ * run of random work: text (with the odd non-ASCII character), new
+ * lines, console switches, scrollback, status updates, and the cursor
+ * and backlight going on and off. Every few operations -- as the mirror
+ * task would, every MIRROR_INTERVAL_MS -- the mirror is polled, and its
+ * frames are fed to the same decoder that lcd_mirror uses. The decoded
+ * screen is then compared with the simulated panel: every character,
+ * the cursor position, and the backlight.
+ *
+ * Part way through, a frame is thrown away, as if lost on the serial
+ * line. The decoder must notice, and be back in step after the next key
+ * frame.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include <mirror/mirror.h>
+#include "mirror_decode.h"
+#include "config.h"
+
+#define WIDTH 20
+#define HEIGHT 4
+#define CONSOLES 4
+#define MAX_BYTES 64
+
+// Serial console baud rate, for working out how long frames take to send
+#define UART_BAUD 115200
+
+static MIRROR_SCREEN screen;
+static BOOL drop_next = FALSE;
+static unsigned long dropped = 0;
+static unsigned long frame_bytes = 0;
+static unsigned long worst_frame = 0;
+
+/*===========================================================================
+ * write_frame
+ * ========================================================================*/
+static void write_frame (const char *s, int n, void *context)
+  {
+  (void)context;
+  if ((unsigned long)n > worst_frame) worst_frame = (unsigned long)n;
+  frame_bytes += (unsigned long)n;
+  if (drop_next && s[1] == 'U')
+    {
+    drop_next = FALSE;
+    dropped++;
+    return;
+    }
+  char line[MAX_BYTES + 1];
+  memcpy (line, s, n);
+  line[n] = 0;
+  mirror_screen_line (&screen, line);
+  }
+
+/*===========================================================================
+ * screen_matches
+ * ========================================================================*/
+static BOOL screen_matches (void)
+  {
+  if (!screen.synced || screen.rows != HEIGHT || screen.cols != WIDTH)
+    return FALSE;
+  char have[WIDTH + 1];
+  for (int r = 0; r < HEIGHT; r++)
+    {
+    host_lcd_get_row (r, have);
+    // The simulated panel shows characters it can't print as '?'
+    for (int c = 0; c < WIDTH; c++)
+      {
+      unsigned char want = (unsigned char)screen.cells[r * WIDTH + c];
+      if (want < 32 || want > 126) want = '?';
+      if ((unsigned char)have[c] != want) return FALSE;
+      }
+    }
+  int row, col;
+  host_lcd_get_cursor (&row, &col);
+  if (row != screen.cursor_row || col != screen.cursor_col) return FALSE;
+  BOOL lit = (screen.flags & I2C_LCD_PANEL_BACKLIGHT) != 0;
+  return lit == host_lcd_backlight();
+  }
+
+/*===========================================================================
+ * random_work
+ * ========================================================================*/
+static void random_work (I2C_LCD **consoles, int *current, int i)
+  {
+  I2C_LCD *lcd = consoles[*current];
+  char s[WIDTH + 1];
+  int r = rand() % 100;
+  if (r < 50)
+    {
+    int n = 1 + rand() % 12;
+    for (int k = 0; k < n; k++)
+      {
+      int c = rand() % 40;
+      s[k] = c == 0 ? (char)0xFF : c == 1 ? '\\' : (char)('a' + c % 26);
+      }
+    i2c_lcd_print_chars (lcd, s, n);
+    }
+  else if (r < 65)
+    i2c_lcd_print_char (lcd, '\r');
+  else if (r < 72)
+    {
+    *current = rand() % CONSOLES;
+    i2c_lcd_activate (consoles[*current]);
+    }
+  else if (r < 78)
+    {
+    i2c_lcd_scrollback_page_up (lcd);
+    i2c_lcd_update (lcd);
+    }
+  else if (r < 82)
+    {
+    i2c_lcd_scrollback_live (lcd);
+    i2c_lcd_update (lcd);
+    }
+  else if (r < 92)
+    {
+    snprintf (s, sizeof (s), "F%d        00:%02d:%02d", *current + 1,
+      i / 60 % 60, i % 60);
+    i2c_lcd_set_status (lcd, 0, 0, s);
+    }
+  else if (r < 95)
+    {
+    if (rand() % 2) i2c_lcd_cursor_on (lcd); else i2c_lcd_cursor_off (lcd);
+    }
+  else if (r < 98)
+    i2c_lcd_clear (lcd, FALSE);
+  else
+    {
+    if (rand() % 2)
+      i2c_lcd_backlight_on (lcd);
+    else
+      i2c_lcd_backlight_off (lcd);
+    }
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  int steps = 20000;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'n': steps = atoi (optarg); break;
+      default:
+        fprintf (stderr, "Usage: %s [-n steps]\n", argv[0]);
+        return 1;
+      }
+    }
+
+  srand (1);
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    400000);
+  I2C_LCD *consoles[CONSOLES];
+  consoles[0] = i2c_lcd_new_with_transport (WIDTH, HEIGHT, t, 4);
+  for (int i = 1; i < CONSOLES; i++)
+    consoles[i] = i2c_lcd_new_console (consoles[0], 4);
+  for (int i = 0; i < CONSOLES; i++)
+    i2c_lcd_set_status_region (consoles[i], 1, TRUE);
+  int current = 0;
+
+  mirror_screen_init (&screen);
+  MIRROR *mirror = mirror_new (consoles[0], MAX_BYTES, write_frame, NULL);
+
+  unsigned long polls = 0, checks = 0, wrong = 0, detected = 0;
+  for (int i = 0; i < steps; i++)
+    {
+    random_work (consoles, &current, i);
+    // The mirror task runs every few operations. Check the screen once
+    //   it has caught up.
+    if (rand() % 4 != 0) continue;
+    if (i >= steps / 2 && !dropped) drop_next = TRUE;
+    BOOL more;
+    do
+      {
+      more = mirror_poll (mirror);
+      polls++;
+      } while (more);
+    if (!screen.synced)
+      {
+      // A real viewer would ask for a key frame, or wait for the next
+      detected++;
+      mirror_key_frame (mirror);
+      while (mirror_poll (mirror)) polls++;
+      }
+    // The viewer can't know that a frame is missing until the next one
+    //   arrives, so don't check until it has found out
+    if (dropped > detected) continue;
+    checks++;
+    if (!screen_matches()) wrong++;
+    }
+
+  const MIRROR_STATS *st = mirror_get_stats (mirror);
+  double frames = st->frames ? st->frames : 1;
+  int full = 4 + WIDTH * HEIGHT;
+  printf ("operations:          %d\n", steps);
+  printf ("mirror polls:        %lu\n", polls);
+  printf ("frames:              %lu (%lu key, %lu split)\n",
+    (unsigned long)st->frames, (unsigned long)st->key_frames,
+    (unsigned long)st->split_frames);
+  printf ("bytes per frame:     mean %.1f, worst %lu (limit %d)\n",
+    frame_bytes / frames, worst_frame, MAX_BYTES);
+  printf ("cells per frame:     mean %.1f (a whole screen is %d)\n",
+    st->cells / frames, WIDTH * HEIGHT);
+  printf ("bytes sent:          %lu; %lu for whole screens\n",
+    frame_bytes, (unsigned long)(st->frames - st->key_frames) * full);
+  printf ("UART time per frame: mean %.2f ms, worst %.2f ms at %d baud\n",
+    frame_bytes / frames * 10000.0 / UART_BAUD,
+    worst_frame * 10000.0 / UART_BAUD, UART_BAUD);
+  printf ("frames dropped:      %lu, detected and recovered: %lu\n",
+    dropped, detected);
+  printf ("screen wrong:        %lu of %lu checks\n", wrong, checks);
+  BOOL ok = wrong == 0 && screen.bad == 0 && detected == dropped
+    && dropped > 0;
+  printf ("\n%s\n", ok ? "passed" : "FAILED");
+
+  mirror_destroy (mirror);
+  mirror_screen_free (&screen);
+  for (int i = CONSOLES - 1; i >= 0; i--)
+    i2c_lcd_destroy (consoles[i]);
+  return ok ? 0 : 1;
+  }
+
@@ -0,0 +1,158 @@
+/*===========================================================================
+ * tools/mirror_decode.c
+ *
+ * Reconstruction of the display from mirror frames. See mirror_decode.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "mirror_decode.h"
+
+/*===========================================================================
+ * parse_int
+ * Parse a decimal number, which may be negative, and move *p past it.
+ * ========================================================================*/
+static bool parse_int (const char **p, int *n)
+  {
+  char *end;
+  long v = strtol (*p, &end, 10);
+  if (end == *p) return false;
+  *n = (int)v;
+  *p = end;
+  return true;
+  }
+
+/*===========================================================================
+ * check_seq
+ * ========================================================================*/
+static void check_seq (MIRROR_SCREEN *screen, int seq)
+  {
+  if (screen->next_seq >= 0 && seq != screen->next_seq)
+    {
+    screen->lost++;
+    screen->synced = false;
+    }
+  screen->next_seq = (seq + 1) % 256;
+  }
+
+/*===========================================================================
+ * key_frame
+ * ========================================================================*/
+static int key_frame (MIRROR_SCREEN *screen, const char *p)
+  {
+  int seq, rows, cols;
+  if (!parse_int (&p, &seq) || !parse_int (&p, &rows)
+       || !parse_int (&p, &cols) || rows <= 0 || cols <= 0
+       || rows > 4 || cols > 80)
+    return -1;
+  screen->next_seq = -1;
+  check_seq (screen, seq);
+  if (rows != screen->rows || cols != screen->cols)
+    {
+    free (screen->cells);
+    screen->cells = malloc ((size_t)rows * cols);
+    screen->rows = rows;
+    screen->cols = cols;
+    }
+  memset (screen->cells, ' ', (size_t)rows * cols);
+  screen->cursor_row = -1;
+  screen->cursor_col = -1;
+  screen->synced = true;
+  return 1;
+  }
+
+/*===========================================================================
+ * update_frame
+ * ========================================================================*/
+static int update_frame (MIRROR_SCREEN *screen, const char *p)
+  {
+  int seq, row, col;
+  if (!parse_int (&p, &seq)) return -1;
+  check_seq (screen, seq);
+  if (!screen->synced) return -1;
+
+  char *end;
+  long flags = strtol (p, &end, 16);
+  if (end == p) return -1;
+  p = end;
+  if (!parse_int (&p, &row) || !parse_int (&p, &col)) return -1;
+  screen->flags = (int)flags;
+  screen->cursor_row = row;
+  screen->cursor_col = col;
+
+  // Cell ranges: " row,col,n:text"
+  while (*p == ' ')
+    {
+    p++;
+    int n;
+    if (!parse_int (&p, &row) || *p++ != ',' || !parse_int (&p, &col)
+         || *p++ != ',' || !parse_int (&p, &n) || *p++ != ':')
+      return -1;
+    if (row < 0 || row >= screen->rows || col < 0 || n < 0
+         || col + n > screen->cols)
+      return -1;
+    char *cell = screen->cells + row * screen->cols + col;
+    for (int i = 0; i < n; i++)
+      {
+      if (*p == 0 || *p == '\n') return -1;
+      if (*p == '\\')
+        {
+        if (p[1] != 'x' || !p[2] || !p[3]) return -1;
+        char hex[3] = { p[2], p[3], 0 };
+        cell[i] = (char)strtol (hex, NULL, 16);
+        p += 4;
+        }
+      else
+        cell[i] = *p++;
+      }
+    }
+  return 1;
+  }
+
+/*===========================================================================
+ * mirror_screen_init
+ * ========================================================================*/
+void mirror_screen_init (MIRROR_SCREEN *screen)
+  {
+  memset (screen, 0, sizeof (MIRROR_SCREEN));
+  screen->cursor_row = -1;
+  screen->cursor_col = -1;
+  screen->next_seq = -1;
+  }
+
+/*===========================================================================
+ * mirror_screen_free
+ * ========================================================================*/
+void mirror_screen_free (MIRROR_SCREEN *screen)
+  {
+  free (screen->cells);
+  screen->cells = NULL;
+  }
+
+/*===========================================================================
+ * mirror_screen_line
+ * ========================================================================*/
+int mirror_screen_line (MIRROR_SCREEN *screen, const char *line)
+  {
+  if (line[0] != '@') return 0;
+  int ret;
+  if (line[1] == 'K')
+    ret = key_frame (screen, line + 2);
+  else if (line[1] == 'U')
+    ret = update_frame (screen, line + 2);
+  else
+    return 0;
+  if (ret > 0)
+    screen->frames++;
+  else if (screen->synced)
+    {
+    // A frame that we couldn't make sense of has left the screen in an
+    //   unknown state
+    screen->bad++;
+    screen->synced = false;
+    }
+  return ret;
+  }
+
@@ -0,0 +1,39 @@
+/*===========================================================================
+ * tools/mirror_decode.h
+ *
+ * Reconstruction of the display from the frames that the firmware's
+ * mirror sends over the serial console. The frame format is described
+ * in mirror/include/mirror/mirror.h.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct _MIRROR_SCREEN
+  {
+  int rows;
+  int cols;
+  char *cells;          // rows * cols
+  int flags;            // I2C_LCD_PANEL_ flags
+  int cursor_row;       // -1 if the cursor is not on the screen
+  int cursor_col;
+  bool synced;          // A key frame has arrived, and nothing is missing
+  int next_seq;         // The sequence number expected next
+  unsigned long frames; // Frames applied
+  unsigned long lost;   // Gaps in the sequence numbers
+  unsigned long bad;    // Frames that couldn't be parsed
+  } MIRROR_SCREEN;
+
+/** Start with an empty screen, waiting for a key frame. */
+extern void mirror_screen_init (MIRROR_SCREEN *screen);
+extern void mirror_screen_free (MIRROR_SCREEN *screen);
+
+/** Apply one line of serial output. Returns 1 if it was a frame, and
+    has been applied, 0 if it wasn't a frame, or -1 if it was a frame
+    that couldn't be parsed, or couldn't be applied because the screen
+    is out of step. The line may or may not end with a newline. */
+extern int  mirror_screen_line (MIRROR_SCREEN *screen, const char *line);
+
@@ -0,0 +1,216 @@
+/*===========================================================================
+ * tools/printf_bench.c
+ *
+ * Checks the display's own formatter, i2c_lcd_printf(), against the C
+ * library's, and measures how much faster it is.
+ *
+ * First, thousands of random values are formatted both ways, with each
+ * of the conversions and flags that i2c_lcd_printf() supports, and the
+ * results compared. Fixed-point numbers, which the C library has no
+ * integer conversion for, are compared with the integer and fractional
+ * parts printed separately.
+ *
+ * Then the time to format a typical line of a display -- a reading,
+ * a fixed-point value, a hex code, and a label -- is measured for
+ * i2c_lcd_format() and snprintf().
+ *
+ * Last, the line is printed on a simulated 20x4 display, once with
+ * i2c_lcd_printf() and once with snprintf() and i2c_lcd_print_string(),
+ * to check that both reach the display as the same single batch.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+#include "replay.h"
+
+#define CASES 20000
+#define CALLS 1000000
+
+#define LINE_FORMAT "T%3d %.1dC %04X %-4s"
+
+/*===========================================================================
+ * random_int
+ * A random value, of random size, so that every number of digits is
+ * tried.
+ * ========================================================================*/
+static long random_int (void)
+  {
+  long v = (long)(((unsigned long)rand() << 16) ^ (unsigned long)rand());
+  v >>= rand() % 31;
+  return rand() % 2 ? -v : v;
+  }
+
+/*===========================================================================
+ * same
+ * ========================================================================*/
+static int same (const char *fmt, const char *mine, const char *libc)
+  {
+  if (strcmp (mine, libc) == 0) return 1;
+  printf ("  \"%s\": \"%s\", should be \"%s\"\n", fmt, mine, libc);
+  return 0;
+  }
+
+/*===========================================================================
+ * check
+ * Returns the number of differences.
+ * ========================================================================*/
+static int check (void)
+  {
+  static const char *const int_formats[] =
+    { "%d", "%5d", "%-7d|", "%08d", "%+d", "%+06d", "%i", "%x", "%08X",
+      "%.5x", "%-6X|", "%.30x", "%012.9X|", "%-12.9x|", "[%c]", "%3c|",
+      "%%%d" };
+  static const char *const words[] =
+    { "", "a", "READY", "sensor", "0123456789abcdef" };
+  int n = sizeof (int_formats) / sizeof (int_formats[0]);
+  char mine[64], libc[64];
+  int ok = 0, total = 0;
+
+  for (int i = 0; i < CASES; i++)
+    {
+    int v = (int)random_int();
+    const char *fmt = int_formats[i % n];
+    if (strchr (fmt, 'c')) v = 32 + (v & 0x7FFFFFFF) % 95;
+    i2c_lcd_format (mine, sizeof (mine), fmt, v);
+    snprintf (libc, sizeof (libc), fmt, v);
+    ok += same (fmt, mine, libc);
+
+    long l = random_int();
+    i2c_lcd_format (mine, sizeof (mine), "%ld %lu %lx", l,
+      (unsigned long)l, (unsigned long)l);
+    snprintf (libc, sizeof (libc), "%ld %lu %lx", l, (unsigned long)l,
+      (unsigned long)l);
+    ok += same ("%ld %lu %lx", mine, libc);
+
+    const char *w = words[i % 5];
+    int width = rand() % 10, prec = rand() % 6;
+    i2c_lcd_format (mine, sizeof (mine), "%*s|%-*s|%.*s", width, w,
+      width, w, prec, w);
+    snprintf (libc, sizeof (libc), "%*s|%-*s|%.*s", width, w, width, w,
+      prec, w);
+    ok += same ("%*s|%-*s|%.*s", mine, libc);
+
+    // Fixed-point, against the parts printed separately
+    int places = 1 + rand() % 4, scale = 1;
+    for (int k = 0; k < places; k++) scale *= 10;
+    unsigned a = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    char part[32];
+    snprintf (part, sizeof (part), "%s%u.%0*u", v < 0 ? "-" : "",
+      a / scale, places, a % scale);
+    snprintf (libc, sizeof (libc), "%10s", part);
+    i2c_lcd_format (mine, sizeof (mine), "%10.*d", places, v);
+    ok += same ("%10.*d", mine, libc);
+
+    total += 4;
+    }
+
+  // Truncation, which must behave as snprintf()'s does. The size is
+  //   volatile, or the compiler warns about the truncation.
+  volatile int small = 6;
+  int r1 = i2c_lcd_format (mine, small, "%s=%d", "count", 12345);
+  int r2 = snprintf (libc, small, "%s=%d", "count", 12345);
+  ok += same ("%s=%d, truncated", mine, libc) && r1 == r2;
+  total++;
+
+  // An unsupported conversion stops the output, rather than taking an
+  //   argument it may not have, and throwing out the rest. The format
+  //   isn't a literal, or the compiler warns about it.
+  const char *volatile bad = "a%qb%s";
+  i2c_lcd_format (mine, sizeof (mine), bad, 1, "x");
+  ok += same ("a%qb%s", mine, "a%q");
+  total++;
+
+  printf ("formatting:          %d of %d the same as snprintf\n", ok,
+    total);
+  return total - ok;
+  }
+
+/*===========================================================================
+ * time_format
+ * ========================================================================*/
+static void time_format (void)
+  {
+  char buf[64];
+  volatile int sink = 0;
+  uint64_t start = replay_wall_us();
+  for (int i = 0; i < CALLS; i++)
+    sink += i2c_lcd_format (buf, sizeof (buf), LINE_FORMAT, i % 1000,
+      i % 500 - 100, i, "OK");
+  uint64_t mine = replay_wall_us() - start;
+  start = replay_wall_us();
+  for (int i = 0; i < CALLS; i++)
+    sink += snprintf (buf, sizeof (buf), "T%3d %s%d.%dC %04X %-4s",
+      i % 1000, i % 500 - 100 < 0 ? "-" : "", abs (i % 500 - 100) / 10,
+      abs (i % 500 - 100) % 10, i, "OK");
+  uint64_t libc = replay_wall_us() - start;
+  printf ("format a line:       %.1f ns, snprintf %.1f ns (%.1fx)\n",
+    mine * 1000.0 / CALLS, libc * 1000.0 / CALLS, (double)libc / mine);
+  }
+
+/*===========================================================================
+ * print_line
+ * Print the line both ways, and check that the display shows the same,
+ * for the same traffic. Returns TRUE if it does.
+ * ========================================================================*/
+static BOOL print_line (void)
+  {
+  host_lcd_set_geometry (20, 4);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    400000);
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (20, 4, t, 1);
+  char row[2][64];
+  unsigned long trans[2];
+  uint64_t us[2];
+
+  for (int k = 0; k < 2; k++)
+    {
+    i2c_lcd_set_cursor (lcd, k, 0);
+    host_lcd_reset_stats();
+    uint64_t start = time_us_64();
+    if (k == 0)
+      i2c_lcd_printf (lcd, LINE_FORMAT, 21, -35, 0xBEEF, "OK");
+    else
+      {
+      char buf[32];
+      snprintf (buf, sizeof (buf), "T%3d %s%d.%dC %04X %-4s", 21, "-", 3,
+        5, 0xBEEF, "OK");
+      i2c_lcd_print_string (lcd, buf);
+      }
+    us[k] = time_us_64() - start;
+    trans[k] = host_lcd_stats()->i2c_transactions;
+    host_lcd_get_row (k, row[k]);
+    }
+  i2c_lcd_destroy (lcd);
+
+  BOOL ok = strncmp (row[0], row[1], 20) == 0 && trans[0] == trans[1];
+  printf ("print a line:        %.20s, %lu I2C transfers, %lu us\n",
+    row[0], trans[0], (unsigned long)us[0]);
+  printf ("  with snprintf:     %.20s, %lu I2C transfers, %lu us %s\n",
+    row[1], trans[1], (unsigned long)us[1], ok ? "ok" : "WRONG");
+  return ok;
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  srand (1);
+  int differences = check();
+  time_format();
+  BOOL ok = print_line() && differences == 0;
+  printf ("\n%s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+  }
+
@@ -0,0 +1,215 @@
+/*===========================================================================
+ * tools/ram_map.c
+ *
+ * Reads the linker map that the build writes alongside the firmware
+ * (build/pico_usb_kbd_lcd.elf.map), and says how much of the Pico's RAM
+ * each module's static data takes, and each part of the program:
+ * display, keyboard, USB, and so on. This is the static half of the
+ * memory budget; the 'r' serial command gives the heap and stacks.
+ *
+ * Every input section placed in RAM is counted, including code that
+ * the SDK copies to RAM to run, and the space set aside for the stacks
+ * and the heap. Padding between sections is counted separately.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The RP2040's RAM: the striped 256kB, then the two 4kB scratch banks
+#define RAM_START 0x20000000UL
+#define RAM_END 0x20042000UL
+
+#define MAX_MODULES 32
+
+typedef struct _RULE
+  {
+  const char *match;  // Part of an object's path
+  const char *module;
+  const char *part;
+  } RULE;
+
+// The first rule that matches an object's path says what it belongs to
+static const RULE rules[] =
+  {
+  { "/i2c_lcd/", "i2c_lcd", "display" },
+  { "/mirror/", "mirror", "display" },
+  { "/export/", "export", "display" },
+  { "/kbd/src/", "kbd", "keyboard" },
+  { "/line_edit/", "line_edit", "keyboard" },
+  { "/burst/", "burst", "keyboard" },
+  { "/usb_kbd/", "usb_kbd", "USB" },
+  { "tinyusb", "tinyusb", "USB" },
+  { "/journal/", "journal", "journal" },
+  { "/sched/", "sched", "other" },
+  { "/memstat/", "memstat", "other" },
+  { "main.c", "main", "other" },
+  { "libgcc", "libgcc", "libraries" },
+  { "libc", "libc", "libraries" },
+  { "libg", "libc", "libraries" },
+  { "libm", "libc", "libraries" },
+  { "", "sdk", "SDK" },
+  };
+
+typedef struct _TOTAL
+  {
+  const char *name;
+  unsigned long bytes;
+  } TOTAL;
+
+static TOTAL modules[MAX_MODULES], parts[MAX_MODULES];
+static int num_modules, num_parts;
+static unsigned long stack_heap, padding;
+
+/*===========================================================================
+ * add
+ * ========================================================================*/
+static void add (TOTAL *t, int *n, const char *name, unsigned long bytes)
+  {
+  for (int i = 0; i < *n; i++)
+    {
+    if (strcmp (t[i].name, name) == 0)
+      {
+      t[i].bytes += bytes;
+      return;
+      }
+    }
+  if (*n == MAX_MODULES) return;
+  t[*n].name = name;
+  t[*n].bytes = bytes;
+  (*n)++;
+  }
+
+/*===========================================================================
+ * count
+ * One input section.
+ * ========================================================================*/
+static void count (const char *section, unsigned long addr,
+    unsigned long size, const char *object)
+  {
+  if (addr < RAM_START || addr >= RAM_END || size == 0) return;
+  if (strcmp (section, "*fill*") == 0)
+    {
+    padding += size;
+    return;
+    }
+  if (strncmp (section, ".stack", 6) == 0 || strncmp (section, ".heap", 5)
+        == 0)
+    {
+    stack_heap += size;
+    return;
+    }
+  for (size_t i = 0; i < sizeof (rules) / sizeof (rules[0]); i++)
+    {
+    if (strstr (object, rules[i].match))
+      {
+      add (modules, &num_modules, rules[i].module, size);
+      add (parts, &num_parts, rules[i].part, size);
+      return;
+      }
+    }
+  }
+
+/*===========================================================================
+ * by_size
+ * ========================================================================*/
+static int by_size (const void *a, const void *b)
+  {
+  unsigned long x = ((const TOTAL *)a)->bytes;
+  unsigned long y = ((const TOTAL *)b)->bytes;
+  return x < y ? 1 : x > y ? -1 : 0;
+  }
+
+/*===========================================================================
+ * print
+ * ========================================================================*/
+static void print (const char *title, TOTAL *t, int n, unsigned long all)
+  {
+  qsort (t, n, sizeof (TOTAL), by_size);
+  printf ("%-12s %8s %6s\n", title, "bytes", "%");
+  for (int i = 0; i < n; i++)
+    printf ("%-12s %8lu %6.1f\n", t[i].name, t[i].bytes,
+      all ? 100.0 * t[i].bytes / all : 0.0);
+  printf ("\n");
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (int argc, char **argv)
+  {
+  if (argc != 2)
+    {
+    fprintf (stderr, "Usage: %s build/pico_usb_kbd_lcd.elf.map\n",
+      argv[0]);
+    return 1;
+    }
+  FILE *f = fopen (argv[1], "r");
+  if (!f)
+    {
+    perror (argv[1]);
+    return 1;
+    }
+
+  char *line = NULL;
+  size_t size = 0;
+  char section[256] = "";
+  int in_map = 0;
+  while (getline (&line, &size, f) >= 0)
+    {
+    if (!in_map)
+      {
+      in_map = strncmp (line, "Linker script and memory map", 28) == 0;
+      continue;
+      }
+    unsigned long addr, bytes;
+    char name[256], object[1024];
+    // An input section is indented by one space. A long name is on a
+    //   line of its own, and its address, size, and object are on the
+    //   next one, indented further.
+    if (line[0] == ' ' && line[1] != ' ')
+      {
+      int n = sscanf (line, " %255s 0x%lx 0x%lx %1023s", name, &addr,
+        &bytes, object);
+      if (n == 4 || (n == 3 && strcmp (name, "*fill*") == 0))
+        {
+        count (name, addr, bytes, n == 4 ? object : "");
+        section[0] = 0;
+        }
+      else if (n == 1)
+        strcpy (section, name);
+      else
+        section[0] = 0;
+      }
+    else if (section[0] && line[0] == ' ')
+      {
+      if (sscanf (line, " 0x%lx 0x%lx %1023s", &addr, &bytes, object) == 3)
+        count (section, addr, bytes, object);
+      section[0] = 0;
+      }
+    else
+      section[0] = 0;
+    }
+  free (line);
+  fclose (f);
+
+  if (!in_map)
+    {
+    fprintf (stderr, "%s: not a GNU linker map\n", argv[1]);
+    return 1;
+    }
+
+  unsigned long data = 0;
+  for (int i = 0; i < num_modules; i++) data += modules[i].bytes;
+  print ("module", modules, num_modules, data);
+  print ("part", parts, num_parts, data);
+  printf ("Static data and RAM code: %lu bytes\n", data);
+  printf ("Padding: %lu bytes\n", padding);
+  printf ("Set aside for stacks and heap: %lu bytes\n", stack_heap);
+  printf ("RAM: %lu bytes\n", RAM_END - RAM_START);
+  return 0;
+  }
+
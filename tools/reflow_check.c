@@ -0,0 +1,403 @@
+/*===========================================================================
+ * tools/reflow_check.c
+ *
+ * Checks that the scrollback buffer keeps logical lines, and shows them
+ * rewrapped when the display changes size, and measures what that costs.
+ *
+ * A 20x4 display is filled with lines of random length, many of them
+ * long enough to wrap on to two or three rows, and the rows of its
+ * scrollback buffer are checked against the same lines wrapped at 20
+ * characters. Then the display is changed to 16x2, and the rows must be
+ * the lines wrapped at 16. The buffer is paged through from the bottom
+ * to the top, and the panel checked at every step.
+ *
+ * The lines also go to a flash journal as they're printed, as the
+ * firmware does it, and the journal is restored into a fresh 16x2
+ * display, which must end up holding the same lines. Then the lines are
+ * journalled again while the display changes from 20x4 to 16x2 to 40x2,
+ * and what is restored must be the same lines, whatever width they
+ * were written at.
+ *
+ * Changing the size should cost about the same however big the buffer
+ * is, because nothing in it is worked out again until it's shown. So
+ * the change is timed with buffers of different sizes; so is the first
+ * movement after it, which has to count the rows.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include <journal/journal.h>
+#include "config.h"
+#include "replay.h"
+
+#define WIDTH 20
+#define HEIGHT 4
+#define NEW_WIDTH 16
+#define NEW_HEIGHT 2
+#define PAGES 50
+#define LINES 600
+#define LONGEST 56
+#define WIDE 40
+#define BIG_PAGES 1000
+
+static char printed[LINES][LONGEST + 1];
+static JOURNAL *journal;
+
+/*===========================================================================
+ * make_line
+ * Line i: its number, and then words of random letters, up to a random
+ * length.
+ * ========================================================================*/
+static void make_line (int i, char *s)
+  {
+  int want = rand() % (LONGEST + 1);
+  int len = snprintf (s, LONGEST + 1, "%d", i);
+  while (len < want)
+    {
+    s[len++] = ' ';
+    int word = 1 + rand() % 7;
+    for (int k = 0; k < word && len < want; k++)
+      s[len++] = (char)('a' + rand() % 26);
+    }
+  // Lines are kept without trailing spaces
+  while (len > 0 && s[len - 1] == ' ') len--;
+  s[len] = 0;
+  }
+
+/*===========================================================================
+ * expected_line
+ * Logical line n is what was printed as line n; after that come the
+ * empty lines at the cursor and below.
+ * ========================================================================*/
+static const char *expected_line (uint32_t n)
+  {
+  return n < LINES ? printed[n] : "";
+  }
+
+/*===========================================================================
+ * check_lines
+ * The display's logical lines must be the ones that were printed.
+ * ========================================================================*/
+static BOOL check_lines (const I2C_LCD *lcd)
+  {
+  char line[I2C_LCD_LINE_MAX + 1];
+  for (uint32_t n = i2c_lcd_first_line (lcd); n != i2c_lcd_end_line (lcd);
+        n++)
+    {
+    i2c_lcd_get_line (lcd, n, line, sizeof (line));
+    if (strcmp (line, expected_line (n)) != 0)
+      {
+      printf ("line %lu is \"%s\", not \"%s\"\n", (unsigned long)n, line,
+        expected_line (n));
+      return FALSE;
+      }
+    }
+  return TRUE;
+  }
+
+/*===========================================================================
+ * expected_rows
+ * The rows the display's lines should take up at its width, worked out
+ * independently of the driver. Returns the number of rows.
+ * ========================================================================*/
+static int expected_rows (const I2C_LCD *lcd, char *rows)
+  {
+  int width = i2c_lcd_get_width (lcd);
+  int n_rows = 0;
+  for (uint32_t n = i2c_lcd_first_line (lcd); n != i2c_lcd_end_line (lcd);
+        n++)
+    {
+    const char *s = expected_line (n);
+    int len = (int)strlen (s);
+    int k = 0;
+    do
+      {
+      char *row = rows + (size_t)n_rows++ * (width + 1);
+      int c = MIN (width, len - k);
+      memcpy (row, s + k, c);
+      memset (row + c, ' ', width - c);
+      row[width] = 0;
+      k += width;
+      } while (k < len);
+    }
+  return n_rows;
+  }
+
+/*===========================================================================
+ * check_rows
+ * The rows of the scrollback buffer must be the lines, wrapped at the
+ * display's width.
+ * ========================================================================*/
+static BOOL check_rows (const I2C_LCD *lcd, char *rows)
+  {
+  int width = i2c_lcd_get_width (lcd);
+  int n_rows = expected_rows (lcd, rows);
+  if (n_rows != i2c_lcd_scrollback_lines (lcd))
+    {
+    printf ("%d rows, not %d\n", i2c_lcd_scrollback_lines (lcd), n_rows);
+    return FALSE;
+    }
+  char row[WIDTH + 1];
+  for (int r = 0; r < n_rows; r++)
+    {
+    i2c_lcd_get_scrollback_line (lcd, r, row);
+    if (strcmp (row, rows + (size_t)r * (width + 1)) != 0)
+      {
+      printf ("row %d is \"%s\", not \"%s\"\n", r, row,
+        rows + (size_t)r * (width + 1));
+      return FALSE;
+      }
+    }
+  return TRUE;
+  }
+
+/*===========================================================================
+ * page_through
+ * Page up from the live display to the top, checking the panel at every
+ * step. Returns the mean host time of a step, or -1 if the panel was
+ * ever wrong.
+ * ========================================================================*/
+static double page_through (I2C_LCD *lcd, char *rows)
+  {
+  int width = i2c_lcd_get_width (lcd);
+  int height = i2c_lcd_get_height (lcd);
+  int n_rows = expected_rows (lcd, rows);
+  uint64_t total = 0;
+  int steps = 0;
+  char have[WIDTH + 1];
+  do
+    {
+    uint64_t start = replay_wall_us();
+    i2c_lcd_scrollback_page_up (lcd);
+    i2c_lcd_update (lcd);
+    total += replay_wall_us() - start;
+    steps++;
+    int first = n_rows - height - i2c_lcd_get_scrollback (lcd);
+    for (int r = 0; r < height; r++)
+      {
+      host_lcd_get_row (r, have);
+      if (strcmp (have, rows + (size_t)(first + r) * (width + 1)) != 0)
+        return -1;
+      }
+    } while (i2c_lcd_get_scrollback (lcd)
+               < i2c_lcd_scrollback_history (lcd));
+  i2c_lcd_scrollback_live (lcd);
+  i2c_lcd_update (lcd);
+  return (double)total / steps;
+  }
+
+/*===========================================================================
+ * journal_line
+ * ========================================================================*/
+static void journal_line (const char *line, int width, BOOL continued,
+              void *context)
+  {
+  (void)context;
+  journal_add_line (journal, line, width, continued);
+  while (journal_work (journal, FALSE))
+    ;
+  }
+
+/*===========================================================================
+ * restore_line
+ * ========================================================================*/
+static void restore_line (const char *line, int width, BOOL continued,
+              void *context)
+  {
+  i2c_lcd_restore_line ((I2C_LCD *)context, line, width, continued);
+  }
+
+/*===========================================================================
+ * new_display
+ * ========================================================================*/
+static I2C_LCD *new_display (int width, int height, int pages)
+  {
+  host_lcd_set_geometry (width, height);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    1000000);
+  return i2c_lcd_new_with_transport (width, height, t, pages);
+  }
+
+/*===========================================================================
+ * fill
+ * ========================================================================*/
+static void fill (I2C_LCD *lcd)
+  {
+  for (int i = 0; i < LINES; i++)
+    {
+    i2c_lcd_print_string (lcd, printed[i]);
+    i2c_lcd_print_char (lcd, '\r');
+    }
+  }
+
+/*===========================================================================
+ * check_journal_resize
+ * Journal the lines while the display changes size, and restore them.
+ * Every line restored, but the first (which may have lost its start),
+ * must be one that was printed, and they must follow on from each 
+ * other. Lines of spaces, journalled as the size changed, are skipped.
+ * ========================================================================*/
+static void check_journal_resize (void)
+  {
+  I2C_LCD *lcd = new_display (WIDTH, HEIGHT, PAGES);
+  journal = journal_new (I2C_LCD_MAX_WIDTH, 16, 64);
+  i2c_lcd_set_line_callback (lcd, journal_line, NULL);
+  static const int sizes[3][2] = 
+    { { WIDTH, HEIGHT }, { NEW_WIDTH, NEW_HEIGHT }, { WIDE, NEW_HEIGHT } };
+  for (int k = 0; k < 3; k++)
+    {
+    if (k > 0)
+      {
+      host_lcd_set_geometry (sizes[k][0], sizes[k][1]);
+      i2c_lcd_set_geometry (lcd, sizes[k][0], sizes[k][1]);
+      }
+    for (int i = k * LINES / 3; i < (k + 1) * LINES / 3; i++)
+      {
+      i2c_lcd_print_string (lcd, printed[i]);
+      i2c_lcd_print_char (lcd, '\r');
+      }
+    }
+  while (journal_work (journal, TRUE))
+    ;
+  i2c_lcd_destroy (lcd);
+  journal_destroy (journal);
+
+  lcd = new_display (NEW_WIDTH, NEW_HEIGHT, BIG_PAGES);
+  journal = journal_new (NEW_WIDTH, 16, 64);
+  int restored = journal_restore (journal, (BIG_PAGES - 1) * NEW_HEIGHT,
+    restore_line, lcd);
+  char line[I2C_LCD_LINE_MAX + 1];
+  uint32_t end = i2c_lcd_end_line (lcd) - NEW_HEIGHT;
+  int first = -1, last = -1;
+  BOOL ok = TRUE;
+  for (uint32_t n = i2c_lcd_first_line (lcd) + 1; ok && n != end; n++)
+    {
+    i2c_lcd_get_line (lcd, n, line, sizeof (line));
+    if (strspn (line, " ") == strlen (line)) continue;
+    int i = atoi (line);
+    ok = i >= 0 && i < LINES && strcmp (line, printed[i]) == 0
+      && (last < 0 || i == last + 1);
+    if (first < 0) first = i;
+    last = i;
+    }
+  // The lines must go back past both changes of size
+  ok = ok && first >= 0 && first < LINES / 3 && last > 2 * LINES / 3;
+  printf ("resize:  %d rows of 20, 16 and 40 restored as lines %d to %d\n",
+    restored, first, last);
+  replay_expect ("lines restored in order, across both changes", ok);
+  i2c_lcd_destroy (lcd);
+  journal_destroy (journal);
+  }
+
+/*===========================================================================
+ * time_change
+ * Time a change of size with a buffer of 'pages' pages, and the first
+ * page up after it.
+ * ========================================================================*/
+static void time_change (int pages)
+  {
+  I2C_LCD *lcd = new_display (WIDTH, HEIGHT, pages);
+  for (int k = 0; k < pages * HEIGHT / LINES + 1; k++) fill (lcd);
+  host_lcd_set_geometry (NEW_WIDTH, NEW_HEIGHT);
+  uint64_t start = replay_wall_us();
+  i2c_lcd_set_geometry (lcd, NEW_WIDTH, NEW_HEIGHT);
+  uint64_t change = replay_wall_us() - start;
+  start = replay_wall_us();
+  i2c_lcd_scrollback_page_up (lcd);
+  i2c_lcd_update (lcd);
+  uint64_t first = replay_wall_us() - start;
+  start = replay_wall_us();
+  i2c_lcd_scrollback_page_up (lcd);
+  i2c_lcd_update (lcd);
+  uint64_t second = replay_wall_us() - start;
+  printf ("%-8d %-8lu %-10d %-12lu %-14lu %lu\n", pages,
+    (unsigned long)(i2c_lcd_end_line (lcd) - i2c_lcd_first_line (lcd)),
+    i2c_lcd_scrollback_history (lcd), (unsigned long)change,
+    (unsigned long)first, (unsigned long)second);
+  i2c_lcd_destroy (lcd);
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  srand (1);
+  for (int i = 0; i < LINES; i++) make_line (i, printed[i]);
+  char *rows = malloc ((size_t)(LINES + 8) * 4 * (WIDTH + 1));
+
+  I2C_LCD *lcd = new_display (WIDTH, HEIGHT, PAGES);
+  journal = journal_new (WIDTH, 16, 64);
+  i2c_lcd_set_line_callback (lcd, journal_line, NULL);
+  fill (lcd);
+  while (journal_work (journal, TRUE))
+    ;
+  i2c_lcd_set_line_callback (lcd, NULL, NULL);
+
+  printf ("20x4:    %lu lines held, %d rows above the display\n",
+    (unsigned long)(i2c_lcd_end_line (lcd) - i2c_lcd_first_line (lcd)),
+    i2c_lcd_scrollback_history (lcd));
+  replay_expect ("lines and rows as printed",
+    check_lines (lcd) && check_rows (lcd, rows));
+
+  host_lcd_set_geometry (NEW_WIDTH, NEW_HEIGHT);
+  host_lcd_reset_stats();
+  i2c_lcd_set_geometry (lcd, NEW_WIDTH, NEW_HEIGHT);
+  const HOST_LCD_STATS *st = host_lcd_stats();
+  printf ("change:  %lu characters, %lu commands sent\n", st->lcd_chars,
+    st->lcd_commands);
+  printf ("16x2:    %lu lines held, %d rows above the display\n",
+    (unsigned long)(i2c_lcd_end_line (lcd) - i2c_lcd_first_line (lcd)),
+    i2c_lcd_scrollback_history (lcd));
+  replay_expect ("lines the same, rows rewrapped at 16",
+    check_lines (lcd) && check_rows (lcd, rows));
+  double step_us = page_through (lcd, rows);
+  if (step_us >= 0)
+    printf ("paging:  %.1f us a page on the host\n", step_us);
+  replay_expect ("panel right at every page, to the top", step_us >= 0);
+  i2c_lcd_destroy (lcd);
+  journal_destroy (journal);
+
+  // Restore the 20-character journal into a 16x2 display. The oldest
+  //   line restored may have lost its start, so it isn't checked.
+  lcd = new_display (NEW_WIDTH, NEW_HEIGHT, PAGES);
+  journal = journal_new (NEW_WIDTH, 16, 64);
+  int restored = journal_restore (journal, (PAGES - 1) * NEW_HEIGHT,
+    restore_line, lcd);
+  uint32_t first = i2c_lcd_first_line (lcd) + 1;
+  uint32_t end = i2c_lcd_end_line (lcd) - NEW_HEIGHT;
+  char line[I2C_LCD_LINE_MAX + 1];
+  BOOL ok = end - first > 0;
+  for (uint32_t n = first; ok && n != end; n++)
+    {
+    i2c_lcd_get_line (lcd, n, line, sizeof (line));
+    ok = strcmp (line, printed[LINES - (end - n)]) == 0;
+    }
+  printf ("journal: %d rows of 20 restored as %lu lines of a 16x2 "
+    "display\n", restored, (unsigned long)(end - first + 1));
+  replay_expect ("the last lines printed, in order", ok);
+  i2c_lcd_destroy (lcd);
+  journal_destroy (journal);
+  check_journal_resize();
+
+  printf ("\nChanging 20x4 to 16x2, host time in us:\n");
+  printf ("%-8s %-8s %-10s %-12s %-14s %s\n", "pages", "lines", "rows",
+    "change", "first page", "second page");
+  time_change (10);
+  time_change (100);
+  time_change (1000);
+
+  free (rows);
+  printf ("\n%s\n", replay_failures() ? "FAILED" : "passed");
+  return replay_failures() ? 1 : 0;
+  }
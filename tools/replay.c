@@ -0,0 +1,176 @@
+/*===========================================================================
+ * tools/replay.c
+ *
+ * Functions shared by the host tools: loading and parsing HID traces,
+ * timing, and reporting checks. This needs nothing from the firmware,
+ * so any tool can link it; the parts that run the firmware are in 
+ * replay_firmware.c.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <usb_kbd/hid_trace.h>
+#include "replay.h"
+
+static int failures = 0;
+
+/*===========================================================================
+ * replay_wall_us
+ * ========================================================================*/
+uint64_t replay_wall_us (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+  }
+
+/*===========================================================================
+ * hex_value
+ * ========================================================================*/
+static int hex_value (int c)
+  {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+  }
+
+/*===========================================================================
+ * parse_dump
+ * Find the text that hid_trace_dump() writes in the n bytes at buf, and
+ * convert its hex to binary, in place. Returns the number of bytes of 
+ * trace, which is zero if there is no dump.
+ * ========================================================================*/
+static size_t parse_dump (uint8_t *buf, size_t n)
+  {
+  char *text = malloc (n + 1);
+  memcpy (text, buf, n);
+  text[n] = 0;
+  char *p = strstr (text, "HIDTRACE BEGIN");
+  size_t out = 0;
+  if (p)
+    {
+    p = strchr (p, '\n');
+    while (p && *p)
+      {
+      p++;
+      if (strncmp (p, "HIDTRACE END", 12) == 0) break;
+      while (*p && *p != '\n')
+        {
+        int hi = hex_value (p[0]);
+        int lo = hi >= 0 ? hex_value (p[1]) : -1;
+        if (hi < 0 || lo < 0) { p++; continue; }
+        buf[out++] = (uint8_t)(hi << 4 | lo);
+        p += 2;
+        }
+      }
+    }
+  free (text);
+  return out;
+  }
+
+/*===========================================================================
+ * replay_load
+ * ========================================================================*/
+uint8_t *replay_load (const char *filename, size_t *size)
+  {
+  FILE *f = fopen (filename, "rb");
+  if (!f)
+    {
+    perror (filename);
+    return NULL;
+    }
+  size_t cap = 4096, n = 0;
+  uint8_t *buf = malloc (cap);
+  int c;
+  while ((c = fgetc (f)) != EOF)
+    {
+    if (n == cap) buf = realloc (buf, cap *= 2);
+    buf[n++] = (uint8_t)c;
+    }
+  fclose (f);
+
+  // A text dump, saved on its own, starts "HIDTRACE", which starts
+  //   with the magic too
+  BOOL binary = n >= 4 && memcmp (buf, HID_TRACE_MAGIC, 4) == 0
+      && !(n >= 8 && memcmp (buf, "HIDTRACE", 8) == 0);
+  size_t out = binary ? n : parse_dump (buf, n);
+
+  if (out < HID_TRACE_HEADER_SIZE || memcmp (buf, HID_TRACE_MAGIC, 4) != 0)
+    {
+    fprintf (stderr, "%s: not a HID trace\n", filename);
+    free (buf);
+    return NULL;
+    }
+  if (buf[4] > HID_TRACE_VERSION)
+    {
+    fprintf (stderr, "%s: HID trace version %d is not supported\n", 
+      filename, buf[4]);
+    free (buf);
+    return NULL;
+    }
+  *size = out;
+  return buf;
+  }
+
+/*===========================================================================
+ * replay_next
+ * ========================================================================*/
+int replay_next (const uint8_t *trace, size_t size, size_t *pos,
+      REPLAY_RECORD *rec)
+  {
+  size_t p = *pos;
+  uint32_t delta = 0;
+  int shift = 0;
+  while (p < size)
+    {
+    uint8_t b = trace[p++];
+    delta |= (uint32_t)(b & 0x7F) << shift;
+    shift += 7;
+    if (!(b & 0x80)) break;
+    }
+  rec->delta_us = delta;
+  // Version 1 packed the address and instance into one byte
+  if (trace[4] == 1)
+    {
+    if (p + 2 > size) return 0;
+    rec->dev_addr = trace[p] >> 4;
+    rec->instance = trace[p] & 0x0F;
+    p++;
+    }
+  else
+    {
+    if (p + 3 > size) return 0;
+    rec->dev_addr = trace[p];
+    rec->instance = trace[p + 1];
+    p += 2;
+    }
+  rec->len = trace[p++];
+  if (p + rec->len > size) return 0;
+  rec->report = trace + p;
+  *pos = p + rec->len;
+  return 1;
+  }
+
+/*===========================================================================
+ * replay_expect
+ * ========================================================================*/
+BOOL replay_expect (const char *what, BOOL ok)
+  {
+  printf ("  %-48s %s\n", what, ok ? "ok" : "WRONG");
+  if (!ok) failures++;
+  return ok;
+  }
+
+/*===========================================================================
+ * replay_failures
+ * ========================================================================*/
+int replay_failures (void)
+  {
+  return failures;
+  }
@@ -0,0 +1,52 @@
+/*===========================================================================
+ * tools/replay.h
+ *
+ * Functions shared by the host tools. replay_init_firmware() and
+ * replay_report() are in replay_firmware.c, and need the firmware
+ * linked in; the rest are in replay.c, and need nothing else.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <i2c_lcd/i2c_lcd.h>
+
+typedef struct _REPLAY_RECORD
+  {
+  uint32_t delta_us;
+  uint8_t dev_addr;
+  uint8_t instance;
+  uint8_t len;
+  const uint8_t *report;
+  } REPLAY_RECORD;
+
+/** Monotonic wall-clock time on the host, in microseconds. */
+extern uint64_t replay_wall_us (void);
+
+/** Load a trace, either binary or as dumped by hid_trace_dump(). Returns
+    the binary trace, including its header, or NULL on error (which has
+    already been reported). The caller must free the result. */
+extern uint8_t *replay_load (const char *filename, size_t *size);
+
+/** Parse the record at offset *pos, and advance *pos past it. Returns
+    zero at the end of the trace. */
+extern int      replay_next (const uint8_t *trace, size_t size, size_t *pos,
+                  REPLAY_RECORD *rec);
+
+/** Print what was checked, with "ok" or "WRONG", and count it if it
+    was wrong. Returns ok. */
+extern BOOL     replay_expect (const char *what, BOOL ok);
+
+/** The number of checks that have been wrong. */
+extern int      replay_failures (void);
+
+/** Set up the firmware as its main() does. */
+extern void     replay_init_firmware (void);
+
+/** Deliver one report to the firmware, and run a pass of its main 
+    loop. */
+extern void     replay_report (const REPLAY_RECORD *rec);
+
@@ -0,0 +1,54 @@
+/*===========================================================================
+ * tools/replay_firmware.c
+ *
+ * Functions shared by the tools that push HID reports through the
+ * firmware: setting up the firmware's display stack on the simulated 
+ * Pico, and delivering reports to it. Tools that use these link main.c
+ * as well.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include "tusb.h"
+#include "config.h"
+#include "replay.h"
+
+// These are defined in main.c
+extern void app_init (void);
+extern bool app_ready (void);
+extern absolute_time_t app_poll (void);
+
+/*===========================================================================
+ * replay_init_firmware
+ * ========================================================================*/
+void replay_init_firmware (void)
+  {
+  host_lcd_set_geometry (LCD_WIDTH, LCD_HEIGHT);
+  if (LCD_BUS == LCD_BUS_GPIO)
+    host_lcd_set_gpio (LCD_GPIO_RS, LCD_GPIO_E, LCD_GPIO_D4);
+  app_init();
+  // Run the firmware until it has finished starting up
+  while (!app_ready())
+    {
+    absolute_time_t due = app_poll();
+    if (due != at_the_end_of_time && due > time_us_64())
+      host_advance_us (due - time_us_64());
+    }
+  }
+
+/*===========================================================================
+ * replay_report
+ * ========================================================================*/
+void replay_report (const REPLAY_RECORD *rec)
+  {
+  // On the device, the USB callback runs inside the main loop's USB
+  //   task. Here, we call it directly, and then run a pass of the main
+  //   loop to let the other tasks deal with the report.
+  tuh_hid_report_received_cb (rec->dev_addr, rec->instance, rec->report,
+    rec->len);
+  app_poll();
+  }
+
@@ -0,0 +1,123 @@
+/*===========================================================================
+ * tools/scrollback_nav.c
+ *
+ * Checks page-wise scrollback navigation, and measures what it costs.
+ *
+ * A 20x4 display with a large scrollback buffer is filled with numbered
+ * lines. Then the tool moves around the scrollback buffer -- runs of
+ * page up and page down, as auto-repeat would produce, and jumps to the
+ * top and back to the live display -- and after each run checks that 
+ * the simulated panel shows the right lines. It counts the characters
+ * and commands that reached the HD44780, and the time taken, for each
+ * run drawn once at the end (as the firmware does), and for the same 
+ * run drawn after every step.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+
+#define WIDTH 20
+#define HEIGHT 4
+#define PAGES 100
+
+typedef void (*MOVE_FN) (I2C_LCD *self);
+
+/*===========================================================================
+ * panel_ok
+ * TRUE if the panel shows the lines at the display's scrollback 
+ * position.
+ * ========================================================================*/
+static BOOL panel_ok (I2C_LCD *lcd)
+  {
+  char want[WIDTH + 1], have[WIDTH + 1];
+  int first = i2c_lcd_scrollback_lines (lcd) - HEIGHT 
+    - i2c_lcd_get_scrollback (lcd);
+  for (int r = 0; r < HEIGHT; r++)
+    {
+    i2c_lcd_get_scrollback_line (lcd, first + r, want);
+    host_lcd_get_row (r, have);
+    if (strcmp (want, have) != 0) return FALSE;
+    }
+  return TRUE;
+  }
+
+/*===========================================================================
+ * run
+ * Make n moves, drawing after every step if 'each' is TRUE, or only at 
+ * the end. Returns FALSE if the panel is wrong afterwards.
+ * ========================================================================*/
+static BOOL run (I2C_LCD *lcd, const char *name, MOVE_FN fn, int n, 
+      BOOL each)
+  {
+  host_lcd_reset_stats();
+  uint64_t start = time_us_64();
+  for (int i = 0; i < n; i++)
+    {
+    fn (lcd);
+    if (each) i2c_lcd_update (lcd);
+    }
+  i2c_lcd_update (lcd);
+  uint64_t elapsed = time_us_64() - start;
+  const HOST_LCD_STATS *st = host_lcd_stats();
+  BOOL ok = panel_ok (lcd);
+  printf ("%-16s %-5s %-10d %-10lu %-10lu %-10.3f %s\n", name,
+    each ? "each" : "end", i2c_lcd_get_scrollback (lcd), st->lcd_chars, 
+    st->lcd_commands, elapsed / 1000.0, ok ? "ok" : "WRONG");
+  return ok;
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    400000);
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT, t, PAGES);
+
+  char line[WIDTH + 1];
+  for (int i = 0; i < PAGES * HEIGHT; i++)
+    {
+    snprintf (line, sizeof (line), "line %d\r", i);
+    i2c_lcd_print_string (lcd, line);
+    }
+
+  printf ("%-16s %-5s %-10s %-10s %-10s %-10s %s\n", "moves", "draw", 
+    "position", "chars", "commands", "ms", "panel");
+  int failures = 0;
+  for (int each = 1; each >= 0; each--)
+    {
+    if (!run (lcd, "20 x page up", i2c_lcd_scrollback_page_up, 20, each)) 
+      failures++;
+    if (!run (lcd, "10 x page down", i2c_lcd_scrollback_page_down, 10, 
+      each)) failures++;
+    if (!run (lcd, "200 x page up", i2c_lcd_scrollback_page_up, 200, each)) 
+      failures++;
+    if (!run (lcd, "live", i2c_lcd_scrollback_live, 1, each)) failures++;
+    if (!run (lcd, "top", i2c_lcd_scrollback_top, 1, each)) failures++;
+    if (!run (lcd, "live", i2c_lcd_scrollback_live, 1, each)) failures++;
+    }
+
+  // At the top, the oldest line still in the buffer should be showing
+  i2c_lcd_scrollback_top (lcd);
+  i2c_lcd_update (lcd);
+  char top[WIDTH + 1];
+  host_lcd_get_row (0, top);
+  i2c_lcd_get_scrollback_line (lcd, 0, line);
+  if (strcmp (top, line) != 0) failures++;
+  printf ("\ntop line: %s\n", top);
+
+  i2c_lcd_destroy (lcd);
+  printf ("\n%s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+  }
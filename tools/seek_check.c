@@ -0,0 +1,246 @@
+/*===========================================================================
+ * tools/seek_check.c
+ *
+ * Checks the times that scrollback lines carry, and scrolling back to a
+ * time, on the simulated Pico.
+ *
+ * A 20x4 console is given lines at known (simulated) times, some of
+ * them blank, and some long enough to wrap. Each line still held should
+ * have the time it was written -- a blank line, the time of the one
+ * before -- and, after a gap of more than nine hours, a time no more
+ * than 64 seconds early. Then it is scrolled back to many times, and
+ * each seek should find the same line as a search from the oldest line
+ * would, with that line at the top of the panel. The times should
+ * survive a change of width, and lines put back from the journal
+ * should have time zero.
+ *
+ * Last, the RAM that the times cost is worked out from what the
+ * consoles allocate, and a seek in a large buffer is timed, on the host,
+ * against a search from the oldest line.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+#include "replay.h"
+
+#define WIDTH 20
+#define HEIGHT 4
+#define PAGES 50
+#define LINES 600
+#define SEEKS 2000
+#define BIG_PAGES 2000
+#define TIMED_SEEKS 2000
+
+// The time each line was written, by line number
+static uint32_t want[LINES + 16];
+
+/*===========================================================================
+ * write_line
+ * Wait for gap seconds -- to just after the start of a second, so that
+ * the line is written within it -- and write line n, which may be blank
+ * or long enough to wrap.
+ * ========================================================================*/
+static void write_line (I2C_LCD *lcd, int n, uint32_t gap)
+  {
+  uint64_t now = time_us_64();
+  uint64_t at = (now / 1000000 + gap) * 1000000 + 1000;
+  if (at <= now) at += 1000000;
+  host_advance_us (at - now);
+  // The rows below the cursor are blank, and each would start a line
+  int row, col;
+  i2c_lcd_get_cursor (lcd, &row, &col);
+  uint32_t k = i2c_lcd_end_line (lcd) - HEIGHT + row;
+  if (n % 7 == 3)
+    want[k] = want[k - 1];
+  else
+    {
+    want[k] = (uint32_t)(time_us_64() / 1000000);
+    i2c_lcd_printf (lcd, "line %d%s", n,
+      n % 5 == 1 ? " which is long enough to wrap" : "");
+    }
+  i2c_lcd_print_char (lcd, '\r');
+  }
+
+/*===========================================================================
+ * times_right
+ * Check the times of the lines held, which are exact up to 'exact', and
+ * may be up to 64 seconds early after.
+ * ========================================================================*/
+static BOOL times_right (const I2C_LCD *lcd, uint32_t exact)
+  {
+  uint32_t t, last = 0;
+  uint32_t end = i2c_lcd_end_line (lcd) - HEIGHT;
+  for (uint32_t k = i2c_lcd_first_line (lcd); k != end; k++)
+    {
+    if (!i2c_lcd_get_line_time (lcd, k, &t)) return FALSE;
+    if (t < last) return FALSE;
+    if (k < exact && t != want[k]) return FALSE;
+    if (k >= exact && (t > want[k] || want[k] - t >= 64)) return FALSE;
+    last = t;
+    }
+  return TRUE;
+  }
+
+/*===========================================================================
+ * linear_seek
+ * The first line held that was started at or after t, found by looking
+ * at each in turn from the oldest.
+ * ========================================================================*/
+static uint32_t linear_seek (const I2C_LCD *lcd, uint32_t t)
+  {
+  uint32_t k = i2c_lcd_first_line (lcd), when;
+  uint32_t end = i2c_lcd_end_line (lcd);
+  while (k != end && i2c_lcd_get_line_time (lcd, k, &when) && when < t)
+    k++;
+  return k;
+  }
+
+/*===========================================================================
+ * seeks_right
+ * ========================================================================*/
+static BOOL seeks_right (I2C_LCD *lcd, uint32_t from, uint32_t to)
+  {
+  for (int i = 0; i < SEEKS; i++)
+    {
+    uint32_t t = from + (uint32_t)rand() % (to - from);
+    uint32_t number;
+    BOOL found = i2c_lcd_scrollback_seek (lcd, t, &number);
+    i2c_lcd_update (lcd);
+    uint32_t k = linear_seek (lcd, t);
+    if (!found)
+      {
+      // Every line above the display is older
+      if (k < number || i2c_lcd_get_scrollback (lcd) != 0) return FALSE;
+      continue;
+      }
+    if (k != number) return FALSE;
+    char line[I2C_LCD_LINE_MAX + 1], top[WIDTH + 1];
+    i2c_lcd_get_line (lcd, number, line, sizeof (line));
+    host_lcd_get_row (0, top);
+    int n = (int)strlen (line);
+    if (n > WIDTH) n = WIDTH;
+    if (memcmp (top, line, n) != 0) return FALSE;
+    }
+  i2c_lcd_scrollback_live (lcd);
+  i2c_lcd_update (lcd);
+  return TRUE;
+  }
+
+/*===========================================================================
+ * check_times
+ * ========================================================================*/
+static void check_times (void)
+  {
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    400000);
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT, t, PAGES);
+
+  printf ("%dx%d, %d pages of scrollback:\n", WIDTH, HEIGHT, PAGES);
+  srand (1);
+  int n = 0;
+  for (; n < LINES / 2; n++) write_line (lcd, n, (uint32_t)rand() % 300);
+  uint32_t start = want[i2c_lcd_first_line (lcd)];
+  uint32_t end = (uint32_t)(time_us_64() / 1000000);
+  replay_expect ("each line has its time; blank, the one before",
+    times_right (lcd, UINT32_MAX));
+  replay_expect ("seeks find the first line at or after",
+    seeks_right (lcd, start - 60, end + 60));
+
+  // Ten hours, then lines in quick succession
+  uint32_t exact = i2c_lcd_end_line (lcd) - 1;
+  write_line (lcd, n++, 10 * 3600);
+  for (; n < LINES; n++) write_line (lcd, n, (uint32_t)rand() % 5);
+  replay_expect ("after a ten-hour gap, within 64 seconds",
+    times_right (lcd, exact));
+  replay_expect ("seeks across the gap",
+    seeks_right (lcd, start, (uint32_t)(time_us_64() / 1000000) + 60));
+
+  i2c_lcd_set_geometry (lcd, 16, 2);
+  host_lcd_set_geometry (16, 2);
+  replay_expect ("a change of width keeps the times",
+    times_right (lcd, exact));
+  i2c_lcd_destroy (lcd);
+
+  // Lines put back from the journal
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT,
+    lcd_transport_mock_new(), PAGES);
+  i2c_lcd_restore_line (lcd, "from the journal", 16, FALSE);
+  i2c_lcd_restore_line (lcd, "and more", 8, FALSE);
+  uint32_t when0, when1;
+  BOOL ok = i2c_lcd_get_line_time (lcd, 0, &when0)
+    && i2c_lcd_get_line_time (lcd, 1, &when1) && when0 == 0 && when1 == 0;
+  replay_expect ("restored lines have time zero", ok);
+  i2c_lcd_destroy (lcd);
+  }
+
+/*===========================================================================
+ * measure
+ * ========================================================================*/
+static void measure (void)
+  {
+  // What a page of scrollback costs, from what two consoles allocate
+  I2C_LCD *a = i2c_lcd_new_with_transport (WIDTH, HEIGHT,
+    lcd_transport_mock_new(), PAGES);
+  I2C_LCD *b = i2c_lcd_new_with_transport (WIDTH, HEIGHT,
+    lcd_transport_mock_new(), 2 * PAGES);
+  double per_line = (double)(i2c_lcd_get_memory (b) - i2c_lcd_get_memory (a))
+    / (PAGES * HEIGHT) - WIDTH - (int)sizeof (uint32_t);
+  printf ("\ntimes:               %.3f bytes a line\n", per_line);
+  replay_expect ("about two bytes a line", per_line > 2.0 && per_line < 2.5);
+  i2c_lcd_destroy (a);
+  i2c_lcd_destroy (b);
+
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT,
+    lcd_transport_mock_new(), BIG_PAGES);
+  int lines = (BIG_PAGES - 1) * HEIGHT;
+  for (int i = 0; i < lines + HEIGHT; i++)
+    {
+    host_advance_us (1000000);
+    i2c_lcd_printf (lcd, "line %d\r", i);
+    }
+  uint32_t first;
+  i2c_lcd_get_line_time (lcd, i2c_lcd_first_line (lcd), &first);
+
+  uint64_t start = replay_wall_us();
+  uint32_t number, sum = 0;
+  for (int i = 0; i < TIMED_SEEKS; i++)
+    {
+    i2c_lcd_scrollback_seek (lcd, first + (uint32_t)rand() % lines, &number);
+    sum += number;
+    }
+  uint64_t seek_us = replay_wall_us() - start;
+
+  start = replay_wall_us();
+  for (int i = 0; i < TIMED_SEEKS; i++)
+    sum += linear_seek (lcd, first + (uint32_t)rand() % lines);
+  uint64_t linear_us = replay_wall_us() - start;
+  printf ("seek in %d lines:   %.2f us; from the oldest, %.2f us, "
+    "on the host\n", lines, (double)seek_us / TIMED_SEEKS,
+    (double)linear_us / TIMED_SEEKS);
+  if (sum == 0) printf ("\n");
+  i2c_lcd_destroy (lcd);
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  check_times();
+  measure();
+  printf ("\n%s\n", replay_failures() ? "FAILED" : "passed");
+  return replay_failures() ? 1 : 0;
+  }
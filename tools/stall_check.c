@@ -0,0 +1,201 @@
+/*===========================================================================
+ * tools/stall_check.c
+ *
+ * Checks the main-loop watchdog and its record of stalls, on the
+ * simulated Pico.
+ *
+ * A main loop like the firmware's runs three tasks like the firmware's:
+ * a USB scan on every pass, a display update every 100ms, and a blink
+ * every second. First the display updates are quick, and nothing
+ * should be recorded. Then they are made slower than the budget, and
+ * each should be recorded as the display's. Then the display task
+ * hangs, as it would waiting for a bus that never answers, and the
+ * watchdog should reset the (simulated) Pico. After the "reset", the
+ * record that survived it should say that the display task was stuck,
+ * and for how long, and still have the slow updates from before.
+ *
+ * Last, the cost of the hook that the scheduler calls around each task
+ * is measured, on the host.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pico/stdlib.h>
+#include <host/host_pico.h>
+#include <sched/sched.h>
+#include <stall/stall.h>
+#include "replay.h"
+
+#define WATCHDOG_MS 2000
+#define BUDGET_US 50000
+#define MAX_SLEEP_MS 100
+#define CALLS 10000000
+
+static int display_id;
+static uint32_t display_work_us = 5000;
+static BOOL hang = FALSE;
+static jmp_buf reset;
+
+// Set before the reset, and checked after it
+static volatile uint32_t slow_before = 0;
+
+/*===========================================================================
+ * Tasks
+ * ========================================================================*/
+static void usb_task (void *context)
+  {
+  (void)context;
+  busy_wait_us (100);
+  }
+
+static void display_task (void *context)
+  {
+  (void)context;
+  // Waiting for something that never comes
+  while (hang) busy_wait_us (1000);
+  busy_wait_us (display_work_us);
+  sched_start (display_id, 100000);
+  }
+
+static void blink_task (void *context)
+  {
+  (void)context;
+  }
+
+/*===========================================================================
+ * run_for
+ * Run the main loop, as the firmware's main() does.
+ * ========================================================================*/
+static void run_for (uint32_t ms)
+  {
+  uint64_t end = time_us_64() + (uint64_t)ms * 1000;
+  while (time_us_64() < end)
+    {
+    stall_pass();
+    absolute_time_t next = sched_run();
+    absolute_time_t limit = make_timeout_time_ms (MAX_SLEEP_MS);
+    if (absolute_time_diff_us (limit, next) > 0) next = limit;
+    stall_stage (STALL_ASLEEP);
+    best_effort_wfe_or_timeout (next);
+    }
+  }
+
+/*===========================================================================
+ * all_display
+ * TRUE if the over-budget stages in a record were all the display's.
+ * ========================================================================*/
+static BOOL all_display (const STALL_RECORD *r)
+  {
+  int n = r->slow < STALL_HISTORY ? (int)r->slow : STALL_HISTORY;
+  for (int i = 0; i < n; i++)
+    if (r->recent[i].stage != display_id || r->recent[i].us < BUDGET_US)
+      return FALSE;
+  return TRUE;
+  }
+
+/*===========================================================================
+ * before_reset
+ * ========================================================================*/
+static void before_reset (void)
+  {
+  stall_init (WATCHDOG_MS, BUDGET_US);
+  const STALL_RECORD *r = stall_get_record();
+  printf ("before the reset:\n");
+  replay_expect ("no record of a reset at power-on",
+    stall_last_reset() == NULL);
+
+  sched_start (display_id, 0);
+  run_for (5000);
+  replay_expect ("5 ms updates, for 5 s: nothing recorded", r->slow == 0);
+  printf ("    %lu passes, longest stage %s, %lu us\n",
+    (unsigned long)r->passes, sched_task_name (r->worst_stage),
+    (unsigned long)r->worst_us);
+
+  display_work_us = 80000;
+  uint32_t calls = sched_get_stats (display_id)->calls;
+  run_for (1000);
+  calls = sched_get_stats (display_id)->calls - calls;
+  replay_expect ("80 ms updates: each recorded as the display's",
+    calls > 0 && r->slow == calls && all_display (r));
+  slow_before = r->slow;
+
+  display_work_us = 5000;
+  hang = TRUE;
+  run_for (10000);
+  replay_expect ("the display task hangs: the watchdog resets", FALSE);
+  }
+
+/*===========================================================================
+ * after_reset
+ * ========================================================================*/
+static void after_reset (void)
+  {
+  hang = FALSE;
+  stall_init (WATCHDOG_MS, BUDGET_US);
+  const STALL_RECORD *last = stall_last_reset();
+  printf ("after the reset:\n");
+  replay_expect ("a record of the reset", last != NULL);
+  if (!last) return;
+
+  uint32_t stuck_us = last->timeout_ms * 1000
+    - (last->stage_start_us - last->fed_us);
+  printf ("    stuck in %s for %lu ms, %lu stages over budget\n",
+    sched_task_name (last->stage), (unsigned long)(stuck_us / 1000),
+    (unsigned long)last->slow);
+  replay_expect ("stuck in the display task", last->stage == display_id);
+  replay_expect ("for nearly the watchdog's timeout",
+    stuck_us > (WATCHDOG_MS - MAX_SLEEP_MS) * 1000
+    && stuck_us <= WATCHDOG_MS * 1000);
+  replay_expect ("the slow updates from before are kept",
+    last->slow == slow_before && all_display (last));
+  replay_expect ("one reset counted", stall_get_record()->resets == 1
+    && host_lcd_stats()->watchdog_resets == 1);
+  replay_expect ("a new record started", stall_get_record()->slow == 0);
+
+  // The loop carries on as before
+  sched_start (display_id, 0);
+  run_for (2000);
+  replay_expect ("running again: nothing recorded",
+    stall_get_record()->slow == 0
+    && host_lcd_stats()->watchdog_resets == 1);
+  }
+
+/*===========================================================================
+ * time_hook
+ * ========================================================================*/
+static void time_hook (void)
+  {
+  uint64_t start = replay_wall_us();
+  for (int i = 0; i < CALLS; i++)
+    stall_stage (i & 1 ? STALL_LOOP : display_id);
+  uint64_t us = replay_wall_us() - start;
+  printf ("\nhook:                %.1f ns a call, on the host\n",
+    us * 1000.0 / CALLS);
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  sched_add_polled ("usb", usb_task, NULL, 30, 0);
+  display_id = sched_add_oneshot ("display", display_task, NULL, 20, 0);
+  sched_add_periodic ("blink", blink_task, NULL, 1000000, 0, 0);
+  sched_set_hook (stall_stage);
+
+  host_watchdog_set_reset (&reset);
+  if (setjmp (reset) == 0)
+    before_reset();
+  else
+    after_reset();
+  host_watchdog_set_reset (NULL);
+
+  time_hook();
+  printf ("\n%s\n", replay_failures() ? "FAILED" : "passed");
+  return replay_failures() ? 1 : 0;
+  }
@@ -0,0 +1,144 @@
+/*===========================================================================
+ * tools/status_scroll.c
+ *
+ * Checks that a status region stays put while the rest of the display
+ * scrolls, and measures what scrolling and status updates cost.
+ *
+ * A 20x4 display is set up with a one-row status region, at the top and
+ * then at the bottom. Lines of text are written until the display has
+ * scrolled many times, with the status line updated (as a clock would
+ * be) between lines. After every line, and after scrolling back and
+ * forward again, the tool checks that the status row on the simulated
+ * panel is exactly what was last written to it. It reports how many
+ * characters and commands reached the HD44780 for each new line, and for
+ * each status update. Last, a console created after the status region
+ * was set aside must still fill the whole panel.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/i2c.h>
+#include <host/host_pico.h>
+#include <i2c_lcd/i2c_lcd.h>
+#include <i2c_lcd/lcd_transport.h>
+#include "config.h"
+
+#define WIDTH 20
+#define HEIGHT 4
+#define LINES 200
+
+/*===========================================================================
+ * status_ok
+ * ========================================================================*/
+static BOOL status_ok (int row, const char *expected)
+  {
+  char have[WIDTH + 1];
+  host_lcd_get_row (row, have);
+  return strcmp (have, expected) == 0;
+  }
+
+/*===========================================================================
+ * run
+ * Returns the number of times the status row was found to be wrong.
+ * ========================================================================*/
+static int run (int status_rows, BOOL at_top)
+  {
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  LCD_TRANSPORT *t = lcd_transport_i2c_new (PICO_DEFAULT_I2C_INSTANCE,
+    I2C_LCD_ADDRESS, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN,
+    400000);
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT, t, 4);
+  i2c_lcd_set_status_region (lcd, status_rows, at_top);
+  int status_row = at_top ? 0 : HEIGHT - 1;
+
+  int wrong = 0;
+  char status[WIDTH + 1], line[WIDTH + 1];
+  unsigned long line_cmds = 0, line_chars = 0;
+  unsigned long status_cmds = 0, status_chars = 0;
+  for (int i = 0; i < LINES; i++)
+    {
+    snprintf (status, sizeof (status), "STATUS      00:%02d:%02d",
+      i / 60 % 60, i % 60);
+    host_lcd_reset_stats();
+    i2c_lcd_set_status (lcd, 0, 0, status);
+    status_cmds += host_lcd_stats()->lcd_commands;
+    status_chars += host_lcd_stats()->lcd_chars;
+
+    snprintf (line, sizeof (line), "line %d", i);
+    host_lcd_reset_stats();
+    i2c_lcd_print_string (lcd, line);
+    i2c_lcd_print_char (lcd, '\r');
+    line_cmds += host_lcd_stats()->lcd_commands;
+    line_chars += host_lcd_stats()->lcd_chars;
+    if (status_rows && !status_ok (status_row, status)) wrong++;
+    }
+
+  // Scroll back a few lines, and forward again
+  for (int i = 0; i < 5; i++)
+    {
+    i2c_lcd_scrollback_line_up (lcd);
+    i2c_lcd_update (lcd);
+    if (status_rows && !status_ok (status_row, status)) wrong++;
+    }
+  for (int i = 0; i < 5; i++)
+    {
+    i2c_lcd_scrollback_line_down (lcd);
+    i2c_lcd_update (lcd);
+    if (status_rows && !status_ok (status_row, status)) wrong++;
+    }
+
+  printf ("%-8s %-12.1f %-12.1f %-12.1f %-12.1f %s\n",
+    status_rows ? (at_top ? "top" : "bottom") : "none",
+    (double)line_cmds / LINES, (double)line_chars / LINES,
+    (double)status_cmds / LINES, (double)status_chars / LINES,
+    wrong ? "WRONG" : "ok");
+  i2c_lcd_destroy (lcd);
+  return wrong;
+  }
+
+/*===========================================================================
+ * check_new_console
+ * A console created on a display with a status region gets the whole
+ * panel. Returns TRUE if, when shown, its last row reaches the bottom.
+ * ========================================================================*/
+static BOOL check_new_console (void)
+  {
+  host_lcd_set_geometry (WIDTH, HEIGHT);
+  I2C_LCD *lcd = i2c_lcd_new_with_transport (WIDTH, HEIGHT,
+    lcd_transport_mock_new(), 4);
+  i2c_lcd_set_status_region (lcd, 1, TRUE);
+  I2C_LCD *console = i2c_lcd_new_console (lcd, 4);
+  i2c_lcd_activate (console);
+  i2c_lcd_set_cursor (console, HEIGHT - 1, 0);
+  i2c_lcd_print_string (console, "bottom");
+  BOOL ok = i2c_lcd_get_panel_rows (console) == HEIGHT
+    && i2c_lcd_get_height (console) == HEIGHT;
+  char row[WIDTH + 1];
+  i2c_lcd_get_scrollback_line (console, i2c_lcd_scrollback_lines (console)
+    - 1, row);
+  ok = ok && strncmp (row, "bottom", 6) == 0;
+  printf ("\nconsole created after the region: %d rows, %s\n",
+    i2c_lcd_get_height (console), ok ? "ok" : "WRONG");
+  i2c_lcd_destroy (console);
+  i2c_lcd_destroy (lcd);
+  return ok;
+  }
+
+/*===========================================================================
+ * main
+ * ========================================================================*/
+int main (void)
+  {
+  printf ("%-8s %-12s %-12s %-12s %-12s %s\n", "status", "line cmds",
+    "line chars", "status cmds", "status chars", "status row");
+  int wrong = run (0, TRUE);
+  wrong += run (1, TRUE);
+  wrong += run (1, FALSE);
+  if (!check_new_console()) wrong++;
+  printf ("\n%s\n", wrong ? "FAILED" : "passed");
+  return wrong ? 1 : 0;
+  }
+
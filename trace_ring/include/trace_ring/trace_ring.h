@@ -0,0 +1,70 @@
+/*===========================================================================
+ * trace_ring/trace_ring.h
+ *
+ * A RAM ring buffer of variable-length records, for the HID and I2C
+ * traces (usb_kbd/hid_trace.h, i2c_lcd/i2c_trace.h), which are dumped
+ * as hex and read on a host.
+ *
+ * A record is some number of varints (7 bits per byte, least
+ * significant first, top bit set on all bytes except the last), then a
+ * fixed number of bytes, the last of which is the length of the data
+ * that follows. That is all the ring needs to know to find where a
+ * record ends, so that when a new record doesn't fit, whole records
+ * can be discarded from the tail to make room.
+ *
+ * A trace, as copied or dumped, is an eight-byte header -- four bytes
+ * of magic, a version, and three zero bytes -- followed by the records,
+ * oldest first.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define TRACE_RING_HEADER_SIZE 8
+
+// The most bytes a 32-bit value takes as a varint
+#define TRACE_RING_VARINT_MAX 5
+
+typedef struct _TRACE_RING TRACE_RING;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Create a ring of 'bytes' bytes, for records of 'varints' varints
+    and 'fixed' bytes before the data. The ring is made big enough for
+    the longest possible record, if 'bytes' is smaller. 'magic' is the
+    four bytes that start the trace. Returns NULL if there isn't the
+    memory. */
+extern TRACE_RING *trace_ring_new (int bytes, int varints, int fixed,
+                     const char *magic, int version);
+extern void        trace_ring_destroy (TRACE_RING *self);
+
+/** Discard all the records. */
+extern void        trace_ring_clear (TRACE_RING *self);
+
+/** Write v as a varint at rec, and return the number of bytes taken. */
+extern int         trace_ring_put_varint (uint8_t *rec, uint32_t v);
+
+/** Add a record of n bytes, discarding the oldest records to make room
+    for it. */
+extern void        trace_ring_record (TRACE_RING *self, const uint8_t *rec,
+                     int n);
+
+/** Copy the trace, header included, to buf, as much as fits. Returns
+    the size of the whole trace. */
+extern int         trace_ring_copy (const TRACE_RING *self, uint8_t *buf,
+                     int size);
+
+/** Write the whole trace to stdout, as hex, between the lines
+    "<name> BEGIN <size>" and "<name> END". */
+extern void        trace_ring_dump (const TRACE_RING *self,
+                     const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
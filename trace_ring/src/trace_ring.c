@@ -0,0 +1,169 @@
+/*===========================================================================
+ * trace_ring/trace_ring.c
+ *
+ * A RAM ring buffer of variable-length records. See trace_ring.h.
+ *
+ * The ring is just a ring of bytes. To make room for a new record, we
+ * discard whole records from the tail, parsing each one to find its
+ * length.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <trace_ring/trace_ring.h>
+
+struct _TRACE_RING
+  {
+  uint8_t *ring;
+  int size;
+  int head;     // Next byte to write
+  int tail;     // First byte of the oldest record
+  int used;
+  int varints;  // Varints at the start of a record
+  int fixed;    // Bytes after them, the last being the data length
+  uint8_t header[TRACE_RING_HEADER_SIZE];
+  };
+
+/*===========================================================================
+ * ring_at
+ * ========================================================================*/
+static inline uint8_t ring_at (const TRACE_RING *self, int offset)
+  {
+  return self->ring[(self->tail + offset) % self->size];
+  }
+
+/*===========================================================================
+ * drop_oldest
+ * Remove the oldest record from the ring.
+ * ========================================================================*/
+static void drop_oldest (TRACE_RING *self)
+  {
+  int n = 0;
+  for (int v = 0; v < self->varints; v++)
+    {
+    while (ring_at (self, n) & 0x80) n++;
+    n++; // Last byte of the varint
+    }
+  int len = ring_at (self, n + self->fixed - 1);
+  n += self->fixed + len;
+  self->tail = (self->tail + n) % self->size;
+  self->used -= n;
+  }
+
+/*===========================================================================
+ * trace_at
+ * A byte of the trace, header included.
+ * ========================================================================*/
+static uint8_t trace_at (const TRACE_RING *self, int i)
+  {
+  return i < TRACE_RING_HEADER_SIZE
+    ? self->header[i] : ring_at (self, i - TRACE_RING_HEADER_SIZE);
+  }
+
+/*===========================================================================
+ * trace_ring_new
+ * ========================================================================*/
+TRACE_RING *trace_ring_new (int bytes, int varints, int fixed,
+              const char *magic, int version)
+  {
+  // Must be able to hold at least one record, or drop_oldest() will
+  //   run off the end.
+  int longest = varints * TRACE_RING_VARINT_MAX + fixed + 255;
+  if (bytes < longest) bytes = longest;
+  TRACE_RING *self = malloc (sizeof (TRACE_RING));
+  if (!self) return NULL;
+  self->ring = malloc (bytes);
+  if (!self->ring)
+    {
+    free (self);
+    return NULL;
+    }
+  self->size = bytes;
+  self->varints = varints;
+  self->fixed = fixed;
+  memset (self->header, 0, TRACE_RING_HEADER_SIZE);
+  memcpy (self->header, magic, 4);
+  self->header[4] = (uint8_t)version;
+  trace_ring_clear (self);
+  return self;
+  }
+
+/*===========================================================================
+ * trace_ring_destroy
+ * ========================================================================*/
+void trace_ring_destroy (TRACE_RING *self)
+  {
+  if (!self) return;
+  free (self->ring);
+  free (self);
+  }
+
+/*===========================================================================
+ * trace_ring_clear
+ * ========================================================================*/
+void trace_ring_clear (TRACE_RING *self)
+  {
+  self->head = 0;
+  self->tail = 0;
+  self->used = 0;
+  }
+
+/*===========================================================================
+ * trace_ring_put_varint
+ * ========================================================================*/
+int trace_ring_put_varint (uint8_t *rec, uint32_t v)
+  {
+  int n = 0;
+  do
+    {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    if (v) b |= 0x80;
+    rec[n++] = b;
+    } while (v);
+  return n;
+  }
+
+/*===========================================================================
+ * trace_ring_record
+ * ========================================================================*/
+void trace_ring_record (TRACE_RING *self, const uint8_t *rec, int n)
+  {
+  while (self->size - self->used < n) drop_oldest (self);
+
+  for (int i = 0; i < n; i++)
+    {
+    self->ring[self->head] = rec[i];
+    self->head = (self->head + 1) % self->size;
+    }
+  self->used += n;
+  }
+
+/*===========================================================================
+ * trace_ring_copy
+ * ========================================================================*/
+int trace_ring_copy (const TRACE_RING *self, uint8_t *buf, int size)
+  {
+  int total = TRACE_RING_HEADER_SIZE + self->used;
+  for (int i = 0; i < total && i < size; i++) buf[i] = trace_at (self, i);
+  return total;
+  }
+
+/*===========================================================================
+ * trace_ring_dump
+ * ========================================================================*/
+void trace_ring_dump (const TRACE_RING *self, const char *name)
+  {
+  int total = TRACE_RING_HEADER_SIZE + self->used;
+  printf ("%s BEGIN %d\n", name, total);
+  for (int i = 0; i < total; i++)
+    {
+    printf ("%02X", trace_at (self, i));
+    if (i % 32 == 31 || i == total - 1) printf ("\n");
+    }
+  printf ("%s END\n", name);
+  }
+
@@ -0,0 +1,66 @@
+/*===========================================================================
+ * usb_kbd/hid_trace.h
+ *
+ * Capture of raw HID reports into a RAM ring buffer, so that what a
+ * keyboard actually sent can be dumped and replayed later.
+ *
+ * Trace format. A trace is a header followed by a sequence of records.
+ * All multi-byte values are little-endian.
+ *
+ *   header:  'H' 'I' 'D' 'T'  version (1 byte)  flags (1 byte)
+ *            reserved (2 bytes)
+ *   record:  time delta, microseconds since the previous record, as a
+ *              varint (7 bits per byte, least significant first, top
+ *              bit set on all bytes except the last)
+ *            device address (1 byte)
+ *            interface instance (1 byte)
+ *            report length (1 byte)
+ *            report (length bytes)
+ *
+ * In version 1, the device address and instance shared a byte, the
+ * address in the top four bits, so addresses above 15 were cut short.
+ * The replay tool still reads version 1 traces.
+ *
+ * A keyboard boot report is eight bytes, so a typical record is twelve
+ * or thirteen bytes. When the ring is full, the oldest records are
+ * discarded. The time delta of the first record in a dump is relative to
+ * a record that is no longer present, and should be ignored.
+ *
+ * hid_trace_dump() writes the trace to stdout as hex, between the lines
+ * "HIDTRACE BEGIN" and "HIDTRACE END". The host-side replay tool in
+ * tools/ can read either this text form or the raw binary.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define HID_TRACE_MAGIC "HIDT"
+#define HID_TRACE_VERSION 2
+#define HID_TRACE_HEADER_SIZE 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Allocate a trace buffer of the specified size, and start capturing.
+    Until this is called, hid_trace_record() does nothing. */
+extern void hid_trace_init (int bytes);
+
+/** Record one raw HID report. Called from the TinyUSB report callback. */
+extern void hid_trace_record (uint8_t dev_addr, uint8_t instance,
+              const uint8_t *report, uint16_t len);
+
+/** Write the whole trace to stdout, as hex. */
+extern void hid_trace_dump (void);
+
+/** Discard all recorded reports. */
+extern void hid_trace_clear (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
@@ -15,6 +15,12 @@ extern void usb_kbd_init (void);
 /** Read the USB input queue and dispatch callback functions. */
 extern void usb_kbd_scan (void);
 
+/** The USB device address of the keyboard whose report is being 
+    processed. This is only meaningful when called from 
+    kbd_raw_key_down(), and allows keystrokes from different keyboards 
+    (or barcode scanners) to be told apart. */
+extern int usb_kbd_current_device (void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,8 @@
  * ========================================================================*/
 
 #include <kbd/kbd.h>
+#include <usb_kbd/usb_kbd.h>
+#include <usb_kbd/hid_trace.h>
 #include "bsp/board.h"
 #include "tusb.h"
 
@@ -92,18 +94,18 @@ static int conv_table_us[128][2] =
     {'.'   , '>'    }, /* 0x37 */ \
     {'/'   , '?'    }, /* 0x38 */ \
     {0     , 0      }, /* 0x39 */ \
-    {0     , 0      }, /* 0x3a */ \
-    {0     , 0      }, /* 0x3b */ \
-    {0     , 0      }, /* 0x3c */ \
-    {0     , 0      }, /* 0x3d */ \
-    {0     , 0      }, /* 0x3e */ \
-    {0     , 0      }, /* 0x3f */ \
-    {0     , 0      }, /* 0x40 */ \
-    {0     , 0      }, /* 0x41 */ \
-    {0     , 0      }, /* 0x42 */ \
-    {0     , 0      }, /* 0x43 */ \
-    {0     , 0      }, /* 0x44 */ \
-    {0     , 0      }, /* 0x45 */ \
+    {KBD_KEY_F1 + 0, KBD_KEY_F1 + 0}, /* 0x3a */ \
+    {KBD_KEY_F1 + 1, KBD_KEY_F1 + 1}, /* 0x3b */ \
+    {KBD_KEY_F1 + 2, KBD_KEY_F1 + 2}, /* 0x3c */ \
+    {KBD_KEY_F1 + 3, KBD_KEY_F1 + 3}, /* 0x3d */ \
+    {KBD_KEY_F1 + 4, KBD_KEY_F1 + 4}, /* 0x3e */ \
+    {KBD_KEY_F1 + 5, KBD_KEY_F1 + 5}, /* 0x3f */ \
+    {KBD_KEY_F1 + 6, KBD_KEY_F1 + 6}, /* 0x40 */ \
+    {KBD_KEY_F1 + 7, KBD_KEY_F1 + 7}, /* 0x41 */ \
+    {KBD_KEY_F1 + 8, KBD_KEY_F1 + 8}, /* 0x42 */ \
+    {KBD_KEY_F1 + 9, KBD_KEY_F1 + 9}, /* 0x43 */ \
+    {KBD_KEY_F1 + 10, KBD_KEY_F1 + 10}, /* 0x44 */ \
+    {KBD_KEY_F1 + 11, KBD_KEY_F1 + 11}, /* 0x45 */ \
     {0     , 0      }, /* 0x46 */ \
     {0     , 0      }, /* 0x47 */ \
     {0     , 0      }, /* 0x48 */ \
@@ -140,6 +142,17 @@ static int conv_table_us[128][2] =
 
 /* =================  End keycode translation table. ================== */
 
+// Address of the device whose report is being processed
+static int current_dev = 0;
+
+/*===========================================================================
+ * usb_kbd_current_device
+ * ========================================================================*/
+int usb_kbd_current_device (void)
+  {
+  return current_dev;
+  }
+
 /*===========================================================================
  * is_key_held 
  * Check whether the current key scancode is a repetition of the previous
@@ -225,6 +238,10 @@ void tuh_hid_report_received_cb  (uint8_t dev_addr, uint8_t instance,
       uint8_t const* report, uint16_t len)
   {
   (void) instance; (void) len;
+  // Record the report exactly as it arrived, before we interpret it
+  hid_trace_record (dev_addr, instance, report, len);
+  current_dev = dev_addr;
+
   // In principle we don't need to test that this USB report came from
   //   a keyboard, since we are only asking for reports from keyboards.
   // But, for future expansion, we should be systematic
@@ -0,0 +1,75 @@
+/*===========================================================================
+ * usb_kbd/hid_trace.c
+ *
+ * Capture of raw HID reports into a RAM ring buffer. See hid_trace.h for
+ * the trace format.
+ *
+ * The records are kept in a trace_ring: one varint, and three bytes
+ * before the report, the last of which is its length.
+ *
+ * Copyright (c)2022 Kevin Boone, GPL v3.0
+ * ========================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <trace_ring/trace_ring.h>
+#include <usb_kbd/hid_trace.h>
+
+// Longest possible record: five bytes of varint, three header bytes, 
+//   and a report of up to 255 bytes.
+#define HID_TRACE_MAX_RECORD (TRACE_RING_VARINT_MAX + 3 + 255)
+
+static TRACE_RING *ring = NULL;
+static uint32_t last_us = 0;
+
+/*===========================================================================
+ * hid_trace_init
+ * ========================================================================*/
+void hid_trace_init (int bytes)
+  {
+  trace_ring_destroy (ring);
+  ring = trace_ring_new (bytes, 1, 3, HID_TRACE_MAGIC, HID_TRACE_VERSION);
+  hid_trace_clear ();
+  }
+
+/*===========================================================================
+ * hid_trace_clear
+ * ========================================================================*/
+void hid_trace_clear (void)
+  {
+  if (ring) trace_ring_clear (ring);
+  last_us = time_us_32();
+  }
+
+/*===========================================================================
+ * hid_trace_record
+ * ========================================================================*/
+void hid_trace_record (uint8_t dev_addr, uint8_t instance,
+       const uint8_t *report, uint16_t len)
+  {
+  if (!ring) return;
+  if (len > 255) len = 255;
+
+  uint8_t rec[HID_TRACE_MAX_RECORD];
+  uint32_t now = time_us_32();
+  int n = trace_ring_put_varint (rec, now - last_us);
+  last_us = now;
+  rec[n++] = dev_addr;
+  rec[n++] = instance;
+  rec[n++] = (uint8_t)len;
+  memcpy (rec + n, report, len);
+  n += len;
+  trace_ring_record (ring, rec, n);
+  }
+
+/*===========================================================================
+ * hid_trace_dump
+ * ========================================================================*/
+void hid_trace_dump (void)
+  {
+  if (ring)
+    trace_ring_dump (ring, "HIDTRACE");
+  else
+    printf ("HID tracing is off\n");
+  }